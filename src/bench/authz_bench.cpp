@@ -0,0 +1,206 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+/*
+ * Benchmark of topic authorization checks under policy reloads (topicauthorizationservice.cpp).
+ *
+ *   authz_bench [readers] [reload interval] [seconds]
+ *       Reader threads check publish and subscribe authorizations, while a reload thread
+ *       replaces the authorization state every reload interval (microseconds, 0 to replace it
+ *       continuously, -1 to never replace it). Reports the checks per second of each reader,
+ *       the latency percentiles of the checks, the cache hit rate, and the time taken to
+ *       replace the state. Contention only shows with a CPU per thread.
+ */
+
+#include "include/BrokerSettings.h"
+#include "topicauthorization/include/topicauthorizationservice.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace dxl::broker;
+
+typedef chrono::steady_clock Clock;
+
+/* The broker setting that the JSON service reads (the broker settings are not linked) */
+bool BrokerSettings::sm_jsonPrettyPrint = false;
+
+/** A service that is not the broker instance */
+class BenchAuthorizationService : public TopicAuthorizationService
+{
+public:
+    BenchAuthorizationService() {}
+};
+
+/** The results of a reader thread */
+struct ReaderResult
+{
+    /** The count of checks */
+    long checks;
+    /** The count of state replacements observed */
+    long statesSeen;
+    /** The elapsed time (seconds) */
+    double seconds;
+    /** The sampled check latencies (ns) */
+    vector<double> latencies;
+};
+
+/**
+ * Creates an authorization state of 200 wildcard topics, each authorized for a few of 16 clients
+ *
+ * @param   seed The seed of the state
+ * @return  The state
+ */
+static shared_ptr<TopicAuthorizationState> createState( unsigned int seed )
+{
+    srand( seed );
+    TopicAuthorizationState::TopicAuthorizationStateData publish, subscribe;
+    for( int i = 0; i < 200; i++ )
+    {
+        string topic = "/a" + to_string( rand() % 10 ) + "/b" + to_string( rand() % 10 ) + "/#";
+        for( int k = 0; k < 2; k++ )
+        {
+            publish[topic].insert( "client" + to_string( rand() % 16 ) );
+            subscribe[topic].insert( "client" + to_string( rand() % 16 ) );
+        }
+    }
+    publish["/seed" + to_string( seed )].insert( "client0" );
+    return make_shared<TopicAuthorizationState>( publish, subscribe );
+}
+
+/**
+ * Checks authorizations until the end time
+ *
+ * @param   service The service
+ * @param   end The end time
+ * @param   result The results of the thread
+ */
+static void checkAuthorizations( BenchAuthorizationService* service, Clock::time_point end, ReaderResult* result )
+{
+    vector<string> topics, clientIds;
+    for( int i = 0; i < 1000; i++ )
+    {
+        topics.push_back( "/a" + to_string( i % 10 ) + "/b" + to_string( i / 10 % 10 ) +
+            "/c" + to_string( i / 100 ) + "/d" );
+    }
+    for( int i = 0; i < 8; i++ )
+    {
+        clientIds.push_back( "client" + to_string( i ) );
+    }
+
+    result->checks = 0;
+    result->statesSeen = 0;
+    result->latencies.reserve( 1 << 20 );
+    const TopicAuthorizationState* lastState = NULL;
+    size_t authorized = 0;
+    Clock::time_point start = Clock::now(), now;
+    do
+    {
+        for( int i = 0; i < 256; i++, result->checks++ )
+        {
+            const string& clientId = clientIds[result->checks % clientIds.size()];
+            const string& topic = topics[( result->checks * 7 ) % topics.size()];
+            if( ( i & 15 ) == 0 )
+            {
+                // Sample the latency of every 16th check
+                Clock::time_point before = Clock::now();
+                authorized += service->isAuthorizedToPublish( clientId, topic );
+                result->latencies.push_back( chrono::duration<double, nano>( Clock::now() - before ).count() );
+            }
+            else
+            {
+                authorized += ( result->checks & 1 ) ?
+                    service->isAuthorizedToPublish( clientId, topic ) :
+                    service->isAuthorizedToSubscribe( clientId, topic );
+            }
+        }
+
+        const TopicAuthorizationState* state = service->getTopicAuthorizationState().get();
+        if( state != lastState )
+        {
+            result->statesSeen++;
+            lastState = state;
+        }
+        now = Clock::now();
+    } while( now < end );
+
+    result->seconds = chrono::duration<double>( now - start ).count();
+    if( !authorized )
+    {
+        fprintf( stderr, "no check was authorized\n" );
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if( argc > 1 && atoi( argv[1] ) <= 0 )
+    {
+        fprintf( stderr, "usage: %s [readers] [reload interval] [seconds]\n", argv[0] );
+        return 1;
+    }
+    int readers = argc > 1 ? atoi( argv[1] ) : 1;
+    int reloadInterval = argc > 2 ? atoi( argv[2] ) : 0;
+    int seconds = argc > 3 ? atoi( argv[3] ) : 2;
+
+    BenchAuthorizationService service;
+    shared_ptr<TopicAuthorizationState> states[] = { createState( 1 ), createState( 2 ) };
+    service.setTopicState( states[0] );
+
+    atomic<bool> stop( false );
+    long reloads = 0;
+    double reloadNs = 0;
+    thread reloader( [&]() {
+        while( reloadInterval >= 0 && !stop.load() )
+        {
+            Clock::time_point before = Clock::now();
+            service.setTopicState( states[++reloads % 2] );
+            reloadNs += chrono::duration<double, nano>( Clock::now() - before ).count();
+            if( reloadInterval > 0 )
+            {
+                this_thread::sleep_for( chrono::microseconds( reloadInterval ) );
+            }
+        }
+    } );
+
+    Clock::time_point end = Clock::now() + chrono::seconds( seconds );
+    vector<ReaderResult> results( readers );
+    vector<thread> threads;
+    for( int i = 0; i < readers; i++ )
+    {
+        threads.push_back( thread( checkAuthorizations, &service, end, &results[i] ) );
+    }
+    for( size_t i = 0; i < threads.size(); i++ )
+    {
+        threads[i].join();
+    }
+    stop = true;
+    reloader.join();
+
+    printf( "%d readers, %u CPUs, reload interval %d us:\n", readers, thread::hardware_concurrency(),
+        reloadInterval );
+    vector<double> latencies;
+    for( int i = 0; i < readers; i++ )
+    {
+        printf( "  reader %d: %.2f M checks/s, %ld states seen\n", i,
+            results[i].checks / results[i].seconds / 1e6, results[i].statesSeen );
+        latencies.insert( latencies.end(), results[i].latencies.begin(), results[i].latencies.end() );
+    }
+    sort( latencies.begin(), latencies.end() );
+    printf( "  check latency: p50 %.0f ns, p99 %.0f ns, p99.9 %.0f ns, max %.1f us\n",
+        latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100],
+        latencies[latencies.size() * 999 / 1000], latencies.back() / 1000 );
+    uint64_t hits = service.getCacheHitCount(), misses = service.getCacheMissCount();
+    printf( "  cache hits %.1f%%, %ld reloads, %.0f ns/reload\n",
+        100.0 * hits / ( hits + misses ), reloads, reloads ? reloadNs / reloads : 0 );
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+/*
+ * Benchmark of the decoding of DXL messages (messageImpl.cpp).
+ *
+ *   decode_bench [small count] [large count]
+ *       Decodes a small request (200 byte payload) and a large event (1 MB payload), and
+ *       reports the time and the count of heap allocations per message for each mode:
+ *         full           createDxlMessageFromBytes (every field and the payload are copied)
+ *         header         parseDxlMessageHeader (the fields reference the bytes, as routing does)
+ *         header+fields  parseDxlMessageHeader and createDxlMessageFromHeader without the
+ *                        payload (as the fields of a lazily decoded message are materialized)
+ */
+
+#include "message/include/dx_message.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+/** The count of heap allocations */
+static size_t g_allocs = 0;
+
+/* Allocations are counted by interposing the allocator (glibc) */
+extern "C" void* __libc_malloc( size_t size );
+extern "C" void* __libc_calloc( size_t nmemb, size_t size );
+extern "C" void* __libc_realloc( void* ptr, size_t size );
+extern "C" void* malloc( size_t size ) { g_allocs++; return __libc_malloc( size ); }
+extern "C" void* calloc( size_t nmemb, size_t size ) { g_allocs++; return __libc_calloc( nmemb, size ); }
+extern "C" void* realloc( void* ptr, size_t size ) { g_allocs++; return __libc_realloc( ptr, size ); }
+
+/** Prevents the decoding from being optimized away */
+static volatile size_t g_sink = 0;
+
+/**
+ * Creates a message as a client would send it
+ *
+ * @param   type The type of the message
+ * @param   payloadSize The size of the payload
+ * @return  The message
+ */
+static dxl_message_t* createMessage( dxl_message_type_t type, size_t payloadSize )
+{
+    dxl_message_t* message = NULL;
+    if( createDxlMessage( NULL, type, "{4e8f3a2c-1b7d-4c55-9e2a-0f6b8d1c3e57}", "instance", NULL, &message )
+        != DXLMP_OK )
+    {
+        fprintf( stderr, "failed to create the message\n" );
+        exit( 1 );
+    }
+
+    setDxlMessageSourceBrokerGuid( NULL, message, "{0d4e6f7a-8b9c-4d1e-a2f3-b4c5d6e7f809}" );
+    setDxlMessageSourceTenantGuid( NULL, message, "{7c1d2e3f-4a5b-4c6d-8e9f-0a1b2c3d4e5f}" );
+    const char* guids[] = { "{a1b2c3d4-e5f6-4a7b-8c9d-0e1f2a3b4c5d}" };
+    setDxlMessageBrokerGuids( NULL, message, guids, 1 );
+    setDxlMessageClientGuids( NULL, message, guids, 1 );
+    setDxlMessageTenantGuids( NULL, message, guids, 1 );
+    const char* otherFields[] = { "key", "value" };
+    setDxlMessageOtherFields( NULL, message, otherFields, 2 );
+
+    string payload( payloadSize, '\0' );
+    for( size_t i = 0; i < payloadSize; i++ )
+    {
+        payload[i] = (char)( i * 31 );
+    }
+    setDxlMessagePayload( NULL, message, (const unsigned char*)payload.data(), payloadSize );
+
+    if( type == DXLMP_REQUEST )
+    {
+        setDxlRequestMessageAttributes( NULL, message, reply_to_topic,
+            "/mcafee/client/{4e8f3a2c-1b7d-4c55-9e2a-0f6b8d1c3e57}" );
+        setDxlRequestMessageAttributes( NULL, message, service_instance_id,
+            "{5f6a7b8c-9d0e-4f1a-2b3c-4d5e6f7a8b9c}" );
+    }
+
+    return message;
+}
+
+/**
+ * Prints the time and allocations per message of a run
+ *
+ * @param   name The name of the mode
+ * @param   start The start of the run
+ * @param   allocs The count of allocations at the start of the run
+ * @param   count The count of messages decoded
+ */
+static void report( const char* name, chrono::steady_clock::time_point start, size_t allocs, int count )
+{
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    printf( "  %-14s %10.1f ns/message  %5.2f allocs/message\n", name,
+        chrono::duration<double, nano>( end - start ).count() / count, (double)( g_allocs - allocs ) / count );
+}
+
+/**
+ * Benchmarks the decoding of a message
+ *
+ * @param   type The type of the message
+ * @param   payloadSize The size of the payload
+ * @param   count The count of messages to decode per mode
+ */
+static void benchDecode( dxl_message_type_t type, size_t payloadSize, int count )
+{
+    dxl_message_t* message = createMessage( type, payloadSize );
+    unsigned char* bytes = NULL;
+    size_t size = 0;
+    if( dxlMessageToBytes( NULL, &bytes, &size, message, 0 ) != DXLMP_OK )
+    {
+        fprintf( stderr, "failed to serialize the message\n" );
+        exit( 1 );
+    }
+
+    printf( "%s (%zu byte payload, %zu bytes serialized):\n",
+        type == DXLMP_REQUEST ? "request" : "event", payloadSize, size );
+
+    size_t allocs = g_allocs;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for( int i = 0; i < count; i++ )
+    {
+        dxl_message_t* decoded = NULL;
+        if( createDxlMessageFromBytes( NULL, bytes, size, &decoded ) == DXLMP_OK )
+        {
+            g_sink += decoded->payloadSize;
+            freeDxlMessage( NULL, decoded );
+        }
+    }
+    report( "full", start, allocs, count );
+
+    allocs = g_allocs;
+    start = chrono::steady_clock::now();
+    for( int i = 0; i < count; i++ )
+    {
+        dxl_message_header_t header;
+        if( parseDxlMessageHeader( NULL, bytes, size, &header ) == DXLMP_OK )
+        {
+            g_sink += header.brokerGuids.count + header.clientGuids.count + header.payloadSize;
+        }
+    }
+    report( "header", start, allocs, count );
+
+    allocs = g_allocs;
+    start = chrono::steady_clock::now();
+    for( int i = 0; i < count; i++ )
+    {
+        dxl_message_header_t header;
+        dxl_message_t* decoded = NULL;
+        if( parseDxlMessageHeader( NULL, bytes, size, &header ) == DXLMP_OK &&
+            createDxlMessageFromHeader( NULL, &header, 1, &decoded ) == DXLMP_OK )
+        {
+            g_sink += decoded->brokerGuidCount;
+            freeDxlMessage( NULL, decoded );
+        }
+    }
+    report( "header+fields", start, allocs, count );
+
+    dxlMessageReleaseSerializedBytes( NULL, bytes );
+    freeDxlMessage( NULL, message );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc > 1 && atoi( argv[1] ) <= 0 )
+    {
+        fprintf( stderr, "usage: %s [small count] [large count]\n", argv[0] );
+        return 1;
+    }
+
+    benchDecode( DXLMP_REQUEST, 200, argc > 1 ? atoi( argv[1] ) : 1000000 );
+    benchDecode( DXLMP_EVENT, 1024 * 1024, argc > 2 ? atoi( argv[2] ) : 2000 );
+
+    return 0;
+}
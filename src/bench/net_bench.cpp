@@ -0,0 +1,512 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+/*
+ * Benchmark of the socket reads and writes of the broker (net_mosq.c).
+ *
+ *   net_bench read [bursts]
+ *       A client sends bursts of QoS 0 publishes over a socket pair, and the broker reads
+ *       them (_mosquitto_packet_read, once per readiness event) until the socket is drained.
+ *       Reports the count of read system calls per message, the count of messages that are
+ *       handled per readiness event, and the time per message (including the sends of the
+ *       client), for payloads that fit the receive buffer of a connection and payloads that
+ *       exceed it.
+ *
+ *   net_bench write [bursts]
+ *       The broker queues bursts of QoS 0 publishes to a client (over TCP and over TLS) and
+ *       flushes them (_mosquitto_packet_write, as the write threads or a writable socket do)
+ *       until they are written. Reports the count of write system calls per message, the
+ *       (unencrypted) bytes per write system call and the time of the flushes per message.
+ *       The gathered writes (writev, and TLS records staged across packets) are compared to
+ *       a reference that writes each packet on its own, as _mosquitto_packet_write did before.
+ */
+
+#include <config.h>
+#include <mosquitto_broker.h>
+#include <memory_mosq.h>
+#include <mqtt3_protocol.h>
+#include <net_mosq.h>
+#include "dxl.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/ec.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+/** The count of read system calls */
+static size_t g_reads = 0;
+
+/** The count of write system calls */
+static size_t g_writes = 0;
+
+/* System calls are counted by interposing read, write and writev (glibc) */
+extern "C" ssize_t read( int fd, void* buf, size_t count )
+{
+    g_reads++;
+    return syscall( SYS_read, fd, buf, count );
+}
+extern "C" ssize_t write( int fd, const void* buf, size_t count )
+{
+    g_writes++;
+    return syscall( SYS_write, fd, buf, count );
+}
+extern "C" ssize_t writev( int fd, const struct iovec* iov, int iovcnt )
+{
+    g_writes++;
+    return syscall( SYS_writev, fd, iov, iovcnt );
+}
+
+/** The count of write threads (more than one defers the writes of queued packets) */
+static int g_writeThreadCount = 1;
+
+/** The count of packets that the broker has handled */
+static size_t g_handled = 0;
+
+/*
+ * The broker functions that the socket reads and writes call
+ */
+int log_priorities = 0;
+int g_ws_pre_buffer_size = 0;
+int _mosquitto_log_printf( struct mosquitto*, int, const char*, ... ) { return 0; }
+int _mosquitto_socket_get_address( int, char*, int, int* ) { return 1; }
+int _mosquitto_server_certificate_verify( int preverify_ok, X509_STORE_CTX* ) { return preverify_ok; }
+time_t mosquitto_time_cached() { return 0; }
+void _mosquitto_frame_release( struct _mosquitto_frame* ) {}
+void mosquitto_update_context( uint32_t, struct mosquitto* ) {}
+void mosquitto_context_timer_update( struct mosquitto*, time_t ) {}
+void mosquitto_add_pending_bytes_set( struct mosquitto* ) {}
+void mosquitto_remove_pending_bytes_set( struct mosquitto* ) {}
+void mosquitto_add_pending_writes_set( struct mosquitto* ) {}
+int mosquitto_write_thread_count() { return g_writeThreadCount; }
+void mosquitto_ws_request_writeable_callback( struct mosquitto* ) {}
+int mosquitto_ws_write( struct mosquitto*, uint8_t*, uint32_t ) { return -1; }
+bool dxl_update_sent_byte_count( struct mosquitto*, uint32_t ) { return false; }
+bool dxl_is_tenant_connection_allowed( struct mosquitto* ) { return true; }
+void mqtt3_context_disconnect( struct mosquitto_db*, struct mosquitto* context )
+{
+    context->sock = INVALID_SOCKET;
+}
+int mqtt3_packet_handle( struct mosquitto_db*, struct mosquitto* )
+{
+    g_handled++;
+    return MOSQ_ERR_SUCCESS;
+}
+
+/**
+ * Appends a QoS 0 publish to the specified bytes
+ *
+ * @param   bytes The bytes
+ * @param   payloadSize The size of the payload of the publish
+ */
+static void appendPublish( vector<uint8_t>& bytes, uint32_t payloadSize )
+{
+    static const char topic[] = "/mcafee/event/bench";
+    uint16_t topicLen = (uint16_t)strlen( topic );
+    uint32_t remainingLength = 2 + topicLen + payloadSize;
+
+    bytes.push_back( PUBLISH );
+    do
+    {
+        uint8_t byte = remainingLength % 128;
+        remainingLength /= 128;
+        bytes.push_back( remainingLength > 0 ? ( byte | 128 ) : byte );
+    } while( remainingLength > 0 );
+    bytes.push_back( topicLen >> 8 );
+    bytes.push_back( topicLen & 0xFF );
+    bytes.insert( bytes.end(), topic, topic + topicLen );
+    bytes.insert( bytes.end(), payloadSize, 'x' );
+}
+
+/**
+ * Returns the count of bytes that can be read from the specified socket
+ *
+ * @param   sock The socket
+ * @return  The count of bytes that can be read from the socket
+ */
+static int readable( int sock )
+{
+    int count = 0;
+    ioctl( sock, FIONREAD, &count );
+    return count;
+}
+
+/**
+ * Sends bursts of publishes to the broker, and reports the reads of the broker
+ *
+ * @param   payloadSize The size of the payload of the publishes
+ * @param   burst The count of publishes per burst
+ * @param   bursts The count of bursts
+ */
+static void benchRead( uint32_t payloadSize, int burst, int bursts )
+{
+    int socks[2];
+    if( socketpair( AF_UNIX, SOCK_STREAM, 0, socks ) )
+    {
+        perror( "socketpair" );
+        exit( 1 );
+    }
+    fcntl( socks[0], F_SETFL, fcntl( socks[0], F_GETFL, 0 ) | O_NONBLOCK );
+
+    struct mqtt3_config config;
+    memset( &config, 0, sizeof( config ) );
+    struct mosquitto_db db;
+    memset( &db, 0, sizeof( db ) );
+    db.config = &config;
+
+    struct mosquitto* context = (struct mosquitto*)calloc( 1, sizeof( struct mosquitto ) );
+    context->sock = socks[0];
+    context->state = mosq_cs_connected;
+    context->in_packet.remaining_mult = 1;
+
+    vector<uint8_t> bytes;
+    for( int i = 0; i < burst; i++ )
+    {
+        appendPublish( bytes, payloadSize );
+    }
+
+    size_t readsBefore = g_reads;
+    size_t handledBefore = g_handled;
+    size_t events = 0;
+    auto start = chrono::steady_clock::now();
+    for( int i = 0; i < bursts; i++ )
+    {
+        size_t sent = 0;
+        while( sent < bytes.size() || readable( socks[0] ) > 0 )
+        {
+            if( sent < bytes.size() )
+            {
+                ssize_t len = send( socks[1], &bytes[sent], bytes.size() - sent, MSG_DONTWAIT );
+                if( len > 0 )
+                {
+                    sent += len;
+                }
+                else if( errno != EAGAIN )
+                {
+                    perror( "send" );
+                    exit( 1 );
+                }
+            }
+            // A readiness event of the socket of the broker
+            if( readable( socks[0] ) > 0 )
+            {
+                events++;
+                if( _mosquitto_packet_read( &db, context, NULL, 0 ) )
+                {
+                    fprintf( stderr, "read failed\n" );
+                    exit( 1 );
+                }
+            }
+        }
+    }
+    double ns = chrono::duration<double, nano>( chrono::steady_clock::now() - start ).count();
+
+    size_t messages = g_handled - handledBefore;
+    if( messages != (size_t)burst * bursts )
+    {
+        fprintf( stderr, "handled %zu of %zu messages\n", messages, (size_t)burst * bursts );
+        exit( 1 );
+    }
+    printf( "payload %6u B, burst %4d: %7.3f reads/msg  %7.2f msgs/event  %8.0f ns/msg\n",
+        payloadSize, burst, (double)( g_reads - readsBefore ) / messages,
+        (double)messages / events, ns / messages );
+
+    _mosquitto_packet_cleanup_received( &context->in_packet );
+    _mosquitto_rx_buffer_release( context );
+    free( context );
+    close( socks[0] );
+    close( socks[1] );
+}
+
+/**
+ * Creates a self-signed certificate for the TLS server
+ *
+ * @param   ctx The TLS context of the server
+ */
+static void useCertificate( SSL_CTX* ctx )
+{
+    EVP_PKEY* key = NULL;
+    EVP_PKEY_CTX* keyCtx = EVP_PKEY_CTX_new_id( EVP_PKEY_EC, NULL );
+    EVP_PKEY_keygen_init( keyCtx );
+    EVP_PKEY_CTX_set_ec_paramgen_curve_nid( keyCtx, NID_X9_62_prime256v1 );
+    EVP_PKEY_keygen( keyCtx, &key );
+    EVP_PKEY_CTX_free( keyCtx );
+
+    X509* cert = X509_new();
+    ASN1_INTEGER_set( X509_get_serialNumber( cert ), 1 );
+    X509_gmtime_adj( X509_get_notBefore( cert ), 0 );
+    X509_gmtime_adj( X509_get_notAfter( cert ), 3600 );
+    X509_set_pubkey( cert, key );
+    X509_NAME_add_entry_by_txt( X509_get_subject_name( cert ), "CN", MBSTRING_ASC,
+        (const unsigned char*)"net_bench", -1, -1, 0 );
+    X509_set_issuer_name( cert, X509_get_subject_name( cert ) );
+    X509_sign( cert, key, EVP_sha256() );
+
+    if( SSL_CTX_use_certificate( ctx, cert ) != 1 || SSL_CTX_use_PrivateKey( ctx, key ) != 1 )
+    {
+        ERR_print_errors_fp( stderr );
+        exit( 1 );
+    }
+    X509_free( cert );
+    EVP_PKEY_free( key );
+}
+
+/**
+ * Performs the TLS handshake of the specified server and client (non-blocking sockets)
+ *
+ * @param   server The TLS connection of the server
+ * @param   client The TLS connection of the client
+ */
+static void handshake( SSL* server, SSL* client )
+{
+    int serverRc = 0, clientRc = 0;
+    while( serverRc != 1 || clientRc != 1 )
+    {
+        if( serverRc != 1 )
+        {
+            serverRc = SSL_accept( server );
+        }
+        if( clientRc != 1 )
+        {
+            clientRc = SSL_connect( client );
+        }
+        if( ( serverRc != 1 && SSL_get_error( server, serverRc ) != SSL_ERROR_WANT_READ ) ||
+            ( clientRc != 1 && SSL_get_error( client, clientRc ) != SSL_ERROR_WANT_READ ) )
+        {
+            ERR_print_errors_fp( stderr );
+            exit( 1 );
+        }
+    }
+}
+
+/**
+ * Writes the queued packets of a context, each packet on its own (the reference)
+ *
+ * @param   context The context
+ * @return  MOSQ_ERR_SUCCESS if the packets were written (or the socket is full)
+ */
+static int writePerPacket( struct mosquitto* context )
+{
+    if( context->out_packet && !context->current_out_packet )
+    {
+        context->current_out_packet = context->out_packet;
+        context->out_packet = context->out_packet->next;
+        if( !context->out_packet )
+        {
+            context->out_packet_last = NULL;
+        }
+    }
+    while( context->current_out_packet )
+    {
+        struct _mosquitto_packet* packet = context->current_out_packet;
+        while( packet->to_process > 0 )
+        {
+            ssize_t len = _mosquitto_net_write( context, &( packet->payload[packet->pos] ), packet->to_process );
+            if( len > 0 )
+            {
+                packet->to_process -= len;
+                packet->pos += len;
+            }
+            else
+            {
+                return errno == EAGAIN ? MOSQ_ERR_SUCCESS : MOSQ_ERR_ERRNO;
+            }
+        }
+
+        context->current_out_packet = context->out_packet;
+        if( context->out_packet )
+        {
+            context->out_packet = context->out_packet->next;
+            if( !context->out_packet )
+            {
+                context->out_packet_last = NULL;
+            }
+        }
+        _mosquitto_packet_cleanup( packet );
+        _mosquitto_pool_free( packet, sizeof( struct _mosquitto_packet ) );
+    }
+    return MOSQ_ERR_SUCCESS;
+}
+
+/**
+ * Reads the bytes that the broker has written, as the client
+ *
+ * @param   sock The socket of the client
+ * @param   ssl The TLS connection of the client (NULL for TCP)
+ * @return  The count of bytes that were read
+ */
+static size_t drain( int sock, SSL* ssl )
+{
+    static uint8_t buf[65536];
+    size_t count = 0;
+    for( ;; )
+    {
+        ssize_t len = ssl ? SSL_read( ssl, buf, sizeof( buf ) ) : recv( sock, buf, sizeof( buf ), 0 );
+        if( len <= 0 )
+        {
+            return count;
+        }
+        count += len;
+    }
+}
+
+/**
+ * Queues bursts of publishes to a client, and reports the writes of the broker
+ *
+ * @param   tls Whether the client is connected over TLS
+ * @param   gather Whether the writes are gathered (or written per packet)
+ * @param   payloadSize The size of the payload of the publishes
+ * @param   burst The count of publishes per burst
+ * @param   bursts The count of bursts
+ */
+static void benchWrite( bool tls, bool gather, uint32_t payloadSize, int burst, int bursts )
+{
+    int socks[2];
+    if( socketpair( AF_UNIX, SOCK_STREAM, 0, socks ) )
+    {
+        perror( "socketpair" );
+        exit( 1 );
+    }
+    fcntl( socks[0], F_SETFL, fcntl( socks[0], F_GETFL, 0 ) | O_NONBLOCK );
+    fcntl( socks[1], F_SETFL, fcntl( socks[1], F_GETFL, 0 ) | O_NONBLOCK );
+
+    struct mosquitto* context = (struct mosquitto*)calloc( 1, sizeof( struct mosquitto ) );
+    context->sock = socks[0];
+    context->state = mosq_cs_connected;
+    context->in_packet.remaining_mult = 1;
+
+    SSL_CTX* serverCtx = NULL;
+    SSL_CTX* clientCtx = NULL;
+    SSL* client = NULL;
+    if( tls )
+    {
+        // As the listeners of the broker (see net.c)
+        serverCtx = SSL_CTX_new( SSLv23_server_method() );
+        SSL_CTX_set_mode( serverCtx, SSL_MODE_RELEASE_BUFFERS );
+        SSL_CTX_set_mode( serverCtx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER );
+        useCertificate( serverCtx );
+        clientCtx = SSL_CTX_new( SSLv23_client_method() );
+        context->ssl = SSL_new( serverCtx );
+        SSL_set_fd( context->ssl, socks[0] );
+        client = SSL_new( clientCtx );
+        SSL_set_fd( client, socks[1] );
+        handshake( context->ssl, client );
+    }
+
+    vector<uint8_t> bytes;
+    appendPublish( bytes, payloadSize );
+
+    // The packets are flushed by the bench (as by the write threads)
+    g_writeThreadCount = 2;
+    size_t writesBefore = g_writes;
+    size_t bytesBefore = g_net_stats.bytes_written;
+    size_t received = 0;
+    double ns = 0;
+    for( int i = 0; i < bursts; i++ )
+    {
+        for( int j = 0; j < burst; j++ )
+        {
+            struct _mosquitto_packet* packet =
+                (struct _mosquitto_packet*)_mosquitto_pool_calloc( sizeof( struct _mosquitto_packet ) );
+            packet->payload = (uint8_t*)_mosquitto_malloc( bytes.size() );
+            memcpy( packet->payload, &bytes[0], bytes.size() );
+            packet->packet_length = bytes.size();
+            _mosquitto_packet_queue( context, packet );
+        }
+        while( context->current_out_packet || context->out_packet )
+        {
+            auto start = chrono::steady_clock::now();
+            int rc = gather ? _mosquitto_packet_write( context ) : writePerPacket( context );
+            ns += chrono::duration<double, nano>( chrono::steady_clock::now() - start ).count();
+            if( rc )
+            {
+                fprintf( stderr, "write failed\n" );
+                exit( 1 );
+            }
+            received += drain( socks[1], client );
+        }
+    }
+    g_writeThreadCount = 1;
+
+    size_t messages = (size_t)burst * bursts;
+    if( received != messages * bytes.size() )
+    {
+        fprintf( stderr, "received %zu of %zu bytes\n", received, messages * bytes.size() );
+        exit( 1 );
+    }
+    size_t writes = g_writes - writesBefore;
+    printf( "%s %-10s payload %5u B, burst %4d: %7.3f writes/msg  %7.0f bytes/write  %6.0f ns/msg\n",
+        tls ? "tls" : "tcp", gather ? "gathered" : "per-packet", payloadSize, burst,
+        (double)writes / messages, (double)( g_net_stats.bytes_written - bytesBefore ) / writes,
+        ns / messages );
+
+    if( tls )
+    {
+        SSL_free( client );
+        SSL_free( context->ssl );
+        SSL_CTX_free( clientCtx );
+        SSL_CTX_free( serverCtx );
+    }
+    free( context );
+    close( socks[0] );
+    close( socks[1] );
+}
+
+int main( int argc, char** argv )
+{
+    bool readMode = argc > 1 && !strcmp( argv[1], "read" );
+    if( !readMode && ( argc < 2 || strcmp( argv[1], "write" ) ) )
+    {
+        fprintf( stderr, "usage: net_bench read|write [bursts]\n" );
+        return 1;
+    }
+    int bursts = argc > 2 ? atoi( argv[2] ) : 10000;
+
+    const int burstSizes[] = { 1, 16, 128 };
+    if( readMode )
+    {
+        const uint32_t payloadSizes[] = { 64, 1024, 65536 };
+        for( size_t i = 0; i < sizeof( payloadSizes ) / sizeof( payloadSizes[0] ); i++ )
+        {
+            for( size_t j = 0; j < sizeof( burstSizes ) / sizeof( burstSizes[0] ); j++ )
+            {
+                // Large payloads are sent in fewer bursts
+                int count = payloadSizes[i] > MOSQ_RX_BUF_SIZE ? bursts / burstSizes[j] + 1 : bursts;
+                benchRead( payloadSizes[i], burstSizes[j], count );
+            }
+        }
+    }
+    else
+    {
+        SSL_library_init();
+        SSL_load_error_strings();
+        const uint32_t payloadSizes[] = { 64, 1024 };
+        for( int tls = 0; tls < 2; tls++ )
+        {
+            for( size_t i = 0; i < sizeof( payloadSizes ) / sizeof( payloadSizes[0] ); i++ )
+            {
+                for( size_t j = 0; j < sizeof( burstSizes ) / sizeof( burstSizes[0] ); j++ )
+                {
+                    benchWrite( tls, false, payloadSizes[i], burstSizes[j], bursts );
+                    benchWrite( tls, true, payloadSizes[i], burstSizes[j], bursts );
+                }
+            }
+        }
+    }
+    return 0;
+}
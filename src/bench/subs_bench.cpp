@@ -0,0 +1,241 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+/*
+ * Benchmark of the subscription tree (subs.c).
+ *
+ *   subs_bench publish [subscribers] [publishes]
+ *       Matches publishes against the subscription tree (mqtt3_db_messages_queue), and
+ *       reports the time and the count of heap allocations per publish. The topics are
+ *       published from a set of 100 distinct topics (which the match cache holds) and of up
+ *       to 100000 distinct topics (which mostly miss the match cache, so the tree is searched).
+ *
+ *   subs_bench memory [clients]
+ *       Subscribes each client to its own reply topic (/mcafee/client/{guid}), as DXL
+ *       clients do, and reports the heap memory used per subscription.
+ */
+
+#include <config.h>
+#include <mosquitto_broker.h>
+#include <memory_mosq.h>
+#include "dxl.h"
+
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** The count of heap allocations */
+static size_t g_allocs = 0;
+
+/* Allocations are counted by interposing the allocator (glibc) */
+extern "C" void* __libc_malloc( size_t size );
+extern "C" void* __libc_calloc( size_t nmemb, size_t size );
+extern "C" void* __libc_realloc( void* ptr, size_t size );
+extern "C" void* malloc( size_t size ) { g_allocs++; return __libc_malloc( size ); }
+extern "C" void* calloc( size_t nmemb, size_t size ) { g_allocs++; return __libc_calloc( nmemb, size ); }
+extern "C" void* realloc( void* ptr, size_t size ) { g_allocs++; return __libc_realloc( ptr, size ); }
+
+/** The count of messages delivered to subscribers */
+static size_t g_delivered = 0;
+
+/*
+ * The broker functions that the subscription tree calls
+ */
+int _mosquitto_log_printf( struct mosquitto*, int, const char*, ... ) { return 0; }
+uint16_t _mosquitto_mid_generate( struct mosquitto* ) { return 1; }
+bool dxl_is_multi_tenant_mode_enabled() { return false; }
+bool dxl_is_tenant_subscription_allowed( struct mosquitto* ) { return true; }
+void dxl_get_message_tenants( struct mosquitto_msg_store*, struct dxl_message_tenants* tenants )
+{
+    memset( tenants, 0, sizeof( *tenants ) );
+}
+void dxl_on_finalize_message( struct mosquitto_msg_store* ) {}
+void dxl_on_topic_added_to_broker( const char* ) {}
+void dxl_on_topic_removed_from_broker( const char* ) {}
+void mqtt3_db_msg_store_ref_inc( struct mosquitto_msg_store* ) {}
+void mqtt3_db_msg_store_ref_dec( struct mosquitto_msg_store* ) {}
+int mqtt3_db_message_insert( struct mosquitto_db*, struct mosquitto*, uint16_t,
+    enum mosquitto_msg_direction, int, bool, struct mosquitto_msg_store* )
+{
+    g_delivered++;
+    return 0;
+}
+
+/**
+ * Creates a client context
+ *
+ * @param   id The numeric identifier of the context
+ * @return  The context
+ */
+static struct mosquitto* createContext( int id )
+{
+    struct mosquitto* context = (struct mosquitto*)__libc_calloc( 1, sizeof( struct mosquitto ) );
+    context->numericId = id;
+    context->id = (char*)"bench";
+    return context;
+}
+
+/**
+ * Publishes the topics and prints the time and allocations per publish
+ *
+ * @param   db The database
+ * @param   name The name of the run
+ * @param   topics The topics to publish to
+ * @param   count The count of publishes
+ */
+static void publish( struct mosquitto_db* db, const char* name, const vector<string>& topics, int count )
+{
+    struct mosquitto_msg_store stored;
+    memset( &stored, 0, sizeof( stored ) );
+
+    struct mqtt3_sub_cache_stats before, after;
+    mqtt3_sub_cache_stats( &before );
+    size_t allocs = g_allocs;
+    size_t delivered = g_delivered;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for( int i = 0; i < count; i++ )
+    {
+        mqtt3_db_messages_queue( db, "bench", topics[i % topics.size()].c_str(), 0, 0, &stored );
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    mqtt3_sub_cache_stats( &after );
+
+    printf( "  %-34s %8.1f ns/publish  %5.2f allocs/publish  %5.2f deliveries/publish  %5.1f%% cached\n",
+        name, chrono::duration<double, nano>( end - start ).count() / count,
+        (double)( g_allocs - allocs ) / count, (double)( g_delivered - delivered ) / count,
+        100.0 * ( after.hits - before.hits ) / count );
+}
+
+/**
+ * Benchmarks publishes against a tree of event subscriptions
+ *
+ * @param   subscribers The count of subscribers
+ * @param   count The count of publishes per run
+ */
+static void benchPublish( int subscribers, int count )
+{
+    struct mosquitto_db db;
+    memset( &db, 0, sizeof( db ) );
+    struct mqtt3_config config;
+    memset( &config, 0, sizeof( config ) );
+    db.config = &config;
+
+    mqtt3_sub_init();
+    mqtt3_subs_open( &db );
+
+    // Subscribers to 1000 event topics of 6 levels, and a few wildcard subscribers
+    char topic[128];
+    for( int i = 0; i < subscribers; i++ )
+    {
+        snprintf( topic, sizeof( topic ), "/mcafee/event/epo/%d/x/y", i % 1000 );
+        mqtt3_sub_add( &db, createContext( i + 1 ), topic, 0, &db.subs );
+    }
+    mqtt3_sub_add( &db, createContext( subscribers + 1 ), "/mcafee/event/epo/+/x/#", 0, &db.subs );
+    mqtt3_sub_add( &db, createContext( subscribers + 2 ), "/mcafee/#", 0, &db.subs );
+
+    const int topicCounts[] = { 100, 100000 };
+    for( size_t t = 0; t < sizeof( topicCounts ) / sizeof( topicCounts[0] ); t++ )
+    {
+        // The subscribed topics are limited to the 1000 topics that have subscribers
+        vector<string> subscribed, wildcard, unsubscribed;
+        for( int i = 0; i < topicCounts[t]; i++ )
+        {
+            snprintf( topic, sizeof( topic ), "/mcafee/event/epo/%d/x/y", i % 1000 );
+            if( i < 1000 )
+            {
+                subscribed.push_back( topic );
+            }
+            snprintf( topic, sizeof( topic ), "/mcafee/event/epo/%d/x/z", i );
+            wildcard.push_back( topic );
+            snprintf( topic, sizeof( topic ), "/other/event/epo/%d/x/y", i );
+            unsubscribed.push_back( topic );
+        }
+
+        printf( "publish (%d subscribers, %d distinct 6-level topics):\n", subscribers, topicCounts[t] );
+        publish( &db, "subscribed topic (at most 1000)", subscribed, count );
+        publish( &db, "wildcard subscribers only", wildcard, count );
+        publish( &db, "no subscribers", unsubscribed, count );
+    }
+
+    mqtt3_subs_close( &db );
+}
+
+/**
+ * Returns the heap memory in use
+ *
+ * @return  The heap memory in use (bytes)
+ */
+static size_t heapInUse()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/**
+ * Benchmarks the memory used by the reply topic subscriptions of clients
+ *
+ * @param   clients The count of clients
+ */
+static void benchMemory( int clients )
+{
+    struct mosquitto_db db;
+    memset( &db, 0, sizeof( db ) );
+    struct mqtt3_config config;
+    memset( &config, 0, sizeof( config ) );
+    db.config = &config;
+
+    mqtt3_sub_init();
+    mqtt3_subs_open( &db );
+
+    // The contexts are allocated up front, so that they are not counted
+    vector<struct mosquitto*> contexts;
+    for( int i = 0; i < clients; i++ )
+    {
+        contexts.push_back( createContext( i + 1 ) );
+    }
+
+    char topic[128];
+    size_t before = heapInUse();
+    for( int i = 0; i < clients; i++ )
+    {
+        snprintf( topic, sizeof( topic ), "/mcafee/client/{%08x-1234-5678-9abc-%012x}", i, i * 7 );
+        mqtt3_sub_add( &db, contexts[i], topic, 0, &db.subs );
+    }
+    size_t after = heapInUse();
+
+    printf( "memory (%d reply topic subscriptions):\n", clients );
+    printf( "  %.1f MB in use, %.1f bytes per subscription\n",
+        ( after - before ) / ( 1024.0 * 1024.0 ), (double)( after - before ) / clients );
+
+    mqtt3_subs_close( &db );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc >= 2 && !strcmp( argv[1], "publish" ) )
+    {
+        int subscribers = argc > 2 ? atoi( argv[2] ) : 20000;
+        int count = argc > 3 ? atoi( argv[3] ) : 1000000;
+        benchPublish( subscribers, count );
+    }
+    else if( argc >= 2 && !strcmp( argv[1], "memory" ) )
+    {
+        benchMemory( argc > 2 ? atoi( argv[2] ) : 200000 );
+    }
+    else
+    {
+        fprintf( stderr, "usage: %s publish [subscribers] [publishes]\n", argv[0] );
+        fprintf( stderr, "       %s memory [clients]\n", argv[0] );
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,287 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+/*
+ * Benchmark of the wildcard lookups of topics (CoreUtil::WildcardIterator).
+ *
+ *   wildcard_bench [repetitions]
+ *       Looks up exact topics, topics that match a wildcard pattern, and topics that match
+ *       nothing, as the callers of the wildcard iterator do:
+ *         service lookup   ServiceLookupHandler (the topic maps of the service registry)
+ *         topic set        BrokerBridgeTopicCache::isSubscriber and
+ *                          BrokerRegistry::isSubscriberInBroker (the topic sets)
+ *         authorization    TopicAuthorizationService (the authorization trie)
+ *       Reports the time and the count of heap allocations per lookup. Each caller is compared
+ *       to a reference that looks up a std::string per pattern in containers of strings, as the
+ *       callers did before the iterator yielded views.
+ */
+
+#include "include/BrokerSettings.h"
+#include "include/unordered_map.h"
+#include "include/unordered_set.h"
+#include "core/include/CoreUtil.h"
+#include "topicauthorization/include/topicauthorizationstate.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace dxl::broker;
+using namespace dxl::broker::core;
+
+/* The broker setting that the JSON service reads (the broker settings are not linked) */
+bool BrokerSettings::sm_jsonPrettyPrint = false;
+
+/** The count of heap allocations */
+static size_t g_allocs = 0;
+
+/* Allocations are counted by interposing the allocator (glibc) */
+extern "C" void* __libc_malloc( size_t size );
+extern "C" void* __libc_calloc( size_t nmemb, size_t size );
+extern "C" void* __libc_realloc( void* ptr, size_t size );
+extern "C" void* malloc( size_t size ) { g_allocs++; return __libc_malloc( size ); }
+extern "C" void* calloc( size_t nmemb, size_t size ) { g_allocs++; return __libc_calloc( nmemb, size ); }
+extern "C" void* realloc( void* ptr, size_t size ) { g_allocs++; return __libc_realloc( ptr, size ); }
+void* operator new( size_t size )
+{
+    g_allocs++;
+    void* ptr = __libc_malloc( size ? size : 1 );
+    if( !ptr )
+    {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+void operator delete( void* ptr ) noexcept { free( ptr ); }
+void operator delete( void* ptr, size_t ) noexcept { free( ptr ); }
+
+/** The topic map of the service registry (see ServiceRegistry) */
+typedef unordered_map<string, string, CoreUtil::TopicHash, CoreUtil::TopicEqual> serviceTopics_t;
+/** The topic sets of the bridge topic cache and the broker states */
+typedef unordered_set<string, CoreUtil::TopicHash, CoreUtil::TopicEqual> topics_t;
+/** The reference topic map (strings only) */
+typedef unordered_map<string, string> referenceServiceTopics_t;
+/** The reference topic set (strings only) */
+typedef unordered_set<string> referenceTopics_t;
+
+/**
+ * Returns the string of a wildcard pattern, as the callers built before the views
+ *
+ * @param   pattern The wildcard pattern
+ * @return  The string of the pattern
+ */
+static string toString( const CoreUtil::TopicView& pattern )
+{
+    string str( pattern.chars, pattern.len );
+    if( pattern.wildcard )
+    {
+        str += '#';
+    }
+    return str;
+}
+
+/**
+ * Returns whether the topic, or one of its wildcard patterns, is in the container
+ *
+ * @param   container The container (searched with views)
+ * @param   topic The topic
+ * @return  Whether the topic, or one of its wildcard patterns, is in the container
+ */
+template <class C> static bool find( const C& container, const string& topic )
+{
+    CoreUtil::WildcardIterator iter( topic.data(), topic.size() );
+    if( container.find( iter.getTopic(), CoreUtil::TopicHash(), CoreUtil::TopicEqual() ) != container.end() )
+    {
+        return true;
+    }
+    while( iter.next() )
+    {
+        if( container.find( iter.get(), CoreUtil::TopicHash(), CoreUtil::TopicEqual() ) != container.end() )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns whether the topic, or one of its wildcard patterns, is in the container
+ *
+ * @param   container The container (searched with a string per pattern)
+ * @param   topic The topic
+ * @return  Whether the topic, or one of its wildcard patterns, is in the container
+ */
+template <class C> static bool findReference( const C& container, const string& topic )
+{
+    if( container.find( topic ) != container.end() )
+    {
+        return true;
+    }
+    // The topic was copied to be rewritten into each pattern
+    string copy( topic );
+    CoreUtil::WildcardIterator iter( copy.data(), copy.size() );
+    while( iter.next() )
+    {
+        if( container.find( toString( iter.get() ) ) != container.end() )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns whether the key is authorized to publish to the topic, by looking up the topic and
+ * a string per wildcard pattern in the authorization data
+ *
+ * @param   data The authorization data
+ * @param   key The key
+ * @param   topic The topic
+ * @return  Whether the key is authorized to publish to the topic
+ */
+static bool isAuthorizedReference( const TopicAuthorizationState::TopicAuthorizationStateData& data,
+    const string& key, const string& topic )
+{
+    bool matched = false;
+    TopicAuthorizationState::TopicAuthorizationStateData::const_iterator found = data.find( topic );
+    if( found != data.end() )
+    {
+        if( found->second.count( key ) )
+        {
+            return true;
+        }
+        matched = true;
+    }
+    string copy( topic );
+    CoreUtil::WildcardIterator iter( copy.data(), copy.size() );
+    while( iter.next() )
+    {
+        found = data.find( toString( iter.get() ) );
+        if( found != data.end() )
+        {
+            if( found->second.count( key ) )
+            {
+                return true;
+            }
+            matched = true;
+        }
+    }
+    return !matched;
+}
+
+/**
+ * Looks up the topics and prints the time and allocations per lookup
+ *
+ * @param   name The name of the run
+ * @param   topics The topics to look up
+ * @param   repetitions The count of times to look up the topics
+ * @param   lookup The lookup
+ * @return  The count of lookups that found the topic
+ */
+template <class F> static size_t bench(
+    const char* name, const vector<string>& topics, int repetitions, F lookup )
+{
+    size_t found = 0;
+    size_t allocs = g_allocs;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for( int r = 0; r < repetitions; r++ )
+    {
+        for( size_t i = 0; i < topics.size(); i++ )
+        {
+            found += lookup( topics[i] );
+        }
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+    double count = (double)repetitions * topics.size();
+    printf( "  %-26s %7.1f ns/lookup  %5.2f allocs/lookup\n", name,
+        chrono::duration<double, nano>( end - start ).count() / count, ( g_allocs - allocs ) / count );
+    return found;
+}
+
+int main( int argc, char** argv )
+{
+    if( argc > 1 && atoi( argv[1] ) <= 0 )
+    {
+        fprintf( stderr, "usage: %s [repetitions]\n", argv[0] );
+        return 1;
+    }
+    int repetitions = argc > 1 ? atoi( argv[1] ) : 300;
+
+    // 5000 service topics and 200 wildcard event topics
+    vector<string> registered;
+    for( int i = 0; i < 5000; i++ )
+    {
+        registered.push_back( "/mcafee/service/svc" + to_string( i ) + "/request/op" + to_string( i % 7 ) );
+    }
+    for( int i = 0; i < 200; i++ )
+    {
+        registered.push_back( "/mcafee/event/wc" + to_string( i ) + "/#" );
+    }
+
+    serviceTopics_t serviceTopics;
+    referenceServiceTopics_t referenceServiceTopics;
+    topics_t topics( registered.begin(), registered.end() );
+    referenceTopics_t referenceTopics( registered.begin(), registered.end() );
+    TopicAuthorizationState::TopicAuthorizationStateData publishers, subscribers;
+    for( size_t i = 0; i < registered.size(); i++ )
+    {
+        serviceTopics[registered[i]] = "service";
+        referenceServiceTopics[registered[i]] = "service";
+        if( i % 5 == 0 )
+        {
+            publishers[registered[i]].insert( "client" + to_string( i % 13 ) );
+        }
+    }
+    TopicAuthorizationState state( publishers, subscribers );
+    const string key = "client3";
+    uint32_t keyId = state.getKeyId( key.c_str() );
+
+    vector<string> exact, wildcard, unmatched;
+    for( int i = 0; i < 1000; i++ )
+    {
+        exact.push_back( registered[( i * 37 ) % 5000] );
+        wildcard.push_back( "/mcafee/event/wc" + to_string( i % 200 ) + "/sub/topic/leaf" + to_string( i ) );
+        unmatched.push_back( "/mcafee/other/path/to/some/topic" + to_string( i ) );
+    }
+
+    struct { const char* name; const vector<string>* topics; } runs[] = {
+        { "exact topic", &exact },
+        { "wildcard match (6 levels)", &wildcard },
+        { "no match (7 levels)", &unmatched } };
+    int mismatches = 0;
+    for( size_t r = 0; r < sizeof( runs ) / sizeof( runs[0] ); r++ )
+    {
+        const vector<string>& t = *runs[r].topics;
+        printf( "%s:\n", runs[r].name );
+        mismatches +=
+            bench( "service lookup", t, repetitions,
+                [&]( const string& topic ) { return find( serviceTopics, topic ); } ) !=
+            bench( "service lookup (reference)", t, repetitions,
+                [&]( const string& topic ) { return findReference( referenceServiceTopics, topic ); } );
+        mismatches +=
+            bench( "topic set", t, repetitions,
+                [&]( const string& topic ) { return find( topics, topic ); } ) !=
+            bench( "topic set (reference)", t, repetitions,
+                [&]( const string& topic ) { return findReference( referenceTopics, topic ); } );
+        mismatches +=
+            bench( "authorization", t, repetitions,
+                [&]( const string& topic ) { return state.isAuthorizedToPublish( &keyId, 1, topic ); } ) !=
+            bench( "authorization (reference)", t, repetitions,
+                [&]( const string& topic ) { return isAuthorizedReference( publishers, key, topic ); } );
+    }
+
+    if( mismatches )
+    {
+        fprintf( stderr, "the lookups and their references differ\n" );
+        return 1;
+    }
+
+    return 0;
+}
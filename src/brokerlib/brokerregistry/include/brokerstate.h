@@ -11,6 +11,7 @@
 #include <string>
 #include <functional>
 #include "broker.h"
+#include "core/include/CoreUtil.h"
 
 namespace dxl {
 namespace broker {
@@ -27,7 +28,8 @@ namespace registry
     typedef unordered_map<std::string,uint32_t> countedConnections_t;
 
     /** Type used to store subscriptions (topics) */
-    typedef unordered_set<std::string> subscriptions_t;
+    typedef unordered_set<std::string,
+        dxl::broker::core::CoreUtil::TopicHash, dxl::broker::core::CoreUtil::TopicEqual> subscriptions_t;
 }
 
 /**
@@ -188,6 +190,19 @@ public:
      */
     bool hasTopic( const std::string& topic ) const { return m_subscriptions.find( topic ) != m_subscriptions.end(); }
 
+    /**
+     * Returns whether the topic exists for the broker
+     *
+     * @param   topic The broker topic view (see CoreUtil::WildcardIterator)
+     * @return  Whether the topic exists for the broker
+     */
+    bool hasTopic( const dxl::broker::core::CoreUtil::TopicView& topic ) const
+    {
+        return m_subscriptions.find(
+            topic, dxl::broker::core::CoreUtil::TopicHash(), dxl::broker::core::CoreUtil::TopicEqual() ) !=
+                m_subscriptions.end();
+    }
+
     /**
      * Returns the count of topics that have a wildcard
      *
@@ -781,7 +781,12 @@ bool BrokerRegistry::isSubscriberInBroker( const std::string &brokerId, const st
         const BrokerState& state = it->second;
 
         // If topic routing is disabled or the broker has the topic
-        if( !state.isTopicRoutingEnabled() || state.hasTopic( topic ) )
+        if( !state.isTopicRoutingEnabled() )
+        {
+            return true;
+        }
+        CoreUtil::WildcardIterator wcIter( topic.data(), topic.size() );
+        if( state.hasTopic( wcIter.getTopic() ) )
         {
             return true;
         }
@@ -789,23 +794,13 @@ bool BrokerRegistry::isSubscriberInBroker( const std::string &brokerId, const st
         // Check for wildcards (if applicable)
         if( state.getTopicWildcardCount() > 0 )
         {
-            char* wcTopic = CoreUtil::iterateWildcardBegin( topic.c_str() );
-
-            bool found = false;
-            while( CoreUtil::iterateWildcardNext( wcTopic ) )
+            while( wcIter.next() )
             {
-                if( state.hasTopic( wcTopic ) )
+                if( state.hasTopic( wcIter.get() ) )
                 {
-                    found = true;
-                    break;
+                    return true;
                 }
             }
-            CoreUtil::iterateWildcardEnd( wcTopic );
-
-            if( found )
-            {
-                return true;
-            }
         }
     }
 
@@ -7,6 +7,7 @@
 
 #include <memory>
 #include "include/unordered_set.h"
+#include "core/include/CoreUtil.h"
 
 namespace dxl {
 namespace broker {
@@ -23,7 +24,8 @@ class BrokerTopicCache;
 typedef unordered_set<std::string> brokers_t;
 
 /** Typedef for the subscriptions */
-typedef unordered_set<std::string> cachesubs_t;
+typedef unordered_set<std::string,
+    dxl::broker::core::CoreUtil::TopicHash, dxl::broker::core::CoreUtil::TopicEqual> cachesubs_t;
 
 /**
  * Contains a cache of the topics that are subscribed to via a particular bridge from
@@ -291,22 +291,22 @@ bool BrokerBridgeTopicCache::isSubscriber( const string& topic, bool* result )
     }
 
     // If topic routing is disabled or the broker has the topic
-    if( !m_topicRoutingEnabled || ( m_topics.find( topic ) != m_topics.end() ) )
+    CoreUtil::WildcardIterator wcIter( topic.data(), topic.size() );
+    if( !m_topicRoutingEnabled ||
+        ( m_topics.find( wcIter.getTopic(), CoreUtil::TopicHash(), CoreUtil::TopicEqual() ) != m_topics.end() ) )
     {
         *result = true;
     }
     else if( m_wildcardCount > 0 )  // Check for wildcards (if applicable)
     {
-        char* wcTopic = CoreUtil::iterateWildcardBegin( topic.c_str() );
-        while( CoreUtil::iterateWildcardNext( wcTopic ) )
+        while( wcIter.next() )
         {
-            if( m_topics.find( wcTopic ) != m_topics.end() )
+            if( m_topics.find( wcIter.get(), CoreUtil::TopicHash(), CoreUtil::TopicEqual() ) != m_topics.end() )
             {
                 *result = true;
                 break;
             }
         }
-        CoreUtil::iterateWildcardEnd( wcTopic );
     }
 
     return true;
@@ -6,6 +6,7 @@
 #define COREBROKERHEALTH_H_
 
 #include <ctime>
+#include <stdint.h>
 
 namespace dxl {
 namespace broker {
@@ -96,6 +97,34 @@ public:
      */
     std::size_t getLocalServicesCounter() const;
 
+    /**
+     * Sets the count of topic authorization checks answered by the verdict cache
+     *
+     * @param   hits The count of topic authorization checks answered by the verdict cache
+     */
+    void setAuthorizationCacheHits( const uint64_t hits );
+
+    /**
+     * Returns the count of topic authorization checks answered by the verdict cache
+     *
+     * @return  The count of topic authorization checks answered by the verdict cache
+     */
+    uint64_t getAuthorizationCacheHits() const;
+
+    /**
+     * Sets the count of topic authorization checks not answered by the verdict cache
+     *
+     * @param   misses The count of topic authorization checks not answered by the verdict cache
+     */
+    void setAuthorizationCacheMisses( const uint64_t misses );
+
+    /**
+     * Returns the count of topic authorization checks not answered by the verdict cache
+     *
+     * @return  The count of topic authorization checks not answered by the verdict cache
+     */
+    uint64_t getAuthorizationCacheMisses() const;
+
 protected:
 
     /** The count of connected clients */
@@ -108,6 +137,10 @@ protected:
     std::time_t m_startUpTime;
     /** Count of local services */
     std::size_t m_localServices;
+    /** Count of authorization checks answered by the verdict cache */
+    uint64_t m_authCacheHits;
+    /** Count of authorization checks not answered by the verdict cache */
+    uint64_t m_authCacheMisses;
 };
 
 } /* namespace core */
@@ -0,0 +1,153 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+#ifndef COREGUIDTABLE_H_
+#define COREGUIDTABLE_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace dxl {
+namespace broker {
+namespace core {
+
+/**
+ * Table that interns the GUIDs of the core contexts (clients, bridged brokers and tenants) as
+ * dense integer identifiers. The identifiers are stored with the contexts when they connect,
+ * and the destinations of a message are resolved to identifiers once (see
+ * <code>DxlMessage</code>), which allows each destination context to be matched by comparing
+ * integers rather than hashing and comparing strings.
+ *
+ * GUIDs are reference counted, the identifier of a GUID is reused once all of its references
+ * have been released. The generation of the table changes whenever an identifier is assigned,
+ * so identifiers resolved in an earlier generation must be resolved again.
+ *
+ * NOTE: This table is not thread safe. It can only be safely accessed on the core messaging
+ * thread.
+ */
+class CoreGuidTable
+{
+public:
+    /** Destructor */
+    virtual ~CoreGuidTable() {}
+
+    /**
+     * Returns the single table instance
+     *
+     * @return  The single table instance
+     */
+    static CoreGuidTable& getInstance();
+
+    /**
+     * Interns the specified GUID, adding a reference to it
+     *
+     * @param   guid The GUID
+     * @return  The identifier of the GUID
+     */
+    uint32_t acquire( const char* guid );
+
+    /**
+     * Releases a reference to the GUID with the specified identifier
+     *
+     * @param   id The identifier of the GUID (ignored if 0)
+     */
+    void release( uint32_t id );
+
+    /**
+     * Returns the identifier of the specified GUID
+     *
+     * @param   guid The GUID characters (not necessarily null-terminated)
+     * @param   len The length of the GUID
+     * @return  The identifier of the GUID, or 0 if it has not been interned
+     */
+    uint32_t find( const char* guid, size_t len ) const;
+
+    /**
+     * Returns the identifier of the local broker GUID (interned on first access)
+     *
+     * @return  The identifier of the local broker GUID
+     */
+    uint32_t getBrokerId();
+
+    /**
+     * Returns the identifier of the local broker instance GUID (interned on first access)
+     *
+     * @return  The identifier of the local broker instance GUID
+     */
+    uint32_t getBrokerInstanceId();
+
+    /**
+     * Returns the generation of the table, which changes whenever an identifier is assigned
+     *
+     * @return  The generation of the table
+     */
+    uint64_t getGeneration() const { return m_generation; }
+
+    /**
+     * Returns whether the specified sorted identifiers contain the identifier
+     *
+     * @param   ids The identifiers (sorted)
+     * @param   id The identifier
+     * @return  Whether the identifiers contain the identifier (always false for 0)
+     */
+    static bool contains( const std::vector<uint32_t>& ids, uint32_t id );
+
+private:
+    /** Constructor */
+    CoreGuidTable();
+
+    /**
+     * Returns the hash of the specified GUID
+     *
+     * @param   guid The GUID characters
+     * @param   len The length of the GUID
+     * @return  The hash of the GUID
+     */
+    static uint32_t hash( const char* guid, size_t len );
+
+    /**
+     * Returns the slot that holds the specified GUID, or the empty slot that it would be held in
+     *
+     * @param   guid The GUID characters
+     * @param   len The length of the GUID
+     * @return  The index of the slot
+     */
+    size_t findSlot( const char* guid, size_t len ) const;
+
+    /**
+     * Doubles the count of slots, placing the interned GUIDs again
+     */
+    void grow();
+
+    /** The GUIDs, indexed by identifier (the GUID of a released identifier is empty) */
+    std::vector<std::string> m_guids;
+
+    /** The count of references to each identifier */
+    std::vector<uint32_t> m_refCounts;
+
+    /** The released identifiers, available for reuse */
+    std::vector<uint32_t> m_freeIds;
+
+    /** The open addressed slots (linear probing), holding the identifiers (0 if empty) */
+    std::vector<uint32_t> m_slots;
+
+    /** The count of interned GUIDs */
+    size_t m_count;
+
+    /** The generation of the table */
+    uint64_t m_generation;
+
+    /** The identifier of the local broker GUID (0 until accessed) */
+    uint32_t m_brokerId;
+
+    /** The identifier of the local broker instance GUID (0 until accessed) */
+    uint32_t m_brokerInstanceId;
+};
+
+} /* namespace core */
+} /* namespace broker */
+} /* namespace dxl */
+
+#endif /* COREGUIDTABLE_H_ */
@@ -10,14 +10,23 @@
 #include "CoreOnPublishMessageHandler.h"
 #include "CoreBrokerHealth.h"
 #include "cert_hashes.h"
+#include "guid_ids.h"
+#include "payload_splice.h"
 #include <ctime>
 #include <string>
+#include <vector>
+
+/** Forward structure reference */
+struct dxl_message_source_t;
 
 namespace dxl {
 namespace broker {
 /** Namespace for declarations related to communicating with the core messaging layer */
 namespace core {
 
+/** Forward class reference */
+class CoreMessageContext;
+
 /**
  * The level of a particular log message
  */
@@ -319,20 +328,53 @@ public:
      * @param   topic The message topic
      * @param   payloadLen The length of the message payload
      * @param   payload The message payload
-     * @param   outPayloadLen The length of the message payload (0 if not rewritten)
-     * @param   outPayload The output payload (NULL if not rewritten)
+     * @param   outPayload The rewritten payload (bytes are NULL if not rewritten), which may
+     *          reference a region of the payload rather than copying it
      * @param   sourceTenantGuid The core context source tenant identifier
      * @param   certHashes The certificate hashes associated with the source context
      * @param   certChain The certificate chain associated with the source context
+     * @param   messageSource The message source of the source context, which is created on the
+     *          first message stored for the context and held by core until the context is cleaned
+     *          up (can be null)
+     * @return  The context of the message, which core carries with the stored message and
+     *          provides to the other message methods until the message is finalized
      */
-    void onStoreMessage(
+    CoreMessageContext* onStoreMessage(
         uint64_t dbId, const char* sourceId, const char* canonicalSourceId, bool isBridge, 
         uint8_t contextFlags, const char* topic,
         uint32_t payloadLen, const void* payload,
-        uint32_t* outPayloadLen, void** outPayload,
+        struct payload_splice* outPayload,
         const char* sourceTenantGuid,
         struct cert_hashes *certHashes,
-        const char* certChain ) const;
+        const char* certChain,
+        struct dxl_message_source_t** messageSource ) const;
+
+    /**
+     * Interns the specified GUID of a core context, adding a reference to it (see
+     * <code>CoreGuidTable</code>)
+     *
+     * NOTE: This method should only be called on the core messaging thread.
+     *
+     * @param   guid The GUID
+     * @return  The identifier of the GUID
+     */
+    uint32_t acquireGuidId( const char* guid ) const;
+
+    /**
+     * Releases a reference to the interned GUID with the specified identifier
+     *
+     * NOTE: This method should only be called on the core messaging thread.
+     *
+     * @param   id The identifier of the GUID (ignored if 0)
+     */
+    void releaseGuidId( uint32_t id ) const;
+
+    /**
+     * Releases a message source that was created when storing a message
+     *
+     * @param   messageSource The message source (can be null)
+     */
+    void releaseMessageSource( struct dxl_message_source_t* messageSource ) const;
 
     /**
      * Invoked by core when the queue of packets for a context exceeds the maximum
@@ -341,11 +383,11 @@ public:
      * @param   destId The core context identifier that the message is about to be
      *          inserted for
      * @param   isBridge Whether the destination context is a bridge
-     * @param   dbId The core database identifier
+     * @param   context The context of the message (see onStoreMessage())
      * @return  True if the message should be rejected. False if the insert should be allowed
      *          even though the maximum queue size is exceeded.
      */
-    bool onPreInsertPacketQueueExceeded( const char* destId, bool isBridge, uint64_t dbId ) const;
+    bool onPreInsertPacketQueueExceeded( const char* destId, bool isBridge, CoreMessageContext* context ) const;
 
     /**
      * Invoked by core for every message that is about to be inserted for delivery
@@ -354,8 +396,9 @@ public:
      * @param   canonicalDestId The canonical destination identifier
      * @param   isBridge Whether the destination context is a bridge
      * @param   contextFlags The context specific flags
-     * @param   dbId The core database identifier
+     * @param   context The context of the message (see onStoreMessage())
      * @param   targetTenantGuid The core context tenant identifier that will receive the message
+     * @param   destGuidIds The interned identifiers of the GUIDs of the destination context
      * @param   certHashes The certificate hashes associated with the destination context
      * @param   isClientMessageEnabled Whether to use the client message (or bridge) (out)
      * @param   clientMessage A message that should be sent to clients versus bridges (if applicable) (out)
@@ -364,18 +407,30 @@ public:
      * @return  Whether the message should be allowed to be inserted for delivery
      */
     bool onInsertMessage( const char* destId, const char* canonicalDestId, bool isBridge, uint8_t contextFlags,
-        uint64_t dbId, const char* targetTenantGuid, struct cert_hashes *certHashes,
+        CoreMessageContext* context, const char* targetTenantGuid, const struct guid_ids* destGuidIds,
+        struct cert_hashes *certHashes,
         bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen ) const;
 
+    /**
+     * Returns the tenants that a message may be delivered to in multi-tenant mode, in
+     * addition to operations clients and bridges.
+     *
+     * @param   context The context of the message (see onStoreMessage())
+     * @param   tenantGuids The GUIDs of the tenants (out, valid until the message is finalized)
+     * @return  Whether the message is restricted to the tenants (otherwise any tenant may
+     *          receive it)
+     */
+    bool getMessageTenants( CoreMessageContext* context, std::vector<const char*>& tenantGuids ) const;
+
     /**
      * Invoked prior to a message being finalized (all work has been completed).
      *
      * After this method has been invoked, the information provided in <code>onStoreMessage()</code> is no
-     * longer valid.
+     * longer valid, and the context of the message is released.
      *
-     * @param   dbId The core database identifier
+     * @param   context The context of the message (see onStoreMessage())
      */
-    void onFinalizeMessage( uint64_t dbId ) const;
+    void onFinalizeMessage( CoreMessageContext* context ) const;
 
     /**
      * Invoked when core does its maintenance
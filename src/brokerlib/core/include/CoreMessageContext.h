@@ -224,6 +224,27 @@ private:
      */
     void setMessageInsertEnabled( bool enabled ) { m_messageInsertEnabled = enabled; }
 
+    /**
+     * Resets the context for a new message (allows the message service to reuse contexts)
+     *
+     * @param   sourceId The identifier associated with the source of the message
+     * @param   canonicalSourceId The canonical identifier associated with the source of the message
+     * @param   isSourceBridge Whether the source is a bridge
+     * @param   contextFlags The context-specific flags
+     * @param   topic The message topic
+     * @param   payloadLen The payload length
+     * @param   payload The payload
+     */
+    void reset(
+        const char* sourceId, const char* canonicalSourceId, bool isSourceBridge, uint8_t contextFlags,
+        const char* topic, uint32_t payloadLen, const void* payload
+    );
+
+    /**
+     * Releases the message specific state (parsed DXL message) once the message is finalized
+     */
+    void release() { m_dxlMessage.reset(); }
+
     /**
      * Parses the payload into a DXL message
      */
@@ -12,6 +12,7 @@
 #include "core/include/CoreOnPublishMessageHandler.h"
 #include "core/include/CoreOnStoreMessageHandler.h"
 #include "include/unordered_map.h"
+#include "payload_splice.h"
 #include <memory>
 #include <string>
 #include <stdint.h>
@@ -32,14 +33,15 @@ namespace core {
  *               vetoed.
  *
  *   onStore - The message has been stored in the core database for sending to recipients.
- *             At this point a <code>CoreMessageContext</code> object will be created. This message
- *             context object will exist until after the finalize method has been invoked.
+ *             At this point a <code>CoreMessageContext</code> object will be created (or reused).
+ *             The core carries this message context object with the stored message, and it will
+ *             exist until after the finalize method has been invoked.
  *
  *   onInsert - This is called for each of the possible recipients of the message (this queues for
  *              delivery to the recipient). The insertion can be vetoed.
  * 
  *   onFinalize - The message sending process has completed. After this message is invoked, the
- *                message context object will be destroyed.
+ *                message context object will be reset for reuse (or destroyed).
  */
 class CoreMessageHandlerService :
     public CoreOnPublishMessageHandler,
@@ -47,7 +49,7 @@ class CoreMessageHandlerService :
 {
 public:
     /** Destructor */
-    virtual ~CoreMessageHandlerService() {}
+    virtual ~CoreMessageHandlerService();
 
     /**
      * Returns the single service instance
@@ -113,7 +115,6 @@ public:
     /**
      * Invoked when a message to be published has been stored
      *
-     * @param   dbId The core database identifier
      * @param   sourceId The source identifier (the context publishing the message)
      * @param   canonicalSourceId The canonical source identifier (the context publishing the message)
      * @param   isBridge Whether the source is a bridge
@@ -121,18 +122,21 @@ public:
      * @param   topic The message topic
      * @param   payloadLen The length of the message payload
      * @param   payload The message payload
-     * @param   outPayloadLen The length of the output payload (0 if not rewritten)
-     * @param   outPayload <code>NULL</code> if not rewritten
+     * @param   outPayload The rewritten payload (bytes are <code>NULL</code> if not rewritten)
      * @param   sourceTenantGuid The tenant source identifier of the client
      * @param   certHashes The certificate hashes associated with the source context
      * @param   certChain The certificate chain associated with the source context
+     * @param   messageSource The message source of the source context (created if it is
+     *          <code>NULL</code>, can be <code>NULL</code>)
+     * @return  The context of the message (valid until the message is finalized)
      */
-    void onStoreMessage(
-        uint64_t dbId, const char* sourceId, const char* canonicalSourceId, bool isBridge, 
+    CoreMessageContext* onStoreMessage(
+        const char* sourceId, const char* canonicalSourceId, bool isBridge, 
         uint8_t contextFlags, const char* topic,
         uint32_t payloadLen, const void* payload,
-        uint32_t *outPayloadLen, void** outPayload,
-        const char* sourceTenantGuid, struct cert_hashes *certHashes, const char* certChain );
+        struct payload_splice* outPayload,
+        const char* sourceTenantGuid, struct cert_hashes *certHashes, const char* certChain,
+        dxl_message_source_t** messageSource );
 
     /**
      * Invoked by core when the queue of packets for a context exceeds the maximum
@@ -141,11 +145,11 @@ public:
      * @param   destId The core context identifier that the message is about to be
      *          inserted for
      * @param   isBridge Whether the destination context is a bridge
-     * @param   dbId The core database identifier
+     * @param   ctx The context of the message
      * @return  True if the message should be rejected. False if the insert should be allowed
      *          even though the maximum queue size is exceeded.
      */
-    bool onPreInsertPacketQueueExceeded( const char* destId, bool isBridge, uint64_t dbId ) const;
+    bool onPreInsertPacketQueueExceeded( const char* destId, bool isBridge, CoreMessageContext* ctx ) const;
 
     /**
      * Invoked by the core messaging layer for every message that is about to be inserted for delivery
@@ -154,8 +158,9 @@ public:
      * @param   canonicalDestId The canonical destination identifier
      * @param   isBridge Whether the destination context is a bridge
      * @param   contextFlags The context-specific flags
-     * @param   dbId The core database identifier
+     * @param   ctx The context of the message
      * @param   targetTenantGuid The core context tenant identifier that will receive the message
+     * @param   destGuidIds The interned identifiers of the GUIDs of the destination context
      * @param   certHashes The certificate hashes associated with the destination context
      * @param   isClientMessageEnabled Whether to use the client message (or bridge) (out)
      * @param   clientMessage A message that should be sent to clients versus bridges (if applicable) (out)
@@ -163,19 +168,32 @@ public:
      *          (if applicable) (out)
      * @return  Whether the message should be allowed to be inserted for delivery
      */
-    bool onInsertMessage( const char* destId, const char* canonicalDestId, bool isBridge, uint8_t contextFlags, uint64_t dbId,
-        const char* targetTenantGuid, struct cert_hashes *certHashes,
+    bool onInsertMessage( const char* destId, const char* canonicalDestId, bool isBridge, uint8_t contextFlags,
+        CoreMessageContext* ctx,
+        const char* targetTenantGuid, const struct guid_ids* destGuidIds, struct cert_hashes *certHashes,
         bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen) const;
 
+    /**
+     * Returns the tenants that a message may be delivered to in multi-tenant mode, in
+     * addition to operations clients and bridges. This mirrors the tenant checks of
+     * the message routing handler, which still applies to each destination.
+     *
+     * @param   ctx The context of the message
+     * @param   tenantGuids The GUIDs of the tenants (out, valid until the message is finalized)
+     * @return  Whether the message is restricted to the tenants (otherwise any tenant may
+     *          receive it)
+     */
+    bool getMessageTenants( CoreMessageContext* ctx, std::vector<const char*>& tenantGuids ) const;
+
     /**
      * Invoked prior to a message being finalized (all work has been completed).
      *
      * After this method has been invoked, the information provided in <code>onStoreMessage()</code> is no
-     * longer valid.
+     * longer valid, and the context is recycled.
      *
-     * @param   dbId The core database identifier
+     * @param   ctx The context of the message
      */
-    void onFinalizeMessage( uint64_t dbId );
+    void onFinalizeMessage( CoreMessageContext* ctx );
 
     /** {@inheritDoc} */
     void onCoreMaintenance( time_t time );
@@ -216,10 +234,12 @@ private:
      * @param   sourceTenantGuid The tenant GUID of the source context
      * @param   message The DXL message
      * @param   certChain The certificate chain of the source context
+     * @param   messageSource The message source of the source context (created if it is
+     *          <code>NULL</code>, can be <code>NULL</code>)
      */
     bool setDxlMessageFields( CoreMessageContext* context,
         const char* sourceTenantGuid, dxl::broker::message::DxlMessage* message,
-        const char* certChain ) const;
+        const char* certChain, dxl_message_source_t** messageSource ) const;
 
     /** On publish handlers (topic-based) */
     unordered_map<std::string, const CoreOnPublishMessageHandler*> m_onPublishHandlers;
@@ -239,8 +259,11 @@ private:
     /** On finalize handlers (all topics) */
     std::vector<const CoreOnFinalizeMessageHandler*> m_globalOnFinalizeHandlers;
 
-    /** The map of message contexts */
-    unordered_map<uint64_t, CoreMessageContext*> m_contexts;
+    /** The maximum count of message contexts kept for reuse */
+    static const size_t MAX_CONTEXT_POOL_SIZE = 1024;
+
+    /** The contexts of finalized messages, reused for the next messages */
+    std::vector<CoreMessageContext*> m_contextPool;
 
     /** The start of the sample time for message timing */
     time_t m_messageTimingStart;
@@ -6,6 +6,7 @@
 #define COREONINSERTMESSAGEHANDLER_H_
 
 #include "cert_hashes.h"
+#include "guid_ids.h"
 #include "core/include/CoreMessageContext.h"
 
 namespace dxl {
@@ -32,6 +33,7 @@ public:
      * @param   isBridge Whether the destination context is a bridge
      * @param   contextFlags The context-specific flags
      * @param   targetTenantGuid The core context tenant identifier that will receive the message
+     * @param   destGuidIds The interned identifiers of the GUIDs of the destination context
      * @param   certHashes The certificate hashes associated with the destination context
      * @param   isClientMessageEnabled Whether to use the client message (or bridge) (out)
      * @param   clientMessage A message that should be sent to clients versus bridges (if applicable) (out)
@@ -41,7 +43,7 @@ public:
      */
     virtual bool onInsertMessage(
         CoreMessageContext* context, const char* destId, const char* canonicalDestId, bool isBridge, uint8_t contextFlags,
-        const char* targetTenantGuid, struct cert_hashes *certHashes, 
+        const char* targetTenantGuid, const struct guid_ids* destGuidIds, struct cert_hashes *certHashes, 
         bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen ) const = 0;
 };
 
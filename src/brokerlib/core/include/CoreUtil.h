@@ -5,6 +5,10 @@
 #ifndef COREUTIL_H_
 #define COREUTIL_H_
 
+#include <cstddef>
+#include <string>
+#include <stdint.h>
+
 namespace dxl {
 namespace broker {
 namespace core {
@@ -13,30 +17,114 @@ namespace core {
  * Core messaging utility methods
  */
 class CoreUtil
-{    
+{
 public:
-    /** 
-     * Begins iteration of the wildcard patterns in the specified topic
-     *
-     * @param   topic The topic
-     * @return  The modified topic (a copy of the topic with some padding)
+    /**
+     * A view of a topic that does not own its characters. The view is the characters,
+     * optionally followed by the wildcard ("#"), which allows the wildcard patterns of a topic
+     * to be viewed without copying the topic.
      */
-    static char* iterateWildcardBegin( const char* topic );
+    struct TopicView
+    {
+        /** The characters of the topic (not necessarily null-terminated) */
+        const char* chars;
+        /** The count of characters (excluding the wildcard) */
+        size_t len;
+        /** Whether the characters are followed by the wildcard */
+        bool wildcard;
+        /** The hash of the topic (see TopicHash) */
+        size_t hash;
+    };
 
     /**
-     * Returns the next wildcard pattern (if found)
-     *
-     * @param   modifiedTopic The modified topic
-     * @return  Whether we found the next wildcard pattern (or none were found)
+     * Hash of topics, which is the same for a topic string and a view of the same topic.
+     * Containers of topic strings that use it (and TopicEqual) can be searched with views,
+     * for example <code>topics.find( view, CoreUtil::TopicHash(), CoreUtil::TopicEqual() )</code>.
      */
-    static bool iterateWildcardNext( char* modifiedTopic );
+    struct TopicHash
+    {
+        size_t operator()( const std::string& topic ) const
+        {
+            return (size_t)hash( HASH_BASIS, topic.data(), topic.size() );
+        }
+
+        size_t operator()( const TopicView& view ) const { return view.hash; }
+    };
 
     /**
-     * Completes the iteration (frees the modified topic)
-     *
-     * @param   modifiedTopic The modified topic that will be freed
+     * Equality of topic strings and views
      */
-    static void iterateWildcardEnd( char *modifiedTopic );
+    struct TopicEqual
+    {
+        bool operator()( const std::string& lhs, const std::string& rhs ) const { return lhs == rhs; }
+        bool operator()( const TopicView& lhs, const std::string& rhs ) const { return isEqual( lhs, rhs ); }
+        bool operator()( const std::string& lhs, const TopicView& rhs ) const { return isEqual( rhs, lhs ); }
+    };
+
+    /**
+     * Iterates the wildcard patterns of a topic without allocating. For example, the patterns
+     * of <code>a/b/c</code> are <code>a/b/#</code>, <code>a/#</code> and <code>#</code>. The
+     * patterns are views of the topic (which must outlive the iterator), and their hashes are
+     * derived from the hash of the topic rather than being computed for each pattern.
+     */
+    class WildcardIterator
+    {
+    public:
+        /**
+         * Constructor
+         *
+         * @param   topic The topic
+         */
+        explicit WildcardIterator( const char* topic );
+
+        /**
+         * Constructor
+         *
+         * @param   topic The topic characters (not necessarily null-terminated)
+         * @param   len The length of the topic
+         */
+        WildcardIterator( const char* topic, size_t len );
+
+        /**
+         * Returns the view of the topic itself
+         *
+         * @return  The view of the topic itself
+         */
+        const TopicView& getTopic() const { return m_topic; }
+
+        /**
+         * Moves to the next wildcard pattern (if found)
+         *
+         * @return  Whether we found the next wildcard pattern (or none were found)
+         */
+        bool next();
+
+        /**
+         * Returns the view of the current wildcard pattern (see next())
+         *
+         * @return  The view of the current wildcard pattern
+         */
+        const TopicView& get() const { return m_pattern; }
+
+    private:
+        /**
+         * Starts the iteration
+         */
+        void begin();
+
+        /** The view of the topic */
+        TopicView m_topic;
+        /** The view of the current wildcard pattern */
+        TopicView m_pattern;
+        /** The count of characters of the topic that remain to be searched for a separator */
+        size_t m_searchLen;
+        /** Whether there are no more wildcard patterns */
+        bool m_done;
+        /** The hash of the characters of the topic up to m_hashLen */
+        uint64_t m_hash;
+        /** The count of characters of the topic that m_hash is for */
+        size_t m_hashLen;
+    };
 
     /**
      * Whether the specified topic is a wildcard topic
@@ -45,8 +133,39 @@ public:
      * @return  Whether the specified topic is a wildcard topic
      */
     static bool isWildcard( const char* topic );
+
+private:
+    /** The initial value of topic hashes (FNV-1a) */
+    static const uint64_t HASH_BASIS = 14695981039346656037ULL;
+
+    /**
+     * Continues the hash of a topic with the specified characters (FNV-1a)
+     *
+     * @param   h The hash of the preceding characters
+     * @param   chars The characters
+     * @param   len The count of characters
+     * @return  The hash including the characters
+     */
+    static uint64_t hash( uint64_t h, const char* chars, size_t len )
+    {
+        for( size_t i = 0; i < len; i++ )
+        {
+            h ^= (unsigned char)chars[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    /**
+     * Returns whether the view is of the specified topic
+     *
+     * @param   view The view
+     * @param   topic The topic
+     * @return  Whether the view is of the topic
+     */
+    static bool isEqual( const TopicView& view, const std::string& topic );
 };
-    
+
 
 } /* namespace core */
 } /* namespace broker */
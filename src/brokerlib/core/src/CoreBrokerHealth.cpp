@@ -15,7 +15,9 @@ CoreBrokerHealth::CoreBrokerHealth(): m_connectedClients(0),
     m_incomingMsgs(0), 
     m_outgoingMsgs(0), 
     m_startUpTime(0), 
-    m_localServices(0)
+    m_localServices(0),
+    m_authCacheHits(0),
+    m_authCacheMisses(0)
 {
 }
 
@@ -84,6 +86,30 @@ std::size_t CoreBrokerHealth::getLocalServicesCounter() const
     return m_localServices;
 }
 
+/** {@inheritDoc} */
+void CoreBrokerHealth::setAuthorizationCacheHits( const uint64_t hits )
+{
+    m_authCacheHits = hits;
+}
+
+/** {@inheritDoc} */
+uint64_t CoreBrokerHealth::getAuthorizationCacheHits() const
+{
+    return m_authCacheHits;
+}
+
+/** {@inheritDoc} */
+void CoreBrokerHealth::setAuthorizationCacheMisses( const uint64_t misses )
+{
+    m_authCacheMisses = misses;
+}
+
+/** {@inheritDoc} */
+uint64_t CoreBrokerHealth::getAuthorizationCacheMisses() const
+{
+    return m_authCacheMisses;
+}
+
 }
 }
 }
@@ -0,0 +1,182 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+#include "include/BrokerSettings.h"
+#include "core/include/CoreGuidTable.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace dxl::broker;
+using namespace dxl::broker::core;
+
+/** The initial count of slots (a power of two) */
+static const size_t INITIAL_SLOT_COUNT = 256;
+
+/** {@inheritDoc} */
+CoreGuidTable& CoreGuidTable::getInstance()
+{
+    static CoreGuidTable instance;
+    return instance;
+}
+
+/** Constructor */
+CoreGuidTable::CoreGuidTable() :
+    m_guids( 1 ),
+    m_refCounts( 1, 0 ),
+    m_slots( INITIAL_SLOT_COUNT, 0 ),
+    m_count( 0 ),
+    m_generation( 0 ),
+    m_brokerId( 0 ),
+    m_brokerInstanceId( 0 )
+{
+}
+
+/** {@inheritDoc} */
+uint32_t CoreGuidTable::hash( const char* guid, size_t len )
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for( size_t i = 0; i < len; i++ )
+    {
+        h ^= (unsigned char)guid[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/** {@inheritDoc} */
+size_t CoreGuidTable::findSlot( const char* guid, size_t len ) const
+{
+    size_t mask = m_slots.size() - 1;
+    size_t slot = hash( guid, len ) & mask;
+    while( m_slots[slot] )
+    {
+        const string& interned = m_guids[m_slots[slot]];
+        if( interned.size() == len && !memcmp( interned.data(), guid, len ) )
+        {
+            break;
+        }
+        slot = ( slot + 1 ) & mask;
+    }
+    return slot;
+}
+
+/** {@inheritDoc} */
+void CoreGuidTable::grow()
+{
+    m_slots.assign( m_slots.size() * 2, 0 );
+    for( uint32_t id = 1; id < m_guids.size(); id++ )
+    {
+        if( m_refCounts[id] > 0 )
+        {
+            m_slots[findSlot( m_guids[id].data(), m_guids[id].size() )] = id;
+        }
+    }
+}
+
+/** {@inheritDoc} */
+uint32_t CoreGuidTable::acquire( const char* guid )
+{
+    size_t len = strlen( guid );
+    size_t slot = findSlot( guid, len );
+    if( m_slots[slot] )
+    {
+        m_refCounts[m_slots[slot]]++;
+        return m_slots[slot];
+    }
+
+    // Keep the slots at most half full
+    if( ( m_count + 1 ) * 2 > m_slots.size() )
+    {
+        grow();
+        slot = findSlot( guid, len );
+    }
+
+    uint32_t id;
+    if( !m_freeIds.empty() )
+    {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+    else
+    {
+        id = (uint32_t)m_guids.size();
+        m_guids.push_back( string() );
+        m_refCounts.push_back( 0 );
+    }
+
+    m_guids[id].assign( guid, len );
+    m_refCounts[id] = 1;
+    m_slots[slot] = id;
+    m_count++;
+
+    // Identifiers resolved before now may not include this GUID
+    m_generation++;
+
+    return id;
+}
+
+/** {@inheritDoc} */
+void CoreGuidTable::release( uint32_t id )
+{
+    if( id == 0 || id >= m_refCounts.size() || m_refCounts[id] == 0 || --m_refCounts[id] > 0 )
+    {
+        return;
+    }
+
+    // Remove the slot, shifting back the slots that follow it in its probe sequence
+    size_t mask = m_slots.size() - 1;
+    size_t empty = findSlot( m_guids[id].data(), m_guids[id].size() );
+    m_slots[empty] = 0;
+    for( size_t slot = ( empty + 1 ) & mask; m_slots[slot]; slot = ( slot + 1 ) & mask )
+    {
+        const string& guid = m_guids[m_slots[slot]];
+        size_t home = hash( guid.data(), guid.size() ) & mask;
+        bool inPlace = ( empty <= slot ) ?
+            ( empty < home && home <= slot ) : ( empty < home || home <= slot );
+        if( !inPlace )
+        {
+            m_slots[empty] = m_slots[slot];
+            m_slots[slot] = 0;
+            empty = slot;
+        }
+    }
+
+    string().swap( m_guids[id] );
+    m_freeIds.push_back( id );
+    m_count--;
+}
+
+/** {@inheritDoc} */
+uint32_t CoreGuidTable::find( const char* guid, size_t len ) const
+{
+    return m_slots[findSlot( guid, len )];
+}
+
+/** {@inheritDoc} */
+uint32_t CoreGuidTable::getBrokerId()
+{
+    if( !m_brokerId )
+    {
+        m_brokerId = acquire( BrokerSettings::getGuid() );
+    }
+    return m_brokerId;
+}
+
+/** {@inheritDoc} */
+uint32_t CoreGuidTable::getBrokerInstanceId()
+{
+    if( !m_brokerInstanceId )
+    {
+        m_brokerInstanceId = acquire( BrokerSettings::getInstanceGuid() );
+    }
+    return m_brokerInstanceId;
+}
+
+/** {@inheritDoc} */
+bool CoreGuidTable::contains( const vector<uint32_t>& ids, uint32_t id )
+{
+    return id && binary_search( ids.begin(), ids.end(), id );
+}
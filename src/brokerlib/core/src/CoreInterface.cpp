@@ -10,6 +10,7 @@
 #include "cert/include/RevocationService.h"
 #include "core/include/CoreInterface.h"
 #include "core/include/CoreBridgeConfigurationFactory.h"
+#include "core/include/CoreGuidTable.h"
 #include "core/include/CoreMessageHandlerService.h"
 #include "message/include/DxlMessageConstants.h"
 #include "message/include/DxlMessageService.h"
@@ -242,57 +243,83 @@ bool CoreInterface::onPublishMessage( const char* sourceId, const char* canonica
 
 /** {@inheritDoc} */
 bool CoreInterface::onPreInsertPacketQueueExceeded(
-    const char* destId, bool isBridge, uint64_t dbId ) const
+    const char* destId, bool isBridge, CoreMessageContext* context ) const
 {
     if( SL_LOG.isDebugEnabled() )
-        SL_START << "onPreInsertPacketQueueExceeded: dbId=" << dbId << ", dest=" << destId << ", isBridge=" << 
+        SL_START << "onPreInsertPacketQueueExceeded: dest=" << destId << ", isBridge=" << 
             isBridge << SL_DEBUG_END;
 
     return CoreMessageHandlerService::getInstance()
-        .onPreInsertPacketQueueExceeded( destId, isBridge, dbId );
+        .onPreInsertPacketQueueExceeded( destId, isBridge, context );
 }
 
 /** {@inheritDoc} */
 bool CoreInterface::onInsertMessage( const char* destId, const char* canonicalDestId, bool isBridge,
-    uint8_t targetContextFlags, uint64_t dbId, const char* targetTenantGuid, struct cert_hashes *certHashes,
-    bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen ) const
+    uint8_t targetContextFlags, CoreMessageContext* context, const char* targetTenantGuid,
+    const struct guid_ids* destGuidIds, struct cert_hashes *certHashes, bool* isClientMessageEnabled,
+    unsigned char** clientMessage, size_t* clientMessageLen ) const
 {
     if( SL_LOG.isDebugEnabled() )
-        SL_START << "onInsertMessage: dbId=" << dbId << ", dest=" << destId <<
+        SL_START << "onInsertMessage: dest=" << destId <<
             ", isBridge=" << isBridge << ", targetContextFlags=" << targetContextFlags <<
             ", targetTenantGuid=" << targetTenantGuid << SL_DEBUG_END;
 
     return CoreMessageHandlerService::getInstance()
-        .onInsertMessage( destId, canonicalDestId, isBridge, targetContextFlags, dbId, targetTenantGuid, certHashes,
-            isClientMessageEnabled, clientMessage, clientMessageLen );
+        .onInsertMessage( destId, canonicalDestId, isBridge, targetContextFlags, context, targetTenantGuid,
+            destGuidIds, certHashes, isClientMessageEnabled, clientMessage, clientMessageLen );
 }
 
 /** {@inheritDoc} */
-void CoreInterface::onStoreMessage(
+CoreMessageContext* CoreInterface::onStoreMessage(
     uint64_t dbId, const char* sourceId, const char* canonicalSourceId, bool isBridge, 
     uint8_t contextFlags, const char* topic,
     uint32_t payloadLen, const void* payload,
-    uint32_t* outPayloadLen, void** outPayload,
-    const char* sourceTenantGuid, struct cert_hashes *certHashes, const char* certChain ) const
+    struct payload_splice* outPayload,
+    const char* sourceTenantGuid, struct cert_hashes *certHashes, const char* certChain,
+    struct dxl_message_source_t** messageSource ) const
 {
     if( SL_LOG.isDebugEnabled() )
         SL_START << "onStoreMessage: dbId=" << dbId << ", source=" << sourceId << ", isBridge=" << isBridge <<
             ", contextFlags=" << contextFlags << ", topic=" << topic << ", length=" << payloadLen <<
             ", sourceTenantGuid=" << sourceTenantGuid << SL_DEBUG_END;
 
-    CoreMessageHandlerService::getInstance()
+    return CoreMessageHandlerService::getInstance()
         .onStoreMessage(
-            dbId, sourceId, canonicalSourceId, isBridge, contextFlags, topic, payloadLen, payload,
-            outPayloadLen, outPayload, sourceTenantGuid, certHashes, certChain );
+            sourceId, canonicalSourceId, isBridge, contextFlags, topic, payloadLen, payload,
+            outPayload, sourceTenantGuid, certHashes, certChain, messageSource );
+}
+
+/** {@inheritDoc} */
+uint32_t CoreInterface::acquireGuidId( const char* guid ) const
+{
+    return CoreGuidTable::getInstance().acquire( guid );
+}
+
+/** {@inheritDoc} */
+void CoreInterface::releaseGuidId( uint32_t id ) const
+{
+    CoreGuidTable::getInstance().release( id );
+}
+
+/** {@inheritDoc} */
+void CoreInterface::releaseMessageSource( struct dxl_message_source_t* messageSource ) const
+{
+    releaseDxlMessageSource( messageSource );
+}
+
+/** {@inheritDoc} */
+bool CoreInterface::getMessageTenants( CoreMessageContext* context, vector<const char*>& tenantGuids ) const
+{
+    return CoreMessageHandlerService::getInstance().getMessageTenants( context, tenantGuids );
 }
 
 /** {@inheritDoc} */
-void CoreInterface::onFinalizeMessage( uint64_t dbId ) const
+void CoreInterface::onFinalizeMessage( CoreMessageContext* context ) const
 {
     if( SL_LOG.isDebugEnabled() )
-        SL_START << "onFinalizeMessage: dbId=" << dbId << SL_DEBUG_END;
+        SL_START << "onFinalizeMessage: topic=" << ( context ? context->getTopic() : "" ) << SL_DEBUG_END;
 
-    CoreMessageHandlerService::getInstance().onFinalizeMessage( dbId );
+    CoreMessageHandlerService::getInstance().onFinalizeMessage( context );
 }
 
 /** {@inheritDoc} */
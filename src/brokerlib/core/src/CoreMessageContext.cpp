@@ -19,20 +19,12 @@ using namespace dxl::broker::core;
 CoreMessageContext::CoreMessageContext(
     const char* sourceId, const char* canonicalSourceId, bool isSourceBridge, 
     uint8_t contextFlags, const char* topic,
-    uint32_t payloadLen, const void* payload ) :
-    m_sourceId( sourceId ), 
-    m_canonicalSourceId( canonicalSourceId ),
-    m_isSourceBridge( isSourceBridge ), 
-    m_topic( topic ),
-    m_originalPayloadLen( payloadLen ), m_originalPayload( payload ),
-    m_dxlMessageParsed( false ),
-    m_messageInsertEnabled( true ),
-    m_serviceNotFoundEnabled( true ),
-    m_destCount( 0 ), m_contextFlags( contextFlags ),
-    m_clientSpecificMessageGenerated( false )
+    uint32_t payloadLen, const void* payload )
 {
     if( SL_LOG.isDebugEnabled() )
         SL_START << "CoreMessageContext::CoreMessageContext()" << SL_DEBUG_END;
+
+    reset( sourceId, canonicalSourceId, isSourceBridge, contextFlags, topic, payloadLen, payload );
 }
 
 /** {@inheritDoc} */
@@ -42,6 +34,28 @@ CoreMessageContext::~CoreMessageContext()
         SL_START << "CoreMessageContext::~CoreMessageContext()" << SL_DEBUG_END;
 }
 
+/** {@inheritDoc} */
+void CoreMessageContext::reset(
+    const char* sourceId, const char* canonicalSourceId, bool isSourceBridge, 
+    uint8_t contextFlags, const char* topic,
+    uint32_t payloadLen, const void* payload )
+{
+    // Assign (rather than construct) the identifiers to reuse their storage
+    m_sourceId.assign( sourceId );
+    m_canonicalSourceId.assign( canonicalSourceId );
+    m_isSourceBridge = isSourceBridge;
+    m_topic = topic;
+    m_originalPayloadLen = payloadLen;
+    m_originalPayload = payload;
+    m_dxlMessageParsed = false;
+    m_dxlMessage.reset();
+    m_messageInsertEnabled = true;
+    m_serviceNotFoundEnabled = true;
+    m_destCount = 0;
+    m_contextFlags = contextFlags;
+    m_clientSpecificMessageGenerated = false;
+}
+
 /** {@inheritDoc} */
 bool CoreMessageContext::isLocalBrokerSource() const
 {
@@ -66,8 +80,9 @@ void CoreMessageContext::parseDxlMessage()
 
         try
         {        
+            // Decode the header only, the fields are copied from the payload on first use
             m_dxlMessage =
-                DxlMessageService::getInstance().fromBytes(
+                DxlMessageService::getInstance().fromBytesLazy(
                     static_cast<const unsigned char*>(m_originalPayload), m_originalPayloadLen );
         }
         catch( const exception& ex )
@@ -9,6 +9,8 @@
 #include "message/include/DxlMessageService.h"
 #include "core/include/CoreMessageHandlerService.h"
 #include <cstring>
+#include <sstream>
+#include <stdexcept>
 
 using namespace SimpleLogger;
 using namespace std;
@@ -32,6 +34,15 @@ CoreMessageHandlerService::CoreMessageHandlerService() :
 {
 }
 
+/** Destructor */
+CoreMessageHandlerService::~CoreMessageHandlerService()
+{
+    for( auto it = m_contextPool.begin(); it != m_contextPool.end(); it++ )
+    {
+        delete *it;
+    }
+}
+
 /** {@inheritDoc} */
 bool CoreMessageHandlerService::onPublishMessage(
     const char* sourceId, const char* canonicalSourceId, bool isBridge, uint8_t contextFlags,
@@ -100,22 +111,32 @@ void CoreMessageHandlerService::fireOnStoreMessage(
 }
 
 /** {@inheritDoc} */
-void CoreMessageHandlerService::onStoreMessage(
-    uint64_t dbId, const char* sourceId, const char* canonicalSourceId, bool isBridge, 
+CoreMessageContext* CoreMessageHandlerService::onStoreMessage(
+    const char* sourceId, const char* canonicalSourceId, bool isBridge, 
     uint8_t contextFlags, const char* topic,
     uint32_t payloadLen, const void* payload,
-    uint32_t *outPayloadLen, void** outPayload,
-    const char* sourceTenantGuid, struct cert_hashes *certHashes, const char* certChain )
+    struct payload_splice* outPayload,
+    const char* sourceTenantGuid, struct cert_hashes *certHashes, const char* certChain,
+    dxl_message_source_t** messageSource )
 {
-    CoreMessageContext* context =
-        new CoreMessageContext( sourceId, canonicalSourceId, isBridge, contextFlags, topic, payloadLen, payload );
-    m_contexts[dbId] = context;
+    // Reuse the context of a finalized message if one is available
+    CoreMessageContext* context;
+    if( !m_contextPool.empty() )
+    {
+        context = m_contextPool.back();
+        m_contextPool.pop_back();
+        context->reset( sourceId, canonicalSourceId, isBridge, contextFlags, topic, payloadLen, payload );
+    }
+    else
+    {
+        context = new CoreMessageContext(
+            sourceId, canonicalSourceId, isBridge, contextFlags, topic, payloadLen, payload );
+    }
 
     try
     {
         // Clear output values
-        *outPayloadLen = 0;
-        *outPayload = NULL;
+        memset( outPayload, 0, sizeof( struct payload_splice ) );
 
         // Is it a DXL message?
         DxlMessage* dxlMessage = NULL;
@@ -124,13 +145,13 @@ void CoreMessageHandlerService::onStoreMessage(
             dxlMessage = context->getDxlMessage();
 
             // Set DXL message fields appropriately (clientId, tenantId, etc.)
-            if( !setDxlMessageFields( context, sourceTenantGuid, dxlMessage, certChain ) )
+            if( !setDxlMessageFields( context, sourceTenantGuid, dxlMessage, certChain, messageSource ) )
             {
                 // Specify that the message should not be published
                 context->setMessageInsertEnabled( false );
 
                 // Exit, do not process any on store handlers
-                return;
+                return context;
             }
         }
 
@@ -155,14 +176,28 @@ void CoreMessageHandlerService::onStoreMessage(
                 SL_START << "Message is dirty, rewriting message." << SL_DEBUG_END;
             }
 
-            size_t outLen;
-            DxlMessageService::getInstance().toBytes( 
-                *dxlMessage, reinterpret_cast<unsigned char**>(outPayload), &outLen );
-            *outPayloadLen = (uint32_t)outLen;
+            // Only the fields surrounding the payload are rewritten if it is unchanged, the
+            // payload region of the stored message is reused (no copy)
+            unsigned char* bytes;
+            size_t len;
+            const unsigned char* region;
+            size_t regionLen;
+            size_t offset;
+            DxlMessageService::getInstance().toBytesExcludingPayload(
+                *dxlMessage, &bytes, &len, &region, &regionLen, &offset );
+            outPayload->bytes = bytes;
+            outPayload->len = (uint32_t)len;
+            if( region )
+            {
+                outPayload->offset = (uint32_t)offset;
+                outPayload->region_start = 
+                    (uint32_t)( region - static_cast<const unsigned char*>( payload ) );
+                outPayload->region_len = (uint32_t)regionLen;
+            }
         }
 
         // Success
-        return;
+        return context;
     }
     catch( const exception& ex )
     {
@@ -175,80 +210,75 @@ void CoreMessageHandlerService::onStoreMessage(
 
     // An error occurred, don't allow publish
     context->setMessageInsertEnabled( false );
+    return context;
 }
 
 /** {@inheritDoc} */
 bool CoreMessageHandlerService::onPreInsertPacketQueueExceeded(
-    const char* destId, bool isBridge, uint64_t dbId ) const
+    const char* destId, bool isBridge, CoreMessageContext* ctx ) const
 {
     //
     // TODO: Use a callback/registration mechanism when the queue is exceeded
     //
 
-    CoreMessageContext* ctx = NULL;
-    auto iter = m_contexts.find( dbId );
-    if( iter != m_contexts.end() )
+    if( ctx )
     {
-        ctx = iter->second;
-        if( ctx )
-        {    
-            try
+        try
+        {
+            bool isDxlMessage = ctx->isDxlMessage();
+
+            // Allow the queue operation to succeed if the context is a bridge, it is not a DXL message,
+            // or it is a broker-specific message.
+            if( isBridge || !isDxlMessage || 
+                !strncmp( ctx->getTopic(), DXL_BROKER_EVENT_PREFIX, DXL_BROKER_EVENT_PREFIX_LEN ) ||
+                !strncmp( ctx->getTopic(), DXL_BROKER_REQUEST_PREFIX, DXL_BROKER_REQUEST_PREFIX_LEN ) ||
+                !strncmp( ctx->getTopic(), DXL_CLIENT_PREFIX, DXL_CLIENT_PREFIX_LEN ) )
             {
-                bool isDxlMessage = ctx->isDxlMessage();
-
-                // Allow the queue operation to succeed if the context is a bridge, it is not a DXL message,
-                // or it is a broker-specific message.
-                if( isBridge || !isDxlMessage || 
-                    !strncmp( ctx->getTopic(), DXL_BROKER_EVENT_PREFIX, DXL_BROKER_EVENT_PREFIX_LEN ) ||
-                    !strncmp( ctx->getTopic(), DXL_BROKER_REQUEST_PREFIX, DXL_BROKER_REQUEST_PREFIX_LEN ) ||
-                    !strncmp( ctx->getTopic(), DXL_CLIENT_PREFIX, DXL_CLIENT_PREFIX_LEN ) )
-                {
-                    if( SL_LOG.isDebugEnabled() )
-                    {
-                        SL_START << "Overriding packet queue full, allowing insert(" << 
-                            ctx->getTopic() << "), destId=" << destId << ", isBridge=" << isBridge << 
-                            ", isDxlMessage=" << isDxlMessage << SL_DEBUG_END;
-                    }
-
-                    return false;
-                }
-
-                if( isDxlMessage && ctx->getDxlMessage()->isRequestMessage() )
-                {
-                    // Disable sending of the service not found message since we are going to 
-                    // send a service is overloaded message
-                    ctx->setServiceNotFoundMessageEnabled( false );                    
-
-                    // The service is overloaded, send the appropriate error response message
-                    DxlMessageService::getInstance()
-                        .sendServiceOverloadedErrorMessage( ctx->getDxlRequest() );
-                }
-
                 if( SL_LOG.isDebugEnabled() )
                 {
-                    SL_START << "Packet queue is full, rejecting insert(" << 
+                    SL_START << "Overriding packet queue full, allowing insert(" << 
                         ctx->getTopic() << "), destId=" << destId << ", isBridge=" << isBridge << 
-                        SL_DEBUG_END;
+                        ", isDxlMessage=" << isDxlMessage << SL_DEBUG_END;
                 }
 
-                return true;
+                return false;
             }
-            catch( const exception& ex )
+
+            if( isDxlMessage && ctx->getDxlMessage()->isRequestMessage() )
             {
-                SL_START << "Error while handling insert packet queue exceeded(" << 
-                    ctx->getTopic() << "), " << ex.what() << SL_ERROR_END;
+                // Disable sending of the service not found message since we are going to 
+                // send a service is overloaded message
+                ctx->setServiceNotFoundMessageEnabled( false );                    
+
+                // The service is overloaded, send the appropriate error response message
+                DxlMessageService::getInstance()
+                    .sendServiceOverloadedErrorMessage( ctx->getDxlRequest() );
             }
-            catch( ... )
+
+            if( SL_LOG.isDebugEnabled() )
             {
-                SL_START << "Error while handling insert packet queue exceeded(" << 
-                    ctx->getTopic() << "), unknown error" << SL_ERROR_END;
+                SL_START << "Packet queue is full, rejecting insert(" << 
+                    ctx->getTopic() << "), destId=" << destId << ", isBridge=" << isBridge << 
+                    SL_DEBUG_END;
             }
+
+            return true;
+        }
+        catch( const exception& ex )
+        {
+            SL_START << "Error while handling insert packet queue exceeded(" << 
+                ctx->getTopic() << "), " << ex.what() << SL_ERROR_END;
+        }
+        catch( ... )
+        {
+            SL_START << "Error while handling insert packet queue exceeded(" << 
+                ctx->getTopic() << "), unknown error" << SL_ERROR_END;
         }
     }
 
     if( !ctx )
     {
-        SL_START << "Unable to find message context (packet queue full)." << dbId << SL_ERROR_END;
+        SL_START << "Unable to find message context (packet queue full)." << SL_ERROR_END;
     }
 
     return true;        
@@ -256,94 +286,127 @@ bool CoreMessageHandlerService::onPreInsertPacketQueueExceeded(
 
 /** {@inheritDoc} */
 bool CoreMessageHandlerService::onInsertMessage( const char* destId, const char* canonicalDestId, bool isBridge,
-    uint8_t contextFlags, uint64_t dbId, const char* targetTenantGuid, struct cert_hashes *certHashes,
-    bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen ) const
+    uint8_t contextFlags, CoreMessageContext* ctx, const char* targetTenantGuid, const struct guid_ids* destGuidIds,
+    struct cert_hashes *certHashes, bool* isClientMessageEnabled, unsigned char** clientMessage,
+    size_t* clientMessageLen ) const
 {
-    CoreMessageContext* ctx = NULL;
-    auto iter = m_contexts.find( dbId );
-    if( iter != m_contexts.end() )
+    if( ctx )
     {
-        ctx = iter->second;
-        if( ctx )
-        {    
-            if( !ctx->isMessageInsertEnabled() )
-            {
-                // Sending of this particular message has been disabled during on store
-                return false;
-            }
+        if( !ctx->isMessageInsertEnabled() )
+        {
+            // Sending of this particular message has been disabled during on store
+            return false;
+        }
 
-            try
+        try
+        {
+            // Global handlers
+            for( auto it = m_globalOnInsertHandlers.begin(); it != m_globalOnInsertHandlers.end(); it++ )
             {
-                // Global handlers
-                for( auto it = m_globalOnInsertHandlers.begin(); it != m_globalOnInsertHandlers.end(); it++ )
+                // Invoke the callback
+                if( !(*it)->onInsertMessage( ctx, destId, canonicalDestId, isBridge, contextFlags, targetTenantGuid,
+                        destGuidIds, certHashes, isClientMessageEnabled, clientMessage, clientMessageLen) )
                 {
-                    // Invoke the callback
-                    if( !(*it)->onInsertMessage( ctx, destId, canonicalDestId, isBridge, contextFlags, targetTenantGuid, certHashes,
-                            isClientMessageEnabled, clientMessage, clientMessageLen) )
-                    {
-                        // Don't allow insert
-                        return false;
-                    }
+                    // Don't allow insert
+                    return false;
                 }
-
-                // Success
-                ctx->incrementDestinationCount();
-                return true;
-            }
-            catch( const exception& ex )
-            {
-                SL_START << "Error while invoking on insert handlers(" << ctx->getTopic() << "), " << ex.what() << SL_ERROR_END;
-            }
-            catch( ... )
-            {
-                SL_START << "Error while invoking on insert handlers(" << ctx->getTopic() << "), unknown error" << SL_ERROR_END;
             }
 
-            // An error occurred, don't allow insert
-            return false;
+            // Success
+            ctx->incrementDestinationCount();
+            return true;
+        }
+        catch( const exception& ex )
+        {
+            SL_START << "Error while invoking on insert handlers(" << ctx->getTopic() << "), " << ex.what() << SL_ERROR_END;
         }
+        catch( ... )
+        {
+            SL_START << "Error while invoking on insert handlers(" << ctx->getTopic() << "), unknown error" << SL_ERROR_END;
+        }
+
+        // An error occurred, don't allow insert
+        return false;
     }
 
+    SL_START << "Unable to find message context." << SL_ERROR_END;
+    return false;        
+}
+
+/** {@inheritDoc} */
+bool CoreMessageHandlerService::getMessageTenants( CoreMessageContext* ctx, vector<const char*>& tenantGuids ) const
+{
+    tenantGuids.clear();
+
     if( !ctx )
     {
-        SL_START << "Unable to find message context." << dbId << SL_ERROR_END;
+        // Unknown message, leave it to the insert handlers
+        return false;
     }
 
-    return false;        
+    if( !ctx->isMessageInsertEnabled() || !ctx->isDxlMessage() )
+    {
+        // The message is not delivered to any tenant
+        return true;
+    }
+
+    DxlMessage* message = ctx->getDxlMessage();
+    const unordered_set<string>* destTenantGuids = message->getDestinationTenantGuids();
+    if( destTenantGuids != NULL )
+    {
+        for( auto it = destTenantGuids->begin(); it != destTenantGuids->end(); it++ )
+        {
+            tenantGuids.push_back( it->c_str() );
+        }
+        return true;
+    }
+
+    if( ctx->isSourceOps() )
+    {
+        // Messages from operations are delivered to every tenant
+        return false;
+    }
+
+    const char* sourceTenantGuid = message->getSourceTenantGuid();
+    tenantGuids.push_back( sourceTenantGuid ? sourceTenantGuid : "" );
+    return true;
 }
 
 /** {@inheritDoc} */
-void CoreMessageHandlerService::onFinalizeMessage( uint64_t dbId )
+void CoreMessageHandlerService::onFinalizeMessage( CoreMessageContext* ctx )
 {
-    auto iter = m_contexts.find( dbId );
-    if( iter != m_contexts.end() )
+    if( ctx )
     {
-        CoreMessageContext* ctx = iter->second;
-        if( ctx )
+        try
         {
-            try
-            {
-                // Update destination count
-                m_destinationMessageCount += ctx->getDestinationCount();
+            // Update destination count
+            m_destinationMessageCount += ctx->getDestinationCount();
 
-                // Global handlers
-                for( auto it = m_globalOnFinalizeHandlers.begin(); 
-                    it != m_globalOnFinalizeHandlers.end(); it++ )
-                {
-                    // Invoke the callback
-                    (*it)->onFinalizeMessage( ctx );
-                }
-            }
-            catch( const exception& ex )
+            // Global handlers
+            for( auto it = m_globalOnFinalizeHandlers.begin(); 
+                it != m_globalOnFinalizeHandlers.end(); it++ )
             {
-                SL_START << "Error while invoking on finalize handlers(" << ctx->getTopic() << "), " << ex.what() << SL_ERROR_END;
-            }
-            catch( ... )
-            {
-                SL_START << "Error while invoking on finalize handlers(" << ctx->getTopic() << "), unknown error" << SL_ERROR_END;
+                // Invoke the callback
+                (*it)->onFinalizeMessage( ctx );
             }
+        }
+        catch( const exception& ex )
+        {
+            SL_START << "Error while invoking on finalize handlers(" << ctx->getTopic() << "), " << ex.what() << SL_ERROR_END;
+        }
+        catch( ... )
+        {
+            SL_START << "Error while invoking on finalize handlers(" << ctx->getTopic() << "), unknown error" << SL_ERROR_END;
+        }
 
-            m_contexts.erase( dbId );
+        // Keep the context for a subsequent message
+        if( m_contextPool.size() < MAX_CONTEXT_POOL_SIZE )
+        {
+            ctx->release();
+            m_contextPool.push_back( ctx );
+        }
+        else
+        {
             delete ctx;
         }
     }
@@ -421,7 +484,7 @@ void CoreMessageHandlerService::onCoreMaintenance( time_t time )
 /** {@inheritDoc} */
 bool CoreMessageHandlerService::setDxlMessageFields(
     CoreMessageContext* context, const char* sourceTenantGuid, DxlMessage* message,
-    const char* certChain ) const
+    const char* certChain, dxl_message_source_t** messageSource ) const
 {
     // Whether the message is from a bridge
     bool isSourceBridge = context->isSourceBridge();
@@ -436,13 +499,34 @@ bool CoreMessageHandlerService::setDxlMessageFields(
     if( !isSourceBridge ) // Message from a local client
     {
         // This should only occur on the initial broker (set the source client and broker)
-        message->setSourceBrokerGuid( BrokerSettings::getGuid() );
-        message->setSourceClientId( context->getCanonicalSourceId() );    
-        message->setSourceClientInstanceId( context->getSourceId() );
-        if( certChain )
+        if( messageSource )
+        {
+            // The source fields and certificates are the same for each message published by
+            // the context, encode them with the first message and reuse them after that
+            if( !*messageSource )
+            {
+                dxl_message_error_t result = createDxlMessageSource( NULL, 
+                    context->getCanonicalSourceId(), BrokerSettings::getGuid(),
+                    context->getSourceId(), certChain, messageSource );
+                if( result != DXLMP_OK )
+                {
+                    stringstream errMsg;
+                    errMsg << "Error creating message source: " << result;
+                    throw runtime_error( errMsg.str() );
+                }
+            }
+            message->setSource( *messageSource );
+        }
+        else
         {
-            // Set the certificates
-            message->setOtherField( "dxl.certs", certChain );
+            message->setSourceBrokerGuid( BrokerSettings::getGuid() );
+            message->setSourceClientId( context->getCanonicalSourceId() );    
+            message->setSourceClientInstanceId( context->getSourceId() );
+            if( certChain )
+            {
+                // Set the certificates
+                message->setOtherField( "dxl.certs", certChain );
+            }
         }
         
         if( SL_LOG.isDebugEnabled() )
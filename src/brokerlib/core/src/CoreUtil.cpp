@@ -2,77 +2,103 @@
  * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
  *****************************************************************************/
 
-#include <cstdlib>
 #include <cstring>
 #include "core/include/CoreUtil.h"
 
+using namespace std;
 using namespace dxl::broker::core;
 
+/** The multiplicative inverse of the FNV-1a prime (modulo 2^64) */
+static const uint64_t HASH_PRIME_INVERSE = 0xce965057aff6957bULL;
+
 /** {@inheritDoc} */
-char* CoreUtil::iterateWildcardBegin( const char* topic )
+CoreUtil::WildcardIterator::WildcardIterator( const char* topic )
 {
-    if( !topic )
-    {
-        return NULL;
-    }
+    m_topic.chars = topic ? topic : "";
+    m_topic.len = strlen( m_topic.chars );
+    begin();
+}
 
-    int length = (int)strlen( topic ) + 2;
-    char* retval = (char*)malloc( length ); 
-    if( retval )
-    {
-        strcpy( retval, topic );
-    }
-    return retval;
+/** {@inheritDoc} */
+CoreUtil::WildcardIterator::WildcardIterator( const char* topic, size_t len )
+{
+    m_topic.chars = topic;
+    m_topic.len = len;
+    begin();
 }
 
 /** {@inheritDoc} */
-bool CoreUtil::iterateWildcardNext( char* modifiedTopic )
+void CoreUtil::WildcardIterator::begin()
 {
-    if( !modifiedTopic )
-    {
-        return false;    
-    }
+    m_hash = hash( HASH_BASIS, m_topic.chars, m_topic.len );
+    m_hashLen = m_topic.len;
+    m_topic.wildcard = false;
+    m_topic.hash = (size_t)m_hash;
+    m_pattern = m_topic;
+
+    const char* chars = m_topic.chars;
+    size_t len = m_topic.len;
 
-    int length = (int)strlen( modifiedTopic );
-    
-    if( length == 1 && modifiedTopic[0] == '#' )
+    // The topic "#" has no patterns, and the pattern of a topic ending with "/#" is skipped
+    m_done = ( len == 1 && chars[0] == '#' );
+    m_searchLen = ( len >= 2 && chars[len - 1] == '#' && chars[len - 2] == '/' ) ? len - 2 : len;
+}
+
+/** {@inheritDoc} */
+bool CoreUtil::WildcardIterator::next()
+{
+    if( m_done )
     {
         return false;
     }
 
-    int poundPos = 0;
-    int searchPos = length - 1;    
-
-    if( length >= 2 &&
-        modifiedTopic[searchPos] == '#' &&
-        modifiedTopic[searchPos-1] == '/' )
+    // The pattern replaces the characters following the last separator
+    size_t prefixLen = m_searchLen;
+    while( prefixLen > 0 && m_topic.chars[prefixLen - 1] != '/' )
     {
-        searchPos -= 2;
-    }    
+        prefixLen--;
+    }
 
-    while( searchPos >= 0 )
+    // Remove the replaced characters from the hash (each FNV-1a step can be reversed)
+    for( ; m_hashLen > prefixLen; m_hashLen-- )
     {
-        if( modifiedTopic[searchPos] == '/' )
-        {
-            poundPos = searchPos+1;
-            break;
-        }
-        searchPos--;
+        m_hash = ( m_hash * HASH_PRIME_INVERSE ) ^ (unsigned char)m_topic.chars[m_hashLen - 1];
     }
 
-    modifiedTopic[poundPos] = '#';
-    modifiedTopic[poundPos+1] = '\0';
+    m_pattern.len = prefixLen;
+    m_pattern.wildcard = true;
+    m_pattern.hash = (size_t)hash( m_hash, "#", 1 );
+
+    // The next pattern is found before the separator (the last pattern is "#")
+    if( prefixLen > 0 )
+    {
+        m_searchLen = prefixLen - 1;
+    }
+    else
+    {
+        m_done = true;
+    }
 
     return true;
 }
 
 /** {@inheritDoc} */
-void CoreUtil::iterateWildcardEnd( char *modifiedTopic )
+bool CoreUtil::isEqual( const TopicView& view, const string& topic )
 {
-    if( modifiedTopic )
+    size_t len = view.len;
+    if( view.wildcard )
+    {
+        if( topic.size() != len + 1 || topic[len] != '#' )
+        {
+            return false;
+        }
+    }
+    else if( topic.size() != len )
     {
-        free( modifiedTopic );        
+        return false;
     }
+
+    return !memcmp( topic.data(), view.chars, len );
 }
 
 /** {@inheritDoc} */
@@ -86,4 +112,3 @@ bool CoreUtil::isWildcard( const char* topic )
     int length = (int)strlen( topic );
     return ( length > 0 && topic[length-1] == '#' );
 }
-
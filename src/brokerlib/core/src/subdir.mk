@@ -6,6 +6,7 @@ OBJS += \
 	core/src/CoreBridgeConfiguration.o \
 	core/src/CoreBridgeConfigurationFactory.o \
 	core/src/CoreBrokerHealth.o \
+	core/src/CoreGuidTable.o \
 	core/src/CoreInterface.o \
 	core/src/CoreInterfaceEventHandler.o \
 	core/src/CoreMessageContext.o \
@@ -417,6 +417,44 @@ public:
      */
     static uint32_t getBrokerLibThreadPoolSize() { return sm_brokerLibThreadPoolSize; }
 
+    /**
+     * Returns the count of write threads that socket writes are distributed across
+     *
+     * @return  The count of write threads that socket writes are distributed across
+     */
+    static uint32_t getWriteThreadCount() { return sm_writeThreadCount; }
+
+    /**
+     * Returns the count of threads that perform TLS handshakes for new connections. If
+     * zero, handshakes are performed by the main loop.
+     *
+     * @return  The count of threads that perform TLS handshakes for new connections
+     */
+    static uint32_t getTlsHandshakeThreadCount() { return sm_tlsHandshakeThreadCount; }
+
+    /**
+     * Returns the number of sessions held in the server-side TLS session cache. If zero,
+     * the session cache is disabled.
+     *
+     * @return  The number of sessions held in the server-side TLS session cache
+     */
+    static uint32_t getTlsSessionCacheSize() { return sm_tlsSessionCacheSize; }
+
+    /**
+     * Returns whether TLS session tickets are issued to clients
+     *
+     * @return  Whether TLS session tickets are issued to clients
+     */
+    static bool isTlsSessionTicketsEnabled() { return sm_tlsSessionTicketsEnabled; }
+
+    /**
+     * Returns the lifetime of resumable TLS sessions (in seconds). This is also the
+     * interval at which session ticket keys are rotated.
+     *
+     * @return  The lifetime of resumable TLS sessions (in seconds)
+     */
+    static uint32_t getTlsSessionTimeout() { return sm_tlsSessionTimeout; }
+
     /**
      * Returns whether to validate certificates against the connection identifier
      *
@@ -663,6 +701,21 @@ private:
     /** The brokerLib thread pool size */
     static uint32_t sm_brokerLibThreadPoolSize;
 
+    /** The count of write threads */
+    static uint32_t sm_writeThreadCount;
+
+    /** The count of TLS handshake threads */
+    static uint32_t sm_tlsHandshakeThreadCount;
+
+    /** The TLS session cache size */
+    static uint32_t sm_tlsSessionCacheSize;
+
+    /** Whether TLS session tickets are enabled */
+    static bool sm_tlsSessionTicketsEnabled;
+
+    /** The TLS session timeout */
+    static uint32_t sm_tlsSessionTimeout;
+
     /** Whether multi-tenant mode is enabled */
     static bool sm_multiTenantModeEnabled;
 
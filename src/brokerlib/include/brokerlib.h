@@ -41,6 +41,11 @@ namespace broker {
  * @param   brokerCertsUtHash List of broker certificate hashes (SHA-1) (out)
  * @param   webSocketsEnabled Whether WebSockets is enabled (out)
  * @param   webSocketsListenPort The broker WebSockets listen port (out)
+ * @param   writeThreadCount The count of write threads (out)
+ * @param   tlsHandshakeThreadCount The count of TLS handshake threads (out)
+ * @param   tlsSessionCacheSize The size of the TLS session cache (out)
+ * @param   tlsSessionTicketsEnabled Whether TLS session tickets are enabled (out)
+ * @param   tlsSessionTimeout The TLS session timeout in seconds (out)
  * @return  Whether Messaging core should continue starting
  */
 bool brokerlib_main( 
@@ -52,7 +57,9 @@ bool brokerlib_main(
     uint64_t* maxPacketBufferSize, int* listenPort, int* coreLogType,
     unsigned int* coreLogCategoryMask, int* messageSizeLimit, char** user,
     struct cert_hashes** brokerCertsUtHash,
-    bool *webSocketsEnabled, int* webSocketsListenPort );
+    bool *webSocketsEnabled, int* webSocketsListenPort,
+    int* writeThreadCount, int* tlsHandshakeThreadCount,
+    int* tlsSessionCacheSize, bool* tlsSessionTicketsEnabled, int* tlsSessionTimeout );
 
 /**
  * Initializes the broker library.
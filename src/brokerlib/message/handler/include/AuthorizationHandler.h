@@ -37,8 +37,8 @@ public:
     bool onInsertMessage(
         dxl::broker::core::CoreMessageContext* context, const char* destId,
         const char* canonicalDestId, bool isBridge,
-        uint8_t contextFlags, const char* targetTenantGuid, struct cert_hashes *certHashes,
-        bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen) const;
+        uint8_t contextFlags, const char* targetTenantGuid, const struct guid_ids* destGuidIds,
+        struct cert_hashes *certHashes, bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen) const;
 
 private:
     /** The topic authorization service */
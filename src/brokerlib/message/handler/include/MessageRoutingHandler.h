@@ -28,7 +28,7 @@ public:
     bool onInsertMessage(
         dxl::broker::core::CoreMessageContext* context, const char* destId,
         const char* canonicalDestId, bool isBridge, uint8_t contextFlags, const char* targetTenantGuid,
-        struct cert_hashes *certHashes, bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen ) const;
+        const struct guid_ids* destGuidIds, struct cert_hashes *certHashes, bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen ) const;
 
 private:
     /**
@@ -38,10 +38,13 @@ private:
      * @param   targetContextFlags The flags associated with the context being inserted into
      * @param   context The message context
      * @param   targetTenantGuid The tenant GUID associated with the context being inserted into
+     * @param   targetTenantId The interned identifier of the tenant GUID associated with the context
+     *          being inserted into
      * @return  Whether to allow the insertion of the message
      */
     bool onInsertMultiTenantMessage( DxlMessage* message, uint8_t targetContextFlags,
-        dxl::broker::core::CoreMessageContext* context, const char* targetTenantGuid) const;
+        dxl::broker::core::CoreMessageContext* context, const char* targetTenantGuid,
+        uint32_t targetTenantId ) const;
 };
 
 } /* namespace handler */
@@ -43,8 +43,8 @@ bool AuthorizationHandler::onPublishMessage(
 /** {@inheritDoc} */
 bool AuthorizationHandler::onInsertMessage(
     CoreMessageContext* context, const char* /*destId*/, const char* canonicalDestId, bool isBridge,
-    uint8_t contextFlags, const char* /*targetTenantGuid*/, struct cert_hashes *certHashes,
-    bool* /*isClient*/, unsigned char** /*clientMessage*/, size_t* /*clientMessageLen*/ ) const
+    uint8_t contextFlags, const char* /*targetTenantGuid*/, const struct guid_ids* /*destGuidIds*/,
+    struct cert_hashes *certHashes, bool* /*isClient*/, unsigned char** /*clientMessage*/, size_t* /*clientMessageLen*/ ) const
 {
     // Swap the identifier if applicable for local connections
     const char* clientDestId = ( (contextFlags & DXL_FLAG_LOCAL) ? BrokerSettings::getGuid() : canonicalDestId );
@@ -16,6 +16,7 @@
 #include "util/include/BrokerLibThreadPool.h"
 #include "include/BrokerSettings.h"
 #include "serviceregistry/include/ServiceRegistry.h"
+#include "topicauthorization/include/topicauthorizationservice.h"
 #include <unistd.h> // for usleep
 
 using namespace std;
@@ -54,6 +55,10 @@ public:
         brokerHealth.setOutgoingMsgs( m_msvc.getDestinationMessagesPerSecond() );
         brokerHealth.setLocalServicesCounter( ServiceRegistry::getInstance().getLocalSvcCounter() );
 
+        const shared_ptr<TopicAuthorizationService> authService = TopicAuthorizationService::Instance();
+        brokerHealth.setAuthorizationCacheHits( authService->getCacheHitCount() );
+        brokerHealth.setAuthorizationCacheMisses( authService->getCacheMissCount() );
+
         Broker broker; 
         BrokerRegistry::getInstance().getBroker( BrokerSettings::getGuid(), broker );
         brokerHealth.setStartUpTime( broker.getStartTime() ); 
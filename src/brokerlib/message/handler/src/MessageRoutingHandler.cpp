@@ -9,16 +9,19 @@
 #include "message/include/DxlMessageService.h"
 #include "message/handler/include/MessageRoutingHandler.h"
 #include "brokerregistry/include/brokerregistry.h"
+#include "core/include/CoreGuidTable.h"
 #include "DxlFlags.h"
 
+using namespace std;
 using namespace dxl::broker::message;
 using namespace dxl::broker::message::handler;
 using namespace dxl::broker::core;
 
 /** {@inheritDoc} */
 bool MessageRoutingHandler::onInsertMessage(
-    CoreMessageContext* context, const char* destId, const char* canonicalDestId, bool isBridge, uint8_t contextFlags,
-    const char* targetTenantGuid, struct cert_hashes* /*certHashes*/, bool* isClientMessageEnabled, 
+    CoreMessageContext* context, const char* destId, const char* /*canonicalDestId*/, bool isBridge, uint8_t contextFlags,
+    const char* targetTenantGuid, const struct guid_ids* destGuidIds, struct cert_hashes* /*certHashes*/,
+    bool* isClientMessageEnabled, 
     unsigned char** clientMessage, size_t* clientMessageLen ) const
 {
     if( SL_LOG.isDebugEnabled() )
@@ -37,13 +40,12 @@ bool MessageRoutingHandler::onInsertMessage(
         // If the destination is a bridge
         if( isBridge )
         {
-            const unordered_set<std::string>* nextBrokerGuids = 
-                message->getNextBrokerGuids();
+            const vector<uint32_t>* nextBrokerIds = message->getNextBrokerIds();
 
             // If next broker guids are available, ensure is intermediate broker
-            if( nextBrokerGuids != NULL )                
+            if( nextBrokerIds != NULL )                
             {
-                if( nextBrokerGuids->find( destId ) == nextBrokerGuids->end() )
+                if( !CoreGuidTable::contains( *nextBrokerIds, destGuidIds->id ) )
                 {
                     if( SL_LOG.isDebugEnabled() )
                     {
@@ -72,12 +74,12 @@ bool MessageRoutingHandler::onInsertMessage(
         }        
         else // If it is a Normal client
         {                        
-            const unordered_set<std::string>* destBrokerGuids = 
-                message->getDestinationBrokerGuids();
+            CoreGuidTable& guidTable = CoreGuidTable::getInstance();
+            const vector<uint32_t>* destBrokerIds = message->getDestinationBrokerIds();
 
             // If dest brokers are available, ensure this broker is a target
-            if( destBrokerGuids != NULL &&
-                destBrokerGuids->find( BrokerSettings::getGuid() ) == destBrokerGuids->end() )
+            if( destBrokerIds != NULL &&
+                !CoreGuidTable::contains( *destBrokerIds, guidTable.getBrokerId() ) )
             {
                 if( SL_LOG.isDebugEnabled() )
                 {
@@ -87,18 +89,17 @@ bool MessageRoutingHandler::onInsertMessage(
                 return false;
             }
 
-            const unordered_set<std::string>* destClientGuids = 
-                message->getDestinationClientGuids();
+            const vector<uint32_t>* destClientIds = message->getDestinationClientIds();
 
             // If clients are available, ensure this client is listed
             // If the "local" flag is set, check to see if the broker guid is listed
             // For "local" connections we allow routing on both the client id and the broker id
-            if( ( destClientGuids != NULL ) &&
-                ( destClientGuids->find( destId ) == destClientGuids->end() ) &&
-                ( destClientGuids->find( canonicalDestId ) == destClientGuids->end() ) &&
+            if( ( destClientIds != NULL ) &&
+                !CoreGuidTable::contains( *destClientIds, destGuidIds->id ) &&
+                !CoreGuidTable::contains( *destClientIds, destGuidIds->canonical_id ) &&
                 ( !( contextFlags & DXL_FLAG_LOCAL ) ||
-                  ( destClientGuids->find( BrokerSettings::getGuid() ) == destClientGuids->end() &&
-                    destClientGuids->find( BrokerSettings::getInstanceGuid() ) == destClientGuids->end() )
+                  ( !CoreGuidTable::contains( *destClientIds, guidTable.getBrokerId() ) &&
+                    !CoreGuidTable::contains( *destClientIds, guidTable.getBrokerInstanceId() ) )
                 )
               ) 
             {
@@ -114,7 +115,7 @@ bool MessageRoutingHandler::onInsertMessage(
             if( BrokerSettings::isMultiTenantModeEnabled() )
             {
                 if ( !onInsertMultiTenantMessage(
-                        message, contextFlags, context, targetTenantGuid ) )
+                        message, contextFlags, context, targetTenantGuid, destGuidIds->tenant_id ) )
                 {
                     // Target is not allow to recv the message
                     if( SL_LOG.isDebugEnabled() )
@@ -130,7 +131,7 @@ bool MessageRoutingHandler::onInsertMessage(
             }
 
             // Whether to use the client-specific message
-            if( destClientGuids != NULL && message->isEventMessage() )
+            if( destClientIds != NULL && message->isEventMessage() )
             {
                 *isClientMessageEnabled = true;
 
@@ -158,18 +159,18 @@ bool MessageRoutingHandler::onInsertMessage(
 /** {@inheritDoc} */
 bool MessageRoutingHandler::onInsertMultiTenantMessage(
     DxlMessage* message, const uint8_t targetContextFlags, CoreMessageContext* context,
-    const char* targetTenantGuid ) const
+    const char* targetTenantGuid, uint32_t targetTenantId ) const
 {
-    const unordered_set<std::string>* destTenantGuids = message->getDestinationTenantGuids();
+    const vector<uint32_t>* destTenantIds = message->getDestinationTenantIds();
  
     // If destination tenants are available, ensure this tenant is a target.
-    if( destTenantGuids != NULL && 
-        destTenantGuids->find( targetTenantGuid ) == destTenantGuids->end() )
+    if( destTenantIds != NULL && 
+        !CoreGuidTable::contains( *destTenantIds, targetTenantId ) )
     {        
         return false;
     }
     
-    if( destTenantGuids == NULL &&
+    if( destTenantIds == NULL &&
         !( targetContextFlags & DXL_FLAG_OPS ) &&
         !context->isSourceOps() &&
         strcmp( targetTenantGuid, message->getSourceTenantGuid() ) != 0 )
@@ -65,7 +65,8 @@ serviceRegistrationPtr_t ServiceLookupHandler::findServiceForTopic(
     ServiceRegistry& serviceRegistry = ServiceRegistry::getInstance();
 
     // Lookup the service for the specified topic
-    serviceRegistrationPtr_t service = serviceRegistry.getNextService( topic, targetServiceTenantGuid );
+    CoreUtil::WildcardIterator wcIter( topic );
+    serviceRegistrationPtr_t service = serviceRegistry.getNextService( wcIter.getTopic(), targetServiceTenantGuid );
 
     //
     // TODO: If no services are registered with wildcards, we can eliminate the following
@@ -76,17 +77,15 @@ serviceRegistrationPtr_t ServiceLookupHandler::findServiceForTopic(
     if( !service.get() )
     {
         // Attempt to find service based on wildcards (# at the end)
-        char* wcTopic = CoreUtil::iterateWildcardBegin( topic );
-        while( CoreUtil::iterateWildcardNext( wcTopic ) )
+        while( wcIter.next() )
         {
-            service = serviceRegistry.getNextService( wcTopic, targetServiceTenantGuid );
+            service = serviceRegistry.getNextService( wcIter.get(), targetServiceTenantGuid );
             if( service.get() )
             {
                 // Found a service, stop looking
                 break;
             }
         }
-        CoreUtil::iterateWildcardEnd( wcTopic );
     }
     
     return service;
@@ -160,20 +159,19 @@ bool ServiceLookupHandler::handleEvent( CoreMessageContext* context, DxlEvent* d
     ServiceRegistry& serviceRegistry = ServiceRegistry::getInstance();
 
     // Attempt to find prefix for the event
-    std::string prefix = serviceRegistry.getRequestPrefixForEvent( context->getTopic() );
+    CoreUtil::WildcardIterator wcIter( context->getTopic() );
+    std::string prefix = serviceRegistry.getRequestPrefixForEvent( wcIter.getTopic() );
     if( prefix.empty() )
     {
-        char* wcTopic = CoreUtil::iterateWildcardBegin( context->getTopic() );
-        while( CoreUtil::iterateWildcardNext( wcTopic ) )
+        while( wcIter.next() )
         {
-            prefix = serviceRegistry.getRequestPrefixForEvent( wcTopic );
+            prefix = serviceRegistry.getRequestPrefixForEvent( wcIter.get() );
             if( !prefix.empty() )
             {
                 // Found a prefix, stop looking
                 break;
             }
         }
-        CoreUtil::iterateWildcardEnd( wcTopic );
     }
 
     // If we found a prefix, attempt to find a service
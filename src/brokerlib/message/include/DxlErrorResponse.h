@@ -57,6 +57,13 @@ protected:
      * @param   msg The underlying message structure
      */
     DxlErrorResponse( dxl_message_t* msg );
+
+    /** 
+     * Constructor (lazy, see DxlMessage)
+     *
+     * @param   header The header parsed from the serialized message
+     */
+    DxlErrorResponse( const dxl_message_header_t& header );
 };
 
 } /* namespace message */
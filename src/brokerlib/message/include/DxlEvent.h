@@ -33,6 +33,13 @@ protected:
      * @param   msg The underlying message structure
      */
     DxlEvent( dxl_message_t* msg );
+
+    /** 
+     * Constructor (lazy, see DxlMessage)
+     *
+     * @param   header The header parsed from the serialized message
+     */
+    DxlEvent( const dxl_message_header_t& header );
 };
 
 } /* namespace message */
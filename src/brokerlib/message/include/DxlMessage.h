@@ -9,6 +9,8 @@
 #include "json/include/JsonWriter.h"
 #include "include/unordered_map.h"
 #include "include/unordered_set.h"
+#include <vector>
+#include <stdint.h>
 
 namespace dxl {
 namespace broker {
@@ -37,28 +39,28 @@ public:
      *
      * @return  Whether this message is a request message
      */
-    bool isRequestMessage() const { return m_msg->messageType == DXLMP_REQUEST; }
+    bool isRequestMessage() const { return m_messageType == DXLMP_REQUEST; }
 
     /**
      * Whether this message is a DXL response message
      *
      * @return  Whether this message is a response message
      */
-    bool isResponseMessage() const { return m_msg->messageType == DXLMP_RESPONSE; }
+    bool isResponseMessage() const { return m_messageType == DXLMP_RESPONSE; }
 
     /**
      * Whether this message is a DXL error message
      *
      * @return  Whether this message is a error message
      */
-    bool isErrorMessage() const { return m_msg->messageType == DXLMP_RESPONSE_ERROR; }
+    bool isErrorMessage() const { return m_messageType == DXLMP_RESPONSE_ERROR; }
 
     /**
      * Whether this message is a DXL event message
      *
      * @return  Whether this message is a event message
      */
-    bool isEventMessage() const { return m_msg->messageType == DXLMP_EVENT; }
+    bool isEventMessage() const { return m_messageType == DXLMP_EVENT; }
 
     /**
      * Returns the message id
@@ -109,6 +111,14 @@ public:
      */
     void setSourceClientInstanceId( const char* sourceClientInstanceId );
 
+    /**
+     * Sets the source of the message, which holds the source client and broker fields, and
+     * the certificate chain of the client, encoded once for the connection of the client
+     *
+     * @param   source The message source (the message holds a reference to it)
+     */
+    void setSource( dxl_message_source_t* source );
+
     /**
      * Sets the payload via the specified string
      *
@@ -247,6 +257,42 @@ public:
      */
     const unordered_set<std::string>* getNextBrokerGuids();
 
+    /**
+     * Returns the interned identifiers of the destination broker guids (see CoreGuidTable), or
+     * NULL if no destinations have been set. Guids that have not been interned are omitted.
+     *
+     * @return  The identifiers of the destination broker guids (sorted), or NULL if no
+     *          destinations have been set.
+     */
+    const std::vector<uint32_t>* getDestinationBrokerIds();
+
+    /**
+     * Returns the interned identifiers of the destination client guids (see CoreGuidTable), or
+     * NULL if no destinations have been set. Guids that have not been interned are omitted.
+     *
+     * @return  The identifiers of the destination client guids (sorted), or NULL if no
+     *          destinations have been set.
+     */
+    const std::vector<uint32_t>* getDestinationClientIds();
+
+    /**
+     * Returns the interned identifiers of the destination tenant GUIDs (see CoreGuidTable), or
+     * NULL if no destinations have been set. GUIDs that have not been interned are omitted.
+     *
+     * @return  The identifiers of the destination tenant GUIDs (sorted), or NULL if no
+     *          destinations have been set.
+     */
+    const std::vector<uint32_t>* getDestinationTenantIds();
+
+    /**
+     * Returns the interned identifiers of the next broker guids (see getNextBrokerGuids() and
+     * CoreGuidTable). Guids that have not been interned are omitted.
+     *
+     * @return  The identifiers of the next broker guids (sorted). A "NULL" value indicates that
+     *          the message is being sent everywhere (unrestricted).
+     */
+    const std::vector<uint32_t>* getNextBrokerIds();
+
     /**
      * Whether the message is dirty (has been updated)
      * 
@@ -267,21 +313,119 @@ protected:
      */
     DxlMessage( dxl_message_t* msg );
 
+    /** 
+     * Constructor (lazy). The message references the serialized bytes the header was parsed
+     * from, and the underlying message structure is created from the header when it is first
+     * accessed. The bytes must remain valid until the message is destroyed.
+     *
+     * @param   header The header parsed from the serialized message
+     */
+    DxlMessage( const dxl_message_header_t& header );
+
     /**
-     * Returns the underlying message structure
+     * Returns the underlying message structure (created from the header, including the
+     * payload, if necessary)
      * 
      * @return  The underlying message structure
      */
     dxl_message_t* getMessage() const;
 
+    /**
+     * Returns the underlying message structure for reading fields other than the payload
+     * (created from the header, excluding the payload, if necessary)
+     * 
+     * @return  The underlying message structure
+     */
+    const dxl_message_t* getMessageFields() const;
+
+    /**
+     * Returns the underlying message structure for updating fields other than the payload
+     * (created from the header, excluding the payload, if necessary)
+     * 
+     * @return  The underlying message structure
+     */
+    dxl_message_t* getMessageFields();
+
     /**
      * Sets that the message is dirty 
      */
     void markDirty() { m_isDirty = true; }
 
 private:
-    /** The underlying message structure */
-    dxl_message_t* m_msg;
+    /**
+     * Adds the strings of a header string array to the specified set
+     *
+     * @param   array The header string array
+     * @param   strings The set to add the strings to
+     */
+    static void addHeaderStrings( const dxl_message_str_array_t& array, unordered_set<std::string>& strings );
+
+    /**
+     * The interned identifiers of a set of guids (see CoreGuidTable)
+     */
+    struct GuidIds
+    {
+        /** The identifiers (sorted) */
+        std::vector<uint32_t> ids;
+        /** The generation of the guid table that the identifiers were resolved in */
+        uint64_t generation;
+    };
+
+    /**
+     * Resolves the identifiers of the specified guids, unless they were resolved in the current
+     * generation of the guid table
+     *
+     * @param   guidIds The identifiers (created if necessary)
+     * @param   headerGuids The guids of the serialized message (if the message structure has
+     *          not been created)
+     * @param   guids The guids of the message structure (if it has been created)
+     * @param   guidCount The count of guids of the message structure
+     * @return  The identifiers, or NULL if there are no guids
+     */
+    const std::vector<uint32_t>* resolveGuidIds( GuidIds*& guidIds,
+        const dxl_message_str_array_t& headerGuids, const char** guids, size_t guidCount );
+
+    /**
+     * Discards the identifiers of a set of guids
+     *
+     * @param   guidIds The identifiers
+     */
+    static void clearGuidIds( GuidIds*& guidIds );
+
+    /**
+     * Returns the payload within the serialized bytes the message was created from, if it has
+     * not been copied into the underlying message structure or replaced since
+     *
+     * @param   bytes The payload bytes (out)
+     * @param   size The size of the payload (out)
+     * @return  Whether the payload is still within the serialized bytes
+     */
+    bool getSerializedPayload( const unsigned char** bytes, size_t* size ) const;
+
+    /**
+     * Returns the source of the message, if its fields have not been set individually since
+     *
+     * @return  The source of the message (or NULL)
+     */
+    const dxl_message_source_t* getSource() const { return m_source; }
+
+    /**
+     * Sets the fields of the message source individually (on the underlying message structure
+     * and other fields) and releases the source. Invoked prior to a source field being set or
+     * the other fields being accessed, and prior to the message being fully converted to bytes.
+     */
+    void applySource();
+
+    /** The message type */
+    dxl_message_type_t m_messageType;
+    /** The underlying message structure (NULL until created from the header) */
+    mutable dxl_message_t* m_msg;
+    /** The header of the serialized message (lazy messages) */
+    dxl_message_header_t m_header;
+    /** Whether the payload has yet to be copied from the header into the message structure */
+    mutable bool m_payloadPending;
+    /** The source of the message (NULL if its fields are held individually) */
+    dxl_message_source_t* m_source;
     /** Whether the message is dirty (has been updated) */
     bool m_isDirty;
     /** The destination broker guids */
@@ -296,6 +440,14 @@ private:
     bool m_otherFieldsPending;
     /** The destination tenant GUIDs. */
     unordered_set<std::string>* m_destTenantGuids;
+    /** The identifiers of the destination broker guids */
+    GuidIds* m_destBrokerIds;
+    /** The identifiers of the destination client guids */
+    GuidIds* m_destClientIds;
+    /** The identifiers of the destination tenant GUIDs */
+    GuidIds* m_destTenantIds;
+    /** The identifiers of the next broker guids */
+    GuidIds* m_nextBrokerIds;
 };
 
 } /* namespace message */
@@ -80,6 +80,10 @@ struct DxlMessageConstants
     /** Channel for the "Service registry unregister request" */
     static const char* CHANNEL_DXL_SVCREGISTRY_UNREGISTER_REQUEST;
 
+    /** Authorization cache hits property */
+    static const char* PROP_AUTH_CACHE_HITS;
+    /** Authorization cache misses property */
+    static const char* PROP_AUTH_CACHE_MISSES;
     /** Bridges property */
     static const char* PROP_BRIDGES;
     /** Bridges that are children */
@@ -97,6 +97,24 @@ public:
     void toBytes( DxlMessage& message, unsigned char** bytes, size_t* size, 
         bool stripClientGuids = false ) const;
 
+    /**
+     * Returns the bytes for the DXL message, excluding the payload if it is still within the
+     * bytes the message was created from (see fromBytesLazy()). In that case only the fields
+     * around the payload are encoded, and the payload belongs at the offset within the bytes.
+     * The pre-encoded fields of the message source (see DxlMessage::setSource()) are written
+     * as-is.
+     *
+     * @param   message The DXL message
+     * @param   bytes The bytes pointer to output to
+     * @param   size The size of the bytes
+     * @param   payload The payload that belongs at the offset (out, NULL if the bytes include
+     *          the payload)
+     * @param   payloadSize The size of the payload (out)
+     * @param   payloadOffset The offset within the bytes that the payload belongs at (out)
+     */
+    void toBytesExcludingPayload( DxlMessage& message, unsigned char** bytes, size_t* size,
+        const unsigned char** payload, size_t* payloadSize, size_t* payloadOffset ) const;
+
     /**
      * Creates and returns a DXL message corresponding to the specified bytes
      *
@@ -107,6 +125,19 @@ public:
     std::shared_ptr<DxlMessage> fromBytes(
         const unsigned char* bytes, size_t size ) const;
 
+    /**
+     * Creates and returns a DXL message corresponding to the specified bytes, decoding only
+     * the message header. The message references the bytes (no copy) and its fields are
+     * copied from them when first accessed. Therefore, the bytes must remain valid until the
+     * message is destroyed.
+     *
+     * @param   bytes The bytes
+     * @param   size The bytes size
+     * @return  A DXL message corresponding to the specified bytes
+     */
+    std::shared_ptr<DxlMessage> fromBytesLazy(
+        const unsigned char* bytes, size_t size ) const;
+
     /**
      * Sends a DXL message as built by the specified builder
      * 
@@ -54,6 +54,13 @@ protected:
      * @param   msg The underlying message structure
      */
     DxlRequest( dxl_message_t* msg );
+
+    /** 
+     * Constructor (lazy, see DxlMessage)
+     *
+     * @param   header The header parsed from the serialized message
+     */
+    DxlRequest( const dxl_message_header_t& header );
 };
 
 } /* namespace message */
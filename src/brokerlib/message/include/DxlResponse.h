@@ -55,6 +55,13 @@ protected:
      * @param   msg The underlying message structure
      */
     DxlResponse( dxl_message_t* msg );
+
+    /** 
+     * Constructor (lazy, see DxlMessage)
+     *
+     * @param   header The header parsed from the serialized message
+     */
+    DxlResponse( const dxl_message_header_t& header );
 };
 
 } /* namespace message */
@@ -57,6 +57,25 @@ dxl_message_error_t copyDxlMessage(
 dxl_message_error_t createDxlMessageFromBytes(
     struct dxl_message_context_t *context, const unsigned char* bytes, size_t size, dxl_message_t** message);
 
+/*
+ * Parse the header (all fields) of a message from bytes. Nothing is allocated or copied; the
+ * header fields reference the bytes (see dxl_message_header_t).
+ */
+dxl_message_error_t parseDxlMessageHeader(
+    struct dxl_message_context_t *context, const unsigned char* bytes, size_t size, dxl_message_header_t* header);
+
+/*
+ * Returns the next string of a header string array (position starts at 0).
+ * Returns 0 if there are no more strings.
+ */
+int nextDxlMessageHeaderString(
+    const dxl_message_str_array_t* array, size_t* position, dxl_message_str_t* value);
+
+/* Create from a parsed header. The data is copied (the payload is not copied if excludePayload is set) */
+dxl_message_error_t createDxlMessageFromHeader(
+    struct dxl_message_context_t *context, const dxl_message_header_t* header, int excludePayload,
+    dxl_message_t** message);
+
 /* Free a DXL message */
 void freeDxlMessage(struct dxl_message_context_t *context, dxl_message_t* message);
 
@@ -64,6 +83,33 @@ void freeDxlMessage(struct dxl_message_context_t *context, dxl_message_t* messag
 dxl_message_error_t dxlMessageToBytes(struct dxl_message_context_t *context,
     unsigned char** bytes, size_t* size, dxl_message_t* message, int stripClientGuids);
 
+/*
+ * Convert a DXL message to bytes, excluding the body of the payload (the payload of the message
+ * is ignored, payloadSize is the size of the body). The body belongs at payloadOffset within the
+ * bytes, which allows existing payload bytes to be reused rather than copied.
+ * If a source is specified, its encoded fields replace those of the message (the source client
+ * ID, broker GUID and instance ID). Its certificate chain is added as an other field, unless the
+ * message already has that field.
+ */
+dxl_message_error_t dxlMessageToBytesExcludingPayload(struct dxl_message_context_t *context,
+    unsigned char** bytes, size_t* size, size_t* payloadOffset,
+    dxl_message_t* message, size_t payloadSize, const dxl_message_source_t* source,
+    int stripClientGuids);
+
+/*
+ * Create the source of the messages published by a client connection, with a single reference.
+ * The certificate chain may be NULL.
+ */
+dxl_message_error_t createDxlMessageSource(struct dxl_message_context_t *context,
+    const char* sourceClientId, const char* sourceBrokerGuid, const char* sourceClientInstanceId,
+    const char* certChain, dxl_message_source_t** source);
+
+/* Add a reference to a message source */
+void acquireDxlMessageSource(dxl_message_source_t* source);
+
+/* Remove a reference from a message source, the source is freed when none remain */
+void releaseDxlMessageSource(dxl_message_source_t* source);
+
 /*
  * Provide api to release bytes, to prevent memory operations from crossing dll boundaries
  * The buffer was allocated by dxlMessageToBytes
@@ -122,6 +122,91 @@ typedef struct dxl_message_t
 
 } dxl_message_t; /* struct dxl_message_t */
 
+/*
+ * A string within serialized message bytes. The string is borrowed from the bytes and is not
+ * null-terminated.
+ */
+typedef struct dxl_message_str_t
+{
+    const char* ptr;                    /* The characters (NULL if not present) */
+    size_t size;                        /* The count of characters */
+} dxl_message_str_t;
+
+/*
+ * An array of strings within serialized message bytes (borrowed from the bytes). Iterate the
+ * strings via nextDxlMessageHeaderString.
+ */
+typedef struct dxl_message_str_array_t
+{
+    const unsigned char* ptr;           /* The serialized strings */
+    size_t size;                        /* The size of the serialized strings (bytes) */
+    size_t count;                       /* The count of strings */
+} dxl_message_str_array_t;
+
+/*
+ * The fields of a serialized message, parsed without allocating or copying (see
+ * parseDxlMessageHeader). The fields are borrowed from the serialized bytes and are only valid
+ * while the bytes are. Fields that are not present in the message version are empty.
+ */
+typedef struct dxl_message_header_t
+{
+    ////////////////////////////////////////////////////////////////////////////
+    // Version 0
+    ////////////////////////////////////////////////////////////////////////////
+    dxl_message_type_t messageType;             /* The type of this message */
+    unsigned int version;                       /* Version (as serialized) */
+    dxl_message_str_t messageId;                /* Unique message ID */
+    dxl_message_str_t sourceClientId;           /* ID of the source client */
+    dxl_message_str_t sourceBrokerGuid;         /* GUID of the source broker */
+    dxl_message_str_array_t brokerGuids;        /* The GUIDs of brokers to deliver the message to */
+    dxl_message_str_array_t clientGuids;        /* The GUIDs of clients to deliver the message to */
+    const unsigned char* payload;               /* payload data */
+    size_t payloadSize;                         /* payload size */
+    dxl_message_str_t replyToTopic;             /* Request: reply-to topic */
+    dxl_message_str_t requestMessageId;         /* Response (and error): request message ID */
+    dxl_message_str_t serviceInstanceId;        /* Request, response (and error): service ID */
+    dxl_message_str_t errorMessage;             /* Response error: error message */
+    int errorCode;                              /* Response error: error code */
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Version 1
+    ////////////////////////////////////////////////////////////////////////////
+    dxl_message_str_array_t otherFields;        /* Other message fields (name-value pairs) */
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Version 2
+    ////////////////////////////////////////////////////////////////////////////
+    dxl_message_str_t sourceTenantGuid;         /* GUID of the source tenant */
+    dxl_message_str_array_t tenantGuids;        /* The GUIDs of tenants to deliver the message to */
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Version 3
+    ////////////////////////////////////////////////////////////////////////////
+    dxl_message_str_t sourceClientInstanceId;   /* Instance ID of the source client */
+
+} dxl_message_header_t; /* struct dxl_message_header_t */
+
+/*
+ * The source fields of the messages published by a client connection. The fields do not change
+ * for the life of the connection, so they are encoded once (see createDxlMessageSource) and the
+ * encoded fields are written as-is to each message. Sources are reference counted.
+ */
+typedef struct dxl_message_source_t
+{
+    int refCount;                               /* The count of references to the source */
+    const char* sourceClientId;                 /* ID of the source client (canonical) */
+    const char* sourceBrokerGuid;               /* GUID of the source broker */
+    const char* sourceClientInstanceId;         /* Instance ID of the source client */
+    const char* certChain;                      /* Certificate chain of the client (or NULL) */
+    const unsigned char* encodedIds;            /* Encoded client ID and broker GUID (adjacent) */
+    size_t encodedIdsSize;                      /* Encoded client ID and broker GUID size */
+    const unsigned char* encodedCerts;          /* Encoded certificate chain other field */
+    size_t encodedCertsSize;                    /* Encoded certificate chain other field size */
+    const unsigned char* encodedInstanceId;     /* Encoded client instance ID */
+    size_t encodedInstanceIdSize;               /* Encoded client instance ID size */
+
+} dxl_message_source_t; /* struct dxl_message_source_t */
+
 #if defined __cplusplus
 }
 #endif
@@ -8,6 +8,7 @@
 #include <cstdint>
 #include <string>
 #include "include/unordered_set.h"
+#include "core/include/CoreUtil.h"
 
 #include "message/payload/include/AbstractBrokerTopicEventPayload.h"
 
@@ -29,7 +30,8 @@ public:
     static const uint8_t STATE_END      = 1 << 1;
 
     /** Topic type def */
-    typedef unordered_set<std::string> topics_t;
+    typedef unordered_set<std::string,
+        dxl::broker::core::CoreUtil::TopicHash, dxl::broker::core::CoreUtil::TopicEqual> topics_t;
 
     /** 
      * Constructor
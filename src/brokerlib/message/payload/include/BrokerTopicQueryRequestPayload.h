@@ -6,6 +6,7 @@
 #define BROKERTOPICQUERYREQUESTPAYLOAD_H_
 
 #include "include/unordered_set.h"
+#include "core/include/CoreUtil.h"
 #include "json/include/JsonReader.h"
 
 namespace dxl {
@@ -20,6 +21,10 @@ class BrokerTopicQueryRequestPayload :
     public dxl::broker::json::JsonReader
 {
 public:
+    /** Topic type def */
+    typedef unordered_set<std::string,
+        dxl::broker::core::CoreUtil::TopicHash, dxl::broker::core::CoreUtil::TopicEqual> topics_t;
+
     /** 
      * Constructor
      */
@@ -43,14 +48,14 @@ public:
      *
      * @return  The query topics
      */
-    unordered_set<std::string> getQueryTopics() const { return m_queryTopics; }
+    topics_t getQueryTopics() const { return m_queryTopics; }
 
 private:
     /** The broker guid */
     std::string m_brokerGuid;
 
     /** The queried topics */
-    unordered_set<std::string> m_queryTopics;
+    topics_t m_queryTopics;
 };
 
 } /* namespace payload */
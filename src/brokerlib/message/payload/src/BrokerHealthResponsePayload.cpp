@@ -16,4 +16,6 @@ void BrokerHealthResponsePayload::write( Json::Value& out ) const
     out[ DxlMessageConstants::PROP_OUTGOING_MSGS ] = static_cast<double>(m_brokerHealth.getOutgoingMsgs());
     out[ DxlMessageConstants::PROP_LOCAL_SVC_COUNTER ] = static_cast<Json::Value::UInt>(m_brokerHealth.getLocalServicesCounter());
     out[ DxlMessageConstants::PROP_START_TIME ] = static_cast<Json::Value::UInt>(m_brokerHealth.getStartUpTime());
+    out[ DxlMessageConstants::PROP_AUTH_CACHE_HITS ] = static_cast<Json::Value::UInt64>(m_brokerHealth.getAuthorizationCacheHits());
+    out[ DxlMessageConstants::PROP_AUTH_CACHE_MISSES ] = static_cast<Json::Value::UInt64>(m_brokerHealth.getAuthorizationCacheMisses());
 }
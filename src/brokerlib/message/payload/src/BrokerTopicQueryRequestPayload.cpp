@@ -17,7 +17,7 @@ void BrokerTopicQueryRequestPayload::read( const Json::Value& in )
     m_brokerGuid = in[ DxlMessageConstants::PROP_BROKER_GUID ].asString();
 
     Json::Value queryTopicsJson = in[ DxlMessageConstants::PROP_TOPICS ];
-    unordered_set<string> queryTopics;
+    topics_t queryTopics;
     for( Value::iterator itr = queryTopicsJson.begin(); itr != queryTopicsJson.end(); itr++ )
     {
         queryTopics.insert( (*itr).asString() );
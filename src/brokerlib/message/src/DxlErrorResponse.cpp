@@ -18,6 +18,12 @@ DxlErrorResponse::DxlErrorResponse( dxl_message_t* msg ) :
 {
 }
 
+/** {@inheritDoc} */
+DxlErrorResponse::DxlErrorResponse( const dxl_message_header_t& header ) : 
+    DxlResponse( header )
+{
+}
+
 /** {@inheritDoc} */
 DxlErrorResponse::~DxlErrorResponse()
 {
@@ -26,12 +32,12 @@ DxlErrorResponse::~DxlErrorResponse()
 /** {@inheritDoc} */
 uint32_t DxlErrorResponse::getErrorCode() const
 {
-    return getMessage()->dxl_message_specificData.responseErrorData->code;
+    return getMessageFields()->dxl_message_specificData.responseErrorData->code;
 }
 
 /** {@inheritDoc} */
 const char* DxlErrorResponse::getDestinationServiceId() const
 {
-    return getMessage()->dxl_message_specificData.responseErrorData->serviceInstanceId;
+    return getMessageFields()->dxl_message_specificData.responseErrorData->serviceInstanceId;
 }
 
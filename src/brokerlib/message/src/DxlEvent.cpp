@@ -12,6 +12,11 @@ DxlEvent::DxlEvent( dxl_message_t* msg ) : DxlMessage( msg )
     
 }
 
+/** {@inheritDoc} */
+DxlEvent::DxlEvent( const dxl_message_header_t& header ) : DxlMessage( header )
+{  
+}
+
 /** {@inheritDoc} */
 DxlEvent::~DxlEvent()
 {
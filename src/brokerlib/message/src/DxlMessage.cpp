@@ -5,29 +5,61 @@
 #include "include/BrokerSettings.h"
 #include "include/SimpleLog.h"
 #include "brokerregistry/include/brokerregistry.h"
+#include "core/include/CoreGuidTable.h"
 #include "json/include/JsonService.h"
 #include "message/include/DxlMessage.h"
 #include "message/include/dx_message.h"
 #include <boost/format.hpp>
 #include "dxlcommon.h"
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 
 using namespace std;
 using namespace dxl::broker;
+using namespace dxl::broker::core;
 using namespace dxl::broker::json;
 using namespace dxl::broker::message;
 
 /** {@inheritDoc} */
 DxlMessage::DxlMessage( dxl_message_t* msg ) : 
+    m_messageType( msg->messageType ),
     m_msg( msg ), 
+    m_payloadPending( false ),
+    m_source( NULL ),
     m_isDirty( false ), 
     m_destBrokerGuids( NULL ), 
     m_destClientGuids( NULL ),
     m_nextBrokerGuids( NULL ),
     m_otherFields( NULL ),
     m_otherFieldsPending( false ),
-    m_destTenantGuids( NULL )
+    m_destTenantGuids( NULL ),
+    m_destBrokerIds( NULL ),
+    m_destClientIds( NULL ),
+    m_destTenantIds( NULL ),
+    m_nextBrokerIds( NULL )
+{  
+    memset( &m_header, 0, sizeof( m_header ) );
+}
+
+/** {@inheritDoc} */
+DxlMessage::DxlMessage( const dxl_message_header_t& header ) : 
+    m_messageType( header.messageType ),
+    m_msg( NULL ), 
+    m_header( header ),
+    m_payloadPending( true ),
+    m_source( NULL ),
+    m_isDirty( false ), 
+    m_destBrokerGuids( NULL ), 
+    m_destClientGuids( NULL ),
+    m_nextBrokerGuids( NULL ),
+    m_otherFields( NULL ),
+    m_otherFieldsPending( false ),
+    m_destTenantGuids( NULL ),
+    m_destBrokerIds( NULL ),
+    m_destClientIds( NULL ),
+    m_destTenantIds( NULL ),
+    m_nextBrokerIds( NULL )
 {  
 }
 
@@ -35,6 +67,7 @@ DxlMessage::DxlMessage( dxl_message_t* msg ) :
 DxlMessage::~DxlMessage()
 {
     freeMessage( m_msg );    
+    releaseDxlMessageSource( m_source );
     if( m_destBrokerGuids )
     {
         delete m_destBrokerGuids;
@@ -55,31 +88,98 @@ DxlMessage::~DxlMessage()
     {
         delete m_destTenantGuids;
     }
+    clearGuidIds( m_destBrokerIds );
+    clearGuidIds( m_destClientIds );
+    clearGuidIds( m_destTenantIds );
+    clearGuidIds( m_nextBrokerIds );
 }
 
 /** {@inheritDoc} */
 dxl_message_t* DxlMessage::getMessage() const
 {
+    getMessageFields();
+
+    if( m_payloadPending )
+    {
+        dxl_message_error_t result = 
+            setDxlMessagePayload( NULL, m_msg, m_header.payload, m_header.payloadSize );
+        if( result != DXLMP_OK )
+        {
+            throw runtime_error(
+                ( boost::format( "Error setting message payload: %1%" ) %
+                    result ).str() );
+        }
+        m_payloadPending = false;
+    }
+
     return m_msg;
 }
 
+/** {@inheritDoc} */
+const dxl_message_t* DxlMessage::getMessageFields() const
+{
+    if( !m_msg )
+    {
+        dxl_message_error_t result = createDxlMessageFromHeader( NULL, &m_header, 1, &m_msg );
+        if( result != DXLMP_OK )
+        {
+            throw runtime_error(
+                ( boost::format( "Error creating message from header: %1%" ) %
+                    result ).str() );
+        }
+    }
+
+    return m_msg;
+}
+
+/** {@inheritDoc} */
+dxl_message_t* DxlMessage::getMessageFields()
+{
+    static_cast<const DxlMessage*>( this )->getMessageFields();
+    return m_msg;
+}
+
+/** {@inheritDoc} */
+bool DxlMessage::getSerializedPayload( const unsigned char** bytes, size_t* size ) const
+{
+    if( m_payloadPending )
+    {
+        *bytes = m_header.payload;
+        *size = m_header.payloadSize;
+    }
+    return m_payloadPending;
+}
+
+/** {@inheritDoc} */
+void DxlMessage::addHeaderStrings( const dxl_message_str_array_t& array, unordered_set<string>& strings )
+{
+    size_t position = 0;
+    dxl_message_str_t value;
+    while( nextDxlMessageHeaderString( &array, &position, &value ) )
+    {
+        strings.insert( string( value.ptr, value.size ) );
+    }
+}
+
 /** {@inheritDoc} */
 const char* DxlMessage::getMessageId() const
 {
-    return m_msg->messageId;
+    return getMessageFields()->messageId;
 }
 
 /** {@inheritDoc} */
 const char* DxlMessage::getSourceBrokerGuid() const
 {
-    return m_msg->sourceBrokerGuid;
+    return m_source ? m_source->sourceBrokerGuid : getMessageFields()->sourceBrokerGuid;
 }
 
 /** {@inheritDoc} */
 void DxlMessage::setSourceBrokerGuid( const char* sourceBrokerGuid )
 {
+    applySource();
+
     dxl_message_error_t result =
-        setDxlMessageSourceBrokerGuid( NULL, m_msg, sourceBrokerGuid );
+        setDxlMessageSourceBrokerGuid( NULL, getMessageFields(), sourceBrokerGuid );
     if( result != DXLMP_OK )
     {
         throw runtime_error(
@@ -94,14 +194,16 @@ void DxlMessage::setSourceBrokerGuid( const char* sourceBrokerGuid )
 /** {@inheritDoc} */
 const char* DxlMessage::getSourceClientId() const
 {
-    return m_msg->sourceClientId;
+    return m_source ? m_source->sourceClientId : getMessageFields()->sourceClientId;
 }
 
 /** {@inheritDoc} */
 void DxlMessage::setSourceClientId( const char* sourceClientId )
 {
+    applySource();
+
     dxl_message_error_t result =
-        setDxlMessageSourceClientId( NULL, m_msg, sourceClientId );
+        setDxlMessageSourceClientId( NULL, getMessageFields(), sourceClientId );
     if( result != DXLMP_OK )
     {
         throw runtime_error(
@@ -116,16 +218,20 @@ void DxlMessage::setSourceClientId( const char* sourceClientId )
 /** {@inheritDoc} */
 const char* DxlMessage::getSourceClientInstanceId() const
 {
+    const char* sourceClientInstanceId = m_source ?
+        m_source->sourceClientInstanceId : getMessageFields()->sourceClientInstanceId;
     return 
-        ( m_msg->sourceClientInstanceId != NULL && strlen(m_msg->sourceClientInstanceId) > 0 ) ?
-            m_msg->sourceClientInstanceId : getSourceClientId();
+        ( sourceClientInstanceId != NULL && strlen(sourceClientInstanceId) > 0 ) ?
+            sourceClientInstanceId : getSourceClientId();
 }
 
 /** {@inheritDoc} */
 void DxlMessage::setSourceClientInstanceId( const char* sourceClientInstanceId )
 {
+    applySource();
+
     dxl_message_error_t result =
-        setDxlMessageSourceClientInstanceId( NULL, m_msg, sourceClientInstanceId );
+        setDxlMessageSourceClientInstanceId( NULL, getMessageFields(), sourceClientInstanceId );
     if( result != DXLMP_OK )
     {
         throw runtime_error(
@@ -137,10 +243,56 @@ void DxlMessage::setSourceClientInstanceId( const char* sourceClientInstanceId )
     markDirty();
 }
 
+/** {@inheritDoc} */
+void DxlMessage::setSource( dxl_message_source_t* source )
+{
+    acquireDxlMessageSource( source );
+    releaseDxlMessageSource( m_source );
+    m_source = source;
+
+    // Mark dirty
+    markDirty();
+}
+
+/** {@inheritDoc} */
+void DxlMessage::applySource()
+{
+    if( !m_source )
+    {
+        return;
+    }
+
+    // Cleared first, the setters apply the source
+    dxl_message_source_t* source = m_source;
+    m_source = NULL;
+
+    try
+    {
+        setSourceBrokerGuid( source->sourceBrokerGuid );
+        setSourceClientId( source->sourceClientId );
+        setSourceClientInstanceId( source->sourceClientInstanceId );
+        if( source->certChain )
+        {
+            setOtherField( "dxl.certs", source->certChain );
+        }
+    }
+    catch( ... )
+    {
+        releaseDxlMessageSource( source );
+        throw;
+    }
+
+    releaseDxlMessageSource( source );
+}
+
 /** {@inheritDoc} */
 void DxlMessage::setPayload( const unsigned char* bytes, size_t size )
 {
-    dxl_message_error_t result = setDxlMessagePayload( 0, getMessage(), bytes, size );
+    // Replacing the payload, no need to copy it from the serialized message
+    dxl_message_t* msg = getMessageFields();
+    m_payloadPending = false;
+
+    dxl_message_error_t result = setDxlMessagePayload( 0, msg, bytes, size );
     if( result != DXLMP_OK )
     {
         throw runtime_error(
@@ -167,8 +319,17 @@ void DxlMessage::setPayload( const JsonWriter& writer, bool log )
 /** {@inheritDoc} */
 void DxlMessage::getPayload( const unsigned char** bytes, size_t* size ) const
 {
-    *bytes = m_msg->payload;
-    *size = m_msg->payloadSize;
+    if( m_payloadPending )
+    {
+        // Not copied from the serialized message yet
+        *bytes = m_header.payload;
+        *size = m_header.payloadSize;
+    }
+    else
+    {
+        *bytes = m_msg->payload;
+        *size = m_msg->payloadSize;
+    }
 }
 
 /** {@inheritDoc} */
@@ -199,8 +360,11 @@ void DxlMessage::setDestinationBrokerGuid( const char* brokerGuid )
         m_nextBrokerGuids = NULL;
     }
 
+    clearGuidIds( m_destBrokerIds );
+    clearGuidIds( m_nextBrokerIds );
+
     const char* brokerGuids[] = { brokerGuid };
-    setDxlMessageBrokerGuids( NULL, m_msg, brokerGuids, 1 );
+    setDxlMessageBrokerGuids( NULL, getMessageFields(), brokerGuids, 1 );
 
     // Mark dirty
     markDirty();
@@ -209,7 +373,13 @@ void DxlMessage::setDestinationBrokerGuid( const char* brokerGuid )
 /** {@inheritDoc} */
 const unordered_set<string>* DxlMessage::getDestinationBrokerGuids()
 {
-    if( !m_destBrokerGuids && m_msg->brokerGuidCount > 0 )
+    if( !m_destBrokerGuids && !m_msg && m_header.brokerGuids.count > 0 )
+    {
+        // Read from the serialized message
+        m_destBrokerGuids = new unordered_set<string>();
+        addHeaderStrings( m_header.brokerGuids, *m_destBrokerGuids );
+    }
+    else if( !m_destBrokerGuids && m_msg && m_msg->brokerGuidCount > 0 )
     {
         m_destBrokerGuids = new unordered_set<string>();
         for( size_t i = 0; i < m_msg->brokerGuidCount; i++ )
@@ -230,8 +400,10 @@ void DxlMessage::setDestinationClientGuid( const char* clientGuid )
         m_destClientGuids = NULL;
     }
 
+    clearGuidIds( m_destClientIds );
+
     const char* clientGuids[] = { clientGuid };
-    setDxlMessageClientGuids( NULL, m_msg, clientGuids, 1 );    
+    setDxlMessageClientGuids( NULL, getMessageFields(), clientGuids, 1 );    
 
     // Mark dirty
     markDirty();
@@ -240,7 +412,13 @@ void DxlMessage::setDestinationClientGuid( const char* clientGuid )
 /** {@inheritDoc} */
 const unordered_set<string>* DxlMessage::getDestinationClientGuids()
 {
-    if( !m_destClientGuids && m_msg->clientGuidCount > 0 )
+    if( !m_destClientGuids && !m_msg && m_header.clientGuids.count > 0 )
+    {
+        // Read from the serialized message
+        m_destClientGuids = new unordered_set<string>();
+        addHeaderStrings( m_header.clientGuids, *m_destClientGuids );
+    }
+    else if( !m_destClientGuids && m_msg && m_msg->clientGuidCount > 0 )
     {
         m_destClientGuids = new unordered_set<string>();
         for( size_t i = 0; i < m_msg->clientGuidCount; i++ )
@@ -282,6 +460,122 @@ const unordered_set<string>* DxlMessage::getNextBrokerGuids()
     return m_nextBrokerGuids;
 }
 
+/** {@inheritDoc} */
+const vector<uint32_t>* DxlMessage::getDestinationBrokerIds()
+{
+    return resolveGuidIds( m_destBrokerIds, m_header.brokerGuids,
+        m_msg ? m_msg->brokerGuids : NULL, m_msg ? m_msg->brokerGuidCount : 0 );
+}
+
+/** {@inheritDoc} */
+const vector<uint32_t>* DxlMessage::getDestinationClientIds()
+{
+    return resolveGuidIds( m_destClientIds, m_header.clientGuids,
+        m_msg ? m_msg->clientGuids : NULL, m_msg ? m_msg->clientGuidCount : 0 );
+}
+
+/** {@inheritDoc} */
+const vector<uint32_t>* DxlMessage::getDestinationTenantIds()
+{
+    return resolveGuidIds( m_destTenantIds, m_header.tenantGuids,
+        m_msg ? m_msg->tenantGuids : NULL, m_msg ? m_msg->tenantGuidCount : 0 );
+}
+
+/** {@inheritDoc} */
+const vector<uint32_t>* DxlMessage::getNextBrokerIds()
+{
+    const unordered_set<string>* nextGuids = getNextBrokerGuids();
+    if( !nextGuids )
+    {
+        return NULL;
+    }
+
+    CoreGuidTable& guidTable = CoreGuidTable::getInstance();
+    if( !m_nextBrokerIds )
+    {
+        m_nextBrokerIds = new GuidIds();
+    }
+    else if( m_nextBrokerIds->generation == guidTable.getGeneration() )
+    {
+        return &m_nextBrokerIds->ids;
+    }
+
+    m_nextBrokerIds->ids.clear();
+    for( auto iter = nextGuids->begin(); iter != nextGuids->end(); ++iter )
+    {
+        uint32_t id = guidTable.find( iter->data(), iter->size() );
+        if( id )
+        {
+            m_nextBrokerIds->ids.push_back( id );
+        }
+    }
+    sort( m_nextBrokerIds->ids.begin(), m_nextBrokerIds->ids.end() );
+    m_nextBrokerIds->generation = guidTable.getGeneration();
+
+    return &m_nextBrokerIds->ids;
+}
+
+/** {@inheritDoc} */
+const vector<uint32_t>* DxlMessage::resolveGuidIds( GuidIds*& guidIds,
+    const dxl_message_str_array_t& headerGuids, const char** guids, size_t guidCount )
+{
+    if( ( m_msg && guidCount == 0 ) || ( !m_msg && headerGuids.count == 0 ) )
+    {
+        return NULL;
+    }
+
+    CoreGuidTable& guidTable = CoreGuidTable::getInstance();
+    if( !guidIds )
+    {
+        guidIds = new GuidIds();
+    }
+    else if( guidIds->generation == guidTable.getGeneration() )
+    {
+        return &guidIds->ids;
+    }
+
+    guidIds->ids.clear();
+    if( m_msg )
+    {
+        for( size_t i = 0; i < guidCount; i++ )
+        {
+            uint32_t id = guidTable.find( guids[i], strlen( guids[i] ) );
+            if( id )
+            {
+                guidIds->ids.push_back( id );
+            }
+        }
+    }
+    else
+    {
+        // Read from the serialized message
+        size_t position = 0;
+        dxl_message_str_t value;
+        while( nextDxlMessageHeaderString( &headerGuids, &position, &value ) )
+        {
+            uint32_t id = guidTable.find( value.ptr, value.size );
+            if( id )
+            {
+                guidIds->ids.push_back( id );
+            }
+        }
+    }
+    sort( guidIds->ids.begin(), guidIds->ids.end() );
+    guidIds->generation = guidTable.getGeneration();
+
+    return &guidIds->ids;
+}
+
+/** {@inheritDoc} */
+void DxlMessage::clearGuidIds( GuidIds*& guidIds )
+{
+    if( guidIds )
+    {
+        delete guidIds;
+        guidIds = NULL;
+    }
+}
+
 /** {@inheritDoc} */
 void DxlMessage::setOtherField( const string& name, const string& value )
 {
@@ -325,7 +619,27 @@ bool DxlMessage::getOtherField( const string& name, string& value )
 /** {@inheritDoc} */
 const unordered_map<string, string>* DxlMessage::getOtherFields()
 {
-    if( !m_otherFields && m_msg->otherFieldsCount > 0 )
+    // The certificate chain of the source is an other field
+    applySource();
+
+    if( !m_otherFields && !m_msg && m_header.otherFields.count > 0 )
+    {
+        // Read from the serialized message (ensure name-value pairs)
+        if( ( m_header.otherFields.count % 2 ) == 0 )
+        {
+            m_otherFields = new unordered_map<string,string>();
+            size_t position = 0;
+            dxl_message_str_t name, value;
+            while( nextDxlMessageHeaderString( &m_header.otherFields, &position, &name ) &&
+                nextDxlMessageHeaderString( &m_header.otherFields, &position, &value ) )
+            {
+                m_otherFields->insert( 
+                    pair<string,string>( 
+                        string( name.ptr, name.size ), string( value.ptr, value.size ) ) );
+            }
+        }
+    }
+    else if( !m_otherFields && m_msg && m_msg->otherFieldsCount > 0 )
     {
         // Ensure it is divisible by 2 (name-value pairs)
         if( ( m_msg->otherFieldsCount % 2 ) == 0 )
@@ -366,7 +680,7 @@ void DxlMessage::onPreToBytes()
                     otherFields[pos++] = iter->first.c_str();
                     otherFields[pos++] = iter->second.c_str();
                 }
-                setDxlMessageOtherFields( NULL, m_msg, otherFields, otherFieldsCount );            
+                setDxlMessageOtherFields( NULL, getMessageFields(), otherFields, otherFieldsCount );            
                 free( otherFields );
             }
             else
@@ -381,13 +695,13 @@ void DxlMessage::onPreToBytes()
 /** {@inheritDoc} */
 const char* DxlMessage::getSourceTenantGuid() const
 {
-     return m_msg->sourceTenantGuid;
+     return getMessageFields()->sourceTenantGuid;
 }
 
 /** {@inheritDoc} */
 void DxlMessage::setSourceTenantGuid( const char* sourceTenantGuid )
 {
-    dxl_message_error_t result = setDxlMessageSourceTenantGuid( NULL, m_msg, sourceTenantGuid );
+    dxl_message_error_t result = setDxlMessageSourceTenantGuid( NULL, getMessageFields(), sourceTenantGuid );
     if( result != DXLMP_OK )
     {
         throw runtime_error(
@@ -402,7 +716,13 @@ void DxlMessage::setSourceTenantGuid( const char* sourceTenantGuid )
 /** {@inheritDoc} */
 const unordered_set<std::string>* DxlMessage::getDestinationTenantGuids()
 {
-    if( !m_destTenantGuids && m_msg->tenantGuidCount > 0 )
+    if( !m_destTenantGuids && !m_msg && m_header.tenantGuids.count > 0 )
+    {
+        // Read from the serialized message
+        m_destTenantGuids = new unordered_set<string>();
+        addHeaderStrings( m_header.tenantGuids, *m_destTenantGuids );
+    }
+    else if( !m_destTenantGuids && m_msg && m_msg->tenantGuidCount > 0 )
     {
         m_destTenantGuids = new unordered_set<string>();
         for( size_t i = 0; i < m_msg->tenantGuidCount; ++i )
@@ -423,7 +743,9 @@ void DxlMessage::setDestinationTenantGuids( const char* tenantGuids[], size_t te
         m_destTenantGuids = NULL;
     }
 
-    setDxlMessageTenantGuids( NULL, m_msg, tenantGuids, tenantGuidCount );
+    clearGuidIds( m_destTenantIds );
+
+    setDxlMessageTenantGuids( NULL, getMessageFields(), tenantGuids, tenantGuidCount );
 
     // Mark dirty
     markDirty();
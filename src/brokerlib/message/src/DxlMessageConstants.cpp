@@ -70,6 +70,8 @@ const char* DxlMessageConstants::CHANNEL_DXL_SVCREGISTRY_UNREGISTER_REQUEST =
 // Properties
 //
 
+const char* DxlMessageConstants::PROP_AUTH_CACHE_HITS = "authorizationCacheHits";
+const char* DxlMessageConstants::PROP_AUTH_CACHE_MISSES = "authorizationCacheMisses";
 const char* DxlMessageConstants::PROP_BRIDGES = "bridges";
 const char* DxlMessageConstants::PROP_BRIDGE_CHILDREN = "bridgeChildren";
 const char* DxlMessageConstants::PROP_BROKERS = "brokers";
@@ -99,6 +99,9 @@ void DxlMessageService::toBytes( const DxlMessageBuilder& builder, unsigned char
 void DxlMessageService::toBytes( DxlMessage& message, unsigned char** bytes, size_t* size, 
     bool stripClientGuids  ) const
 {
+    // The source fields are set individually (only encoded by the source when excluding the payload)
+    message.applySource();
+
     // Inform the message that it is about to be converted to bytes
     message.onPreToBytes();
 
@@ -111,6 +114,34 @@ void DxlMessageService::toBytes( DxlMessage& message, unsigned char** bytes, siz
     }
 }
 
+/** {@inheritDoc} */
+void DxlMessageService::toBytesExcludingPayload( DxlMessage& message, unsigned char** bytes, size_t* size,
+    const unsigned char** payload, size_t* payloadSize, size_t* payloadOffset ) const
+{
+    if( !message.getSerializedPayload( payload, payloadSize ) )
+    {
+        // The payload has been copied or replaced, encode all of it
+        *payload = NULL;
+        *payloadSize = 0;
+        *payloadOffset = 0;
+        toBytes( message, bytes, size );
+        return;
+    }
+
+    // Inform the message that it is about to be converted to bytes
+    message.onPreToBytes();
+
+    dxl_message_error_t result = dxlMessageToBytesExcludingPayload(
+        NULL, bytes, size, payloadOffset, message.getMessageFields(), *payloadSize,
+        message.getSource(), 0 );
+    if( result != DXLMP_OK )
+    {
+        stringstream errMsg;
+        errMsg << "Error converting message to bytes: " << result;
+        throw runtime_error( errMsg.str() );        
+    }
+}
+
 /** {@inheritDoc} */
 shared_ptr<DxlMessage> DxlMessageService::fromBytes( 
     const unsigned char* bytes, size_t size ) const
@@ -142,6 +173,36 @@ shared_ptr<DxlMessage> DxlMessageService::fromBytes(
     }
 }
 
+/** {@inheritDoc} */
+shared_ptr<DxlMessage> DxlMessageService::fromBytesLazy( 
+    const unsigned char* bytes, size_t size ) const
+{
+    dxl_message_header_t header;
+    dxl_message_error_t result = parseDxlMessageHeader( NULL, bytes, size, &header );
+    if( result != DXLMP_OK )
+    {
+        stringstream errMsg;
+        errMsg << "Error parsing message header from bytes: " << result;
+        throw runtime_error( errMsg.str() );        
+    }
+
+    switch( header.messageType )
+    {
+        case DXLMP_EVENT:
+            return shared_ptr<DxlEvent>( new DxlEvent( header ) );
+        case DXLMP_REQUEST:
+            return shared_ptr<DxlRequest>( new DxlRequest( header ) );
+        case DXLMP_RESPONSE:
+            return shared_ptr<DxlResponse>( new DxlResponse( header ) );
+        case DXLMP_RESPONSE_ERROR:
+            return shared_ptr<DxlErrorResponse>( new DxlErrorResponse( header ) );
+        default:
+            stringstream errMsg;
+            errMsg << "Message type from bytes not supported: " << header.messageType;
+            throw runtime_error( errMsg.str() );        
+    }
+}
+
 /** {@inheritDoc} */
 void DxlMessageService::sendMessage( const char* channel, const DxlMessageBuilder& builder ) const
 {
@@ -11,16 +11,21 @@ DxlRequest::DxlRequest( dxl_message_t* msg ) : DxlMessage( msg )
 {      
 }
 
+/** {@inheritDoc} */
+DxlRequest::DxlRequest( const dxl_message_header_t& header ) : DxlMessage( header )
+{      
+}
+
 /** {@inheritDoc} */
 const char* DxlRequest::getReplyToTopic() const
 {
-    return getMessage()->dxl_message_specificData.requestData->replyToTopic;
+    return getMessageFields()->dxl_message_specificData.requestData->replyToTopic;
 }
 
 /** {@inheritDoc} */
 void DxlRequest::setDestinationServiceId( const char* serviceId )
 {
-    setDxlRequestMessageAttributes( NULL, getMessage(), service_instance_id, serviceId );
+    setDxlRequestMessageAttributes( NULL, getMessageFields(), service_instance_id, serviceId );
 
     // Mark dirty
     markDirty();
@@ -29,7 +34,7 @@ void DxlRequest::setDestinationServiceId( const char* serviceId )
 /** {@inheritDoc} */
 const char* DxlRequest::getDestinationServiceId() const
 {
-    return getMessage()->dxl_message_specificData.requestData->serviceInstanceId;
+    return getMessageFields()->dxl_message_specificData.requestData->serviceInstanceId;
 }
 
 /** {@inheritDoc} */
@@ -39,6 +39,12 @@ DxlResponse::DxlResponse( dxl_message_t* msg ) :
 {
 }
 
+/** {@inheritDoc} */
+DxlResponse::DxlResponse( const dxl_message_header_t& header ) : 
+    DxlMessage( header )
+{
+}
+
 /** {@inheritDoc} */
 DxlResponse::~DxlResponse()
 {
@@ -47,7 +53,7 @@ DxlResponse::~DxlResponse()
 /** {@inheritDoc} */
 void DxlResponse::setDestinationServiceId( const char* serviceId )
 {
-    setDxlResponseMessageServiceId( NULL, getMessage(), serviceId );
+    setDxlResponseMessageServiceId( NULL, getMessageFields(), serviceId );
 
     // Mark dirty
     markDirty();
@@ -56,5 +62,5 @@ void DxlResponse::setDestinationServiceId( const char* serviceId )
 /** {@inheritDoc} */
 const char* DxlResponse::getDestinationServiceId() const
 {
-    return getMessage()->dxl_message_specificData.responseData->serviceInstanceId;
+    return getMessageFields()->dxl_message_specificData.responseData->serviceInstanceId;
 }
\ No newline at end of file
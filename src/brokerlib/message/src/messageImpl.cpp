@@ -13,6 +13,9 @@
 /* All the messages are going to be promoted to this DXL message version. */
 #define DXL_MSG_VERSION 3
 
+/* The other field that holds the certificate chain of the source client */
+#define DXL_MSG_CERTS_FIELD "dxl.certs"
+
 struct dxl_message_context_t
 {
     log_callback_t logger_;
@@ -20,14 +23,26 @@ struct dxl_message_context_t
 };
 
 
+/* A read position within serialized message bytes */
+typedef struct dxl_message_reader_t
+{
+    const unsigned char* pos;
+    const unsigned char* end;
+} dxl_message_reader_t;
+
 /* Forward defines */
 dxl_message_error_t generateMessageId(const char** messageId);
-dxl_message_error_t unpackUInt32(msgpack_unpacker *unpack, uint32_t *value);
-dxl_message_error_t unpackInt(msgpack_unpacker *unpack, int* value);
-dxl_message_error_t unpackRaw(msgpack_unpacker *unpack,
-    unsigned char** bufferOut, size_t* bufferSize, bool addNullTerminator);
-static dxl_message_error_t unpackStringArray(msgpack_unpacker *unpack, char* (*arrayOut[]),
-    size_t* arraySize);
+static dxl_message_error_t readHeaderInt(dxl_message_reader_t *reader, uint64_t* value, int* negative);
+static dxl_message_error_t readHeaderString(dxl_message_reader_t *reader, dxl_message_str_t* value);
+static dxl_message_error_t readHeaderStringArray(dxl_message_reader_t *reader, dxl_message_str_array_t* value);
+static dxl_message_error_t copyHeaderString(const dxl_message_str_t* value, const char** stringOut);
+static dxl_message_error_t copyHeaderStringArray(const dxl_message_str_array_t* value,
+    const char** (*arrayOut), size_t* arraySize);
+static void packDxlMessage(struct dxl_message_context_t *context, msgpack_sbuffer *buffer,
+    dxl_message_t* message, size_t payloadSize, int excludePayload,
+    const dxl_message_source_t* source, int stripClientGuids, size_t* payloadOffset);
+static int hasOtherField(const dxl_message_t* message, const char* name);
+static unsigned char* releaseSerializedBytes(msgpack_sbuffer *buffer, size_t* size);
 static void freeStringArray( char* strArray[], size_t strArraySize );
 static dxl_message_error_t copyStringArray(
     const char* sourceArray[], size_t sourceArraySize,
@@ -471,239 +486,133 @@ dxl_message_error_t createDxlMessageFromBytes(struct  dxl_message_context_t *con
     size_t size, dxl_message_t** message)
 /******************************************************************************/
 {
-    dxl_message_t* dest = NULL;
-    const char* messageId = NULL, *clientId = NULL, *sourceBrokerGuid = NULL, 
-        *sourceTenantGuid = NULL;
-    const size_t unpacker_buffer_size = 2048;
-    msgpack_unpacker pac;
-    size_t temp = 0;
-    uint32_t version = 0;
-    int type = 0;
-    unsigned char* buffer;
-    char** stringArray = NULL;
-    size_t stringArraySize = 0;
+    dxl_message_header_t header;
     dxl_message_error_t result;
 
     if ( !bytes )
         return DXLMP_INVALID_PARAMS;
 
-    if ( !msgpack_unpacker_init(&pac, unpacker_buffer_size) )
-        return DXLMP_INIT_FAILED;
+    result = parseDxlMessageHeader(context, bytes, size, &header);
+    if ( DXLMP_OK != result )
+        return result;
 
-    if ( !msgpack_unpacker_reserve_buffer(&pac, size) )
-    {
-        msgpack_unpacker_destroy(&pac);
-        return DXLMP_NO_MEMORY;
-    }
+    return createDxlMessageFromHeader(context, &header, 0, message);
+}
+
+/******************************************************************************/
+dxl_message_error_t parseDxlMessageHeader(struct dxl_message_context_t *context,
+    const unsigned char* bytes,
+    size_t size, dxl_message_header_t* header)
+/******************************************************************************/
+{
+    dxl_message_reader_t reader;
+    dxl_message_str_t field;
+    uint64_t value = 0;
+    int negative = 0;
 
-    memcpy(msgpack_unpacker_buffer(&pac), bytes, size);
-    msgpack_unpacker_buffer_consumed(&pac, size);
+    if ( !bytes || !header )
+        return DXLMP_INVALID_PARAMS;
+
+    memset(header, 0, sizeof(dxl_message_header_t));
+    reader.pos = bytes;
+    reader.end = bytes + size;
 
     ////////////////////////////////////////////////////////////////////////////
     // Version 0
     ////////////////////////////////////////////////////////////////////////////
 
     /* Start reading (version) */
-    if ( DXLMP_OK != unpackUInt32(&pac,&version) )
+    if ( DXLMP_OK != readHeaderInt(&reader, &value, &negative) || negative )
     {
         if (context && context->logger_)
             context->logger_(context->cb_arg_,"Failed to read message version ");
-
-        msgpack_unpacker_destroy(&pac);
         return DXLMP_BAD_DATA;
     }
+    header->version = (unsigned int)value;
 
     /* Next item is message type */
-    if ( DXLMP_OK != unpackInt(&pac, (int*)&type) )
+    if ( DXLMP_OK != readHeaderInt(&reader, &value, &negative) )
     {
         if (context && context->logger_)
             context->logger_(context->cb_arg_,"Failed to get message type");
-        msgpack_unpacker_destroy(&pac);
         return DXLMP_BAD_DATA;
     }
+    header->messageType = (dxl_message_type_t)(int)value;
 
-    if ( type != DXLMP_REQUEST && type != DXLMP_RESPONSE && type != DXLMP_EVENT && type != DXLMP_RESPONSE_ERROR )
+    if ( header->messageType != DXLMP_REQUEST && header->messageType != DXLMP_RESPONSE &&
+        header->messageType != DXLMP_EVENT && header->messageType != DXLMP_RESPONSE_ERROR )
     {
         if (context && context->logger_)
             context->logger_(context->cb_arg_,"Unknown message type");
-        msgpack_unpacker_destroy(&pac);
         return DXLMP_BAD_DATA;
     }
 
     /* Message id */
-    if ( DXLMP_OK != unpackRaw(&pac, (unsigned char**)&messageId, &temp, true) )
+    if ( DXLMP_OK != readHeaderString(&reader, &header->messageId) )
     {
         if (context && context->logger_)
             context->logger_(context->cb_arg_,"Failed to get message id");
-        msgpack_unpacker_destroy(&pac);
         return DXLMP_BAD_DATA;
     }
 
     /* source client id */
-    if ( DXLMP_OK != unpackRaw(&pac, (unsigned char**)&clientId, &temp, true) )
+    if ( DXLMP_OK != readHeaderString(&reader, &header->sourceClientId) )
     {
         if (context && context->logger_)
             context->logger_(context->cb_arg_,"Failed to get client id");
-
-        if ( messageId )
-            free((void*)messageId);
-
-        msgpack_unpacker_destroy(&pac);
         return DXLMP_BAD_DATA;
     }
 
-    result = createDxlMessage(context,(dxl_message_type_t)type, clientId, NULL, messageId, &dest);
-
-    if ( messageId )
-    {
-        free((void*)messageId);
-        messageId = NULL;
-    }
-
-    if ( clientId )
-    {
-        free((void*)clientId);
-        clientId = NULL;
-    }
-
-    if ( DXLMP_OK != result )
-    {
-        if (context && context->logger_)
-            context->logger_(context->cb_arg_,"Failed to deserialize message ");
-        msgpack_unpacker_destroy(&pac);
-        return result;
-    }
-
     /* Source broker GUID */
-    if ( DXLMP_OK != unpackRaw(&pac, (unsigned char**)&sourceBrokerGuid, &temp, true) )
+    if ( DXLMP_OK != readHeaderString(&reader, &header->sourceBrokerGuid) )
     {
         if (context && context->logger_)
             context->logger_(context->cb_arg_,"Failed to get source broker guid");
-        freeDxlMessage(context,dest);
-        msgpack_unpacker_destroy(&pac);
         return DXLMP_BAD_DATA;
     }
-    free( (void*)dest->sourceBrokerGuid );
-    dest->sourceBrokerGuid = sourceBrokerGuid;
 
-    /* broker guids */
-    if ( DXLMP_OK != unpackStringArray(&pac, &stringArray, &stringArraySize ) )
+    /* broker guids, client guids */
+    if ( DXLMP_OK != readHeaderStringArray(&reader, &header->brokerGuids) ||
+        DXLMP_OK != readHeaderStringArray(&reader, &header->clientGuids) )
     {
-        freeDxlMessage(context,dest);
-        msgpack_unpacker_destroy(&pac);
         return DXLMP_BAD_DATA;
     }
-    dest->brokerGuids = (const char**)stringArray;
-    dest->brokerGuidCount = stringArraySize;
 
-    /* client guids */
-    if ( DXLMP_OK != unpackStringArray(&pac, &stringArray, &stringArraySize ) )
-    {
-        freeDxlMessage(context,dest);
-        msgpack_unpacker_destroy(&pac);
-        return DXLMP_BAD_DATA;
-    }
-    dest->clientGuids = (const char**)stringArray;
-    dest->clientGuidCount = stringArraySize;
-
-    /* payload */
-    if ( DXLMP_OK != unpackRaw(&pac, &buffer, &temp, false) )
-    {
-        freeDxlMessage(context,dest);
-        msgpack_unpacker_destroy(&pac);
+    /* payload (skipped, not copied) */
+    if ( DXLMP_OK != readHeaderString(&reader, &field) )
         return DXLMP_BAD_DATA;
-    }
-
-    dest->payload = buffer;
-    dest->payloadSize = temp;
+    header->payload = (const unsigned char*)field.ptr;
+    header->payloadSize = field.size;
 
-    if ( dest->messageType == DXLMP_REQUEST || dest->messageType == DXLMP_RESPONSE
-            || dest->messageType == DXLMP_RESPONSE_ERROR )
+    if ( header->messageType == DXLMP_REQUEST || header->messageType == DXLMP_RESPONSE
+            || header->messageType == DXLMP_RESPONSE_ERROR )
     {
         /* First thing for all these is a string */
-        if ( DXLMP_OK != unpackRaw(&pac, &buffer, &temp, true) )
+        if ( DXLMP_OK != readHeaderString(&reader, &field) )
         {
             if (context && context->logger_)
                 context->logger_(context->cb_arg_,"Failed to extracting message payload");
-            msgpack_unpacker_destroy(&pac);
-            freeDxlMessage(context,dest);
             return DXLMP_BAD_DATA;
         }
 
-        switch ( dest->messageType )
-        {
-        case DXLMP_REQUEST:
-            free((void *)dest->dxl_message_specificData.requestData->replyToTopic);
-            dest->dxl_message_specificData.requestData->replyToTopic = (char*)buffer;
-            break;
-        case DXLMP_RESPONSE:
-            free((void *)dest->dxl_message_specificData.responseData->requestMessageId);
-            dest->dxl_message_specificData.responseData->requestMessageId = (char*)buffer;
-            break;
-        case DXLMP_RESPONSE_ERROR:
-            free((void *)dest->dxl_message_specificData.responseErrorData->requestMessageId);
-            dest->dxl_message_specificData.responseErrorData->requestMessageId = (char*)buffer;
-            break;
-        default:
-            break;
-        }
+        if ( header->messageType == DXLMP_REQUEST )
+            header->replyToTopic = field;
+        else
+            header->requestMessageId = field;
 
-        if ( type == DXLMP_REQUEST)
-        {
-            /* service instance id */
-            if ( DXLMP_OK != unpackRaw(&pac, &buffer, &temp, true) )
-            {
-                freeDxlMessage(context,dest);
-                msgpack_unpacker_destroy(&pac);
-                return DXLMP_BAD_DATA;
-            }
-            free((void *)dest->dxl_message_specificData.requestData->serviceInstanceId);
-            dest->dxl_message_specificData.requestData->serviceInstanceId = (char*)buffer;
-        }
-        else if ( type == DXLMP_RESPONSE )
-        {
+        /* service instance id */
+        if ( DXLMP_OK != readHeaderString(&reader, &header->serviceInstanceId) )
+            return DXLMP_BAD_DATA;
 
-            /* service instance id */
-            if ( DXLMP_OK != unpackRaw(&pac, &buffer, &temp, true) )
-            {
-                freeDxlMessage(context,dest);
-                msgpack_unpacker_destroy(&pac);
-                return DXLMP_BAD_DATA;
-            }
-            free((void *)dest->dxl_message_specificData.responseData->serviceInstanceId);
-            dest->dxl_message_specificData.responseData->serviceInstanceId = (char*)buffer;
-        }
-        else if ( type == DXLMP_RESPONSE_ERROR )
+        if ( header->messageType == DXLMP_RESPONSE_ERROR )
         {
-            int code = 0;
-            /* service instance id */
-            if ( DXLMP_OK != unpackRaw(&pac, &buffer, &temp, true) )
-            {
-                freeDxlMessage(context,dest);
-                msgpack_unpacker_destroy(&pac);
-                return DXLMP_BAD_DATA;
-            }
-            free((void *)dest->dxl_message_specificData.responseErrorData->serviceInstanceId);
-            dest->dxl_message_specificData.responseErrorData->serviceInstanceId = (char*)buffer;
-
-            /* error code */
-            if ( DXLMP_OK != unpackInt(&pac, &code) )
-            {
-                freeDxlMessage(context,dest);
-                msgpack_unpacker_destroy(&pac);
-                return DXLMP_BAD_DATA;
-            }
-            dest->dxl_message_specificData.responseErrorData->code = code;
-
-            /* error message */
-            if ( DXLMP_OK != unpackRaw(&pac, &buffer, &temp, true) )
+            /* error code, error message */
+            if ( DXLMP_OK != readHeaderInt(&reader, &value, &negative) ||
+                DXLMP_OK != readHeaderString(&reader, &header->errorMessage) )
             {
-                freeDxlMessage(context,dest);
-                msgpack_unpacker_destroy(&pac);
                 return DXLMP_BAD_DATA;
             }
-            free((void *)dest->dxl_message_specificData.responseErrorData->errorMessage);
-            dest->dxl_message_specificData.responseErrorData->errorMessage = (char*)buffer;
+            header->errorCode = (int)value;
         }
     }
 
@@ -711,74 +620,189 @@ dxl_message_error_t createDxlMessageFromBytes(struct  dxl_message_context_t *con
     // Version 1
     ////////////////////////////////////////////////////////////////////////////
 
-    if( version > 0 )
+    if ( header->version > 0 )
     {
         /* other fields */
-        if ( DXLMP_OK != unpackStringArray(&pac, &stringArray, &stringArraySize ) )
-        {
-            freeDxlMessage(context,dest);
-            msgpack_unpacker_destroy(&pac);
+        if ( DXLMP_OK != readHeaderStringArray(&reader, &header->otherFields) )
             return DXLMP_BAD_DATA;
-        }
-
-        dest->otherFields = (const char**)stringArray;
-        dest->otherFieldsCount = stringArraySize;
     }
 
     ////////////////////////////////////////////////////////////////////////////
     // Version 2
     ////////////////////////////////////////////////////////////////////////////
 
-    if ( version > 1 )
+    if ( header->version > 1 )
     {
         /* Source tenant GUID */
-        if ( DXLMP_OK != unpackRaw(&pac, (unsigned char**)&sourceTenantGuid, &temp, true) )
+        if ( DXLMP_OK != readHeaderString(&reader, &header->sourceTenantGuid) )
         {
             if (context && context->logger_)
                 context->logger_(context->cb_arg_,"Failed to get source tenant guid");
-            freeDxlMessage(context,dest);
-            msgpack_unpacker_destroy(&pac);
             return DXLMP_BAD_DATA;
         }
-        free( (void*)dest->sourceTenantGuid );
-        dest->sourceTenantGuid = sourceTenantGuid;
 
         /* Destination tenant GUIDs. */
-        if ( DXLMP_OK != unpackStringArray(&pac, &stringArray, &stringArraySize ) )
-        {
-            freeDxlMessage(context, dest);
-            msgpack_unpacker_destroy(&pac);
+        if ( DXLMP_OK != readHeaderStringArray(&reader, &header->tenantGuids) )
             return DXLMP_BAD_DATA;
-        }
-        dest->tenantGuids = (const char**)stringArray;
-        dest->tenantGuidCount = stringArraySize;
     }
 
     ////////////////////////////////////////////////////////////////////////////
     // Version 3
     ////////////////////////////////////////////////////////////////////////////
 
-    if ( version > 2 )
+    if ( header->version > 2 )
     {
-        const char* sourceClientInstanceId;
         /* Source client instance identifier */
-        if ( DXLMP_OK != unpackRaw(&pac, (unsigned char**)&sourceClientInstanceId, &temp, true) )
+        if ( DXLMP_OK != readHeaderString(&reader, &header->sourceClientInstanceId) )
         {
             if (context && context->logger_)
                 context->logger_(context->cb_arg_,"Failed to get client instance identifier");
-            freeDxlMessage(context,dest);
-            msgpack_unpacker_destroy(&pac);
             return DXLMP_BAD_DATA;
         }
-        free( (void*)dest->sourceClientInstanceId );
-        dest->sourceClientInstanceId = sourceClientInstanceId;
+    }
+
+    return DXLMP_OK;
+}
+
+/******************************************************************************/
+int nextDxlMessageHeaderString(const dxl_message_str_array_t* array,
+    size_t* position, dxl_message_str_t* value)
+/******************************************************************************/
+{
+    dxl_message_reader_t reader;
+
+    if ( *position >= array->size )
+        return 0;
+
+    reader.pos = array->ptr + *position;
+    reader.end = array->ptr + array->size;
+    if ( DXLMP_OK != readHeaderString(&reader, value) )
+        return 0;
+
+    *position = (size_t)(reader.pos - array->ptr);
+    return 1;
+}
+
+/******************************************************************************/
+dxl_message_error_t createDxlMessageFromHeader(struct dxl_message_context_t *context,
+    const dxl_message_header_t* header,
+    int excludePayload, dxl_message_t** message)
+/******************************************************************************/
+{
+    dxl_message_t* dest = NULL;
+    const char* messageId = NULL, *clientId = NULL;
+    dxl_message_error_t result;
+
+    if ( !header || !message )
+        return DXLMP_INVALID_PARAMS;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Version 0
+    ////////////////////////////////////////////////////////////////////////////
+
+    result = copyHeaderString(&header->messageId, &messageId);
+    if ( DXLMP_OK == result )
+        result = copyHeaderString(&header->sourceClientId, &clientId);
+    if ( DXLMP_OK == result )
+        result = createDxlMessage(context, header->messageType, clientId, NULL, messageId, &dest);
+
+    free((void*)messageId);
+    free((void*)clientId);
+
+    if ( DXLMP_OK != result )
+    {
+        if (context && context->logger_)
+            context->logger_(context->cb_arg_,"Failed to deserialize message ");
+        return result;
+    }
+
+    /* Source broker GUID, broker guids, client guids */
+    result = copyHeaderString(&header->sourceBrokerGuid, &dest->sourceBrokerGuid);
+    if ( DXLMP_OK == result )
+        result = copyHeaderStringArray(&header->brokerGuids, &dest->brokerGuids, &dest->brokerGuidCount);
+    if ( DXLMP_OK == result )
+        result = copyHeaderStringArray(&header->clientGuids, &dest->clientGuids, &dest->clientGuidCount);
+
+    /* payload */
+    if ( DXLMP_OK == result && !excludePayload )
+        result = setDxlMessagePayload(context, dest, header->payload, header->payloadSize);
+
+    if ( DXLMP_OK == result )
+    {
+        switch ( dest->messageType )
+        {
+        case DXLMP_REQUEST:
+            result = copyHeaderString(&header->replyToTopic,
+                &dest->dxl_message_specificData.requestData->replyToTopic);
+            if ( DXLMP_OK == result )
+                result = copyHeaderString(&header->serviceInstanceId,
+                    &dest->dxl_message_specificData.requestData->serviceInstanceId);
+            break;
+        case DXLMP_RESPONSE:
+            result = copyHeaderString(&header->requestMessageId,
+                &dest->dxl_message_specificData.responseData->requestMessageId);
+            if ( DXLMP_OK == result )
+                result = copyHeaderString(&header->serviceInstanceId,
+                    &dest->dxl_message_specificData.responseData->serviceInstanceId);
+            break;
+        case DXLMP_RESPONSE_ERROR:
+            result = copyHeaderString(&header->requestMessageId,
+                &dest->dxl_message_specificData.responseErrorData->requestMessageId);
+            if ( DXLMP_OK == result )
+                result = copyHeaderString(&header->serviceInstanceId,
+                    &dest->dxl_message_specificData.responseErrorData->serviceInstanceId);
+            if ( DXLMP_OK == result )
+                result = copyHeaderString(&header->errorMessage,
+                    &dest->dxl_message_specificData.responseErrorData->errorMessage);
+            dest->dxl_message_specificData.responseErrorData->code = header->errorCode;
+            break;
+        default:
+            break;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Version 1
+    ////////////////////////////////////////////////////////////////////////////
+
+    if ( DXLMP_OK == result && header->version > 0 )
+    {
+        /* other fields */
+        result = copyHeaderStringArray(&header->otherFields, &dest->otherFields, &dest->otherFieldsCount);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Version 2
+    ////////////////////////////////////////////////////////////////////////////
+
+    if ( DXLMP_OK == result && header->version > 1 )
+    {
+        /* Source tenant GUID, destination tenant GUIDs */
+        result = copyHeaderString(&header->sourceTenantGuid, &dest->sourceTenantGuid);
+        if ( DXLMP_OK == result )
+            result = copyHeaderStringArray(&header->tenantGuids, &dest->tenantGuids, &dest->tenantGuidCount);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Version 3
+    ////////////////////////////////////////////////////////////////////////////
+
+    if ( DXLMP_OK == result && header->version > 2 )
+    {
+        /* Source client instance identifier */
+        result = copyHeaderString(&header->sourceClientInstanceId, &dest->sourceClientInstanceId);
     }
 
     ////////////////////////////////////////////////////////////////////////////
     // Common final steps
     ////////////////////////////////////////////////////////////////////////////
 
-    msgpack_unpacker_destroy(&pac);
+    if ( DXLMP_OK != result )
+    {
+        freeDxlMessage(context,dest);
+        return result;
+    }
+
     *message = dest;
 
     return DXLMP_OK;
@@ -790,14 +814,360 @@ dxl_message_error_t dxlMessageToBytes( struct  dxl_message_context_t *context,
     size_t* size, dxl_message_t* message, int stripClientGuids)
 /******************************************************************************/
 {
-    size_t i;
-    size_t temp;
+    size_t payloadOffset;
 
     /* msgpack::sbuffer is a simple buffer implementation. */
     msgpack_sbuffer simple_buffer;
     msgpack_sbuffer *buffer = &simple_buffer;
     msgpack_sbuffer_init(buffer);
 
+    packDxlMessage(context, buffer, message, message->payloadSize, 0, NULL, stripClientGuids, &payloadOffset);
+
+    *bytes = releaseSerializedBytes(buffer, size);
+    if (context && context->logger_)
+        context->logger_(context->cb_arg_,"Message serialized ");
+
+    return DXLMP_OK;
+}
+
+/******************************************************************************/
+dxl_message_error_t dxlMessageToBytesExcludingPayload( struct dxl_message_context_t *context,
+    unsigned char** bytes, size_t* size, size_t* payloadOffset,
+    dxl_message_t* message, size_t payloadSize, const dxl_message_source_t* source,
+    int stripClientGuids)
+/******************************************************************************/
+{
+    msgpack_sbuffer simple_buffer;
+    msgpack_sbuffer *buffer = &simple_buffer;
+    msgpack_sbuffer_init(buffer);
+
+    packDxlMessage(context, buffer, message, payloadSize, 1, source, stripClientGuids, payloadOffset);
+
+    *bytes = releaseSerializedBytes(buffer, size);
+    if (context && context->logger_)
+        context->logger_(context->cb_arg_,"Message serialized (excluding payload)");
+
+    return DXLMP_OK;
+}
+
+/******************************************************************************/
+dxl_message_error_t createDxlMessageSource(struct dxl_message_context_t *context,
+    const char* sourceClientId, const char* sourceBrokerGuid, const char* sourceClientInstanceId,
+    const char* certChain, dxl_message_source_t** source)
+/******************************************************************************/
+{
+    dxl_message_source_t* dest;
+    unsigned char* encoded;
+    size_t idsSize;
+    size_t certsSize = 0;
+    size_t size;
+    size_t temp;
+
+    if ( !sourceClientId || !sourceBrokerGuid || !sourceClientInstanceId || !source )
+        return DXLMP_INVALID_PARAMS;
+
+    dest = (dxl_message_source_t*)calloc(1, sizeof(dxl_message_source_t));
+    if ( !dest )
+        return DXLMP_NO_MEMORY;
+
+    msgpack_sbuffer simple_buffer;
+    msgpack_sbuffer *buffer = &simple_buffer;
+    msgpack_sbuffer_init(buffer);
+
+    msgpack_packer packer;
+    msgpack_packer *pk = &packer;
+    msgpack_packer_init(pk, buffer, msgpack_sbuffer_write);
+
+    /* client ID and source broker GUID, which are adjacent in messages */
+    temp = strlen(sourceClientId);
+    msgpack_pack_v4raw(pk, temp);
+    msgpack_pack_v4raw_body(pk, temp ? sourceClientId : NULL, temp);
+    temp = strlen(sourceBrokerGuid);
+    msgpack_pack_v4raw(pk, temp);
+    msgpack_pack_v4raw_body(pk, temp ? sourceBrokerGuid : NULL, temp);
+    idsSize = buffer->size;
+
+    /* certificate chain other field (name and value) */
+    if ( certChain )
+    {
+        temp = strlen(DXL_MSG_CERTS_FIELD);
+        msgpack_pack_v4raw(pk, temp);
+        msgpack_pack_v4raw_body(pk, DXL_MSG_CERTS_FIELD, temp);
+        temp = strlen(certChain);
+        msgpack_pack_v4raw(pk, temp);
+        msgpack_pack_v4raw_body(pk, temp ? certChain : NULL, temp);
+        certsSize = buffer->size - idsSize;
+    }
+
+    /* client instance ID */
+    temp = strlen(sourceClientInstanceId);
+    msgpack_pack_v4raw(pk, temp);
+    msgpack_pack_v4raw_body(pk, temp ? sourceClientInstanceId : NULL, temp);
+
+    encoded = releaseSerializedBytes(buffer, &size);
+
+    dest->refCount = 1;
+    dest->sourceClientId = strdup(sourceClientId);
+    dest->sourceBrokerGuid = strdup(sourceBrokerGuid);
+    dest->sourceClientInstanceId = strdup(sourceClientInstanceId);
+    dest->certChain = certChain ? strdup(certChain) : NULL;
+    dest->encodedIds = encoded;
+    dest->encodedIdsSize = idsSize;
+    dest->encodedCerts = encoded ? encoded + idsSize : NULL;
+    dest->encodedCertsSize = certsSize;
+    dest->encodedInstanceId = encoded ? encoded + idsSize + certsSize : NULL;
+    dest->encodedInstanceIdSize = size - idsSize - certsSize;
+
+    if ( !encoded || !dest->sourceClientId || !dest->sourceBrokerGuid ||
+         !dest->sourceClientInstanceId || ( certChain && !dest->certChain ) )
+    {
+        releaseDxlMessageSource(dest);
+        return DXLMP_NO_MEMORY;
+    }
+
+    if (context && context->logger_)
+        context->logger_(context->cb_arg_,"Message source created");
+
+    *source = dest;
+
+    return DXLMP_OK;
+}
+
+/******************************************************************************/
+void acquireDxlMessageSource(dxl_message_source_t* source)
+/******************************************************************************/
+{
+    __sync_add_and_fetch(&source->refCount, 1);
+}
+
+/******************************************************************************/
+void releaseDxlMessageSource(dxl_message_source_t* source)
+/******************************************************************************/
+{
+    if ( source && __sync_sub_and_fetch(&source->refCount, 1) == 0 )
+    {
+        free((void*)source->sourceClientId);
+        free((void*)source->sourceBrokerGuid);
+        free((void*)source->sourceClientInstanceId);
+        free((void*)source->certChain);
+        free((void*)source->encodedIds);
+        free(source);
+    }
+}
+
+/*******************************************************************************/
+dxl_message_error_t generateMessageId(const char** messageId)
+/******************************************************************************/
+{
+    const unsigned int messageSize = 40u;
+    *messageId = (char *)malloc(messageSize * sizeof(char));
+
+    if (!*messageId)
+        return DXLMP_NO_MEMORY;
+
+    // Create a guid using OS libuuid mechanism (v2.17.2).
+    uuid_t newGuid;
+    uuid_generate_random(newGuid);
+    uuid_unparse_lower(newGuid, (char*)*messageId);
+
+    // If there was an error creating messageId it will be freed in "freeDxlMessage" method.
+    return DXLMP_OK;
+}
+
+/******************************************************************************/
+static int readHeaderLength(dxl_message_reader_t *reader, size_t byteCount, uint64_t* value)
+/******************************************************************************/
+{
+    uint64_t result = 0;
+
+    /* Big-endian value of the specified byte count */
+    if ( (size_t)(reader->end - reader->pos) < byteCount )
+        return 0;
+
+    while ( byteCount-- > 0 )
+        result = ( result << 8 ) | *(reader->pos++);
+
+    *value = result;
+    return 1;
+}
+
+/******************************************************************************/
+static dxl_message_error_t readHeaderInt(dxl_message_reader_t *reader, uint64_t* value, int* negative)
+/******************************************************************************/
+{
+    unsigned char format;
+    unsigned int bits;
+
+    if ( reader->pos >= reader->end )
+        return DXLMP_BAD_DATA;
+
+    format = *(reader->pos++);
+    *negative = 0;
+
+    if ( format <= 0x7f )
+    {
+        /* positive fixint */
+        *value = format;
+        return DXLMP_OK;
+    }
+
+    if ( format >= 0xe0 )
+    {
+        /* negative fixint */
+        *value = (uint64_t)(int64_t)(signed char)format;
+        *negative = 1;
+        return DXLMP_OK;
+    }
+
+    if ( format >= 0xcc && format <= 0xcf )
+    {
+        /* uint 8, 16, 32, 64 */
+        return readHeaderLength(reader, (size_t)1 << (format - 0xcc), value) ? DXLMP_OK : DXLMP_BAD_DATA;
+    }
+
+    if ( format >= 0xd0 && format <= 0xd3 )
+    {
+        /* int 8, 16, 32, 64 (sign extended) */
+        if ( !readHeaderLength(reader, (size_t)1 << (format - 0xd0), value) )
+            return DXLMP_BAD_DATA;
+
+        bits = 8u << (format - 0xd0);
+        if ( bits < 64 && ( *value & ( (uint64_t)1 << (bits - 1) ) ) )
+            *value |= ~(uint64_t)0 << bits;
+        *negative = ( (int64_t)*value < 0 );
+        return DXLMP_OK;
+    }
+
+    return DXLMP_BAD_DATA;
+}
+
+/******************************************************************************/
+static dxl_message_error_t readHeaderString(dxl_message_reader_t *reader, dxl_message_str_t* value)
+/******************************************************************************/
+{
+    unsigned char format;
+    uint64_t size;
+
+    if ( reader->pos >= reader->end )
+        return DXLMP_BAD_DATA;
+
+    /* fixstr, str 8, 16, 32 (raw in previous versions) */
+    format = *(reader->pos++);
+    if ( format >= 0xa0 && format <= 0xbf )
+        size = format & 0x1f;
+    else if ( format < 0xd9 || format > 0xdb ||
+        !readHeaderLength(reader, (size_t)1 << (format - 0xd9), &size) )
+        return DXLMP_BAD_DATA;
+
+    if ( (uint64_t)(reader->end - reader->pos) < size )
+        return DXLMP_BAD_DATA;
+
+    value->ptr = (const char*)reader->pos;
+    value->size = (size_t)size;
+    reader->pos += size;
+
+    return DXLMP_OK;
+}
+
+/******************************************************************************/
+static dxl_message_error_t readHeaderStringArray(dxl_message_reader_t *reader,
+    dxl_message_str_array_t* value)
+/******************************************************************************/
+{
+    unsigned char format;
+    uint64_t count, i;
+    dxl_message_str_t element;
+
+    if ( reader->pos >= reader->end )
+        return DXLMP_BAD_DATA;
+
+    /* fixarray, array 16, 32 */
+    format = *(reader->pos++);
+    if ( format >= 0x90 && format <= 0x9f )
+        count = format & 0x0f;
+    else if ( format < 0xdc || format > 0xdd ||
+        !readHeaderLength(reader, (size_t)2 << (format - 0xdc), &count) )
+        return DXLMP_BAD_DATA;
+
+    /* Validate the strings (iterated via nextDxlMessageHeaderString) */
+    value->ptr = reader->pos;
+    for ( i = 0; i < count; i++ )
+    {
+        if ( DXLMP_OK != readHeaderString(reader, &element) )
+            return DXLMP_BAD_DATA;
+    }
+    value->size = (size_t)(reader->pos - value->ptr);
+    value->count = (size_t)count;
+
+    return DXLMP_OK;
+}
+
+/******************************************************************************/
+static dxl_message_error_t copyHeaderString(const dxl_message_str_t* value, const char** stringOut)
+/******************************************************************************/
+{
+    char* copy = (char*)calloc(value->size + 1, 1);
+    if ( !copy )
+        return DXLMP_NO_MEMORY;
+
+    if ( value->size > 0 )
+        memcpy(copy, value->ptr, value->size);
+
+    free((void*)*stringOut);
+    *stringOut = copy;
+
+    return DXLMP_OK;
+}
+
+/******************************************************************************/
+static dxl_message_error_t copyHeaderStringArray(const dxl_message_str_array_t* value,
+    const char** (*arrayOut), size_t* arraySize)
+/******************************************************************************/
+{
+    size_t i = 0, position = 0;
+    dxl_message_str_t element;
+    char** stringArray;
+
+    freeStringArray( (char**)*arrayOut, *arraySize );
+    *arrayOut = NULL;
+    *arraySize = 0;
+
+    if ( value->count == 0 )
+        return DXLMP_OK;
+
+    stringArray = (char**)calloc(value->count, sizeof(char*));
+    if ( !stringArray )
+        return DXLMP_NO_MEMORY;
+
+    while ( i < value->count && nextDxlMessageHeaderString(value, &position, &element) )
+    {
+        if ( DXLMP_OK != copyHeaderString(&element, (const char**)&stringArray[i]) )
+        {
+            if ( i > 0 )
+                freeStringArray( stringArray, i );
+            else
+                free( stringArray );
+            return DXLMP_NO_MEMORY;
+        }
+        i++;
+    }
+
+    *arrayOut = (const char**)stringArray;
+    *arraySize = i;
+
+    return DXLMP_OK;
+}
+
+/******************************************************************************/
+static void packDxlMessage(struct dxl_message_context_t *context, msgpack_sbuffer *buffer,
+    dxl_message_t* message, size_t payloadSize, int excludePayload,
+    const dxl_message_source_t* source, int stripClientGuids, size_t* payloadOffset)
+/******************************************************************************/
+{
+    size_t i;
+    size_t temp;
+    int addCerts;
+
     /* serialize values into the buffer using msgpack_sbuffer_write callback function. */
     msgpack_packer packer;
     msgpack_packer *pk = &packer;
@@ -816,15 +1186,23 @@ dxl_message_error_t dxlMessageToBytes( struct  dxl_message_context_t *context,
     msgpack_pack_v4raw(pk,temp);
     msgpack_pack_v4raw_body(pk,temp ? message->messageId : NULL, temp);
 
-    /* client ID */
-    temp = strlen(message->sourceClientId);
-    msgpack_pack_v4raw(pk,temp);
-    msgpack_pack_v4raw_body(pk,temp ? message->sourceClientId : NULL, temp);
+    if ( source )
+    {
+        /* client ID and source broker GUID (encoded by the source) */
+        msgpack_sbuffer_write(buffer, (const char*)source->encodedIds, source->encodedIdsSize);
+    }
+    else
+    {
+        /* client ID */
+        temp = strlen(message->sourceClientId);
+        msgpack_pack_v4raw(pk,temp);
+        msgpack_pack_v4raw_body(pk,temp ? message->sourceClientId : NULL, temp);
 
-    /* source broker GUID */
-    temp = strlen(message->sourceBrokerGuid);
-    msgpack_pack_v4raw(pk,temp);
-    msgpack_pack_v4raw_body(pk,temp ? message->sourceBrokerGuid : NULL, temp);
+        /* source broker GUID */
+        temp = strlen(message->sourceBrokerGuid);
+        msgpack_pack_v4raw(pk,temp);
+        msgpack_pack_v4raw_body(pk,temp ? message->sourceBrokerGuid : NULL, temp);
+    }
 
     /* Broker GUIDs */
     msgpack_pack_array(pk, message->brokerGuidCount);
@@ -854,8 +1232,12 @@ dxl_message_error_t dxlMessageToBytes( struct  dxl_message_context_t *context,
     }
 
     /* payload */
-    msgpack_pack_v4raw(pk,message->payloadSize);
-    msgpack_pack_v4raw_body(pk,message->payloadSize ? message->payload : NULL, message->payloadSize);
+    msgpack_pack_v4raw(pk,payloadSize);
+    *payloadOffset = buffer->size;
+    if ( !excludePayload )
+    {
+        msgpack_pack_v4raw_body(pk,payloadSize ? message->payload : NULL, payloadSize);
+    }
 
     /* And now message type specific stuff */
     if ( message->messageType == DXLMP_REQUEST )
@@ -913,13 +1295,20 @@ dxl_message_error_t dxlMessageToBytes( struct  dxl_message_context_t *context,
         if (context && context->logger_)
             context->logger_(context->cb_arg_,"Packing other fields");
 
-        msgpack_pack_array(pk, message->otherFieldsCount);
+        /* The certificate chain of the source is added unless the message has one */
+        addCerts = source && source->certChain && !hasOtherField(message, DXL_MSG_CERTS_FIELD);
+
+        msgpack_pack_array(pk, message->otherFieldsCount + (addCerts ? 2 : 0));
         for( i = 0; i < message->otherFieldsCount; i++ )
         {
             temp = strlen(message->otherFields[i]);
             msgpack_pack_v4raw(pk, temp);
             msgpack_pack_v4raw_body(pk, message->otherFields[i], temp);
         }
+        if( addCerts )
+        {
+            msgpack_sbuffer_write(buffer, (const char*)source->encodedCerts, source->encodedCertsSize);
+        }
     }
 
     ////////////////////////////////////////////////////////////////////////////
@@ -949,201 +1338,53 @@ dxl_message_error_t dxlMessageToBytes( struct  dxl_message_context_t *context,
 
     if ( message->version > 2 )
     {
-        /* Source client instance identifier */
-        temp = strlen(message->sourceClientInstanceId);
-        msgpack_pack_v4raw(pk,temp);
-        msgpack_pack_v4raw_body(pk,temp ? message->sourceClientInstanceId : NULL, temp);
-    }
-
-    ////////////////////////////////////////////////////////////////////////////
-    // Common final steps
-    ////////////////////////////////////////////////////////////////////////////
-
-    /* Copy data */
-    *bytes = (unsigned char*)malloc(buffer->size);
-    memcpy((void*)*bytes, buffer->data, buffer->size);
-
-    *size = buffer->size;
-    msgpack_sbuffer_destroy(buffer);
-    if (context && context->logger_)
-        context->logger_(context->cb_arg_,"Message serialized ");
-
-    return DXLMP_OK;
-}
-
-/*******************************************************************************/
-dxl_message_error_t generateMessageId(const char** messageId)
-/******************************************************************************/
-{
-    const unsigned int messageSize = 40u;
-    *messageId = (char *)malloc(messageSize * sizeof(char));
-
-    if (!*messageId)
-        return DXLMP_NO_MEMORY;
-
-    // Create a guid using OS libuuid mechanism (v2.17.2).
-    uuid_t newGuid;
-    uuid_generate_random(newGuid);
-    uuid_unparse_lower(newGuid, (char*)*messageId);
-
-    // If there was an error creating messageId it will be freed in "freeDxlMessage" method.
-    return DXLMP_OK;
-}
-
-/******************************************************************************/
-dxl_message_error_t unpackUInt32(msgpack_unpacker *unpack, uint32_t * value)
-/******************************************************************************/
-{
-    dxl_message_error_t ret = DXLMP_BAD_DATA;
-
-    msgpack_unpacked result;
-    msgpack_unpacked_init(&result);
-
-    /* Unpack */
-    if ( !msgpack_unpacker_next(unpack,&result) )
-    {
-        msgpack_unpacked_destroy(&result);
-        return DXLMP_INIT_FAILED;
-    }
-
-    if ( result.data.type != MSGPACK_OBJECT_POSITIVE_INTEGER )
-        return DXLMP_BAD_DATA;
-
-    *value = (uint32_t)result.data.via.u64;
-
-    ret = DXLMP_OK;
-
-    msgpack_unpacked_destroy(&result);
-
-    return ret;
-}
-
-/******************************************************************************/
-dxl_message_error_t unpackInt( msgpack_unpacker *unpack, int* value)
-/******************************************************************************/
-{
-    dxl_message_error_t ret = DXLMP_BAD_DATA;
-
-    msgpack_unpacked result;
-    msgpack_unpacked_init(&result);
-
-    /* Unpack */
-    if ( !msgpack_unpacker_next(unpack,&result) )
-    {
-        msgpack_unpacked_destroy(&result);
-        return DXLMP_INIT_FAILED;
-    }
-
-    if ( result.data.type != MSGPACK_OBJECT_POSITIVE_INTEGER &&
-        result.data.type != MSGPACK_OBJECT_NEGATIVE_INTEGER )
-    {
-        msgpack_unpacked_destroy(&result);
-        return DXLMP_BAD_DATA;
+        if ( source )
+        {
+            /* Source client instance identifier (encoded by the source) */
+            msgpack_sbuffer_write(buffer, (const char*)source->encodedInstanceId,
+                source->encodedInstanceIdSize);
+        }
+        else
+        {
+            /* Source client instance identifier */
+            temp = strlen(message->sourceClientInstanceId);
+            msgpack_pack_v4raw(pk,temp);
+            msgpack_pack_v4raw_body(pk,temp ? message->sourceClientInstanceId : NULL, temp);
+        }
     }
-
-
-    *value = (int)result.data.via.i64;
-
-    ret = DXLMP_OK;
-
-    msgpack_unpacked_destroy(&result);
-
-    return ret;
 }
 
+/* Whether the message has the specified other field (name-value pair) */
 /******************************************************************************/
-dxl_message_error_t unpackRaw(msgpack_unpacker *unpack,
-    unsigned char** bufferOut, size_t* bufferSize, bool addNullTerminator)
+static int hasOtherField(const dxl_message_t* message, const char* name)
 /******************************************************************************/
 {
-    msgpack_unpacked result;
-    msgpack_unpacked_init(&result);
-
-    /* Unpack */
-    if ( !msgpack_unpacker_next(unpack,&result) )
-    {
-        msgpack_unpacked_destroy(&result);
-        return DXLMP_INIT_FAILED;
-    }
+    size_t i;
 
-    if ( result.data.type != MSGPACK_OBJECT_STR /*RAW in previous versions*/ )
+    for( i = 0; i + 1 < message->otherFieldsCount; i += 2 )
     {
-        msgpack_unpacked_destroy(&result);
-        return DXLMP_BAD_DATA;
+        if( !strcmp(message->otherFields[i], name) )
+            return 1;
     }
-
-    *bufferOut = (unsigned char*)calloc(result.data.via.bin.size + (addNullTerminator ? 1 : 0), 1);
-    if ( !*bufferOut )
-    {
-        msgpack_unpacked_destroy(&result);
-        return DXLMP_NO_MEMORY;
-    }
-
-    memcpy(*bufferOut, result.data.via.bin.ptr, result.data.via.bin.size);
-    *bufferSize = result.data.via.bin.size + (addNullTerminator ? 1 : 0);
-
-    msgpack_unpacked_destroy(&result);
-
-    return DXLMP_OK;
+    return 0;
 }
 
+/*
+Takes ownership of the serialized bytes from the buffer rather than copying them, the
+allocation is shrunk to the size of the bytes.
+*/
 /******************************************************************************/
-static dxl_message_error_t unpackStringArray(msgpack_unpacker *unpack,
-    char* (*stringArray[]), size_t* stringArraySize)
+static unsigned char* releaseSerializedBytes(msgpack_sbuffer *buffer, size_t* size)
 /******************************************************************************/
 {
-    size_t i;
-    size_t mpArraySize;
-    msgpack_unpacked result;
-    msgpack_unpacked_init(&result);
-
-    *stringArray = NULL;
-    *stringArraySize = 0;
-
-    /* Unpack */
-    if ( !msgpack_unpacker_next(unpack,&result) )
-    {
-        msgpack_unpacked_destroy(&result);
-        return DXLMP_INIT_FAILED;
-    }
-
-    if ( result.data.type != MSGPACK_OBJECT_ARRAY )
-    {
-        msgpack_unpacked_destroy(&result);
-        return DXLMP_BAD_DATA;
-    }
+    unsigned char* bytes;
+    unsigned char* shrunk;
 
-    mpArraySize = result.data.via.array.size;
-    if( mpArraySize > 0 )
-    {
-        *stringArray = (char**)calloc(mpArraySize, sizeof(char*));
-        if( !(*stringArray) )
-        {
-            msgpack_unpacked_destroy( &result );
-            return DXLMP_NO_MEMORY;
-        }
-
-        for( i = 0; i < mpArraySize; i++ )
-        {
-            (*stringArray)[i] = (char*)calloc(result.data.via.array.ptr[i].via.bin.size+1,sizeof(char));
-            if( !((*stringArray)[i]) )
-            {
-                freeStringArray( *stringArray, i );
-                msgpack_unpacked_destroy( &result );
-                *stringArray = NULL;
-                *stringArraySize = 0;
-                return DXLMP_NO_MEMORY;
-            }
-            memcpy((*stringArray)[i],
-                result.data.via.array.ptr[i].via.bin.ptr,
-                result.data.via.array.ptr[i].via.bin.size);
-        }
-        *stringArraySize = mpArraySize;
-    }
-
-    msgpack_unpacked_destroy(&result);
+    *size = buffer->size;
+    bytes = (unsigned char*)msgpack_sbuffer_release(buffer);
+    shrunk = (unsigned char*)realloc(bytes, *size ? *size : 1);
 
-    return DXLMP_OK;
+    return shrunk ? shrunk : bytes;
 }
 
 /******************************************************************************/
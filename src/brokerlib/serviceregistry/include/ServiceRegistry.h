@@ -8,6 +8,7 @@
 #include "include/unordered_map.h"
 #include "brokerconfiguration/include/BrokerConfigurationServiceListener.h"
 #include "core/include/CoreMaintenanceListener.h"
+#include "core/include/CoreUtil.h"
 #include "serviceregistry/include/ServiceRegistration.h"
 #include "serviceregistry/include/TopicServices.h"
 #include <iostream>
@@ -27,7 +28,8 @@ typedef unordered_map<std::string,ServiceZoneList> serviceZonesByNode_t;
 typedef std::shared_ptr<serviceZonesByNode_t> serviceZonesByNodePtr_t;
 
 /** The event to request topic mappings */
-typedef unordered_map<std::string,std::string> eventToRequestPrefix_t;
+typedef unordered_map<std::string,std::string,
+    dxl::broker::core::CoreUtil::TopicHash,dxl::broker::core::CoreUtil::TopicEqual> eventToRequestPrefix_t;
 
 /** The name of the event to request topic meta-data property */
 const char EVENT_TO_REQUEST_TOPIC_PROP[] = "eventToRequestTopic";
@@ -104,14 +106,15 @@ public:
     serviceRegistrationPtr_t findService( const std::string& serviceGuid, const char* targetServiceTenantGuid ) const;
 
     /**
-     * Returns the next service for processing a request on the specified topic and, optionally, the
-     * specified tenant GUID
+     * Returns the next service for processing a request on the specified topic view and,
+     * optionally, the specified tenant GUID
      *
-     * @param   topic The topic
+     * @param   topic The topic view (see CoreUtil::WildcardIterator)
      * @param   targetServiceTenantGuid The tenant GUID to find the service for
      * @return  The next service for processing a request on the specified topic
      */
-    serviceRegistrationPtr_t getNextService( const std::string& topic, const char* targetServiceTenantGuid = "" );
+    serviceRegistrationPtr_t getNextService(
+        const dxl::broker::core::CoreUtil::TopicView& topic, const char* targetServiceTenantGuid = "" );
 
     /**
      * Returns the services that are the specified service type and, optionally, the specified tenant GUID
@@ -124,11 +127,12 @@ public:
         const std::string& serviceType, const char* tenantGuid = "" ) const;
     
     /**
-     * Returns the request prefix for the specified event topic
+     * Returns the request prefix for the specified event topic view
      *
+     * @param   eventTopic The event topic view (see CoreUtil::WildcardIterator)
      * @return  The request prefix for the specified event topic
      */
-    std::string getRequestPrefixForEvent( const std::string& eventTopic ) const;
+    std::string getRequestPrefixForEvent( const dxl::broker::core::CoreUtil::TopicView& eventTopic ) const;
 
     /**
      * Returns whether services are registered that will accept requests via transforming
@@ -265,7 +269,8 @@ private:
     /** Service GUIDs by service type */
     std::multimap<std::string, serviceRegistrationPtr_t> m_servicesByType;
     /** Services mapped by topic */
-    unordered_map<std::string, topicServicesPtr_t> m_servicesByTopic;
+    unordered_map<std::string, topicServicesPtr_t,
+        dxl::broker::core::CoreUtil::TopicHash, dxl::broker::core::CoreUtil::TopicEqual> m_servicesByTopic;
     /** Mutex used when updating service state */
     mutable std::mutex m_mutex;
     /** service zones by node (hub or broker) */
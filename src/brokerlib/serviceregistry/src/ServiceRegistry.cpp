@@ -19,6 +19,7 @@
 using namespace SimpleLogger;
 using namespace std;
 using namespace dxl::broker;
+using namespace dxl::broker::core;
 using namespace dxl::broker::message;
 using namespace dxl::broker::message::payload;
 using namespace dxl::broker::metrics;
@@ -380,9 +381,10 @@ const std::vector<serviceRegistrationPtr_t> ServiceRegistry::getAllServices( con
 }
 
 /** {@inheritDoc} */
-serviceRegistrationPtr_t ServiceRegistry::getNextService( const string& topic, const char* targetServiceTenantGuid )
+serviceRegistrationPtr_t ServiceRegistry::getNextService(
+    const CoreUtil::TopicView& topic, const char* targetServiceTenantGuid )
 {
-    auto servicesByTopic = m_servicesByTopic.find( topic );
+    auto servicesByTopic = m_servicesByTopic.find( topic, CoreUtil::TopicHash(), CoreUtil::TopicEqual() );
     if( servicesByTopic != m_servicesByTopic.end() )
     {
         // Next service for topic
@@ -551,9 +553,9 @@ void ServiceRegistry::onCoreMaintenance( time_t time )
 }
 
 /** {@inheritDoc} */
-std::string ServiceRegistry::getRequestPrefixForEvent( const std::string& eventTopic ) const
+std::string ServiceRegistry::getRequestPrefixForEvent( const CoreUtil::TopicView& eventTopic ) const
 {
-    auto find = m_eventToRequestPrefix.find( eventTopic );
+    auto find = m_eventToRequestPrefix.find( eventTopic, CoreUtil::TopicHash(), CoreUtil::TopicEqual() );
     if( find != m_eventToRequestPrefix.end() )
     {
         return find->second;
@@ -110,6 +110,21 @@ bool BrokerSettings::sm_testModeEnabled = false;
 // The default brokerLib thread pool size
 uint32_t BrokerSettings::sm_brokerLibThreadPoolSize = 1;
 
+// The default write thread count
+uint32_t BrokerSettings::sm_writeThreadCount = 1;
+
+// The default TLS handshake thread count
+uint32_t BrokerSettings::sm_tlsHandshakeThreadCount = 0;
+
+// The default TLS session cache size
+uint32_t BrokerSettings::sm_tlsSessionCacheSize = 0;
+
+// Whether TLS session tickets are enabled by default
+bool BrokerSettings::sm_tlsSessionTicketsEnabled = false;
+
+// The default TLS session timeout (in seconds)
+uint32_t BrokerSettings::sm_tlsSessionTimeout = 300;
+
 // The default multi-tenant mode
 bool BrokerSettings::sm_multiTenantModeEnabled = false;
 
@@ -263,6 +278,11 @@ string BrokerSettings::dumpSettings()
     out << "\tcertIdentityValidationEnabled: " << ( isCertIdentityValidationEnabled() ? "true" : "false" ) << endl;
     out << "\tuniqueClientIdPerFabricEnabled: " << ( isUniqueClientIdPerFabricEnabled() ? "true" : "false" ) << endl;
     out << "\tbrokerLibThreadPoolSize: " << getBrokerLibThreadPoolSize() << endl;
+    out << "\twriteThreadCount: " << getWriteThreadCount() << endl;
+    out << "\ttlsHandshakeThreadCount: " << getTlsHandshakeThreadCount() << endl;
+    out << "\ttlsSessionCacheSize: " << getTlsSessionCacheSize() << endl;
+    out << "\ttlsSessionTicketsEnabled: " << ( isTlsSessionTicketsEnabled() ? "true" : "false" ) << endl;
+    out << "\ttlsSessionTimeout: " << getTlsSessionTimeout() << endl;
     out << "\tmultiTenantModeEnabled: " << ( isMultiTenantModeEnabled() ? "true" : "false" ) << endl;
     out << "\tsendConnectEvents: " << ( isSendConnectEventsEnabled() ? "true" : "false" ) << endl;
     if( isMultiTenantModeEnabled() )
@@ -418,6 +438,34 @@ void BrokerSettings::setValuesFromConfig( const Configuration& config )
     config.getProperty( "brokerLibThreadPoolSize", strValue, "1" );
     sm_brokerLibThreadPoolSize = atoi( strValue.c_str() );
 
+    // The write thread count
+    config.getProperty( "writeThreadCount", strValue, "1" );
+    sm_writeThreadCount = atoi( strValue.c_str() );
+    if( sm_writeThreadCount < 1 )
+    {
+        sm_writeThreadCount = 1;
+    }
+
+    // The TLS handshake thread count
+    config.getProperty( "tlsHandshakeThreadCount", strValue, "0" );
+    sm_tlsHandshakeThreadCount = atoi( strValue.c_str() );
+
+    // The TLS session cache size
+    config.getProperty( "tlsSessionCacheSize", strValue, "0" );
+    sm_tlsSessionCacheSize = atoi( strValue.c_str() );
+
+    // Whether TLS session tickets are enabled
+    config.getProperty( "tlsSessionTicketsEnabled", strValue, "false" );
+    sm_tlsSessionTicketsEnabled = ( strValue == "true" );
+
+    // The TLS session timeout
+    config.getProperty( "tlsSessionTimeout", strValue, "300" );
+    sm_tlsSessionTimeout = atoi( strValue.c_str() );
+    if( sm_tlsSessionTimeout < 1 )
+    {
+        sm_tlsSessionTimeout = 300;
+    }
+
     // Whether multi-tenant mode is enabled
     config.getProperty( "multiTenantModeEnabled", strValue, "false" );
     sm_multiTenantModeEnabled = ( strValue == "true" );
@@ -195,7 +195,9 @@ bool brokerlib_main(
     uint64_t* maxPacketBufferSize, int* listenPort, int* coreLogType,
     unsigned int* coreLogCategoryMask, int* messageSizeLimit, char **user,
     struct cert_hashes** brokerCertsUtHash,
-    bool *webSocketsEnabled, int* webSocketsListenPort )
+    bool *webSocketsEnabled, int* webSocketsListenPort,
+    int* writeThreadCount, int* tlsHandshakeThreadCount,
+    int* tlsSessionCacheSize, bool* tlsSessionTicketsEnabled, int* tlsSessionTimeout )
 {
     bool succeeded = false;
     try 
@@ -225,6 +227,17 @@ bool brokerlib_main(
         // Set message size limit
         *messageSizeLimit = BrokerSettings::getMessageSizeLimit();
 
+        // Set the write thread count
+        *writeThreadCount = (int)BrokerSettings::getWriteThreadCount();
+
+        // Set the TLS handshake thread count
+        *tlsHandshakeThreadCount = (int)BrokerSettings::getTlsHandshakeThreadCount();
+
+        // Set the TLS session resumption settings
+        *tlsSessionCacheSize = (int)BrokerSettings::getTlsSessionCacheSize();
+        *tlsSessionTicketsEnabled = BrokerSettings::isTlsSessionTicketsEnabled();
+        *tlsSessionTimeout = (int)BrokerSettings::getTlsSessionTimeout();
+
         // Set the core logging type
         *coreLogType = 0;
         if( SL_LOG.isDebugEnabled() )
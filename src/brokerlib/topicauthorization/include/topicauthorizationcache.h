@@ -0,0 +1,156 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+#ifndef TOPICAUTHORIZATIONCACHE_H_
+#define TOPICAUTHORIZATIONCACHE_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "include/unordered_map.h"
+#include "cert_hashes.h"
+
+namespace dxl {
+namespace broker {
+
+/**
+ * Bounded cache of the publish and subscribe verdicts for topics, per identity set. An identity
+ * set is the keys that a check is made for, either a single client identifier or the hashes
+ * of the certificates presented by a connection. Connections that present the same identities
+ * share their cached verdicts.
+ *
+ * Verdicts are tagged with the generation of the authorization state that they were evaluated
+ * for. When the generation changes, the verdicts of earlier generations are no longer returned
+ * and are overwritten as topics are checked again, rather than being discarded all at once.
+ * It is not thread safe (see TopicAuthorizationService).
+ */
+class TopicAuthorizationCache
+{
+public:
+    /** The verdict kinds */
+    enum VerdictType
+    {
+        PUBLISH = 0, SUBSCRIBE = 1
+    };
+
+    /** The cached verdicts for a topic */
+    struct TopicVerdicts
+    {
+        /** The generation that the verdicts were evaluated for */
+        uint64_t generation;
+        /** The verdict bits */
+        uint8_t bits;
+    };
+
+    /** The cached verdicts of an identity set */
+    struct IdentityVerdicts
+    {
+        /** The identities (sorted) */
+        std::vector<std::string> identities;
+        /** The verdicts per topic */
+        unordered_map<std::string, TopicVerdicts> topics;
+    };
+
+    /** The maximum count of certificates of an identity set that can be cached */
+    static const size_t MAX_CERTS = 16;
+
+    /**
+     * Constructor
+     *
+     * @param   maxIdentitySets The maximum count of identity sets to cache verdicts for
+     * @param   maxTopics The maximum count of topics to cache verdicts for, per identity set
+     */
+    TopicAuthorizationCache( size_t maxIdentitySets, size_t maxTopics );
+
+    /** Destructor */
+    virtual ~TopicAuthorizationCache() {}
+
+    /**
+     * Returns the verdicts for the specified client identifier (created if necessary)
+     *
+     * @param   clientId The client identifier
+     * @return  The verdicts for the client identifier, or NULL if they cannot be cached
+     */
+    IdentityVerdicts* getVerdicts( const std::string& clientId );
+
+    /**
+     * Returns the verdicts for the specified certificates (created if necessary)
+     *
+     * @param   certHashes The certificate hashes (NULL if no certificates)
+     * @return  The verdicts for the certificates, or NULL if they cannot be cached (more than
+     *          MAX_CERTS certificates)
+     */
+    IdentityVerdicts* getVerdicts( struct cert_hashes* certHashes );
+
+    /**
+     * Looks up the cached verdict for a topic
+     *
+     * @param   verdicts The verdicts (see getVerdicts())
+     * @param   type The verdict type
+     * @param   topic The topic
+     * @param   authorized Whether the verdict is to allow (out)
+     * @return  Whether a verdict was cached
+     */
+    bool find( const IdentityVerdicts* verdicts, VerdictType type, const std::string& topic, bool* authorized ) const;
+
+    /**
+     * Caches the verdict for a topic
+     *
+     * @param   verdicts The verdicts (see getVerdicts())
+     * @param   type The verdict type
+     * @param   topic The topic
+     * @param   authorized Whether the verdict is to allow
+     */
+    void add( IdentityVerdicts* verdicts, VerdictType type, const std::string& topic, bool authorized );
+
+    /**
+     * Sets the generation of the authorization state that verdicts are found and cached for
+     *
+     * @param   generation The generation of the authorization state
+     */
+    void setGeneration( uint64_t generation ) { m_generation = generation; }
+
+private:
+    /**
+     * Returns the hash of an identity
+     *
+     * @param   identity The identity
+     * @return  The hash of the identity
+     */
+    static uint64_t hash( const char* identity );
+
+    /**
+     * Returns whether the verdicts are for the specified identities
+     *
+     * @param   verdicts The verdicts
+     * @param   identities The identities (sorted)
+     * @param   count The count of identities
+     * @return  Whether the verdicts are for the identities
+     */
+    static bool isMatch( const IdentityVerdicts& verdicts, const char* const* identities, size_t count );
+
+    /**
+     * Returns the verdicts for the specified identities (created if necessary)
+     *
+     * @param   setHash The hash of the identity set
+     * @param   identities The identities (sorted)
+     * @param   count The count of identities
+     * @return  The verdicts, or NULL if they cannot be cached
+     */
+    IdentityVerdicts* getVerdicts( uint64_t setHash, const char* const* identities, size_t count );
+
+    /** The maximum count of identity sets */
+    size_t m_maxIdentitySets;
+    /** The maximum count of topics per identity set */
+    size_t m_maxTopics;
+    /** The generation of the authorization state that verdicts are found and cached for */
+    uint64_t m_generation;
+    /** The verdicts by the hash of their identity set */
+    unordered_map<uint64_t, IdentityVerdicts> m_verdicts;
+};
+
+}
+}
+
+#endif /* TOPICAUTHORIZATIONCACHE_H_ */
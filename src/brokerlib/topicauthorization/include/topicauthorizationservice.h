@@ -5,10 +5,13 @@
 #ifndef TOPICAUTHORIZATIONSERVICE_H_
 #define TOPICAUTHORIZATIONSERVICE_H_
 
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <vector>
 #include <MutexLock.h>
 #include "topicauthorization/include/topicauthorizationstate.h"
+#include "topicauthorization/include/topicauthorizationcache.h"
 #include "cert_hashes.h"
 
 namespace dxl {
@@ -16,6 +19,11 @@ namespace broker {
 
 /**
  * Service that is used to determine if clients are able to publish/subscribe
+ *
+ * The authorization state is published as an immutable snapshot through an atomic pointer, so
+ * checks never take a lock. Each thread that performs checks has its own reader slot, which
+ * holds its verdict cache (see TopicAuthorizationCache) and the snapshot it is reading (a
+ * hazard pointer). A replaced snapshot is reclaimed once no reader slot holds it.
  */
 class TopicAuthorizationService
 {
@@ -84,35 +92,145 @@ public:
      */
     bool isAuthorizedToSubscribe( struct cert_hashes* certHashes, const std::string& topic );
 
+    /**
+     * Returns the count of authorization checks that were answered by the verdict cache
+     *
+     * @return  The count of authorization checks that were answered by the verdict cache
+     */
+    uint64_t getCacheHitCount();
+
+    /**
+     * Returns the count of authorization checks that were not answered by the verdict cache
+     *
+     * @return  The count of authorization checks that were not answered by the verdict cache
+     */
+    uint64_t getCacheMissCount();
+
 protected:
     /** Constructor */
     TopicAuthorizationService();
 
     /**
-     * Whether the specified key is allowed to subscribe to the topic for the given state
+     * Whether the specified client identifier or certificates are allowed to publish or
+     * subscribe to the topic for the given state
      *
      * @param   state The authorization state
-     * @param   key The key
+     * @param   clientId The client identifier (NULL to check the certificates)
+     * @param   certHashes The certificate hashes (NULL if no certificates)
+     * @param   type Whether to check publish or subscribe
      * @param   topic The topic
-     * @return  Whether subscribe is allowed
+     * @return  Whether publish or subscribe is allowed
      */
-    bool _isAuthorizedToSubscribe(
-        std::shared_ptr<const TopicAuthorizationState>& state, const std::string& key, const std::string& topic );
+    bool _isAuthorized( const std::shared_ptr<const TopicAuthorizationState>& state,
+        const std::string* clientId, struct cert_hashes* certHashes,
+        TopicAuthorizationCache::VerdictType type, const std::string& topic );
 
     /**
-     * Whether the specified key is allowed to publish to the topic for the given state
+     * Whether the specified client identifier or certificates are allowed to publish or
+     * subscribe to the topic, using the cached verdict if available
      *
-     * @param   state The authorization state
-     * @param   key The key
+     * @param   clientId The client identifier (NULL to check the certificates)
+     * @param   certHashes The certificate hashes (NULL if no certificates)
+     * @param   type Whether to check publish or subscribe
      * @param   topic The topic
-     * @return  Whether publish is allowed
+     * @return  Whether publish or subscribe is allowed
      */
-    bool _isAuthorizedToPublish(
-        std::shared_ptr<const TopicAuthorizationState>& state, const std::string& key, const std::string& topic );
+    bool isAuthorized( const std::string* clientId, struct cert_hashes* certHashes,
+        TopicAuthorizationCache::VerdictType type, const std::string& topic );
+
 private:
-    /** Authorization state */
-    std::shared_ptr<const TopicAuthorizationState> m_state;
-    /** Threading mutex */
+    /** An immutable authorization state, as published to readers */
+    struct Snapshot
+    {
+        /** The authorization state */
+        std::shared_ptr<const TopicAuthorizationState> state;
+        /** The generation of the state */
+        uint64_t generation;
+    };
+
+    /** The per-thread state of a reader */
+    struct ReaderSlot
+    {
+        /**
+         * Constructor
+         *
+         * @param   service The service that the slot belongs to
+         */
+        explicit ReaderSlot( TopicAuthorizationService* service );
+
+        /** The service that the slot belongs to (NULL once the service is destroyed) */
+        TopicAuthorizationService* service;
+        /** Whether the slot is owned by a thread */
+        bool owned;
+        /** The snapshot being read (hazard pointer, NULL if none) */
+        std::atomic<const Snapshot*> hazard;
+        /** The cached verdicts */
+        TopicAuthorizationCache cache;
+        /** The count of checks answered by the cache (only written by the owning thread) */
+        std::atomic<uint64_t> cacheHitCount;
+        /** The count of checks not answered by the cache (only written by the owning thread) */
+        std::atomic<uint64_t> cacheMissCount;
+    };
+
+    /** Holds the reader slot of a thread, releasing it when the thread exits */
+    class ReaderHandle
+    {
+    public:
+        /** Constructor */
+        ReaderHandle() : m_slot( NULL ) {}
+        /** Destructor */
+        ~ReaderHandle() { release(); }
+
+        /**
+         * Returns the reader slot of the current thread for the specified service
+         *
+         * @param   service The service
+         * @return  The reader slot of the current thread
+         */
+        ReaderSlot* getSlot( TopicAuthorizationService* service );
+    private:
+        /** Releases the reader slot (deleted if its service has been destroyed) */
+        void release();
+
+        /** The reader slot */
+        ReaderSlot* m_slot;
+    };
+
+    /**
+     * Returns the reader slot of the current thread
+     *
+     * @return  The reader slot of the current thread
+     */
+    ReaderSlot* getReaderSlot();
+
+    /**
+     * Acquires an unowned reader slot (created if necessary)
+     *
+     * @return  The acquired reader slot
+     */
+    ReaderSlot* acquireReaderSlot();
+
+    /**
+     * Releases the specified reader slot
+     *
+     * @param   slot The reader slot
+     */
+    void releaseReaderSlot( ReaderSlot* slot );
+
+    /**
+     * Reclaims the retired snapshots that are not being read. The threading mutex must be held.
+     */
+    void reclaimSnapshots();
+
+    /** The current snapshot */
+    std::atomic<const Snapshot*> m_snapshot;
+    /** The generation of the current snapshot (published after the snapshot) */
+    std::atomic<uint64_t> m_generation;
+    /** The replaced snapshots that have yet to be reclaimed */
+    std::vector<const Snapshot*> m_retiredSnapshots;
+    /** The reader slots */
+    std::vector<ReaderSlot*> m_readerSlots;
+    /** Threading mutex (serializes writers and reader slot registration) */
     std::mutex m_threadingMutex;
 };
 
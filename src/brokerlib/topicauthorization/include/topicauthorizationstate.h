@@ -9,6 +9,7 @@
 #include <string>
 #include "include/unordered_set.h"
 #include "include/unordered_map.h"
+#include "topicauthorization/include/topicauthorizationtrie.h"
 
 namespace dxl {
 namespace broker {
@@ -66,6 +67,41 @@ public:
      */
     bool isAuthorizedToSubscribe( const std::string& key, const std::string& topic, bool* hit = NULL ) const;
 
+    /**
+     * Returns the identifier of the specified key (client id or certificate) for use with the
+     * compiled authorization checks
+     *
+     * @param   key The key (client id or certificate)
+     * @return  The identifier of the key, or 0 if the key is not listed by the state
+     */
+    uint32_t getKeyId( const char* key ) const;
+
+    /**
+     * Returns whether any of the specified keys is able to publish to the specified topic,
+     * including wildcard topics (evaluated using the compiled state)
+     *
+     * @param   ids The identifiers of the keys (see getKeyId(), keys that are not listed are
+     *          omitted)
+     * @param   count The count of identifiers
+     * @param   topic The topic
+     * @return  Whether publish is allowed
+     */
+    bool isAuthorizedToPublish( const uint32_t* ids, size_t count, const std::string& topic ) const
+        { return m_publishersTrie.isAuthorized( ids, count, topic ); }
+
+    /**
+     * Returns whether any of the specified keys is able to subscribe to the specified topic,
+     * including wildcard topics (evaluated using the compiled state)
+     *
+     * @param   ids The identifiers of the keys (see getKeyId(), keys that are not listed are
+     *          omitted)
+     * @param   count The count of identifiers
+     * @param   topic The topic
+     * @return  Whether subscribe is allowed
+     */
+    bool isAuthorizedToSubscribe( const uint32_t* ids, size_t count, const std::string& topic ) const
+        { return m_subscribersTrie.isAuthorized( ids, count, topic ); }
+
     /**
      * Whether topic wildcarding is enabled
      *
@@ -99,6 +135,12 @@ private:
     TopicAuthorizationStateData m_subscribers;
     /** Whether topic wildcarding is enabled */
     bool m_isWildcardingEnabled;
+    /** The identifiers of the keys (shared by the compiled publishers and subscribers) */
+    TopicAuthorizationTrie::KeyIdentifiers m_keyIds;
+    /** The compiled publishers */
+    TopicAuthorizationTrie m_publishersTrie;
+    /** The compiled subscribers */
+    TopicAuthorizationTrie m_subscribersTrie;
 };
 
 }
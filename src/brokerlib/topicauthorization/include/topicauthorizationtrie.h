@@ -0,0 +1,127 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+#ifndef TOPICAUTHORIZATIONTRIE_H_
+#define TOPICAUTHORIZATIONTRIE_H_
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "include/unordered_map.h"
+#include "include/unordered_set.h"
+
+namespace dxl {
+namespace broker {
+
+/**
+ * Topic authorization policy (topics to the keys that may use them), compiled into a trie of
+ * topic levels. The keys (client identifiers or certificate hashes) are interned as integer
+ * identifiers.
+ *
+ * A topic is authorized for a set of keys if no entry of the policy matches the topic, or if any
+ * of the keys is listed by a matching entry. The entries that match a topic are the entry for
+ * the topic itself and the wildcard entries for each of its prefixes (<code>a/b/#</code>,
+ * <code>a/#</code> and <code>#</code> for <code>a/b/c</code>). These are all found by a single
+ * walk along the levels of the topic.
+ */
+class TopicAuthorizationTrie
+{
+public:
+    /** Characters that are not necessarily null-terminated */
+    struct Chars
+    {
+        /** The characters */
+        const char* data;
+        /** The count of characters */
+        size_t size;
+    };
+
+    /** Hash of strings and characters (consistent between both) */
+    struct CharsHash
+    {
+        /** Returns the hash of the characters */
+        size_t operator()( const Chars& chars ) const;
+        /** Returns the hash of the string */
+        size_t operator()( const std::string& str ) const
+            { Chars chars = { str.data(), str.size() }; return (*this)( chars ); }
+    };
+
+    /** Equality of strings and characters */
+    struct CharsEqual
+    {
+        /** Returns whether the string and characters are equal */
+        bool operator()( const std::string& str, const Chars& chars ) const
+            { return str.size() == chars.size && !memcmp( str.data(), chars.data, chars.size ); }
+        /** Returns whether the characters and string are equal */
+        bool operator()( const Chars& chars, const std::string& str ) const
+            { return (*this)( str, chars ); }
+        /** Returns whether the strings are equal */
+        bool operator()( const std::string& str1, const std::string& str2 ) const
+            { return str1 == str2; }
+    };
+
+    /** Identifiers of keys (identifiers start at 1) */
+    typedef unordered_map<std::string, uint32_t, CharsHash, CharsEqual> KeyIdentifiers;
+
+    /**
+     * Constructor
+     *
+     * @param   policy The topics and the keys that may use them
+     * @param   keyIds The identifiers of keys, keys of the policy are added as necessary
+     */
+    TopicAuthorizationTrie(
+        const unordered_map<std::string, unordered_set<std::string>>& policy, KeyIdentifiers& keyIds );
+
+    /** Destructor */
+    virtual ~TopicAuthorizationTrie() {}
+
+    /**
+     * Returns whether the specified keys are authorized for the topic
+     *
+     * @param   ids The identifiers of the keys (keys that are not in the policy are omitted)
+     * @param   count The count of identifiers
+     * @param   topic The topic
+     * @return  Whether the keys are authorized for the topic
+     */
+    bool isAuthorized( const uint32_t* ids, size_t count, const std::string& topic ) const;
+
+private:
+    /** The child nodes, by topic level */
+    typedef unordered_map<std::string, uint32_t, CharsHash, CharsEqual> Children;
+
+    /** A node of the trie (the path to the node is the topic of its entry) */
+    struct Node
+    {
+        /** Constructor */
+        Node() : wildcardChild( 0 ), isEntry( false ) {}
+
+        /** The child nodes (indices) */
+        Children children;
+        /** The index of the <code>#</code> child node if it is an entry (0 if not) */
+        uint32_t wildcardChild;
+        /** Whether the policy has an entry for the node */
+        bool isEntry;
+        /** The identifiers of the keys of the entry (sorted) */
+        std::vector<uint32_t> ids;
+    };
+
+    /**
+     * Returns whether the entry of the specified node lists any of the keys
+     *
+     * @param   node The node
+     * @param   ids The identifiers of the keys
+     * @param   count The count of identifiers
+     * @return  Whether the entry of the node lists any of the keys
+     */
+    static bool isListed( const Node& node, const uint32_t* ids, size_t count );
+
+    /** The nodes (the root is the first node) */
+    std::vector<Node> m_nodes;
+};
+
+}
+}
+
+#endif /* TOPICAUTHORIZATIONTRIE_H_ */
@@ -4,4 +4,6 @@
 
 OBJS += \
 	topicauthorization/src/topicauthorizationstate.o \
-	topicauthorization/src/topicauthorizationservice.o  
+	topicauthorization/src/topicauthorizationservice.o \
+	topicauthorization/src/topicauthorizationcache.o \
+	topicauthorization/src/topicauthorizationtrie.o
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+#include "topicauthorization/include/topicauthorizationcache.h"
+#include <cstring>
+
+using namespace std;
+
+namespace dxl {
+namespace broker {
+
+/** Bit indicating that a verdict is cached (shifted per verdict type) */
+static const uint8_t VERDICT_KNOWN = 0x1;
+/** Bit indicating that the verdict is to allow (shifted per verdict type) */
+static const uint8_t VERDICT_ALLOWED = 0x2;
+
+/** {@inheritDoc} */
+TopicAuthorizationCache::TopicAuthorizationCache( size_t maxIdentitySets, size_t maxTopics ) :
+    m_maxIdentitySets( maxIdentitySets ),
+    m_maxTopics( maxTopics ),
+    m_generation( 0 )
+{
+}
+
+/** {@inheritDoc} */
+uint64_t TopicAuthorizationCache::hash( const char* identity )
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for( const char* c = identity; *c; c++ )
+    {
+        h ^= (unsigned char)*c;
+        h *= 1099511628211ULL;
+    }
+
+    // Mix the bits, so that the hashes of an identity set can be summed
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/** {@inheritDoc} */
+bool TopicAuthorizationCache::isMatch(
+    const IdentityVerdicts& verdicts, const char* const* identities, size_t count )
+{
+    if( verdicts.identities.size() != count )
+    {
+        return false;
+    }
+    for( size_t i = 0; i < count; i++ )
+    {
+        if( verdicts.identities[i] != identities[i] )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** {@inheritDoc} */
+TopicAuthorizationCache::IdentityVerdicts* TopicAuthorizationCache::getVerdicts(
+    uint64_t setHash, const char* const* identities, size_t count )
+{
+    auto iter = m_verdicts.find( setHash );
+    if( iter != m_verdicts.end() )
+    {
+        // A different identity set with the same hash is not cached
+        return isMatch( iter->second, identities, count ) ? &iter->second : NULL;
+    }
+
+    if( m_verdicts.size() >= m_maxIdentitySets )
+    {
+        m_verdicts.clear();
+    }
+
+    IdentityVerdicts& verdicts = m_verdicts[setHash];
+    verdicts.identities.assign( identities, identities + count );
+    return &verdicts;
+}
+
+/** {@inheritDoc} */
+TopicAuthorizationCache::IdentityVerdicts* TopicAuthorizationCache::getVerdicts( const string& clientId )
+{
+    const char* identity = clientId.c_str();
+    return getVerdicts( hash( identity ), &identity, 1 );
+}
+
+/** {@inheritDoc} */
+TopicAuthorizationCache::IdentityVerdicts* TopicAuthorizationCache::getVerdicts( struct cert_hashes* certHashes )
+{
+    if( !certHashes )
+    {
+        // No certificates, checked with an empty key
+        const char* identity = "";
+        return getVerdicts( hash( identity ), &identity, 1 );
+    }
+
+    // The hash of the set is the sum of the hashes of its certificates (independent of order)
+    const char* identities[MAX_CERTS];
+    size_t count = 0;
+    uint64_t setHash = 0;
+    struct cert_hashes *current, *tmp;
+    HASH_ITER( hh, certHashes, current, tmp )
+    {
+        if( count == MAX_CERTS )
+        {
+            return NULL;
+        }
+
+        // Insertion sort (the count of certificates is small)
+        size_t i = count++;
+        for( ; i > 0 && strcmp( identities[i - 1], current->cert_sha1 ) > 0; i-- )
+        {
+            identities[i] = identities[i - 1];
+        }
+        identities[i] = current->cert_sha1;
+        setHash += hash( current->cert_sha1 );
+    }
+
+    return getVerdicts( setHash, identities, count );
+}
+
+/** {@inheritDoc} */
+bool TopicAuthorizationCache::find(
+    const IdentityVerdicts* verdicts, VerdictType type, const string& topic, bool* authorized ) const
+{
+    if( !verdicts )
+    {
+        return false;
+    }
+
+    auto iter = verdicts->topics.find( topic );
+    if( iter == verdicts->topics.end() || iter->second.generation != m_generation ||
+        !( iter->second.bits & ( VERDICT_KNOWN << ( type * 2 ) ) ) )
+    {
+        return false;
+    }
+
+    *authorized = ( iter->second.bits & ( VERDICT_ALLOWED << ( type * 2 ) ) ) != 0;
+    return true;
+}
+
+/** {@inheritDoc} */
+void TopicAuthorizationCache::add(
+    IdentityVerdicts* verdicts, VerdictType type, const string& topic, bool authorized )
+{
+    if( !verdicts )
+    {
+        return;
+    }
+
+    auto iter = verdicts->topics.find( topic );
+    if( iter == verdicts->topics.end() )
+    {
+        if( verdicts->topics.size() >= m_maxTopics )
+        {
+            verdicts->topics.clear();
+        }
+        TopicVerdicts topicVerdicts = { m_generation, 0 };
+        iter = verdicts->topics.insert( make_pair( topic, topicVerdicts ) ).first;
+    }
+    else if( iter->second.generation != m_generation )
+    {
+        // Overwrite the verdicts of an earlier generation
+        iter->second.generation = m_generation;
+        iter->second.bits = 0;
+    }
+
+    iter->second.bits |= ( VERDICT_KNOWN << ( type * 2 ) );
+    if( authorized )
+    {
+        iter->second.bits |= ( VERDICT_ALLOWED << ( type * 2 ) );
+    }
+}
+
+}
+}
@@ -4,20 +4,91 @@
 
 #include "include/SimpleLog.h"
 #include "topicauthorization/include/topicauthorizationservice.h"
-#include "core/include/CoreUtil.h"
 
 using dxl::broker::common::MutexLock;
-using namespace dxl::broker::core;
 using namespace std;
 
 namespace dxl {
 namespace broker {
 
+/**
+ * The maximum count of identity sets to cache verdicts for. The bounds are per reader slot
+ * (thread), so a slot holds at most CACHE_MAX_IDENTITY_SETS * CACHE_MAX_TOPICS verdicts.
+ */
+static const size_t CACHE_MAX_IDENTITY_SETS = 128;
+/** The maximum count of topics to cache verdicts for, per identity set */
+static const size_t CACHE_MAX_TOPICS = 256;
+/** The maximum count of key identifiers that are checked at once */
+static const size_t MAX_KEY_IDS = 16;
+
+/** {@inheritDoc} */
+TopicAuthorizationService::ReaderSlot::ReaderSlot( TopicAuthorizationService* service ) :
+    service( service ),
+    owned( false ),
+    hazard( NULL ),
+    cache( CACHE_MAX_IDENTITY_SETS, CACHE_MAX_TOPICS ),
+    cacheHitCount( 0 ),
+    cacheMissCount( 0 )
+{
+}
+
+/** {@inheritDoc} */
+void TopicAuthorizationService::ReaderHandle::release()
+{
+    if( m_slot )
+    {
+        if( m_slot->service )
+        {
+            m_slot->service->releaseReaderSlot( m_slot );
+        }
+        else
+        {
+            delete m_slot;
+        }
+        m_slot = NULL;
+    }
+}
+
 /** {@inheritDoc} */
-TopicAuthorizationService::TopicAuthorizationService() {}
+TopicAuthorizationService::ReaderSlot* TopicAuthorizationService::ReaderHandle::getSlot(
+    TopicAuthorizationService* service )
+{
+    if( !m_slot || m_slot->service != service )
+    {
+        release();
+        m_slot = service->acquireReaderSlot();
+    }
+    return m_slot;
+}
 
 /** {@inheritDoc} */
-TopicAuthorizationService::~TopicAuthorizationService() {}
+TopicAuthorizationService::TopicAuthorizationService() :
+    m_snapshot( new Snapshot() ),
+    m_generation( 0 )
+{
+}
+
+/** {@inheritDoc} */
+TopicAuthorizationService::~TopicAuthorizationService()
+{
+    delete m_snapshot.load();
+    for( auto iter = m_retiredSnapshots.begin(); iter != m_retiredSnapshots.end(); iter++ )
+    {
+        delete *iter;
+    }
+    for( auto iter = m_readerSlots.begin(); iter != m_readerSlots.end(); iter++ )
+    {
+        // The slots that are owned are deleted when their threads exit
+        if( (*iter)->owned )
+        {
+            (*iter)->service = NULL;
+        }
+        else
+        {
+            delete *iter;
+        }
+    }
+}
 
 /** {@inheritDoc} */
 const shared_ptr<TopicAuthorizationService> TopicAuthorizationService::Instance()
@@ -30,153 +101,235 @@ const shared_ptr<TopicAuthorizationService> TopicAuthorizationService::Instance(
 void TopicAuthorizationService::setTopicState( shared_ptr<TopicAuthorizationState> newState )
 {
     MutexLock lock( &m_threadingMutex );
-    if ( !m_state || ( *newState != *m_state ) )
+    const Snapshot* current = m_snapshot.load();
+    if ( !current->state || ( *newState != *current->state ) )
     {
-        m_state = newState;
+        Snapshot* snapshot = new Snapshot();
+        snapshot->state = newState;
+        snapshot->generation = current->generation + 1;
+
+        // Publish the snapshot before its generation, readers that observe the generation
+        // (and discard their cached verdicts) will then read the new snapshot
+        m_snapshot.store( snapshot );
+        m_generation.store( snapshot->generation );
+
+        m_retiredSnapshots.push_back( current );
+        reclaimSnapshots();
     }
 }
 
 /** {@inheritDoc} */
-bool TopicAuthorizationService::_isAuthorizedToSubscribe( shared_ptr<const TopicAuthorizationState>& state,
-    const std::string& key, const std::string& topic )
+void TopicAuthorizationService::reclaimSnapshots()
 {
-    bool hit;
-    bool authorized = state->isAuthorizedToSubscribe( key, topic, &hit );
-
-    //
-    // Wildcard authorization support
-    //
-    if( state->isWildcardingEnabled() )
+    auto retired = m_retiredSnapshots.begin();
+    while( retired != m_retiredSnapshots.end() )
     {
-        if( hit && authorized )
+        bool reading = false;
+        for( auto slot = m_readerSlots.begin(); slot != m_readerSlots.end() && !reading; slot++ )
         {
-            return true;
+            reading = ( (*slot)->hazard.load() == *retired );
         }
 
-        char* wcTopic = CoreUtil::iterateWildcardBegin( topic.c_str() );
-        while( CoreUtil::iterateWildcardNext( wcTopic ) )
+        if( reading )
         {
-            if( state->isAuthorizedToSubscribe( key, wcTopic, &hit ) )
-            {
-                if( hit )
-                {
-                    authorized = true;
-                    break;
-                }
-            }
-            else
-            {
-                authorized = false;
-            }
+            retired++;
+        }
+        else
+        {
+            delete *retired;
+            retired = m_retiredSnapshots.erase( retired );
         }
-        CoreUtil::iterateWildcardEnd( wcTopic );
     }
-
-    return authorized;
 }
 
 /** {@inheritDoc} */
-bool TopicAuthorizationService::_isAuthorizedToPublish( shared_ptr<const TopicAuthorizationState>& state,
-    const std::string& key, const std::string& topic )
+TopicAuthorizationService::ReaderSlot* TopicAuthorizationService::getReaderSlot()
 {
-    bool hit;
-    bool authorized = state->isAuthorizedToPublish( key, topic, &hit );
+    static thread_local ReaderHandle handle;
+    return handle.getSlot( this );
+}
 
-    //
-    // Wildcard authorization support
-    //    
-    if( state->isWildcardingEnabled() )
+/** {@inheritDoc} */
+TopicAuthorizationService::ReaderSlot* TopicAuthorizationService::acquireReaderSlot()
+{
+    MutexLock lock( &m_threadingMutex );
+    for( auto iter = m_readerSlots.begin(); iter != m_readerSlots.end(); iter++ )
     {
-        if( hit && authorized )
+        if( !(*iter)->owned )
         {
-            return true;
+            (*iter)->owned = true;
+            return *iter;
         }
+    }
+
+    ReaderSlot* slot = new ReaderSlot( this );
+    slot->owned = true;
+    m_readerSlots.push_back( slot );
+    return slot;
+}
+
+/** {@inheritDoc} */
+void TopicAuthorizationService::releaseReaderSlot( ReaderSlot* slot )
+{
+    MutexLock lock( &m_threadingMutex );
+    slot->hazard.store( NULL );
+    slot->owned = false;
+}
 
-        char* wcTopic = CoreUtil::iterateWildcardBegin( topic.c_str() );
-        while( CoreUtil::iterateWildcardNext( wcTopic ) )
+/** {@inheritDoc} */
+bool TopicAuthorizationService::_isAuthorized( const shared_ptr<const TopicAuthorizationState>& state,
+    const std::string* clientId, struct cert_hashes* certHashes,
+    TopicAuthorizationCache::VerdictType type, const std::string& topic )
+{
+    bool publish = ( type == TopicAuthorizationCache::PUBLISH );
+
+    // The identifiers of the keys, keys that are not listed by the state can only be
+    // authorized for topics that have no entries (which does not depend on the keys)
+    uint32_t ids[MAX_KEY_IDS];
+    size_t count = 0;
+    if( clientId || !certHashes )
+    {
+        // Handles case where there are no certs (TLS is disabled?) with an empty key
+        uint32_t id = state->getKeyId( clientId ? clientId->c_str() : "" );
+        if( id )
         {
-            if( state->isAuthorizedToPublish( key, wcTopic, &hit ) )
+            ids[count++] = id;
+        }
+    }
+    else
+    {
+        struct cert_hashes *current, *tmp;
+        HASH_ITER( hh, certHashes, current, tmp )
+        {
+            uint32_t id = state->getKeyId( current->cert_sha1 );
+            if( id )
             {
-                if( hit )
+                if( count == MAX_KEY_IDS )
                 {
-                    authorized = true;
-                    break;
+                    // Check the certificates so far, if we are authorized, return true
+                    // (short circuit)
+                    if( publish ?
+                        state->isAuthorizedToPublish( ids, count, topic ) :
+                        state->isAuthorizedToSubscribe( ids, count, topic ) )
+                    {
+                        return true;
+                    }
+                    count = 0;
                 }
+                ids[count++] = id;
             }
-            else
-            {
-                authorized = false;
-            }
         }
-        CoreUtil::iterateWildcardEnd( wcTopic );
     }
 
+    return publish ?
+        state->isAuthorizedToPublish( ids, count, topic ) :
+        state->isAuthorizedToSubscribe( ids, count, topic );
+}
+
+/** {@inheritDoc} */
+bool TopicAuthorizationService::isAuthorized( const std::string* clientId, struct cert_hashes* certHashes,
+    TopicAuthorizationCache::VerdictType type, const std::string& topic )
+{
+    ReaderSlot* slot = getReaderSlot();
+
+    // The cached verdicts are for the current generation (or an earlier generation that was
+    // current when this check started)
+    slot->cache.setGeneration( m_generation.load( memory_order_acquire ) );
+
+    bool authorized;
+    TopicAuthorizationCache::IdentityVerdicts* verdicts =
+        clientId ? slot->cache.getVerdicts( *clientId ) : slot->cache.getVerdicts( certHashes );
+    if( slot->cache.find( verdicts, type, topic, &authorized ) )
+    {
+        // Only written by this thread, a plain increment avoids a locked instruction
+        slot->cacheHitCount.store(
+            slot->cacheHitCount.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+        return authorized;
+    }
+    slot->cacheMissCount.store(
+        slot->cacheMissCount.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+
+    // Protect the current snapshot from reclamation, the snapshot must still be current once
+    // the hazard pointer is visible to writers
+    const Snapshot* snapshot = m_snapshot.load();
+    for( ;; )
+    {
+        slot->hazard.store( snapshot );
+        const Snapshot* current = m_snapshot.load();
+        if( current == snapshot )
+        {
+            break;
+        }
+        snapshot = current;
+    }
+
+    authorized = _isAuthorized( snapshot->state, clientId, certHashes, type, topic );
+
+    // The snapshot may be newer than the generation of the cached verdicts
+    slot->cache.setGeneration( snapshot->generation );
+    slot->cache.add(
+        clientId ? slot->cache.getVerdicts( *clientId ) : slot->cache.getVerdicts( certHashes ),
+        type, topic, authorized );
+
+    slot->hazard.store( NULL, memory_order_release );
+
     return authorized;
 }
 
 /** {@inheritDoc} */
 bool TopicAuthorizationService::isAuthorizedToPublish( const std::string& clientId, const std::string& topic )
 {
-    auto state = getTopicAuthorizationState();
-    return _isAuthorizedToPublish( state, clientId, topic );
+    return isAuthorized( &clientId, NULL, TopicAuthorizationCache::PUBLISH, topic );
 }
 
 /** {@inheritDoc} */
 bool TopicAuthorizationService::isAuthorizedToSubscribe( const std::string& clientId, const std::string& topic )
 {
-    auto state = getTopicAuthorizationState();
-    return _isAuthorizedToSubscribe( state, clientId, topic );
+    return isAuthorized( &clientId, NULL, TopicAuthorizationCache::SUBSCRIBE, topic );
 }
 
 /** {@inheritDoc} */
 bool TopicAuthorizationService::isAuthorizedToPublish( struct cert_hashes* certHashes, const std::string& topic )
 {
-    auto state = getTopicAuthorizationState();    
-    if( certHashes )
-    {
-        // Iterate the certificate hashes, if we are authorized, return true (short circuit)
-        struct cert_hashes *current, *tmp;
-        HASH_ITER( hh, certHashes, current, tmp ) 
-        {
-            if( _isAuthorizedToPublish( state, current->cert_sha1, topic ) )
-            {
-                return true;
-            }
-        }
-        return false;
-    }
-
-    // Handles case where there are no certs (TLS is disabled?)
-    return _isAuthorizedToPublish( state, "", topic );
+    return isAuthorized( NULL, certHashes, TopicAuthorizationCache::PUBLISH, topic );
 }
 
 /** {@inheritDoc} */
 bool TopicAuthorizationService::isAuthorizedToSubscribe( struct cert_hashes* certHashes, const std::string& topic )
 {
-    auto state = getTopicAuthorizationState();    
-    if( certHashes )
+    return isAuthorized( NULL, certHashes, TopicAuthorizationCache::SUBSCRIBE, topic );
+}
+
+/** {@inheritDoc} */
+uint64_t TopicAuthorizationService::getCacheHitCount()
+{
+    MutexLock lock( &m_threadingMutex );
+    uint64_t count = 0;
+    for( auto iter = m_readerSlots.begin(); iter != m_readerSlots.end(); iter++ )
     {
-        // Iterate the certificate hashes, if we are authorized, return true (short circuit)
-        struct cert_hashes *current, *tmp;
-        HASH_ITER( hh, certHashes, current, tmp ) 
-        {
-            if( _isAuthorizedToSubscribe( state, current->cert_sha1, topic ) )
-            {
-                return true;
-            }
-        }
-        return false;
+        count += (*iter)->cacheHitCount.load( memory_order_relaxed );
     }
+    return count;
+}
 
-    // Handles case where there are no certs (TLS is disabled?)
-    return _isAuthorizedToSubscribe( state, "", topic );
+/** {@inheritDoc} */
+uint64_t TopicAuthorizationService::getCacheMissCount()
+{
+    MutexLock lock( &m_threadingMutex );
+    uint64_t count = 0;
+    for( auto iter = m_readerSlots.begin(); iter != m_readerSlots.end(); iter++ )
+    {
+        count += (*iter)->cacheMissCount.load( memory_order_relaxed );
+    }
+    return count;
 }
 
 /** {@inheritDoc} */
 const shared_ptr<const TopicAuthorizationState> TopicAuthorizationService::getTopicAuthorizationState()
 {
+    // Snapshots are only reclaimed by writers, which hold the mutex
     MutexLock lock(&m_threadingMutex);
-    return m_state;
+    return m_snapshot.load()->state;
 }
 
 }
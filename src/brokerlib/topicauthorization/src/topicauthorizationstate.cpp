@@ -4,6 +4,7 @@
 
 
 #include "topicauthorization/include/topicauthorizationstate.h"
+#include <cstring>
 #include <memory>
 #include <string>
 #include "include/unordered_map.h"
@@ -163,7 +164,8 @@ shared_ptr<TopicAuthorizationState> TopicAuthorizationState::CreateFromJsonFile(
 TopicAuthorizationState::TopicAuthorizationState(
     const TopicAuthorizationState::TopicAuthorizationStateData& publishers,
     const TopicAuthorizationState::TopicAuthorizationStateData& subscribers ) :
-    m_publishers( publishers ), m_subscribers( subscribers ), m_isWildcardingEnabled( false )
+    m_publishers( publishers ), m_subscribers( subscribers ), m_isWildcardingEnabled( false ),
+    m_publishersTrie( publishers, m_keyIds ), m_subscribersTrie( subscribers, m_keyIds )
 {
     // Look for wildcards
     m_isWildcardingEnabled = hasWildcards( publishers ) || hasWildcards( subscribers );
@@ -210,6 +212,15 @@ bool TopicAuthorizationState::isAuthorizedToSubscribe(
     return isAuthorized( m_subscribers, key, topic, hit );
 }
 
+/** {@inheritDoc} */
+uint32_t TopicAuthorizationState::getKeyId( const char* key ) const
+{
+    TopicAuthorizationTrie::Chars chars = { key, strlen( key ) };
+    auto iter = m_keyIds.find(
+        chars, TopicAuthorizationTrie::CharsHash(), TopicAuthorizationTrie::CharsEqual() );
+    return iter == m_keyIds.end() ? 0 : iter->second;
+}
+
 /** {@inheritDoc} */
 bool TopicAuthorizationState::operator!=( const TopicAuthorizationState& rhs ) const
 {
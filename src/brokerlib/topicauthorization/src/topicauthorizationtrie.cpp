@@ -0,0 +1,149 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+#include "topicauthorization/include/topicauthorizationtrie.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace dxl {
+namespace broker {
+
+/** {@inheritDoc} */
+size_t TopicAuthorizationTrie::CharsHash::operator()( const Chars& chars ) const
+{
+    // FNV-1a
+    size_t h = (size_t)14695981039346656037ULL;
+    for( size_t i = 0; i < chars.size; i++ )
+    {
+        h ^= (unsigned char)chars.data[i];
+        h *= (size_t)1099511628211ULL;
+    }
+    return h;
+}
+
+/** {@inheritDoc} */
+TopicAuthorizationTrie::TopicAuthorizationTrie(
+    const unordered_map<string, unordered_set<string>>& policy, KeyIdentifiers& keyIds ) :
+    m_nodes( 1 )
+{
+    for( auto entry = policy.begin(); entry != policy.end(); entry++ )
+    {
+        // Add the nodes along the levels of the topic
+        const string& topic = entry->first;
+        uint32_t index = 0;
+        size_t start = 0;
+        for( ;; )
+        {
+            size_t end = topic.find( '/', start );
+            string level = topic.substr( start, end == string::npos ? string::npos : end - start );
+            auto child = m_nodes[index].children.find( level );
+            if( child == m_nodes[index].children.end() )
+            {
+                uint32_t childIndex = (uint32_t)m_nodes.size();
+                m_nodes[index].children[level] = childIndex;
+                m_nodes.push_back( Node() );
+                index = childIndex;
+            }
+            else
+            {
+                index = child->second;
+            }
+
+            if( end == string::npos )
+            {
+                break;
+            }
+            start = end + 1;
+        }
+
+        Node& node = m_nodes[index];
+        node.isEntry = true;
+        for( auto key = entry->second.begin(); key != entry->second.end(); key++ )
+        {
+            auto id = keyIds.find( *key );
+            if( id == keyIds.end() )
+            {
+                id = keyIds.insert( make_pair( *key, (uint32_t)keyIds.size() + 1 ) ).first;
+            }
+            node.ids.push_back( id->second );
+        }
+        sort( node.ids.begin(), node.ids.end() );
+    }
+
+    // The wildcard entries are found without a lookup
+    for( auto node = m_nodes.begin(); node != m_nodes.end(); node++ )
+    {
+        auto child = node->children.find( "#" );
+        if( child != node->children.end() && m_nodes[child->second].isEntry )
+        {
+            node->wildcardChild = child->second;
+        }
+    }
+}
+
+/** {@inheritDoc} */
+bool TopicAuthorizationTrie::isListed( const Node& node, const uint32_t* ids, size_t count )
+{
+    for( size_t i = 0; i < count; i++ )
+    {
+        if( binary_search( node.ids.begin(), node.ids.end(), ids[i] ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** {@inheritDoc} */
+bool TopicAuthorizationTrie::isAuthorized( const uint32_t* ids, size_t count, const string& topic ) const
+{
+    bool matched = false;
+    const Node* node = &m_nodes[0];
+    const char* level = topic.c_str();
+    const char* topicEnd = level + topic.size();
+    for( ;; )
+    {
+        // The wildcard entry for the levels so far
+        if( node->wildcardChild )
+        {
+            matched = true;
+            if( isListed( m_nodes[node->wildcardChild], ids, count ) )
+            {
+                return true;
+            }
+        }
+
+        const char* levelEnd = (const char*)memchr( level, '/', topicEnd - level );
+        Chars chars = { level, (size_t)( ( levelEnd ? levelEnd : topicEnd ) - level ) };
+        auto child = node->children.find( chars, CharsHash(), CharsEqual() );
+        if( child == node->children.end() )
+        {
+            // No further entries match
+            return !matched;
+        }
+        node = &m_nodes[child->second];
+
+        if( !levelEnd )
+        {
+            break;
+        }
+        level = levelEnd + 1;
+    }
+
+    // The entry for the topic
+    if( node->isEntry )
+    {
+        matched = true;
+        if( isListed( *node, ids, count ) )
+        {
+            return true;
+        }
+    }
+
+    return !matched;
+}
+
+}
+}
@@ -0,0 +1,25 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee LLC - All Rights Reserved.
+ *****************************************************************************/
+
+#ifndef GUID_IDS_H
+#define GUID_IDS_H
+
+#include <stdint.h>
+
+/**
+ * Structure that contains the interned identifiers of the GUIDs of a context. The GUIDs are
+ * interned by the broker library when the context connects, which allows the destinations of
+ * a message to be matched against the context by comparing integers. An identifier of 0
+ * indicates that the GUID has not been interned.
+ */
+struct guid_ids {
+    /** The identifier of the context (client instance or bridged broker) */
+    uint32_t id;
+    /** The identifier of the canonical client */
+    uint32_t canonical_id;
+    /** The identifier of the tenant (0 if the context has no tenant) */
+    uint32_t tenant_id;
+};
+
+#endif
@@ -0,0 +1,28 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee LLC - All Rights Reserved.
+ *****************************************************************************/
+
+#ifndef PAYLOAD_SPLICE_H
+#define PAYLOAD_SPLICE_H
+
+#include <stdint.h>
+
+/**
+ * Structure that describes a payload rewritten by the broker library. The rewritten payload
+ * is the bytes, with a region of the original payload inserted at the offset. This allows the
+ * fields surrounding a large body to be rewritten without copying the body.
+ */
+struct payload_splice {
+    /** The rewritten bytes (NULL if the payload was not rewritten) */
+    unsigned char *bytes;
+    /** The length of the rewritten bytes */
+    uint32_t len;
+    /** The offset within the rewritten bytes that the region is inserted at */
+    uint32_t offset;
+    /** The start of the region within the original payload */
+    uint32_t region_start;
+    /** The length of the region (0 if the bytes are the whole payload) */
+    uint32_t region_len;
+};
+
+#endif
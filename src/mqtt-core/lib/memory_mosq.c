@@ -29,6 +29,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "config.h"
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -132,3 +133,193 @@ char *_mosquitto_strdup(const char *s)
     return str;
 }
 
+// DXL Begin
+/* The object sizes of the pool classes */
+static const size_t pool_class_sizes[] = {32, 48, 64, 80, 96, 128, 192, 256};
+#define POOL_CLASS_COUNT ((int)(sizeof(pool_class_sizes)/sizeof(pool_class_sizes[0])))
+
+/* The size of each slab */
+#define POOL_SLAB_SIZE 16384
+
+/* The count of objects moved between a thread free list and the shared depot at a time */
+#define POOL_BATCH 64
+
+/* The count of free objects a thread holds before returning a batch to the depot */
+#define POOL_CACHE_MAX 256
+
+struct _pool_object {
+    struct _pool_object *next;
+};
+
+struct _pool_class {
+    pthread_mutex_t mutex;
+    /* Free objects shared between threads (guarded by mutex) */
+    struct _pool_object *depot;
+    uint64_t slabs;
+    uint64_t capacity;
+    uint64_t in_use;
+};
+
+/* The free list of a size class for a thread */
+struct _pool_cache {
+    struct _pool_object *head;
+    int count;
+};
+
+static struct _pool_class pool_classes[POOL_CLASS_COUNT] = {
+    {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0},
+    {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0},
+    {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0},
+    {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0},
+    {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0},
+    {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0},
+    {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0},
+    {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0}
+};
+
+static __thread struct _pool_cache pool_caches[POOL_CLASS_COUNT];
+
+/* Returns the size class for the size, or -1 if it is larger than the largest class */
+static int _pool_class(size_t size)
+{
+    int i;
+    for(i=0; i<POOL_CLASS_COUNT; i++){
+        if(size <= pool_class_sizes[i]) return i;
+    }
+    return -1;
+}
+
+/* Refills the free list of the thread from the depot, allocating a slab if it is empty */
+static bool _pool_refill(int size_class)
+{
+    struct _pool_class *pc = &pool_classes[size_class];
+    struct _pool_cache *cache = &pool_caches[size_class];
+    struct _pool_object *obj;
+    size_t size = pool_class_sizes[size_class];
+    size_t count, i;
+    uint8_t *slab;
+
+    pthread_mutex_lock(&pc->mutex);
+    for(i=0; i<POOL_BATCH && pc->depot; i++){
+        obj = pc->depot;
+        pc->depot = obj->next;
+        obj->next = cache->head;
+        cache->head = obj;
+        cache->count++;
+    }
+    if(!cache->head){
+        slab = (uint8_t *)_mosquitto_malloc(POOL_SLAB_SIZE);
+        if(slab){
+            count = POOL_SLAB_SIZE / size;
+            for(i=0; i<count; i++){
+                obj = (struct _pool_object *)(slab + i*size);
+                obj->next = cache->head;
+                cache->head = obj;
+            }
+            cache->count += (int)count;
+            pc->slabs++;
+            pc->capacity += count;
+        }
+    }
+    pthread_mutex_unlock(&pc->mutex);
+
+    return cache->head != NULL;
+}
+
+void *_mosquitto_pool_malloc(size_t size)
+{
+    struct _pool_cache *cache;
+    struct _pool_object *obj;
+    int size_class = _pool_class(size);
+
+    if(size_class < 0) return _mosquitto_malloc(size);
+
+    cache = &pool_caches[size_class];
+    if(!cache->head && !_pool_refill(size_class)) return NULL;
+
+    obj = cache->head;
+    cache->head = obj->next;
+    cache->count--;
+    __sync_add_and_fetch(&pool_classes[size_class].in_use, 1);
+
+    return obj;
+}
+
+void *_mosquitto_pool_calloc(size_t size)
+{
+    void *mem = _mosquitto_pool_malloc(size);
+    if(mem) memset(mem, 0, size);
+    return mem;
+}
+
+void _mosquitto_pool_free(void *mem, size_t size)
+{
+    struct _pool_class *pc;
+    struct _pool_cache *cache;
+    struct _pool_object *obj, *head, *tail;
+    int size_class;
+    int i;
+
+    if(!mem) return;
+
+    size_class = _pool_class(size);
+    if(size_class < 0){
+        _mosquitto_free(mem);
+        return;
+    }
+
+    pc = &pool_classes[size_class];
+    cache = &pool_caches[size_class];
+    obj = (struct _pool_object *)mem;
+    obj->next = cache->head;
+    cache->head = obj;
+    cache->count++;
+    __sync_sub_and_fetch(&pc->in_use, 1);
+
+    /* Return a batch to the depot, so that objects freed by threads that do not allocate
+     * (the write threads) are reused */
+    if(cache->count > POOL_CACHE_MAX){
+        head = tail = cache->head;
+        for(i=1; i<POOL_BATCH; i++){
+            tail = tail->next;
+        }
+        cache->head = tail->next;
+        cache->count -= POOL_BATCH;
+
+        pthread_mutex_lock(&pc->mutex);
+        tail->next = pc->depot;
+        pc->depot = head;
+        pthread_mutex_unlock(&pc->mutex);
+    }
+}
+
+char *_mosquitto_pool_strdup(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *str = (char *)_mosquitto_pool_malloc(len);
+    if(str) memcpy(str, s, len);
+    return str;
+}
+
+void _mosquitto_pool_strfree(char *s)
+{
+    if(s) _mosquitto_pool_free(s, strlen(s) + 1);
+}
+
+int _mosquitto_pool_class_count(void)
+{
+    return POOL_CLASS_COUNT;
+}
+
+void _mosquitto_pool_get_stats(int size_class, struct _mosquitto_pool_stats *stats)
+{
+    struct _pool_class *pc = &pool_classes[size_class];
+
+    pthread_mutex_lock(&pc->mutex);
+    stats->size = pool_class_sizes[size_class];
+    stats->slabs = pc->slabs;
+    stats->capacity = pc->capacity;
+    stats->in_use = __sync_add_and_fetch(&pc->in_use, 0);
+    pthread_mutex_unlock(&pc->mutex);
+}
+// DXL End
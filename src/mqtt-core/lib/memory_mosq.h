@@ -31,6 +31,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define _MEMORY_MOSQ_H_
 
 #include "dxlcommon.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/types.h>
 
@@ -48,4 +49,36 @@ unsigned long _mosquitto_max_memory_used(void);
 void *_mosquitto_realloc(void *ptr, size_t size);
 char *_mosquitto_strdup(const char *s);
 
+// DXL Begin
+/*
+ * Memory pools
+ *
+ * Size-classed pools for small, frequently allocated structures (message store
+ * records, client messages, packets, source identifiers, subscription tree nodes).
+ * Objects are carved from slabs and recycled through per-thread free lists, so they
+ * do not fragment the heap. The size of an object must be specified when it is freed. Sizes larger
+ * than the largest class are passed through to _mosquitto_malloc/_mosquitto_free.
+ */
+
+/* Statistics for a pool size class */
+struct _mosquitto_pool_stats {
+    /* The object size of the class */
+    size_t size;
+    /* The count of slabs allocated */
+    uint64_t slabs;
+    /* The count of objects carved from the slabs */
+    uint64_t capacity;
+    /* The count of objects currently allocated */
+    uint64_t in_use;
+};
+
+void *_mosquitto_pool_malloc(size_t size);
+void *_mosquitto_pool_calloc(size_t size);
+void _mosquitto_pool_free(void *mem, size_t size);
+char *_mosquitto_pool_strdup(const char *s);
+void _mosquitto_pool_strfree(char *s);
+int _mosquitto_pool_class_count(void);
+void _mosquitto_pool_get_stats(int size_class, struct _mosquitto_pool_stats *stats);
+// DXL End
+
 #endif
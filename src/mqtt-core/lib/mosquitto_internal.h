@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <openssl/ssl.h>
 // DXL Begin
 #include "../../common/include/cert_hashes.h"
+#include "../../common/include/guid_ids.h"
 typedef enum CertType {unknown, broker, client} CertType;
 // DXL End
 #include <stdlib.h>
@@ -45,6 +46,7 @@ typedef enum CertType {unknown, broker, client} CertType;
 #include "mosquitto.h"
 #include "time_mosq.h"
 struct mosquitto_client_msg;
+struct _mosquitto_subleaf; // DXL
 
 enum mosquitto_msg_direction {
     mosq_md_in = 0,
@@ -90,6 +92,21 @@ enum _mosquitto_transport {
     mosq_t_sctp = 3
 };
 
+/* DXL: An immutable, encoded packet that is shared (by reference) by the outgoing
+ * packets of each context it is written to. */
+struct _mosquitto_frame{
+    int ref_count;
+    uint32_t length;
+    uint8_t *data;
+};
+
+/* DXL: A part of a payload. Payloads are written from their parts, in order, which
+ * allows the parts to reside in different buffers (see payload_splice.h). */
+struct _mosquitto_payload_part{
+    const void *data;
+    uint32_t len;
+};
+
 struct _mosquitto_packet{
     uint8_t command;
     uint8_t have_remaining;
@@ -102,9 +119,21 @@ struct _mosquitto_packet{
     uint32_t to_process;
     uint32_t pos;
     uint8_t *payload;
+    struct _mosquitto_frame *frame; /* DXL: Shared frame that payload refers to (optional) */
     struct _mosquitto_packet *next;
 };
 
+/* DXL: A timer on the broker timer wheel (see timer.c) */
+struct mosquitto_timer{
+    time_t expiry;
+    void (*callback)(struct mosquitto_timer *timer, time_t now);
+    void *data;
+    /* The wheel slot the timer is linked into (NULL if it is not scheduled) */
+    struct mosquitto_timer **slot;
+    struct mosquitto_timer *prev;
+    struct mosquitto_timer *next;
+};
+
 struct mosquitto_message_all{
     struct mosquitto_message_all *next;
     time_t timestamp;
@@ -118,7 +147,9 @@ struct mosquitto {
     // DXL Begin
     uint32_t numericId;
     bool clean_subs;
+    int clean_subs_index; /* The position in the sessions to clean (if clean_subs) */
     bool pending_bytes;
+    bool pending_write;
     // DXL End
     int sock;
     int ws_sock;
@@ -127,6 +158,7 @@ struct mosquitto {
     char *id;
     char *canonical_id; // DXL
     char *cert_chain; // DXL
+    struct dxl_message_source_t *dxl_message_source; // DXL
     uint16_t keepalive;
     bool clean_session;
     enum mosquitto_client_state state;
@@ -135,6 +167,14 @@ struct mosquitto {
     time_t ping_t;
     uint16_t last_mid;
     struct _mosquitto_packet in_packet;
+    // DXL Begin
+    /* The receive buffer (see _mosquitto_packet_read, NULL when consumed) */
+    uint8_t *rx_buf;
+    /* The position of the next byte to parse in the receive buffer */
+    uint32_t rx_pos;
+    /* The count of bytes in the receive buffer */
+    uint32_t rx_len;
+    // DXL End
     struct _mosquitto_packet *current_out_packet;
     struct _mosquitto_packet *out_packet;
     struct mosquitto_message *will;
@@ -153,6 +193,7 @@ struct mosquitto {
     CertType tls_certtype;
     char* dxl_client_guid;
     char* dxl_tenant_guid;
+    struct guid_ids dxl_guid_ids;
     struct cert_hashes* cert_hashes;
     // DXL end
     bool want_write;
@@ -176,6 +217,13 @@ struct mosquitto {
     // DXL Begin
     uint8_t dxl_flags;
     int subscription_count;
+    /* The length of the coalesced TLS write that must be retried (SSL_write
+     * requires a retry to be made with the same buffer and length) */
+    uint32_t tls_staged_len;
+    /* Keepalive, bridge retry and message retry timer */
+    struct mosquitto_timer timer;
+    /* The subscriptions of the context */
+    struct _mosquitto_subleaf *subs;
     // DXL End
     void* wsi; // Websocket instance
 };
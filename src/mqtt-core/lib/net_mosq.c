@@ -34,7 +34,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <string.h>
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #ifdef __ANDROID__
 #include <linux/in.h>
@@ -70,11 +72,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "memory_mosq.h"
 #include "mqtt3_protocol.h"
 #include "net_mosq.h"
+#include "send_mosq.h"
 #include "time_mosq.h"
 #include "util_mosq.h"
 
 int tls_ex_index_mosq = -1;
 
+// DXL: Network statistics
+__thread struct _mosquitto_net_stats g_net_stats = {0, 0, 0, 0};
+
 // Size of extra buffer that LWS requires prior to user data buffer.
 extern int g_ws_pre_buffer_size;
 
@@ -89,6 +95,43 @@ void _mosquitto_net_init(void)
     }
 }
 
+// DXL Begin
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+static pthread_mutex_t *_mosquitto_net_ssl_locks = NULL;
+
+static void _mosquitto_net_ssl_locking_callback(int mode, int n, const char *UNUSED(file), int UNUSED(line))
+{
+    if(mode & CRYPTO_LOCK){
+        pthread_mutex_lock(&_mosquitto_net_ssl_locks[n]);
+    }else{
+        pthread_mutex_unlock(&_mosquitto_net_ssl_locks[n]);
+    }
+}
+
+static unsigned long _mosquitto_net_ssl_id_callback(void)
+{
+    return (unsigned long)pthread_self();
+}
+#endif
+
+/* Prepares OpenSSL for use by multiple threads. OpenSSL versions prior to 1.1.0
+ * require locking callbacks to be registered. */
+void _mosquitto_net_thread_init(void)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    int i;
+
+    if(CRYPTO_get_locking_callback()) return;
+    _mosquitto_net_ssl_locks = (pthread_mutex_t *)malloc(CRYPTO_num_locks() * sizeof(pthread_mutex_t));
+    for(i=0; i<CRYPTO_num_locks(); i++){
+        pthread_mutex_init(&_mosquitto_net_ssl_locks[i], NULL);
+    }
+    CRYPTO_set_id_callback(_mosquitto_net_ssl_id_callback);
+    CRYPTO_set_locking_callback(_mosquitto_net_ssl_locking_callback);
+#endif
+}
+// DXL End
+
 void _mosquitto_net_cleanup(void)
 {
     ERR_free_strings();
@@ -128,6 +171,12 @@ void _mosquitto_packet_cleanup(struct _mosquitto_packet *packet)
     packet->remaining_count = 0;
     packet->remaining_mult = 1;
     packet->remaining_length = 0;    
+    if(packet->frame){
+        // DXL: The payload belongs to the shared frame
+        _mosquitto_frame_release(packet->frame);
+        packet->frame = NULL;
+        packet->payload = NULL;
+    }
     if(packet->payload) {
         if(packet->is_ws_packet){
             // Reset buffer to the original allocated value.
@@ -140,6 +189,81 @@ void _mosquitto_packet_cleanup(struct _mosquitto_packet *packet)
     packet->pos = 0;
 }
 
+// DXL Begin
+/* The capacities of the received packet buffer classes */
+static const uint32_t packet_buffer_sizes[] = {256, 1024, 4096, 16384};
+#define PACKET_BUFFER_CLASS_COUNT ((int)(sizeof(packet_buffer_sizes)/sizeof(packet_buffer_sizes[0])))
+
+/* The count of free buffers of each class that a thread retains */
+#define PACKET_BUFFER_CACHE_MAX 32
+
+/* The free list of a received packet buffer class for a thread */
+struct _packet_buffer_cache {
+    void *head;
+    int count;
+};
+
+static __thread struct _packet_buffer_cache packet_buffer_caches[PACKET_BUFFER_CLASS_COUNT];
+
+/* Returns the class of a buffer for the packet length, or -1 if it is larger than the largest class */
+static int _packet_buffer_class(uint32_t len)
+{
+    int i;
+    for(i=0; i<PACKET_BUFFER_CLASS_COUNT; i++){
+        if(len < packet_buffer_sizes[i]) return i;
+    }
+    return -1;
+}
+
+uint8_t *_mosquitto_packet_buffer_alloc(uint32_t len)
+{
+    struct _packet_buffer_cache *cache;
+    void *buffer;
+    int buffer_class = _packet_buffer_class(len);
+
+    if(buffer_class < 0) return (uint8_t *)_mosquitto_malloc(len+1);
+
+    cache = &packet_buffer_caches[buffer_class];
+    if(cache->head){
+        buffer = cache->head;
+        cache->head = *(void **)buffer;
+        cache->count--;
+        return (uint8_t *)buffer;
+    }
+    return (uint8_t *)_mosquitto_malloc(packet_buffer_sizes[buffer_class]);
+}
+
+void _mosquitto_packet_buffer_free(uint8_t *buffer, uint32_t len)
+{
+    struct _packet_buffer_cache *cache;
+    int buffer_class;
+
+    if(!buffer) return;
+
+    buffer_class = _packet_buffer_class(len);
+    if(buffer_class < 0 || packet_buffer_caches[buffer_class].count >= PACKET_BUFFER_CACHE_MAX){
+        _mosquitto_free(buffer);
+        return;
+    }
+
+    cache = &packet_buffer_caches[buffer_class];
+    *(void **)buffer = cache->head;
+    cache->head = buffer;
+    cache->count++;
+}
+
+void _mosquitto_packet_cleanup_received(struct _mosquitto_packet *packet)
+{
+    if(!packet) return;
+
+    if(packet->payload && !packet->frame && !packet->is_ws_packet){
+        _mosquitto_packet_buffer_free(packet->payload, packet->remaining_length);
+        packet->payload = NULL;
+    }
+    _mosquitto_packet_cleanup(packet);
+}
+// DXL End
+
 int _mosquitto_packet_queue(struct mosquitto *mosq, struct _mosquitto_packet *packet)
 {
     assert(mosq);
@@ -168,6 +292,12 @@ int _mosquitto_packet_queue(struct mosquitto *mosq, struct _mosquitto_packet *pa
         return 0;
     }
 
+    // DXL: Writes for connected clients are flushed by the write threads
+    if(mosq->state == mosq_cs_connected && !mosq->bridge && mosquitto_write_thread_count() > 1){
+        mosquitto_add_pending_writes_set(mosq);
+        return MOSQ_ERR_SUCCESS;
+    }
+
     return _mosquitto_packet_write(mosq);
 }
 
@@ -207,6 +337,9 @@ int _mosquitto_socket_close(struct mosquitto *mosq)
         mosq->sock = INVALID_SOCKET;
     }
 
+    // DXL: The context timer cleans up the context (or restarts the bridge)
+    mosquitto_context_timer_update(mosq, mosquitto_time_cached());
+
     return rc;
 }
 
@@ -502,6 +635,31 @@ void _mosquitto_write_bytes(struct _mosquitto_packet *packet, const void *bytes,
     packet->pos += count;
 }
 
+// DXL Begin
+uint32_t _mosquitto_payload_parts_len(const struct _mosquitto_payload_part *parts, int part_count)
+{
+    uint32_t len = 0;
+    int i;
+
+    for(i=0; i<part_count; i++){
+        len += parts[i].len;
+    }
+    return len;
+}
+
+void _mosquitto_write_payload_parts(struct _mosquitto_packet *packet,
+    const struct _mosquitto_payload_part *parts, int part_count)
+{
+    int i;
+
+    for(i=0; i<part_count; i++){
+        if(parts[i].len){
+            _mosquitto_write_bytes(packet, parts[i].data, parts[i].len);
+        }
+    }
+}
+// DXL End
+
 int _mosquitto_read_string(struct _mosquitto_packet *packet, char **str)
 {
     uint16_t len;
@@ -524,6 +682,28 @@ int _mosquitto_read_string(struct _mosquitto_packet *packet, char **str)
     return MOSQ_ERR_SUCCESS;
 }
 
+// DXL Begin
+int _mosquitto_read_string_inplace(struct _mosquitto_packet *packet, char **str)
+{
+    uint16_t len;
+    int rc;
+
+    assert(packet);
+    rc = _mosquitto_read_uint16(packet, &len);
+    if(rc) return rc;
+
+    if(packet->pos+len > packet->remaining_length) return MOSQ_ERR_PROTOCOL;
+
+    /* Shift the string over its length prefix to make room for the terminator */
+    *str = (char *)&(packet->payload[packet->pos-2]);
+    memmove(*str, &(packet->payload[packet->pos]), len);
+    (*str)[len] = '\0';
+    packet->pos += len;
+
+    return MOSQ_ERR_SUCCESS;
+}
+// DXL End
+
 void _mosquitto_write_string(struct _mosquitto_packet *packet, const char *str, uint16_t length)
 {
     assert(packet);
@@ -562,6 +742,7 @@ ssize_t _mosquitto_net_read(struct mosquitto *mosq, void *buf, size_t count)
     unsigned long e;
     assert(mosq);
     errno = 0;
+    g_net_stats.read_calls++; // DXL
     if(mosq->ssl){
         ret = SSL_read(mosq->ssl, buf, (int)count);
         if(ret <= 0){
@@ -618,8 +799,10 @@ ssize_t _mosquitto_net_write(struct mosquitto *mosq, void *buf, size_t count)
     assert(mosq);
 
     errno = 0;
+    g_net_stats.write_calls++; // DXL
     if(mosq->ssl){
         ret = SSL_write(mosq->ssl, buf, (int)count);
+        if(ret > 0) g_net_stats.bytes_written += ret; // DXL
         if(ret < 0){
             err = SSL_get_error(mosq->ssl, ret);
             if(err == SSL_ERROR_WANT_READ){
@@ -645,11 +828,159 @@ ssize_t _mosquitto_net_write(struct mosquitto *mosq, void *buf, size_t count)
         return (ssize_t )ret;
     }else{
         /* Call normal write/send */
+        ssize_t written = write(mosq->sock, buf, count);
+        if(written > 0) g_net_stats.bytes_written += written; // DXL
+        return written;
+    }
+}
+
+// DXL Begin
+/* Writes the specified buffers to the (non-TLS) context socket with a single call */
+static ssize_t _mosquitto_net_writev(struct mosquitto *mosq, const struct iovec *iov, int iovcnt)
+{
+    ssize_t written;
+    assert(mosq);
+    assert(!mosq->ssl);
+
+    errno = 0;
+    g_net_stats.write_calls++;
+    written = writev(mosq->sock, iov, iovcnt);
+    if(written > 0) g_net_stats.bytes_written += written;
+    return written;
+}
+
+/* Returns the outgoing packet that follows the specified packet */
+static inline struct _mosquitto_packet* _mosquitto_packet_write_next(
+    struct mosquitto *mosq, struct _mosquitto_packet *packet)
+{
+    /* The current packet has been removed from the queue, its next pointer is stale */
+    return (packet == mosq->current_out_packet ? mosq->out_packet : packet->next);
+}
+
+/* Fills the vector with the unwritten bytes of the outgoing packets. Returns the
+ * number of vector entries that were filled. */
+static int _mosquitto_packet_write_iov(struct mosquitto *mosq, struct iovec *iov, int iovmax)
+{
+    struct _mosquitto_packet *packet;
+    int iovcnt = 0;
+
+    for(packet = mosq->current_out_packet; packet && iovcnt < iovmax;
+        packet = _mosquitto_packet_write_next(mosq, packet)){
+        iov[iovcnt].iov_base = &(packet->payload[packet->pos]);
+        iov[iovcnt].iov_len = packet->to_process;
+        iovcnt++;
+    }
+    return iovcnt;
+}
+
+/* Copies up to count unwritten bytes of the outgoing packets into the buffer. Returns
+ * the number of bytes that were copied. */
+static uint32_t _mosquitto_packet_write_stage(struct mosquitto *mosq, uint8_t *buf, uint32_t count)
+{
+    struct _mosquitto_packet *packet;
+    uint32_t len = 0;
+    uint32_t copy_len;
+
+    for(packet = mosq->current_out_packet; packet && len < count;
+        packet = _mosquitto_packet_write_next(mosq, packet)){
+        copy_len = packet->to_process;
+        if(copy_len > count - len) copy_len = count - len;
+        memcpy(&buf[len], &(packet->payload[packet->pos]), copy_len);
+        len += copy_len;
+    }
+    return len;
+}
+
+/* Advances the outgoing packets by the number of bytes that were written, freeing
+ * the packets that have been completely written */
+static void _mosquitto_packet_write_advance(struct mosquitto *mosq, uint32_t count)
+{
+    struct _mosquitto_packet *packet;
+
+    while(mosq->current_out_packet){
+        packet = mosq->current_out_packet;
+        if(count < packet->to_process){
+            packet->to_process -= count;
+            packet->pos += count;
+            return;
+        }
+        count -= packet->to_process;
+        packet->pos += packet->to_process;
+        packet->to_process = 0;
+
+        /* Free data and reset values */
+        mosq->current_out_packet = mosq->out_packet;
+        if(mosq->out_packet){
+            mosq->out_packet = mosq->out_packet->next;
+            if(!mosq->out_packet){
+                mosq->out_packet_last = NULL;
+            }
+        }
 
-    return write(mosq->sock, buf, count);
+#ifdef PACKET_COUNT
+        mosq->packet_count--;
+#endif
+        _mosquitto_packet_cleanup(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
     }
 }
 
+/*
+ * Writes the outgoing packets of a (non-websocket) context. Rather than issuing a
+ * write per packet, the queued packets are gathered into a single writev call
+ * (plain TCP) or coalesced into a single TLS record (TLS).
+ */
+static int _mosquitto_packet_write_gather(struct mosquitto *mosq)
+{
+    /* Every byte that is staged is either written or re-staged (identically) on
+     * the retry, so a single buffer is shared by all of the contexts (per thread). */
+    static __thread uint8_t tx_buf[MOSQ_TX_BUF_SIZE];
+    struct iovec iov[MOSQ_IOV_MAX];
+    struct _mosquitto_packet *packet;
+    ssize_t write_length;
+    uint32_t staged_len;
+
+    while(mosq->current_out_packet){
+        packet = mosq->current_out_packet;
+        if(mosq->ssl){
+            if(!mosq->tls_staged_len && packet->to_process >= MOSQ_TX_BUF_SIZE){
+                /* Large packets are written directly, without being copied */
+                write_length = _mosquitto_net_write(mosq, &(packet->payload[packet->pos]), packet->to_process);
+            }else{
+                /* A retry must re-stage the same bytes; packets are only ever appended
+                 * to the queue, so the first tls_staged_len bytes are unchanged. */
+                staged_len = _mosquitto_packet_write_stage(mosq, tx_buf,
+                    mosq->tls_staged_len ? mosq->tls_staged_len : MOSQ_TX_BUF_SIZE);
+                write_length = _mosquitto_net_write(mosq, tx_buf, staged_len);
+                mosq->tls_staged_len = (write_length > 0 ? 0 : staged_len);
+            }
+        }else{
+            write_length = _mosquitto_net_writev(mosq, iov,
+                _mosquitto_packet_write_iov(mosq, iov, MOSQ_IOV_MAX));
+        }
+
+        if(write_length > 0){
+            _mosquitto_packet_write_advance(mosq, (uint32_t)write_length);
+            mosq->last_msg_out = mosquitto_time_cached();
+        }else{
+            if(errno == EAGAIN || errno == COMPAT_EWOULDBLOCK){
+                // Update context, will add EPOLLOUT if packets remain
+                mosquitto_update_context(mosq->numericId, mosq);
+                return MOSQ_ERR_SUCCESS;
+            }else{
+                switch(errno){
+                    case COMPAT_ECONNRESET:
+                        return MOSQ_ERR_CONN_LOST;
+                    default:
+                        return MOSQ_ERR_ERRNO;
+                }
+            }
+        }
+    }
+    return MOSQ_ERR_SUCCESS;
+}
+// DXL End
+
 int _mosquitto_packet_write(struct mosquitto *mosq)
 {
     ssize_t write_length;
@@ -666,59 +997,37 @@ int _mosquitto_packet_write(struct mosquitto *mosq)
         }
     }
 
+    // DXL: Socket (non-websocket) writes are gathered across the queued packets
+    if(!mosq->wsi){
+        return _mosquitto_packet_write_gather(mosq);
+    }
+
     while(mosq->current_out_packet){
         packet = mosq->current_out_packet;
 
 
         while(packet->to_process > 0){
-            if(mosq->wsi){
-                write_length = mosquitto_ws_write(mosq, &(packet->payload[packet->pos]), packet->to_process);
-            }
-            else{
-                write_length = _mosquitto_net_write(mosq, &(packet->payload[packet->pos]), packet->to_process);
-            }
+            write_length = mosquitto_ws_write(mosq, &(packet->payload[packet->pos]), packet->to_process);
 
             if(write_length > 0){
-                if(mosq->wsi) {                    
-                    // LWS will internally buffer any data that is not sent and retry sending it later.
-                    // So, advance the packet as though all data has been written.
+                // LWS will internally buffer any data that is not sent and retry sending it later.
+                // So, advance the packet as though all data has been written.
+                packet->pos += packet->to_process;
+                packet->to_process = 0;
+            }else{
+                if(write_length == 0){
+                    // LWS internally buffered the data. So, advance the packet position.
                     packet->pos += packet->to_process;
                     packet->to_process = 0;
-                }
-                else{
-                    packet->to_process -= write_length;
-                    packet->pos += write_length;
-                }
 
-            }else{                
-                if(mosq->wsi){
-                    if(write_length == 0){
-                        // LWS internally buffered the data. So, advance the packet position.
-                        packet->pos += packet->to_process;
-                        packet->to_process = 0;
-
-                        // But, LWS could not write anymore and would have requested for POLLOUT. 
-                        // Stop trying for this iteration.
-                        return MOSQ_ERR_SUCCESS;
-                    }
-                    else{
-                        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR,
-                            "[%p] lws_write failed. Return value [%d]", mosq->wsi, write_length);
-                        return MOSQ_ERR_ERRNO;
-                    }
-                }
-
-                if(errno == EAGAIN || errno == COMPAT_EWOULDBLOCK){
-                    // Update context, will add EPOLLOUT if packets remain
-                    mosquitto_update_context(mosq->numericId, mosq);
+                    // But, LWS could not write anymore and would have requested for POLLOUT. 
+                    // Stop trying for this iteration.
                     return MOSQ_ERR_SUCCESS;
-                }else{
-                    switch(errno){
-                        case COMPAT_ECONNRESET:
-                            return MOSQ_ERR_CONN_LOST;
-                        default:
-                            return MOSQ_ERR_ERRNO;
-                    }
+                }
+                else{
+                    _mosquitto_log_printf(NULL, MOSQ_LOG_ERR,
+                        "[%p] lws_write failed. Return value [%d]", mosq->wsi, write_length);
+                    return MOSQ_ERR_ERRNO;
                 }
             }
         }
@@ -737,21 +1046,76 @@ int _mosquitto_packet_write(struct mosquitto *mosq)
         mosq->packet_count--;
 #endif
         _mosquitto_packet_cleanup(packet);
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
 
-        mosq->last_msg_out = mosquitto_time();
+        mosq->last_msg_out = mosquitto_time_cached();
     }
     return MOSQ_ERR_SUCCESS;
 }
 
-int _mosquitto_packet_read(struct mosquitto_db *db, struct mosquitto *mosq,
-                           uint8_t* ws_buf, uint32_t ws_len)
+/* Handles the result of a failed read on the context socket. */
+static int _mosquitto_packet_read_error(ssize_t read_length)
 {
-    uint32_t ws_pos = 0;
-    int rc = 0;
+    if(read_length == 0) return MOSQ_ERR_CONN_LOST; /* EOF */
+    if(errno == EAGAIN || errno == COMPAT_EWOULDBLOCK){
+        return MOSQ_ERR_SUCCESS;
+    }else{
+        switch(errno){
+            case COMPAT_ECONNRESET:
+                return MOSQ_ERR_CONN_LOST;
+            default:
+                return MOSQ_ERR_ERRNO;
+        }
+    }
+}
 
-    if(!mosq) return MOSQ_ERR_INVAL;
-    if(IS_CONTEXT_INVALID(mosq)) return MOSQ_ERR_NO_CONN;
+/*
+ * DXL: Returns the receive buffer of a connection to the packet buffers
+ */
+void _mosquitto_rx_buffer_release(struct mosquitto *mosq)
+{
+    if(mosq->rx_buf){
+        /* A packet buffer holds one byte more than its length */
+        _mosquitto_packet_buffer_free(mosq->rx_buf, MOSQ_RX_BUF_SIZE - 1);
+        mosq->rx_buf = NULL;
+    }
+    mosq->rx_pos = 0;
+    mosq->rx_len = 0;
+}
+
+/*
+ * DXL: Reads socket data into the receive buffer of a connection, which is taken
+ * from the packet buffers if the connection does not hold one.
+ * Returns the result of the read (see _mosquitto_net_read).
+ */
+static ssize_t _mosquitto_rx_buffer_fill(struct mosquitto *mosq)
+{
+    ssize_t read_length;
+
+    if(!mosq->rx_buf){
+        mosq->rx_buf = _mosquitto_packet_buffer_alloc(MOSQ_RX_BUF_SIZE - 1);
+        if(!mosq->rx_buf){
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    read_length = _mosquitto_net_read(mosq, mosq->rx_buf, MOSQ_RX_BUF_SIZE);
+    if(read_length > 0){
+        mosq->rx_pos = 0;
+        mosq->rx_len = (uint32_t)read_length;
+    }
+    return read_length;
+}
+
+/*
+ * Reads and handles the packets of a connection. The bytes are taken from the
+ * buffer if one is specified, otherwise they are read from the socket.
+ * pos - The position in the buffer (updated as the bytes are consumed)
+ */
+static int _mosquitto_packet_parse(struct mosquitto_db *db, struct mosquitto *mosq,
+                                   uint8_t *buf, uint32_t len, uint32_t *pos)
+{
+    int rc = 0;
 
     do{
         uint8_t byte;
@@ -773,9 +1137,9 @@ int _mosquitto_packet_read(struct mosquitto_db *db, struct mosquitto *mosq,
          * Finally, free the memory and reset everything to starting conditions.
          */
         if(!mosq->in_packet.command){
-            if(ws_buf){
-                if(ws_pos < ws_len){
-                    byte = ws_buf[ws_pos++];
+            if(buf){
+                if(*pos < len){
+                    byte = buf[(*pos)++];
                     read_length = 1;                
                 }
                 else{
@@ -794,24 +1158,14 @@ int _mosquitto_packet_read(struct mosquitto_db *db, struct mosquitto *mosq,
                 /* Clients must send CONNECT as their first command. */
                 if(!(mosq->bridge) && mosq->state == mosq_cs_new && (byte&0xF0) != CONNECT) return MOSQ_ERR_PROTOCOL;
             }else{
-                if(read_length == 0) return MOSQ_ERR_CONN_LOST; /* EOF */
-                if(errno == EAGAIN || errno == COMPAT_EWOULDBLOCK){
-                    return MOSQ_ERR_SUCCESS;
-                }else{
-                    switch(errno){
-                        case COMPAT_ECONNRESET:
-                            return MOSQ_ERR_CONN_LOST;
-                        default:
-                            return MOSQ_ERR_ERRNO;
-                    }
-                }
+                return _mosquitto_packet_read_error(read_length);
             }
         }
         if(!mosq->in_packet.have_remaining){
             do{
-                if(ws_buf){
-                    if(ws_pos < ws_len){
-                        byte = ws_buf[ws_pos++];
+                if(buf){
+                    if(*pos < len){
+                        byte = buf[(*pos)++];
                         read_length = 1;                
                     }
                     else{
@@ -834,17 +1188,7 @@ int _mosquitto_packet_read(struct mosquitto_db *db, struct mosquitto *mosq,
                     mosq->in_packet.remaining_length += (byte & 127) * mosq->in_packet.remaining_mult;
                     mosq->in_packet.remaining_mult *= 128;
                 }else{
-                    if(read_length == 0) return MOSQ_ERR_CONN_LOST; /* EOF */
-                    if(errno == EAGAIN || errno == COMPAT_EWOULDBLOCK){
-                        return MOSQ_ERR_SUCCESS;
-                    }else{
-                        switch(errno){
-                            case COMPAT_ECONNRESET:
-                                return MOSQ_ERR_CONN_LOST;
-                            default:
-                                return MOSQ_ERR_ERRNO;
-                        }
-                    }
+                    return _mosquitto_packet_read_error(read_length);
                 }
             }while((byte & 128) != 0);
 
@@ -858,11 +1202,13 @@ int _mosquitto_packet_read(struct mosquitto_db *db, struct mosquitto *mosq,
                 dxl_update_sent_byte_count(mosq, mosq->in_packet.remaining_length)))
             {
                 mqtt3_context_disconnect(db, mosq);
+                // Do not process any remaining buffered data for the context
+                return MOSQ_ERR_SUCCESS;
             }
             // DXL End
 
             if(mosq->in_packet.remaining_length > 0){
-                mosq->in_packet.payload = (uint8_t *)_mosquitto_malloc(mosq->in_packet.remaining_length*sizeof(uint8_t));
+                mosq->in_packet.payload = _mosquitto_packet_buffer_alloc(mosq->in_packet.remaining_length); // DXL
                 if(!mosq->in_packet.payload) return MOSQ_ERR_NOMEM;
                 mosq->in_packet.to_process = mosq->in_packet.remaining_length;
             }
@@ -870,17 +1216,17 @@ int _mosquitto_packet_read(struct mosquitto_db *db, struct mosquitto *mosq,
         }
         while(mosq->in_packet.to_process>0){
 
-            if(ws_buf){
-                if(ws_pos < ws_len){
-                    if(ws_pos + mosq->in_packet.to_process < ws_len){
+            if(buf){
+                if(*pos < len){
+                    if(*pos + mosq->in_packet.to_process < len){
                         read_length = mosq->in_packet.to_process;
-                        memcpy(&(mosq->in_packet.payload[mosq->in_packet.pos]), &(ws_buf[ws_pos]), read_length);
-                        ws_pos = ws_pos + read_length;
+                        memcpy(&(mosq->in_packet.payload[mosq->in_packet.pos]), &(buf[*pos]), read_length);
+                        *pos += read_length;
                     }
                     else{
-                        read_length = ws_len - ws_pos;
-                        memcpy(&(mosq->in_packet.payload[mosq->in_packet.pos]), &(ws_buf[ws_pos]), read_length);
-                        ws_pos = ws_len;
+                        read_length = len - *pos;
+                        memcpy(&(mosq->in_packet.payload[mosq->in_packet.pos]), &(buf[*pos]), read_length);
+                        *pos = len;
                     }
                 }
                 else{
@@ -906,7 +1252,7 @@ int _mosquitto_packet_read(struct mosquitto_db *db, struct mosquitto *mosq,
                          * This is an arbitrary limit, but with some consideration.
                          * If a client can't send 1000 bytes in a second it
                          * probably shouldn't be using a 1 second keep alive. */
-                        mosq->last_msg_in = mosquitto_time();
+                        mosq->last_msg_in = mosquitto_time_cached();
                     }
                     return MOSQ_ERR_SUCCESS;
                 }else{
@@ -924,16 +1270,59 @@ int _mosquitto_packet_read(struct mosquitto_db *db, struct mosquitto *mosq,
         /* All data for this packet is read. */
         mosq->in_packet.pos = 0;
         rc = mqtt3_packet_handle(db, mosq);
+        g_net_stats.packets_read++; // DXL
 
         /* Free data and reset values */
-        _mosquitto_packet_cleanup(&mosq->in_packet);
+        _mosquitto_packet_cleanup_received(&mosq->in_packet); // DXL
 
-        mosq->last_msg_in = mosquitto_time();
+        mosq->last_msg_in = mosquitto_time_cached();
     }
-    while(ws_buf && (ws_pos < ws_len)); // For websockets, the supplied buffer can have more than one packet. 
-                                        // So, loop again for any remaining data in the buffer. 
+    // The supplied (or received) buffer can have more than one packet. 
+    // So, loop again for any remaining data in the buffer. 
+    while(buf && (*pos < len) && rc == MOSQ_ERR_SUCCESS && !IS_CONTEXT_INVALID(mosq));
 
-    if(mosq->ssl){
+    return rc;
+}
+
+int _mosquitto_packet_read(struct mosquitto_db *db, struct mosquitto *mosq,
+                           uint8_t* ws_buf, uint32_t ws_len)
+{
+    uint32_t pos = 0;
+    int rc;
+
+    if(!mosq) return MOSQ_ERR_INVAL;
+    if(IS_CONTEXT_INVALID(mosq)) return MOSQ_ERR_NO_CONN;
+
+    /* DXL: Once the CONNECT has been handled, perform a single large read per
+     * readiness event into the receive buffer of the connection, and parse as
+     * many packets as it holds. Until then, only the bytes of the current packet
+     * are read, since handling the CONNECT may hand the socket over to an existing
+     * context with the same client id. Payloads that exceed the buffer are read
+     * directly into the packet. The receive buffer is returned to the packet
+     * buffers once it has been consumed, so idle connections do not hold one. */
+    if(ws_buf){
+        rc = _mosquitto_packet_parse(db, mosq, ws_buf, ws_len, &pos);
+    }else if(mosq->rx_pos < mosq->rx_len ||
+        (mosq->state != mosq_cs_new &&
+        !(mosq->in_packet.have_remaining && mosq->in_packet.to_process >= MOSQ_RX_BUF_SIZE))){
+        if(mosq->rx_pos == mosq->rx_len){
+            ssize_t read_length = _mosquitto_rx_buffer_fill(mosq);
+            if(read_length <= 0){
+                _mosquitto_rx_buffer_release(mosq);
+                return _mosquitto_packet_read_error(read_length);
+            }
+        }
+        pos = mosq->rx_pos;
+        rc = _mosquitto_packet_parse(db, mosq, mosq->rx_buf, mosq->rx_len, &pos);
+        mosq->rx_pos = pos;
+        if(mosq->rx_pos == mosq->rx_len){
+            _mosquitto_rx_buffer_release(mosq);
+        }
+    }else{
+        rc = _mosquitto_packet_parse(db, mosq, NULL, 0, &pos);
+    }
+
+    if(rc == MOSQ_ERR_SUCCESS && !IS_CONTEXT_INVALID(mosq) && mosq->ssl){
         int pending = SSL_pending(mosq->ssl);
         if(pending > 0){
             mosquitto_add_pending_bytes_set(mosq);
@@ -45,6 +45,30 @@ struct mosquitto_db;
 #define INVALID_SOCKET -1
 #endif
 
+/* DXL: The size of the buffer used to receive socket data in bulk */
+#define MOSQ_RX_BUF_SIZE 16384
+
+/* DXL: The size of the buffer used to coalesce outgoing packets into a single
+ * TLS write (the maximum TLS record payload size) */
+#define MOSQ_TX_BUF_SIZE 16384
+
+/* DXL: The maximum number of packets gathered into a single writev call */
+#define MOSQ_IOV_MAX 64
+
+/* DXL: Network statistics (per thread, the write thread statistics are merged
+ * into those of the main thread after each flush) */
+struct _mosquitto_net_stats {
+    /* The number of socket read calls (read/SSL_read) */
+    uint64_t read_calls;
+    /* The number of packets read */
+    uint64_t packets_read;
+    /* The number of socket write calls (write/writev/SSL_write) */
+    uint64_t write_calls;
+    /* The number of bytes written */
+    uint64_t bytes_written;
+};
+extern __thread struct _mosquitto_net_stats g_net_stats;
+
 /* Macros for accessing the MSB and LSB of a uint16_t */
 #define MOSQ_MSB(A) (uint8_t)((A & 0xFF00) >> 8)
 #define MOSQ_LSB(A) (uint8_t)(A & 0x00FF)
@@ -53,11 +77,23 @@ void _mosquitto_net_init(void);
 void _mosquitto_net_cleanup(void);
 
 /* DXL begin */
+void _mosquitto_net_thread_init(void);
 int _mosquitto_fips_enable(int mode);
 const char *_mosquitto_ssl_version();
 /* DXL end */
 
 void _mosquitto_packet_cleanup(struct _mosquitto_packet *packet);
+// DXL Begin
+// Received packet buffers. A buffer holds the packet length plus one byte, so that the
+// payload at the end of the packet can be null-terminated in place. Small buffers are
+// recycled through bounded per-thread free lists rather than returned to the heap.
+uint8_t *_mosquitto_packet_buffer_alloc(uint32_t len);
+void _mosquitto_packet_buffer_free(uint8_t *buffer, uint32_t len);
+// Resets a received packet, returning its payload to the packet buffers
+void _mosquitto_packet_cleanup_received(struct _mosquitto_packet *packet);
+// Returns the receive buffer of a connection (and any bytes it holds) to the packet buffers
+void _mosquitto_rx_buffer_release(struct mosquitto *mosq);
+// DXL End
 int _mosquitto_packet_queue(struct mosquitto *mosq, struct _mosquitto_packet *packet);
 int _mosquitto_socket_connect(struct mosquitto *mosq, const char *host, uint16_t port,
     const char *bind_address, bool blocking);
@@ -70,12 +106,21 @@ int _mosquitto_socketpair(int *sp1, int *sp2);
 int _mosquitto_read_byte(struct _mosquitto_packet *packet, uint8_t *byte);
 int _mosquitto_read_bytes(struct _mosquitto_packet *packet, void *bytes, uint32_t count);
 int _mosquitto_read_string(struct _mosquitto_packet *packet, char **str);
+// DXL: Reads a string without copying it. The string is terminated in place within
+// the packet payload (overwriting its length prefix) and is valid for the lifetime
+// of the payload.
+int _mosquitto_read_string_inplace(struct _mosquitto_packet *packet, char **str);
 int _mosquitto_read_uint16(struct _mosquitto_packet *packet, uint16_t *word);
 
 void _mosquitto_write_byte(struct _mosquitto_packet *packet, uint8_t byte);
 void _mosquitto_write_bytes(struct _mosquitto_packet *packet, const void *bytes, uint32_t count);
 void _mosquitto_write_string(struct _mosquitto_packet *packet, const char *str, uint16_t length);
 void _mosquitto_write_uint16(struct _mosquitto_packet *packet, uint16_t word);
+// DXL Begin
+uint32_t _mosquitto_payload_parts_len(const struct _mosquitto_payload_part *parts, int part_count);
+void _mosquitto_write_payload_parts(struct _mosquitto_packet *packet,
+    const struct _mosquitto_payload_part *parts, int part_count);
+// DXL End
 
 ssize_t _mosquitto_net_read(struct mosquitto *mosq, void *buf, size_t count);
 ssize_t _mosquitto_net_write(struct mosquitto *mosq, void *buf, size_t count);
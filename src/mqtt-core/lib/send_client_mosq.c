@@ -52,7 +52,7 @@ int _mosquitto_send_connect(struct mosquitto *mosq, uint16_t keepalive, bool cle
     assert(mosq);
     assert(mosq->id);
 
-    packet = (_mosquitto_packet *)_mosquitto_calloc(1, sizeof(struct _mosquitto_packet));
+    packet = (_mosquitto_packet *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_packet));
     if(!packet) return MOSQ_ERR_NOMEM;
 
     payloadlen = (int)(2 + strlen(mosq->id));
@@ -68,7 +68,7 @@ int _mosquitto_send_connect(struct mosquitto *mosq, uint16_t keepalive, bool cle
     if(mosq->wsi) packet->is_ws_packet = 1;
     rc = _mosquitto_packet_alloc(packet);
     if(rc){
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
         return rc;
     }
 
@@ -118,7 +118,7 @@ int _mosquitto_send_subscribe(struct mosquitto *mosq, int *mid, bool dup, const
     assert(mosq);
     assert(topic);
 
-    packet = (_mosquitto_packet *)_mosquitto_calloc(1, sizeof(struct _mosquitto_packet));
+    packet = (_mosquitto_packet *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_packet));
     if(!packet) return MOSQ_ERR_NOMEM;
 
     packetlen = (uint32_t)(2 + 2+strlen(topic) + 1);
@@ -128,7 +128,7 @@ int _mosquitto_send_subscribe(struct mosquitto *mosq, int *mid, bool dup, const
     if(mosq->wsi) packet->is_ws_packet = 1;
     rc = _mosquitto_packet_alloc(packet);
     if(rc){
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
         return rc;
     }
 
@@ -160,7 +160,7 @@ int _mosquitto_send_unsubscribe(struct mosquitto *mosq, int *mid, bool dup, cons
     assert(mosq);
     assert(topic);
 
-    packet = (_mosquitto_packet *)_mosquitto_calloc(1, sizeof(struct _mosquitto_packet));
+    packet = (_mosquitto_packet *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_packet));
     if(!packet) return MOSQ_ERR_NOMEM;
 
     packetlen = (uint32_t)(2 + 2+strlen(topic));
@@ -170,7 +170,7 @@ int _mosquitto_send_unsubscribe(struct mosquitto *mosq, int *mid, bool dup, cons
     if(mosq->wsi) packet->is_ws_packet = 1;
     rc = _mosquitto_packet_alloc(packet);
     if(rc){
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
         return rc;
     }
 
@@ -51,7 +51,7 @@ int _mosquitto_send_pingreq(struct mosquitto *mosq)
         _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG, "Sending PINGREQ to %s", mosq->id);
     rc = _mosquitto_send_simple_command(mosq, PINGREQ);
     if(rc == MOSQ_ERR_SUCCESS){
-        mosq->ping_t = mosquitto_time();
+        mosq->ping_t = mosquitto_time_cached();
     }
     return rc;
 }
@@ -81,10 +81,11 @@ int _mosquitto_send_pubcomp(struct mosquitto *mosq, uint16_t mid)
 }
 
 int _mosquitto_send_publish(struct mosquitto *mosq, uint16_t mid, const char *topic,
-    uint32_t payloadlen, const void *payload, int qos, bool retain, bool dup)
+    const struct _mosquitto_payload_part *parts, int part_count, int qos, bool retain, bool dup) // DXL
 {
     size_t len;
     int i;
+    uint32_t payloadlen = _mosquitto_payload_parts_len(parts, part_count); // DXL
     struct _mqtt3_bridge_topic *cur_topic;
     bool match;
     int rc;
@@ -137,7 +138,7 @@ int _mosquitto_send_publish(struct mosquitto *mosq, uint16_t mid, const char *to
                         _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG,
                             "Sending PUBLISH to %s (d%d, q%d, r%d, m%d, '%s', ... (%ld bytes))",
                             mosq->id, dup, qos, retain, mid, mapped_topic, (long)payloadlen);
-                    rc =  _mosquitto_send_real_publish(mosq, mid, mapped_topic, payloadlen, payload, qos, retain, dup);
+                    rc =  _mosquitto_send_real_publish(mosq, mid, mapped_topic, parts, part_count, qos, retain, dup); // DXL
                     _mosquitto_free(mapped_topic);
                     return rc;
                 }
@@ -149,7 +150,7 @@ int _mosquitto_send_publish(struct mosquitto *mosq, uint16_t mid, const char *to
             "Sending PUBLISH to %s (d%d, q%d, r%d, m%d, '%s', ... (%ld bytes))",
             mosq->id, dup, qos, retain, mid, topic, (long)payloadlen);
 
-    return _mosquitto_send_real_publish(mosq, mid, topic, payloadlen, payload, qos, retain, dup);
+    return _mosquitto_send_real_publish(mosq, mid, topic, parts, part_count, qos, retain, dup); // DXL
 }
 
 int _mosquitto_send_pubrec(struct mosquitto *mosq, uint16_t mid)
@@ -175,7 +176,7 @@ int _mosquitto_send_command_with_mid(struct mosquitto *mosq, uint8_t command, ui
     int rc;
 
     assert(mosq);
-    packet = (_mosquitto_packet *)_mosquitto_calloc(1, sizeof(struct _mosquitto_packet));
+    packet = (_mosquitto_packet *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_packet));
     if(!packet) return MOSQ_ERR_NOMEM;
 
     packet->command = command;
@@ -186,7 +187,7 @@ int _mosquitto_send_command_with_mid(struct mosquitto *mosq, uint8_t command, ui
     if(mosq->wsi) packet->is_ws_packet = 1;
     rc = _mosquitto_packet_alloc(packet);
     if(rc){
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
         return rc;
     }
 
@@ -203,7 +204,7 @@ int _mosquitto_send_simple_command(struct mosquitto *mosq, uint8_t command)
     int rc;
 
     assert(mosq);
-    packet = (_mosquitto_packet *)_mosquitto_calloc(1, sizeof(struct _mosquitto_packet));
+    packet = (_mosquitto_packet *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_packet));
     if(!packet) return MOSQ_ERR_NOMEM;
 
     packet->command = command;
@@ -212,7 +213,7 @@ int _mosquitto_send_simple_command(struct mosquitto *mosq, uint8_t command)
     if(mosq->wsi) packet->is_ws_packet = 1;
     rc = _mosquitto_packet_alloc(packet);
     if(rc){
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
         return rc;
     }
 
@@ -220,7 +221,7 @@ int _mosquitto_send_simple_command(struct mosquitto *mosq, uint8_t command)
 }
 
 int _mosquitto_send_real_publish(struct mosquitto *mosq, uint16_t mid, const char *topic,
-    uint32_t payloadlen, const void *payload, int qos, bool retain, bool dup)
+    const struct _mosquitto_payload_part *parts, int part_count, int qos, bool retain, bool dup) // DXL
 {
     struct _mosquitto_packet *packet = NULL;
     int packetlen;
@@ -229,9 +230,9 @@ int _mosquitto_send_real_publish(struct mosquitto *mosq, uint16_t mid, const cha
     assert(mosq);
     assert(topic);
 
-    packetlen = (int)(2+strlen(topic) + payloadlen);
+    packetlen = (int)(2+strlen(topic) + _mosquitto_payload_parts_len(parts, part_count)); // DXL
     if(qos > 0) packetlen += 2; /* For message id */
-    packet = (_mosquitto_packet *)_mosquitto_calloc(1, sizeof(struct _mosquitto_packet));
+    packet = (_mosquitto_packet *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_packet));
     if(!packet) return MOSQ_ERR_NOMEM;
 
     packet->mid = mid;
@@ -240,7 +241,7 @@ int _mosquitto_send_real_publish(struct mosquitto *mosq, uint16_t mid, const cha
     if(mosq->wsi) packet->is_ws_packet = 1;
     rc = _mosquitto_packet_alloc(packet);
     if(rc){
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
         return rc;
     }
     /* Variable header (topic string) */
@@ -250,9 +251,71 @@ int _mosquitto_send_real_publish(struct mosquitto *mosq, uint16_t mid, const cha
     }
 
     /* Payload */
-    if(payloadlen){
-        _mosquitto_write_bytes(packet, payload, payloadlen);
+    _mosquitto_write_payload_parts(packet, parts, part_count); // DXL
+
+    return _mosquitto_packet_queue(mosq, packet);
+}
+
+// DXL Begin
+/* Creates a shared QoS 0 PUBLISH frame (no message id, retain and dup clear).
+ * The frame is returned with a reference count of one. */
+struct _mosquitto_frame *_mosquitto_frame_publish_create(const char *topic,
+    const struct _mosquitto_payload_part *parts, int part_count)
+{
+    struct _mosquitto_packet packet;
+    struct _mosquitto_frame *frame;
+
+    assert(topic);
+
+    memset(&packet, 0, sizeof(struct _mosquitto_packet));
+    packet.command = PUBLISH;
+    packet.remaining_length = (uint32_t)(2+strlen(topic) + _mosquitto_payload_parts_len(parts, part_count));
+    if(_mosquitto_packet_alloc(&packet)){
+        return NULL;
+    }
+    _mosquitto_write_string(&packet, topic, (uint16_t)strlen(topic));
+    _mosquitto_write_payload_parts(&packet, parts, part_count);
+
+    frame = (struct _mosquitto_frame *)_mosquitto_malloc(sizeof(struct _mosquitto_frame));
+    if(!frame){
+        _mosquitto_free(packet.payload);
+        return NULL;
+    }
+    frame->ref_count = 1;
+    frame->length = packet.packet_length;
+    frame->data = packet.payload;
+
+    return frame;
+}
+
+void _mosquitto_frame_release(struct _mosquitto_frame *frame)
+{
+    /* Packets that refer to the frame may be released by the write threads */
+    if(frame && __sync_sub_and_fetch(&frame->ref_count, 1) == 0){
+        _mosquitto_free(frame->data);
+        _mosquitto_free(frame);
     }
+}
+
+/* Queues a packet that refers to the specified shared frame. Not valid for
+ * websocket contexts, which require a pre-buffer region per packet. */
+int _mosquitto_send_frame(struct mosquitto *mosq, struct _mosquitto_frame *frame)
+{
+    struct _mosquitto_packet *packet = NULL;
+
+    assert(mosq);
+    assert(frame);
+    assert(!mosq->wsi);
+
+    packet = (_mosquitto_packet *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_packet));
+    if(!packet) return MOSQ_ERR_NOMEM;
+
+    __sync_add_and_fetch(&frame->ref_count, 1);
+    packet->frame = frame;
+    packet->payload = frame->data;
+    packet->command = frame->data[0];
+    packet->packet_length = frame->length;
 
     return _mosquitto_packet_queue(mosq, packet);
 }
+// DXL End
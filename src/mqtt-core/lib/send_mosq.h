@@ -33,8 +33,14 @@ POSSIBILITY OF SUCH DAMAGE.
 
 int _mosquitto_send_simple_command(struct mosquitto *mosq, uint8_t command);
 int _mosquitto_send_command_with_mid(struct mosquitto *mosq, uint8_t command, uint16_t mid, bool dup);
-int _mosquitto_send_real_publish(struct mosquitto *mosq, uint16_t mid, const char *topic, uint32_t payloadlen,
-    const void *payload, int qos, bool retain, bool dup);
+int _mosquitto_send_real_publish(struct mosquitto *mosq, uint16_t mid, const char *topic,
+    const struct _mosquitto_payload_part *parts, int part_count, int qos, bool retain, bool dup); // DXL
+// DXL Begin
+struct _mosquitto_frame *_mosquitto_frame_publish_create(const char *topic,
+    const struct _mosquitto_payload_part *parts, int part_count);
+void _mosquitto_frame_release(struct _mosquitto_frame *frame);
+int _mosquitto_send_frame(struct mosquitto *mosq, struct _mosquitto_frame *frame);
+// DXL End
 
 int _mosquitto_send_connect(struct mosquitto *mosq, uint16_t keepalive, bool clean_session);
 int _mosquitto_send_disconnect(struct mosquitto *mosq);
@@ -42,8 +48,8 @@ int _mosquitto_send_pingreq(struct mosquitto *mosq);
 int _mosquitto_send_pingresp(struct mosquitto *mosq);
 int _mosquitto_send_puback(struct mosquitto *mosq, uint16_t mid);
 int _mosquitto_send_pubcomp(struct mosquitto *mosq, uint16_t mid);
-int _mosquitto_send_publish(struct mosquitto *mosq, uint16_t mid, const char *topic, uint32_t payloadlen,
-    const void *payload, int qos, bool retain, bool dup);
+int _mosquitto_send_publish(struct mosquitto *mosq, uint16_t mid, const char *topic,
+    const struct _mosquitto_payload_part *parts, int part_count, int qos, bool retain, bool dup); // DXL
 int _mosquitto_send_pubrec(struct mosquitto *mosq, uint16_t mid);
 int _mosquitto_send_pubrel(struct mosquitto *mosq, uint16_t mid, bool dup);
 int _mosquitto_send_subscribe(struct mosquitto *mosq, int *mid, bool dup, const char *topic, uint8_t topic_qos);
@@ -64,3 +64,17 @@ time_t mosquitto_time(void)
 #endif
 }
 
+// DXL Begin
+/* The time cached by the main loop */
+static time_t cached_time = 0;
+
+void mosquitto_time_update(void)
+{
+    cached_time = mosquitto_time();
+}
+
+time_t mosquitto_time_cached(void)
+{
+    return cached_time ? cached_time : mosquitto_time();
+}
+// DXL End
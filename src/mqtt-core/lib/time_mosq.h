@@ -32,4 +32,14 @@ POSSIBILITY OF SUCH DAMAGE.
 
 time_t mosquitto_time(void);
 
+// DXL Begin
+/* Caches the current time. This is invoked by the main loop once per iteration
+ * so that the per-message and per-packet time stamps do not read the clock. */
+void mosquitto_time_update(void);
+/* Returns the time cached by the last call to mosquitto_time_update(). This must
+ * only be used by the main loop (and the write threads it waits on); other threads
+ * should use mosquitto_time(). */
+time_t mosquitto_time_cached(void);
+// DXL End
+
 #endif
@@ -97,7 +97,7 @@ void _mosquitto_check_keepalive(struct mosquitto *mosq)
 {
     time_t last_msg_out;
     time_t last_msg_in;
-    time_t now = mosquitto_time();
+    time_t now = mosquitto_time_cached();
 
     assert(mosq);
     /* Check if a lazy bridge should be timed out due to idle. */
@@ -140,6 +140,7 @@ int mqtt3_bridge_new(struct mosquitto_db *db, struct _mqtt3_bridge *bridge)
         // DXL Begin
         new_context->numericId = null_index;
         new_context->db_index = null_index;
+        mosquitto_context_timer_start(new_context);
         // DXL End
     }else{
         /* id was found, so context->id already in memory. */
@@ -172,8 +173,8 @@ int mqtt3_bridge_connect(struct mosquitto_db *db, struct mosquitto *context)
 
     context->state = mosq_cs_new;
     context->sock = -1;
-    context->last_msg_in = mosquitto_time();
-    context->last_msg_out = mosquitto_time();
+    context->last_msg_in = mosquitto_time_cached();
+    context->last_msg_out = mosquitto_time_cached();
     context->keepalive = default_bridge_keepalive; // DXL
     context->clean_session = context->bridge->clean_session;
     context->in_packet.payload = NULL;
@@ -193,11 +194,7 @@ int mqtt3_bridge_connect(struct mosquitto_db *db, struct mosquitto *context)
      * anyway. This means any unwanted subs will be removed.
      */
 
-    // DXL Begin
-    context->clean_subs = true;
-    mqtt3_subs_clean_session(db, &db->subs);
-    context->clean_subs = false;
-    // DXL End
+    mqtt3_subs_clean_context(db, context); // DXL
 
     for(i=0; i<context->bridge->topic_count; i++){
         if(context->bridge->topics[i].direction == bd_out || context->bridge->topics[i].direction == bd_both){
@@ -258,18 +255,20 @@ void mqtt3_bridge_packet_cleanup(struct mosquitto *context)
     if(!context) return;
 
     _mosquitto_packet_cleanup(context->current_out_packet);
-    _mosquitto_free(context->current_out_packet); // DXL
+    _mosquitto_pool_free(context->current_out_packet, sizeof(struct _mosquitto_packet)); // DXL
     context->current_out_packet = NULL; //DXL
     while(context->out_packet){
         _mosquitto_packet_cleanup(context->out_packet);
         packet = context->out_packet;
         context->out_packet = context->out_packet->next;
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
     }
+    context->tls_staged_len = 0; // DXL
 
 #ifdef PACKET_COUNT
     context->packet_count = 0;
 #endif
 
-    _mosquitto_packet_cleanup(&(context->in_packet));
+    _mosquitto_packet_cleanup_received(&(context->in_packet)); // DXL
+    _mosquitto_rx_buffer_release(context); // DXL
 }
@@ -133,7 +133,6 @@ static void _config_init_reload(struct mqtt3_config *config)
     config->log_timestamp = true;
     config->queue_qos0_messages = false;
     config->retry_interval = 20;
-    config->store_clean_interval = 10;
     config->upgrade_outgoing_qos = false;
 }
 
@@ -157,6 +156,11 @@ void mqtt3_config_init(struct mqtt3_config *config)
     config->default_listener.ciphers = NULL;
     config->default_listener.require_certificate = false;
     config->default_listener.crlfile = NULL;
+    // DXL Begin
+    config->default_listener.tls_session_cache_size = 0;
+    config->default_listener.tls_session_tickets = false;
+    config->default_listener.tls_session_timeout = 0;
+    // DXL End
     config->listeners = NULL;
     config->listener_count = 0;
     config->pid_file = NULL;
@@ -358,6 +362,11 @@ int mqtt3_config_parse_args(struct mqtt3_config *config, int argc, char *argv[])
         config->listeners[config->listener_count-1].require_certificate = config->default_listener.require_certificate;
         config->listeners[config->listener_count-1].ssl_ctx = NULL;
         config->listeners[config->listener_count-1].crlfile = config->default_listener.crlfile;
+        // DXL Begin
+        config->listeners[config->listener_count-1].tls_session_cache_size = config->default_listener.tls_session_cache_size;
+        config->listeners[config->listener_count-1].tls_session_tickets = config->default_listener.tls_session_tickets;
+        config->listeners[config->listener_count-1].tls_session_timeout = config->default_listener.tls_session_timeout;
+        // DXL End
     }
 
     /* Default to drop to mosquitto user if we are privileged and no user specified. */
@@ -917,13 +926,13 @@ int _config_read_file(struct mqtt3_config *config, bool reload, const char *file
                         return MOSQ_ERR_INVAL;
                     }
                 }else if(!strcmp(token, "store_clean_interval")){
-                    if(_conf_parse_int(&token, "store_clean_interval", &config->store_clean_interval, saveptr))
+                    // DXL: Deprecated, stored messages are freed when their last reference is released
+                    int store_clean_interval;
+                    if(_conf_parse_int(&token, "store_clean_interval", &store_clean_interval, saveptr))
                         return MOSQ_ERR_INVAL;
-                    if(config->store_clean_interval < 0 || config->store_clean_interval > 65535){
-                        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR,
-                            "Error: Invalid store_clean_interval value (%d).", config->store_clean_interval);
-                        return MOSQ_ERR_INVAL;
-                    }
+                    if(IS_WARNING_ENABLED)
+                        _mosquitto_log_printf(NULL, MOSQ_LOG_WARNING,
+                            "Warning: store_clean_interval is deprecated and has no effect.");
                 }else if(!strcmp(token, "threshold")){
                     if(reload) continue; // FIXME
                     if(!cur_bridge){
@@ -1239,6 +1248,21 @@ struct cert_hashes* s_brokerCerts = NULL;
     return MOSQ_ERR_SUCCESS;
 }
 
+int mqtt3_config_update_tls_sessions(
+    struct mqtt3_config *config,
+    int sessionCacheSize,
+    bool sessionTicketsEnabled,
+    int sessionTimeout)
+{
+    for(int i = 0; i < config->listener_count; i++){
+        config->listeners[i].tls_session_cache_size = sessionCacheSize;
+        config->listeners[i].tls_session_tickets = sessionTicketsEnabled;
+        config->listeners[i].tls_session_timeout = sessionTimeout;
+    }
+
+    return MOSQ_ERR_SUCCESS;
+}
+
 bool mqtt3_config_is_broker_cert(const char* certSha1)
 {
     if(!s_brokerCerts) return false;
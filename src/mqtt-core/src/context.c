@@ -49,14 +49,15 @@ struct mosquitto *mqtt3_context_init(int sock)
     
     context->state = mosq_cs_new;
     context->sock = sock;    
-    context->last_msg_in = mosquitto_time();
-    context->last_msg_out = mosquitto_time();
+    context->last_msg_in = mosquitto_time_cached();
+    context->last_msg_out = mosquitto_time_cached();
     context->keepalive = 60; /* Default to 60s */
     context->clean_session = true;
     context->disconnect_t = 0;
     context->id = NULL;
     context->canonical_id = NULL; // DXL
     context->cert_chain = NULL; // DXL
+    context->dxl_message_source = NULL; // DXL
     context->last_mid = 0;
     context->will = NULL;
     context->listener = NULL;
@@ -94,13 +95,18 @@ struct mosquitto *mqtt3_context_init(int sock)
     context->tls_certtype = unknown;
     context->numericId = 0;
     context->clean_subs = false;
+    context->clean_subs_index = 0;
     context->pending_bytes = false;
+    context->pending_write = false;
     context->dxl_client_guid = NULL;
     context->dxl_tenant_guid = NULL;
+    memset(&context->dxl_guid_ids, 0, sizeof(struct guid_ids));
     context->cert_hashes = NULL;
     context->epoll_events = 0; // EPOLL
     context->dxl_flags = 0;
     context->subscription_count = 0;
+    context->tls_staged_len = 0;
+    context->subs = NULL;
     // DXL End
     context->wsi = NULL;
     context->ws_sock = INVALID_SOCKET;
@@ -146,9 +152,7 @@ void mqtt3_context_cleanup(struct mosquitto_db *db, struct mosquitto *context, b
     if(context->clean_session && db){
         // DXL Begin
         if(clean_subs){
-            context->clean_subs = true;
-            mqtt3_subs_clean_session(db, &db->subs);
-            context->clean_subs = false;
+            mqtt3_subs_clean_context(db, context);
         }
         // DXL End
         mqtt3_db_messages_delete(context);
@@ -188,6 +192,12 @@ void mqtt3_context_cleanup(struct mosquitto_db *db, struct mosquitto *context, b
         _mosquitto_free(context->cert_chain);
         context->cert_chain = NULL;
     }
+    if(context->dxl_message_source){
+        dxl_release_message_source(context);
+    }
+    if(context->dxl_guid_ids.id){
+        dxl_release_guid_ids(context);
+    }
     if(context->dxl_client_guid){
         _mosquitto_free(context->dxl_client_guid);
         context->dxl_client_guid = NULL;
@@ -198,17 +208,20 @@ void mqtt3_context_cleanup(struct mosquitto_db *db, struct mosquitto *context, b
     }
     mqtt3_context_cleanup_certs(context);
     mosquitto_remove_pending_bytes_set(context);
+    mosquitto_remove_pending_writes_set(context);
     // DXL end
-    _mosquitto_packet_cleanup(&(context->in_packet));
+    _mosquitto_packet_cleanup_received(&(context->in_packet)); // DXL
+    _mosquitto_rx_buffer_release(context); // DXL
     _mosquitto_packet_cleanup(context->current_out_packet);
-    _mosquitto_free(context->current_out_packet); // DXL
+    _mosquitto_pool_free(context->current_out_packet, sizeof(struct _mosquitto_packet)); // DXL
     context->current_out_packet = NULL;
     while(context->out_packet){
         _mosquitto_packet_cleanup(context->out_packet);
         packet = context->out_packet;
         context->out_packet = context->out_packet->next;
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
     }
+    context->tls_staged_len = 0; // DXL
     if(context->will){
         if(context->will->topic) _mosquitto_free(context->will->topic);
         if(context->will->payload) _mosquitto_free(context->will->payload);
@@ -219,8 +232,8 @@ void mqtt3_context_cleanup(struct mosquitto_db *db, struct mosquitto *context, b
         msg = context->msgs;
         while(msg){
             next = msg->next;
-            msg->store->ref_count--;
-            _mosquitto_free(msg);
+            mqtt3_db_msg_store_ref_dec(msg->store); // DXL
+            _mosquitto_pool_free(msg, sizeof(struct mosquitto_client_msg)); // DXL
             msg = next;
         }
         context->msgs = NULL;
@@ -235,6 +248,7 @@ void mqtt3_context_cleanup(struct mosquitto_db *db, struct mosquitto *context, b
 #endif
     }
     if(do_free){
+        mosquitto_timer_cancel(&context->timer); // DXL
         context->wsi = NULL;
         context->ws_sock = INVALID_SOCKET;
         _mosquitto_free(context);
@@ -269,7 +283,7 @@ void mqtt3_context_disconnect(struct mosquitto_db *db, struct mosquitto *ctxt)
         }
         ctxt->listener = NULL;
     }
-    ctxt->disconnect_t = mosquitto_time();
+    ctxt->disconnect_t = mosquitto_time_cached();
 
     // DXL: Remove the context explicitly
     mosquitto_remove_context(ctxt);
@@ -162,6 +162,7 @@ int mqtt3_db_add_new_context(struct mosquitto_db* db, struct mosquitto* new_cont
     }
     // If we got here then the context's DB index is "i" regardless of how we got here
     new_context->db_index = i;
+    mosquitto_context_timer_start(new_context); // DXL
 
     return 0;
 }
@@ -169,7 +170,6 @@ int mqtt3_db_add_new_context(struct mosquitto_db* db, struct mosquitto* new_cont
 int mqtt3_db_open(struct mqtt3_config *config, struct mosquitto_db *db)
 {
     int rc = 0;
-    struct _mosquitto_subhier *child;
 
     if(!config || !db) return MOSQ_ERR_INVAL;
 
@@ -184,96 +184,20 @@ int mqtt3_db_open(struct mqtt3_config *config, struct mosquitto_db *db)
     // Initialize the hashtable
     db->clientid_index_hash = NULL;
 
-    db->subs.next = NULL;
-    db->subs.subs = NULL;
-    db->subs.topic = _mosquitto_strdup(""); // DXL
-    // Search OPT Begin
-    db->subs.children_hash_table = NULL;
-    db->subs.hash_table_has_pound_wild_card = 0;
-    db->subs.hash_table_has_plus_wild_card = 0;
-    // Search OPT End
-
-    child = (struct _mosquitto_subhier *)_mosquitto_malloc(sizeof(struct _mosquitto_subhier));
-    if(!child){
-        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Out of memory.");
-        return MOSQ_ERR_NOMEM;
-    }
-    child->next = NULL;
-    child->topic = _mosquitto_strdup("");
-    if(!child->topic){
-        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Out of memory.");
-        return MOSQ_ERR_NOMEM;
-    }
-    child->subs = NULL;
-    child->children = NULL;
-    child->retained = NULL;
-    db->subs.children = child;
-    // Search OPT Begin
-    child->children_hash_table = NULL;
-    child->hash_table_has_pound_wild_card = 0;
-    child->hash_table_has_plus_wild_card = 0;
-    add_heir_to_hash(&db->subs.children_hash_table, "", child);
-    // Search OPT End
-
-    child = (struct _mosquitto_subhier *)_mosquitto_malloc(sizeof(struct _mosquitto_subhier));
-    if(!child){
-        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Out of memory.");
-        return MOSQ_ERR_NOMEM;
-    }
-    child->next = NULL;
-    child->topic = _mosquitto_strdup("$SYS");
-    if(!child->topic){
+    // DXL Begin
+    rc = mqtt3_subs_open(db);
+    if(rc){
         _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Out of memory.");
-        return MOSQ_ERR_NOMEM;
+        return rc;
     }
-    child->subs = NULL;
-    child->children = NULL;
-    child->retained = NULL;
-    db->subs.children->next = child;
-    // Search OPT Begin
-    child->children_hash_table = NULL;
-    child->hash_table_has_pound_wild_card = 0;
-    child->hash_table_has_plus_wild_card = 0;
-    add_heir_to_hash(&db->subs.children_hash_table, "$SYS", child);
-    // Search OPT End
+    // DXL End
 
     return rc;
 }
 
-static void subhier_clean(struct _mosquitto_subhier *subhier)
-{
-    struct _mosquitto_subhier *next;
-    struct _mosquitto_subleaf *leaf, *nextleaf;
-
-    while(subhier){
-        next = subhier->next;
-        leaf = subhier->subs;
-        while(leaf){
-            nextleaf = leaf->next;
-            _mosquitto_free(leaf);
-            leaf = nextleaf;
-        }
-        if(subhier->retained){
-            subhier->retained->ref_count--;
-        }
-        // Search OPT Begin
-        clear_hash_table(&subhier->children_hash_table);
-        // Search OPT End
-        subhier_clean(subhier->children);
-        if(subhier->topic) _mosquitto_free(subhier->topic);
-
-        _mosquitto_free(subhier);
-        subhier = next;
-    }
-}
-
-
 int mqtt3_db_close(struct mosquitto_db *db)
 {
-    subhier_clean(db->subs.children);
-    // Search OPT Begin
-    clear_hash_table(&db->subs.children_hash_table);
-    // Search OPT End
+    mqtt3_subs_close(db); // DXL
     mqtt3_db_store_clean(db);
 
     return MOSQ_ERR_SUCCESS;
@@ -311,8 +235,7 @@ static void _message_remove(struct mosquitto *context, struct mosquitto_client_m
         return;
     }
 
-    /* FIXME - it would be nice to be able to remove the stored message here if ref_count==0 */
-    (*msg)->store->ref_count--;
+    mqtt3_db_msg_store_ref_dec((*msg)->store); // DXL
     if(last){
         last->next = (*msg)->next;
         if(!last->next){
@@ -328,7 +251,7 @@ static void _message_remove(struct mosquitto *context, struct mosquitto_client_m
     if((*msg)->qos > 0){
         context->msg_count12--;
     }
-    _mosquitto_free(*msg);
+    _mosquitto_pool_free(*msg, sizeof(struct mosquitto_client_msg)); // DXL
     if(last){
         *msg = last->next;
     }else{
@@ -348,7 +271,7 @@ int mqtt3_db_message_delete(struct mosquitto *context, uint16_t mid, enum mosqui
     while(tail){
         msg_index++;
         if(tail->state == mosq_ms_queued && msg_index <= max_inflight){
-            tail->timestamp = mosquitto_time();
+            tail->timestamp = mosquitto_time_cached();
             if(tail->direction == mosq_md_out){
                 switch(tail->qos){
                     case 0:
@@ -487,13 +410,13 @@ int mqtt3_db_message_insert(struct mosquitto_db *db, struct mosquitto *context,
     }
     // DXL End
 
-    msg = (struct mosquitto_client_msg *)_mosquitto_malloc(sizeof(struct mosquitto_client_msg));
+    msg = (struct mosquitto_client_msg *)_mosquitto_pool_malloc(sizeof(struct mosquitto_client_msg)); // DXL
     if(!msg) return MOSQ_ERR_NOMEM;
     msg->next = NULL;
     msg->store = stored;
-    msg->store->ref_count++;
+    mqtt3_db_msg_store_ref_inc(msg->store); // DXL
     msg->mid = mid;
-    msg->timestamp = mosquitto_time();
+    msg->timestamp = mosquitto_time_cached();
     msg->direction = dir;
     msg->state = state;
     msg->dup = false;    
@@ -533,7 +456,7 @@ int mqtt3_db_message_update(struct mosquitto *context, uint16_t mid,
     while(tail){
         if(tail->mid == mid && tail->direction == dir){
             tail->state = state;
-            tail->timestamp = mosquitto_time();
+            tail->timestamp = mosquitto_time_cached();
             return MOSQ_ERR_SUCCESS;
         }
         tail = tail->next;
@@ -549,10 +472,9 @@ int mqtt3_db_messages_delete(struct mosquitto *context)
 
     tail = context->msgs;
     while(tail){
-        /* FIXME - it would be nice to be able to remove the stored message here if rec_count==0 */
-        tail->store->ref_count--;
+        mqtt3_db_msg_store_ref_dec(tail->store); // DXL
         next = tail->next;
-        _mosquitto_free(tail);
+        _mosquitto_pool_free(tail, sizeof(struct mosquitto_client_msg)); // DXL
         tail = next;
     }
     context->msgs = NULL;
@@ -580,30 +502,53 @@ int mqtt3_db_messages_easy_queue(struct mosquitto_db *db, struct mosquitto *cont
         source_id = "";
     }
     if(mqtt3_db_message_store(db, context /*DXL*/, source_id, 0, topic, qos, payloadlen, payload, retain, &stored, 0)) return 1;
-    return mqtt3_db_messages_queue(db, source_id, topic, qos, retain, stored);
+    // DXL Begin
+    int rc = mqtt3_db_messages_queue(db, source_id, topic, qos, retain, stored);
+    mqtt3_db_msg_store_ref_dec(stored);
+    return rc;
+    // DXL End
 }
 
-int mqtt3_db_message_store(struct mosquitto_db *db, struct mosquitto *context /*DXL*/,
+// DXL Begin
+/* Whether the pointer references the received packet buffer of the stored message */
+static bool _db_store_buffer_contains(struct mosquitto_msg_store *stored, const void *ptr)
+{
+    return stored->buffer && (const uint8_t *)ptr >= stored->buffer &&
+        (const uint8_t *)ptr < stored->buffer + stored->buffer_len;
+}
+
+/* Frees a topic or payload of the stored message unless it references the packet buffer */
+static void _db_store_free(struct mosquitto_msg_store *stored, void *ptr)
+{
+    if(ptr && !_db_store_buffer_contains(stored, ptr)) _mosquitto_free(ptr);
+}
+// DXL End
+
+/* Stores a message, copying the topic and payload unless the packet buffer they reference is specified (DXL) */
+static int _db_message_store(struct mosquitto_db *db, struct mosquitto *context /*DXL*/,
     const char *source, uint16_t source_mid, const char *topic, int qos, uint32_t payloadlen,
-    const void *payload, int retain, struct mosquitto_msg_store **stored, dbid_t store_id)
+    const void *payload, int retain, struct mosquitto_msg_store **stored, dbid_t store_id,
+    uint8_t *buffer, uint32_t buffer_len)
 {
     struct mosquitto_msg_store *temp;
 
     assert(db);
     assert(stored);
 
-    temp = (struct mosquitto_msg_store *)_mosquitto_malloc(sizeof(struct mosquitto_msg_store));
+    temp = (struct mosquitto_msg_store *)_mosquitto_pool_malloc(sizeof(struct mosquitto_msg_store)); // DXL
     if(!temp) return MOSQ_ERR_NOMEM;
 
-    temp->next = db->msg_store;
-    temp->ref_count = 0;
+    temp->ref_count = 1; // DXL: The reference of the caller
+    temp->timestamp = mosquitto_time_cached(); // DXL
+    temp->buffer = buffer; // DXL
+    temp->buffer_len = buffer_len; // DXL
     if(source){
-        temp->source_id = _mosquitto_strdup(source);
+        temp->source_id = _mosquitto_pool_strdup(source); // DXL
     }else{
-        temp->source_id = _mosquitto_strdup("");
+        temp->source_id = _mosquitto_pool_strdup(""); // DXL
     }
     if(!temp->source_id){
-        _mosquitto_free(temp);
+        _mosquitto_pool_free(temp, sizeof(struct mosquitto_msg_store)); // DXL
         _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Out of memory.");
         return MOSQ_ERR_NOMEM;
     }
@@ -615,11 +560,13 @@ int mqtt3_db_message_store(struct mosquitto_db *db, struct mosquitto *context /*
     temp->msg.client_payload = NULL;
     temp->msg.client_payloadlen = 0;
     // DXL End
-    if(topic){
+    if(buffer){
+        temp->msg.topic = (char *)topic; // DXL
+    }else if(topic){
         temp->msg.topic = _mosquitto_strdup(topic);
         if(!temp->msg.topic){
-            _mosquitto_free(temp->source_id);
-            _mosquitto_free(temp);
+            _mosquitto_pool_strfree(temp->source_id); // DXL
+            _mosquitto_pool_free(temp, sizeof(struct mosquitto_msg_store)); // DXL
             _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Out of memory.");
             return MOSQ_ERR_NOMEM;
         }
@@ -627,13 +574,14 @@ int mqtt3_db_message_store(struct mosquitto_db *db, struct mosquitto *context /*
         temp->msg.topic = NULL;
     }
     temp->msg.payloadlen = payloadlen;
-    if(payloadlen){
+    if(payloadlen && buffer){
+        temp->msg.payload = (void *)payload; // DXL
+    }else if(payloadlen){
         temp->msg.payload = _mosquitto_malloc(sizeof(char)*payloadlen);
         if(!temp->msg.payload){
-            if(temp->source_id) _mosquitto_free(temp->source_id);
-            if(temp->msg.topic) _mosquitto_free(temp->msg.topic);
-            if(temp->msg.payload) _mosquitto_free(temp->msg.payload);
-            _mosquitto_free(temp);
+            _mosquitto_pool_strfree(temp->source_id); // DXL
+            _db_store_free(temp, temp->msg.topic); // DXL
+            _mosquitto_pool_free(temp, sizeof(struct mosquitto_msg_store)); // DXL
             return MOSQ_ERR_NOMEM;
         }
         memcpy(temp->msg.payload, payload, sizeof(char)*payloadlen);
@@ -642,16 +590,28 @@ int mqtt3_db_message_store(struct mosquitto_db *db, struct mosquitto *context /*
     }
 
     if(!temp->source_id || (payloadlen && !temp->msg.payload)){
-        if(temp->source_id) _mosquitto_free(temp->source_id);
-        if(temp->msg.topic) _mosquitto_free(temp->msg.topic);
-        if(temp->msg.payload) _mosquitto_free(temp->msg.payload);
-        _mosquitto_free(temp);
+        _mosquitto_pool_strfree(temp->source_id); // DXL
+        _db_store_free(temp, temp->msg.topic); // DXL
+        _db_store_free(temp, temp->msg.payload); // DXL
+        _mosquitto_pool_free(temp, sizeof(struct mosquitto_msg_store)); // DXL
         return 1;
     }
     temp->dest_ids = NULL;
     temp->dest_id_count = 0;
-    db->msg_store_count++;
+    temp->frames[0] = NULL; // DXL
+    temp->frames[1] = NULL; // DXL
+    temp->dxl_context = NULL; // DXL
+    memset(&temp->splice, 0, sizeof(struct payload_splice)); // DXL
+    // DXL Begin
+    temp->prev = NULL;
+    temp->next = db->msg_store;
+    if(db->msg_store){
+        db->msg_store->prev = temp;
+    }
     db->msg_store = temp;
+    db->msg_store_count++;
+    db->msg_store_bytes += temp->msg.payloadlen;
+    // DXL End
     (*stored) = temp;
 
     if(!store_id){
@@ -661,22 +621,60 @@ int mqtt3_db_message_store(struct mosquitto_db *db, struct mosquitto *context /*
     }
 
     // DXL Begin
-    uint32_t outPayloadLen = 0;
-    unsigned char* outPayload = NULL;
-    dxl_on_store_message(context, temp, &outPayloadLen, reinterpret_cast<void**>(&outPayload),
+    struct payload_splice splice;
+    memset(&splice, 0, sizeof(struct payload_splice));
+    dxl_on_store_message(context, temp, &splice,
         (context != NULL ? context->cert_hashes : NULL),
-        (context != NULL ? context->cert_chain : NULL));
-    if(outPayloadLen > 0 && outPayload != NULL){
+        (context != NULL ? context->cert_chain : NULL),
+        (context != NULL ? &context->dxl_message_source : NULL));
+    if(splice.bytes && splice.region_len){
+        // The fields of the message were rewritten around its body, keep the payload for the body
+        db->msg_store_bytes -= temp->msg.payloadlen;
+        temp->splice = splice;
+        temp->msg.payloadlen = splice.len + splice.region_len;
+        db->msg_store_bytes += temp->msg.payloadlen;
+    }else if(splice.bytes && splice.len > 0){
         // The messge was rewritten, replace it
-        _mosquitto_free(temp->msg.payload);
-        temp->msg.payload = outPayload;
-        temp->msg.payloadlen = outPayloadLen;
+        _db_store_free(temp, temp->msg.payload);
+        db->msg_store_bytes -= temp->msg.payloadlen;
+        temp->msg.payload = splice.bytes;
+        temp->msg.payloadlen = splice.len;
+        db->msg_store_bytes += temp->msg.payloadlen;
+    }else if(splice.bytes){
+        _mosquitto_free(splice.bytes);
     }
     // DXL End
 
     return MOSQ_ERR_SUCCESS;
 }
 
+int mqtt3_db_message_store(struct mosquitto_db *db, struct mosquitto *context /*DXL*/,
+    const char *source, uint16_t source_mid, const char *topic, int qos, uint32_t payloadlen,
+    const void *payload, int retain, struct mosquitto_msg_store **stored, dbid_t store_id)
+{
+    return _db_message_store(db, context, source, source_mid, topic, qos, payloadlen, payload, retain,
+        stored, store_id, NULL, 0);
+}
+
+// DXL Begin
+int mqtt3_db_message_store_packet(struct mosquitto_db *db, struct mosquitto *context,
+    const char *source, uint16_t source_mid, const char *topic, int qos, uint32_t payloadlen,
+    const void *payload, int retain, struct mosquitto_msg_store **stored, struct _mosquitto_packet *packet)
+{
+    int rc;
+
+    assert(packet);
+
+    rc = _db_message_store(db, context, source, source_mid, topic, qos, payloadlen, payload, retain,
+        stored, 0, packet->payload, packet->remaining_length);
+    if(rc == MOSQ_ERR_SUCCESS){
+        /* The packet is given a new payload when the next one is read */
+        packet->payload = NULL;
+    }
+    return rc;
+}
+// DXL End
+
 int mqtt3_db_message_store_find(struct mosquitto *context, uint16_t mid, struct mosquitto_msg_store **stored)
 {
     struct mosquitto_client_msg *tail;
@@ -787,7 +785,7 @@ int mqtt3_db_message_timeout_check(struct mosquitto *context /* DXL */, unsigned
     enum mosquitto_msg_state new_state;
     struct mosquitto_client_msg *msg;
 
-    threshold = mosquitto_time() - timeout;
+    threshold = mosquitto_time_cached() - timeout;
     
     /* DXL: We pass in the context versus iterating all here... */
 
@@ -813,7 +811,7 @@ int mqtt3_db_message_timeout_check(struct mosquitto *context /* DXL */, unsigned
                         break;
                 }
                 if(new_state != mosq_ms_invalid){
-                    msg->timestamp = mosquitto_time();
+                    msg->timestamp = mosquitto_time_cached();
                     msg->state = new_state;
                     msg->dup = true;
                 }
@@ -842,7 +840,7 @@ int mqtt3_db_message_release(struct mosquitto_db *db, struct mosquitto *context,
     while(tail){
         msg_index++;
         if(tail->state == mosq_ms_queued && msg_index <= max_inflight){
-            tail->timestamp = mosquitto_time();
+            tail->timestamp = mosquitto_time_cached();
             if(tail->direction == mosq_md_out){
                 switch(tail->qos){
                     case 0:
@@ -893,6 +891,70 @@ int mqtt3_db_message_release(struct mosquitto_db *db, struct mosquitto *context,
     }
 }
 
+// DXL Begin
+/*
+ * Returns the parts of the payload (or client payload) of the stored message. A payload that
+ * was rewritten around a region of the original payload has three parts (see payload_splice).
+ */
+static int _db_store_payload_parts(struct mosquitto_msg_store *stored, bool client_message,
+    struct _mosquitto_payload_part parts[3])
+{
+    if(client_message){
+        parts[0].data = stored->msg.client_payload;
+        parts[0].len = (uint32_t)stored->msg.client_payloadlen;
+        return 1;
+    }
+    if(!stored->splice.region_len){
+        parts[0].data = stored->msg.payload;
+        parts[0].len = stored->msg.payloadlen;
+        return 1;
+    }
+    parts[0].data = stored->splice.bytes;
+    parts[0].len = stored->splice.offset;
+    parts[1].data = (const uint8_t *)stored->msg.payload + stored->splice.region_start;
+    parts[1].len = stored->splice.region_len;
+    parts[2].data = stored->splice.bytes + stored->splice.offset;
+    parts[2].len = stored->splice.len - stored->splice.offset;
+    return 3;
+}
+
+/*
+ * Sends a QoS 0 message using the encoded PUBLISH frame of the stored message,
+ * which is created the first time it is sent and then shared by every context
+ * the message is written to.
+ */
+static int _message_send_frame(struct mosquitto *context, struct mosquitto_client_msg *msg)
+{
+    struct mosquitto_msg_store *stored = msg->store;
+    int index = msg->client_message ? 1 : 0;
+
+    if(!stored->frames[index]){
+        struct _mosquitto_payload_part parts[3];
+        int part_count = _db_store_payload_parts(stored, msg->client_message, parts);
+        stored->frames[index] = _mosquitto_frame_publish_create(stored->msg.topic, parts, part_count);
+        if(!stored->frames[index]) return MOSQ_ERR_NOMEM;
+    }
+
+    if(IS_DEBUG_ENABLED)
+        _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG,
+            "Sending PUBLISH to %s (d0, q0, r0, m%d, '%s', ... (%ld bytes))",
+            context->id, msg->mid, stored->msg.topic,
+            (long)(msg->client_message ? stored->msg.client_payloadlen : stored->msg.payloadlen));
+
+    return _mosquitto_send_frame(context, stored->frames[index]);
+}
+
+/*
+ * Whether the specified message can be sent using a shared PUBLISH frame. Websocket
+ * packets require their own buffers and bridges may remap topics.
+ */
+static bool _message_is_frame_shareable(struct mosquitto *context, struct mosquitto_client_msg *msg)
+{
+    return msg->qos == 0 && !msg->retain && !msg->dup && msg->store->msg.topic &&
+        !context->wsi && !(context->bridge && context->bridge->topic_remapping);
+}
+// DXL End
+
 int mqtt3_db_message_write(struct mosquitto *context)
 {
     int rc;
@@ -902,8 +964,8 @@ int mqtt3_db_message_write(struct mosquitto *context)
     int retain;
     const char *topic;
     int qos;
-    uint32_t payloadlen;
-    const void *payload;
+    struct _mosquitto_payload_part parts[3]; // DXL
+    int part_count; // DXL
     int msg_count = 0;
 
     if(!context || IS_CONTEXT_INVALID(context)
@@ -922,15 +984,16 @@ int mqtt3_db_message_write(struct mosquitto *context)
             retain = tail->retain;
             topic = tail->store->msg.topic;
             qos = tail->qos;
-            payloadlen = (tail->client_message ?
-                            tail->store->msg.client_payloadlen : tail->store->msg.payloadlen); // DXL
-            payload = (tail->client_message ?
-                            tail->store->msg.client_payload : tail->store->msg.payload); // DXL
+            part_count = _db_store_payload_parts(tail->store, tail->client_message, parts); // DXL
 
             switch(tail->state){
                 case mosq_ms_publish_qos0:
-                    rc = _mosquitto_send_publish(context, mid, topic, payloadlen, payload, qos,
-                            (retain != 0), (retries != 0));
+                    if(_message_is_frame_shareable(context, tail)){
+                        rc = _message_send_frame(context, tail); // DXL
+                    }else{
+                        rc = _mosquitto_send_publish(context, mid, topic, parts, part_count, qos,
+                                (retain != 0), (retries != 0));
+                    }
                     if(!rc){
                         _message_remove(context, &tail, last);
                     }else{
@@ -939,10 +1002,10 @@ int mqtt3_db_message_write(struct mosquitto *context)
                     break;
 
                 case mosq_ms_publish_qos1:
-                    rc = _mosquitto_send_publish(context, mid, topic, payloadlen,
-                            payload, qos, (retain != 0), (retries != 0));
+                    rc = _mosquitto_send_publish(context, mid, topic, parts,
+                            part_count, qos, (retain != 0), (retries != 0));
                     if(!rc){
-                        tail->timestamp = mosquitto_time();
+                        tail->timestamp = mosquitto_time_cached();
                         tail->dup = 1; /* Any retry attempts are a duplicate. */
                         tail->state = mosq_ms_wait_for_puback;
                     }else{
@@ -953,10 +1016,10 @@ int mqtt3_db_message_write(struct mosquitto *context)
                     break;
 
                 case mosq_ms_publish_qos2:
-                    rc = _mosquitto_send_publish(context, mid, topic, payloadlen, payload,
+                    rc = _mosquitto_send_publish(context, mid, topic, parts, part_count,
                             qos, (retain != 0), (retries != 0));
                     if(!rc){
-                        tail->timestamp = mosquitto_time();
+                        tail->timestamp = mosquitto_time_cached();
                         tail->dup = 1; /* Any retry attempts are a duplicate. */
                         tail->state = mosq_ms_wait_for_pubrec;
                     }else{
@@ -1020,45 +1083,106 @@ int mqtt3_db_message_write(struct mosquitto *context)
     return MOSQ_ERR_SUCCESS;
 }
 
-void mqtt3_db_store_clean(struct mosquitto_db *db)
+// DXL Begin
+/* Unlinks the stored message from the store, finalizes and frees it */
+static void _db_store_remove(struct mosquitto_db *db, struct mosquitto_msg_store *stored)
 {
-    /* FIXME - this may not be necessary if checks are made when messages are removed. */
-    struct mosquitto_msg_store *tail, *last = NULL;
     int i;
+
+    if(stored->prev){
+        stored->prev->next = stored->next;
+    }else{
+        db->msg_store = stored->next;
+    }
+    if(stored->next){
+        stored->next->prev = stored->prev;
+    }
+    db->msg_store_count--;
+    db->msg_store_bytes -= stored->msg.payloadlen;
+
+    dxl_on_finalize_message(stored);
+    _mosquitto_pool_strfree(stored->source_id);
+    if(stored->dest_ids){
+        for(i=0; i<stored->dest_id_count; i++){
+            if(stored->dest_ids[i]) _mosquitto_free(stored->dest_ids[i]);
+        }
+        _mosquitto_free(stored->dest_ids);
+    }
+    _db_store_free(stored, stored->msg.topic);
+    _db_store_free(stored, stored->msg.payload);
+    _mosquitto_packet_buffer_free(stored->buffer, stored->buffer_len);
+    if(stored->msg.client_payload) _mosquitto_free(stored->msg.client_payload);
+    if(stored->splice.bytes) _mosquitto_free(stored->splice.bytes); // DXL
+    _mosquitto_frame_release(stored->frames[0]);
+    _mosquitto_frame_release(stored->frames[1]);
+    _mosquitto_pool_free(stored, sizeof(struct mosquitto_msg_store));
+}
+
+void mqtt3_db_msg_store_ref_inc(struct mosquitto_msg_store *stored)
+{
+    stored->ref_count++;
+}
+
+void mqtt3_db_msg_store_ref_dec(struct mosquitto_msg_store *stored)
+{
+    stored->ref_count--;
+    if(stored->ref_count <= 0){
+        _db_store_remove(_mosquitto_get_db(), stored);
+    }
+}
+// DXL End
+
+void mqtt3_db_store_clean(struct mosquitto_db *db)
+{
+    /* DXL: Messages are removed when their last reference is released, this only
+     * removes the messages that were never referenced. */
+    struct mosquitto_msg_store *tail, *next;
     assert(db);
 
     tail = db->msg_store;
     while(tail){
-        if(tail->ref_count == 0){
-            dxl_on_finalize_message(tail->db_id); // DXL
-            if(tail->source_id) _mosquitto_free(tail->source_id);
-            if(tail->dest_ids){
-                for(i=0; i<tail->dest_id_count; i++){
-                    if(tail->dest_ids[i]) _mosquitto_free(tail->dest_ids[i]);
-                }
-                _mosquitto_free(tail->dest_ids);
-            }
-            if(tail->msg.topic) _mosquitto_free(tail->msg.topic);
-            if(tail->msg.payload) _mosquitto_free(tail->msg.payload);
-            if(tail->msg.client_payload) _mosquitto_free(tail->msg.client_payload); // DXL
-            if(last){
-                last->next = tail->next;
-                _mosquitto_free(tail);
-                tail = last->next;
-            }else{
-                db->msg_store = tail->next;
-                _mosquitto_free(tail);
-                tail = db->msg_store;
-            }
-            db->msg_store_count--;
-        }else{
-            last = tail;
-            tail = tail->next;
+        next = tail->next;
+        if(tail->ref_count <= 0){
+            _db_store_remove(db, tail);
         }
+        tail = next;
     }
+}
+
+// DXL Begin
+static const uint32_t _db_store_size_bounds[MQTT3_DB_STORE_HISTOGRAM_BUCKETS] =
+    {256, 1024, 4096, 16384, 65536, UINT32_MAX};
+static const uint32_t _db_store_age_bounds[MQTT3_DB_STORE_HISTOGRAM_BUCKETS] =
+    {1, 10, 60, 300, 3600, UINT32_MAX};
 
+/* Returns the histogram bucket of the value */
+static int _db_store_bucket(const uint32_t *bounds, uint64_t value)
+{
+    int i;
+
+    for(i=0; i<MQTT3_DB_STORE_HISTOGRAM_BUCKETS-1; i++){
+        if(value < bounds[i]) break;
+    }
+    return i;
 }
 
+void mqtt3_db_store_stats(struct mosquitto_db *db, time_t now, struct mqtt3_db_store_stats *stats)
+{
+    struct mosquitto_msg_store *stored;
+
+    memset(stats, 0, sizeof(struct mqtt3_db_store_stats));
+    stats->count = db->msg_store_count;
+    stats->bytes = db->msg_store_bytes;
+    stats->size_bounds = _db_store_size_bounds;
+    stats->age_bounds = _db_store_age_bounds;
+    for(stored = db->msg_store; stored; stored = stored->next){
+        stats->size_counts[_db_store_bucket(_db_store_size_bounds, stored->msg.payloadlen)]++;
+        stats->age_counts[_db_store_bucket(_db_store_age_bounds,
+            (uint64_t)(now > stored->timestamp ? now - stored->timestamp : 0))]++;
+    }
+}
+// DXL End
+
 void mqtt3_db_limits_set(int inflight, int queued)
 {
     max_inflight = inflight;
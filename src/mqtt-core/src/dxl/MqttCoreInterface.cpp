@@ -13,6 +13,7 @@
 #include "RevokeCertsRunner.h"
 #include "logging_mosq.h"
 #include "DxlFlags.h"
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <sys/types.h>
@@ -112,6 +113,43 @@ void MqttCoreInterface::onClientConnected( const struct mosquitto* context ) con
     updateTenantConnectionCount( context, 1 );
 }
 
+/** {@inheritDoc} */
+void MqttCoreInterface::acquireGuidIds( struct mosquitto* context ) const
+{
+    releaseGuidIds( context );
+
+    struct guid_ids& ids = context->dxl_guid_ids;
+    if( context->is_bridge )
+    {
+        bool isChild; 
+        string bridgeBrokerId;
+
+        getBridgeBrokerIdFromContext( context, isChild, bridgeBrokerId );
+        ids.id = acquireGuidId( bridgeBrokerId.c_str() );
+        ids.canonical_id = acquireGuidId( bridgeBrokerId.c_str() );
+    }
+    else
+    {
+        ids.id = acquireGuidId( context->id );
+        ids.canonical_id = acquireGuidId( context->canonical_id ? context->canonical_id : context->id );
+    }
+
+    if( context->dxl_tenant_guid && *context->dxl_tenant_guid )
+    {
+        ids.tenant_id = acquireGuidId( context->dxl_tenant_guid );
+    }
+}
+
+/** {@inheritDoc} */
+void MqttCoreInterface::releaseGuidIds( struct mosquitto* context ) const
+{
+    struct guid_ids& ids = context->dxl_guid_ids;
+    releaseGuidId( ids.id );
+    releaseGuidId( ids.canonical_id );
+    releaseGuidId( ids.tenant_id );
+    memset( &ids, 0, sizeof( struct guid_ids ) );
+}
+
 /** {@inheritDoc} */
 void MqttCoreInterface::onClientDisconnected( const struct mosquitto* context ) const
 {
@@ -143,8 +181,8 @@ bool MqttCoreInterface::onPublishMessage(
 /** {@inheritDoc} */
 void MqttCoreInterface::onStoreMessage(
     struct mosquitto* sourceContext, struct mosquitto_msg_store *message,
-    uint32_t* outPayloadSize, void** outPayload, struct cert_hashes *certHashes,
-    const char* certChain )
+    struct payload_splice* outPayload, struct cert_hashes *certHashes,
+    const char* certChain, struct dxl_message_source_t** messageSource )
 {     
     const char* sourceId = message->source_id;
     const char* canonSourceId = sourceContext ? sourceContext->canonical_id : NULL;
@@ -198,23 +236,23 @@ void MqttCoreInterface::onStoreMessage(
             }
 
             getBridgeBrokerIdFromContext( sourceContext, isChild, bridgeBrokerId );
-            CoreInterface::onStoreMessage(
+            message->dxl_context = CoreInterface::onStoreMessage(
                 message->db_id, bridgeBrokerId.c_str(), bridgeBrokerId.c_str(), true, 
                 dxl_flags, message->msg.topic,
                 message->msg.payloadlen, message->msg.payload,
-                outPayloadSize, outPayload, sourceTenantId, NULL, NULL);
+                outPayload, sourceTenantId, NULL, NULL, NULL );
             // Return, we called the broker library method for a bridge
             return;
         }
     }
 
     // Call the broker library method
-    CoreInterface::onStoreMessage(
+    message->dxl_context = CoreInterface::onStoreMessage(
         message->db_id, sourceId, canonSourceId, isBridge, 
         dxl_flags, message->msg.topic,
         message->msg.payloadlen, message->msg.payload,
-        outPayloadSize, outPayload,
-        sourceTenantId, certHashes, certChain );        
+        outPayload,
+        sourceTenantId, certHashes, certChain, messageSource );
 }
 
 /** {@inheritDoc} */
@@ -228,12 +266,12 @@ bool MqttCoreInterface::onPreInsertPacketQueueExceeded(
 
         getBridgeBrokerIdFromContext( destContext, isChild, bridgeBrokerId );
         return CoreInterface::onPreInsertPacketQueueExceeded(
-            bridgeBrokerId.c_str(), true, message->db_id );
+            bridgeBrokerId.c_str(), true, getMessageContext( message ) );
     }
     else
     {
         return CoreInterface::onPreInsertPacketQueueExceeded(
-            destContext->id, false, message->db_id );
+            destContext->id, false, getMessageContext( message ) );
     }
 }
 
@@ -245,6 +283,12 @@ bool MqttCoreInterface::onInsertMessage(
     // Get the tenant id assuming destContext != NULL.
     const char* targetTenantGuid = (destContext->dxl_tenant_guid ? destContext->dxl_tenant_guid : "");
 
+    // Intern the GUIDs of contexts that messages are queued for prior to connecting (bridges)
+    if( !destContext->dxl_guid_ids.id )
+    {
+        acquireGuidIds( destContext );
+    }
+
     if( destContext->is_bridge )
     {
         bool isChild; 
@@ -252,14 +296,16 @@ bool MqttCoreInterface::onInsertMessage(
 
         getBridgeBrokerIdFromContext( destContext, isChild, bridgeBrokerId );
         return CoreInterface::onInsertMessage(
-            bridgeBrokerId.c_str(), bridgeBrokerId.c_str(), true, destContext->dxl_flags, message->db_id,
-            targetTenantGuid, certHashes, isClientMessageEnabled, clientMessage, clientMessageLen );
+            bridgeBrokerId.c_str(), bridgeBrokerId.c_str(), true, destContext->dxl_flags,
+            getMessageContext( message ), targetTenantGuid, &destContext->dxl_guid_ids,
+            certHashes, isClientMessageEnabled, clientMessage, clientMessageLen );
     }
     else
     {
         return CoreInterface::onInsertMessage(
-            destContext->id, destContext->canonical_id, false, destContext->dxl_flags, message->db_id,
-            targetTenantGuid, certHashes, isClientMessageEnabled, clientMessage, clientMessageLen );
+            destContext->id, destContext->canonical_id, false, destContext->dxl_flags,
+            getMessageContext( message ), targetTenantGuid, &destContext->dxl_guid_ids,
+            certHashes, isClientMessageEnabled, clientMessage, clientMessageLen );
     }
 }
 
@@ -73,6 +73,21 @@ public:
      */
     void onClientConnected( const struct mosquitto* context ) const;
 
+    /**
+     * Interns the GUIDs of the specified context (releasing those it held), which allows the
+     * destinations of messages to be matched against the context by identifier
+     *
+     * @param   context The context
+     */
+    void acquireGuidIds( struct mosquitto* context ) const;
+
+    /**
+     * Releases the interned GUIDs of the specified context
+     *
+     * @param   context The context
+     */
+    void releaseGuidIds( struct mosquitto* context ) const;
+
     /**
      * Method that is invoked (by Mosquitto) when a client disconnects from this broker
      *
@@ -99,15 +114,15 @@ public:
      *
      * @param   sourceContext The source context (can be null)
      * @param   message The message that was stored
-     * @param   outPayloadSize The size of the output message (0 if not rewritten)
-     * @param   outPayload The output payload (NULL if not rewritten)
+     * @param   outPayload The rewritten payload (bytes are NULL if not rewritten)
      * @param   certHashes The certificate hashes associated with the source context
      * @param   certChain The certificate chain for the source context
+     * @param   messageSource The message source of the source context (can be null)
      */
     void onStoreMessage(
         struct mosquitto* sourceContext, struct mosquitto_msg_store *message,
-        uint32_t* outPayloadSize, void** outPayload, struct cert_hashes *certHashes,
-        const char* certChain );
+        struct payload_splice* outPayload, struct cert_hashes *certHashes,
+        const char* certChain, struct dxl_message_source_t** messageSource );
 
     /**
      * Invoked when the queue of packets for a context exceeds the maximum
@@ -248,6 +263,17 @@ private:
     void getBridgeBrokerIdFromContext( 
         const struct mosquitto* context, bool& isChild, std::string& bridgeBrokerId ) const;
 
+    /**
+     * Returns the broker library context carried with the specified stored message
+     *
+     * @param   message The stored message
+     * @return  The broker library context of the message (NULL if not stored via the library)
+     */
+    static CoreMessageContext* getMessageContext( const struct mosquitto_msg_store *message )
+    {
+        return static_cast<CoreMessageContext*>( message->dxl_context );
+    }
+
     /** 
      * Stops the broker from running (exits loop)
      *
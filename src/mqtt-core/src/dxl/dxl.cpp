@@ -43,7 +43,9 @@ bool dxl_main(
     uint64_t* maxPacketBufferSize, int* listenPort, int* mosquittoLogType,
     unsigned int* mosquittoLogCategoryMask, int* messageSizeLimit, char** user,
     struct cert_hashes** brokerCertsUtHash,
-    bool *webSocketsEnabled, int* webSocketsListenPort )
+    bool *webSocketsEnabled, int* webSocketsListenPort,
+    int* writeThreadCount, int* tlsHandshakeThreadCount,
+    int* tlsSessionCacheSize, bool* tlsSessionTicketsEnabled, int* tlsSessionTimeout )
 {
     return dxl::broker::brokerlib_main(
         argc, argv, tlsEnabled, tlsBridgingInsecure, fipsEnabled,
@@ -52,7 +54,9 @@ bool dxl_main(
         brokerCertFile, ciphers, maxPacketBufferSize, listenPort, 
         mosquittoLogType, mosquittoLogCategoryMask, messageSizeLimit, user,
         brokerCertsUtHash,
-        webSocketsEnabled, webSocketsListenPort );
+        webSocketsEnabled, webSocketsListenPort, writeThreadCount,
+        tlsHandshakeThreadCount, tlsSessionCacheSize, tlsSessionTicketsEnabled,
+        tlsSessionTimeout );
 }
 
 /** {@inheritDoc} */
@@ -123,6 +127,7 @@ void dxl_on_bridge_connected( struct mosquitto* context )
 
     try
     {
+        s_dxlInterface.acquireGuidIds( context );
         s_dxlInterface.onBridgeConnected( context );
     }
     catch( const exception& ex )
@@ -167,6 +172,7 @@ void dxl_on_client_connected( struct mosquitto* context )
 
     try
     {
+        s_dxlInterface.acquireGuidIds( context );
         s_dxlInterface.onClientConnected( context );
     }
     catch( const exception& ex )
@@ -226,13 +232,13 @@ bool dxl_on_publish_message(
 /** {@inheritDoc} */
 void dxl_on_store_message(
     struct mosquitto* sourceContext, struct mosquitto_msg_store *message,
-    uint32_t* outPayloadLen, void** outPayload, struct cert_hashes *certHashes,
-    const char* certChain )
+    struct payload_splice* outPayload, struct cert_hashes *certHashes,
+    const char* certChain, struct dxl_message_source_t** messageSource )
 {
     try
     {    
         s_dxlInterface.onStoreMessage(
-            sourceContext, message, outPayloadLen, outPayload, certHashes, certChain );
+            sourceContext, message, outPayload, certHashes, certChain, messageSource );
     }
     catch( const exception& ex )
     {
@@ -297,22 +303,74 @@ bool dxl_on_insert_message(
 }
 
 
+/** The tenant GUIDs returned by dxl_get_message_tenants() */
+static vector<const char*> s_messageTenantGuids;
+
 /** {@inheritDoc} */
-void dxl_on_finalize_message( dbid_t dbId )
+void dxl_get_message_tenants( struct mosquitto_msg_store *message, struct dxl_message_tenants* tenants )
 {
+    tenants->restricted = false;
+    tenants->count = 0;
+    tenants->guids = NULL;
+
+    try
+    {
+        tenants->restricted = s_dxlInterface.getMessageTenants(
+            static_cast<CoreMessageContext*>( message->dxl_context ), s_messageTenantGuids );
+        tenants->count = s_messageTenantGuids.size();
+        tenants->guids = s_messageTenantGuids.data();
+    }
+    catch( const exception& ex )
+    {
+        tenants->restricted = false;
+        _mosquitto_log_printf( NULL, MOSQ_LOG_ERR, "Error getting message tenants: %" PRIu64 ", error=%s",
+            message->db_id, ex.what() );
+    }
+    catch( ... )
+    {
+        tenants->restricted = false;
+        _mosquitto_log_printf( NULL, MOSQ_LOG_ERR, "Error getting message tenants: %" PRIu64 ", unknown error",
+            message->db_id );
+    }
+}
+
+/** {@inheritDoc} */
+void dxl_release_guid_ids( struct mosquitto* context )
+{
+    s_dxlInterface.releaseGuidIds( context );
+}
+
+/** {@inheritDoc} */
+void dxl_release_message_source( struct mosquitto* context )
+{
+    s_dxlInterface.releaseMessageSource( context->dxl_message_source );
+    context->dxl_message_source = NULL;
+}
+
+/** {@inheritDoc} */
+void dxl_on_finalize_message( struct mosquitto_msg_store *message )
+{
+    CoreMessageContext* context = static_cast<CoreMessageContext*>( message->dxl_context );
+    if( !context )
+    {
+        // Not stored via the broker library, or already finalized
+        return;
+    }
+    message->dxl_context = NULL;
+
     try
     {        
-        s_dxlInterface.onFinalizeMessage( dbId );
+        s_dxlInterface.onFinalizeMessage( context );
     }
     catch( const exception& ex )
     {
         _mosquitto_log_printf( NULL, MOSQ_LOG_ERR, "Error firing on finalize message: %" PRIu64 ", error=%s",
-            dbId, ex.what() );
+            message->db_id, ex.what() );
     }
     catch( ... )
     {
         _mosquitto_log_printf( NULL, MOSQ_LOG_ERR, "Error firing on finalize message: %" PRIu64 ", unknown error",
-            dbId );
+            message->db_id );
     }
 }
 
@@ -11,6 +11,7 @@
  */
 
 #include "cert_hashes.h"
+#include "payload_splice.h"
 #include "mosquitto.h"
 #include "mosquitto_internal.h"
 #include "mosquitto_broker.h"
@@ -44,6 +45,11 @@ extern int NID_dxlTenantGuid;
  * @param   brokerCertsUtHash List of broker certificate hashes (SHA-1) (out)
  * @param   webSocketsEnabled Whether WebSockets is enabled (out)
  * @param   webSocketsListenPort The broker WebSockets listen port (out)
+ * @param   writeThreadCount The count of write threads (out)
+ * @param   tlsHandshakeThreadCount The count of TLS handshake threads (out)
+ * @param   tlsSessionCacheSize The size of the TLS session cache (out)
+ * @param   tlsSessionTicketsEnabled Whether TLS session tickets are enabled (out)
+ * @param   tlsSessionTimeout The TLS session timeout in seconds (out)
  * @return  Whether Mosquitto should continue starting
  */
 bool dxl_main(
@@ -55,7 +61,9 @@ bool dxl_main(
     uint64_t* maxPacketBufferSize, int* listenPort, int* mosquittoLogType,
     unsigned int* mosquittoLogCategoryMask, int* messageSizeLimit, char** user,
     struct cert_hashes** brokerCertsUtHash,
-    bool *webSocketsEnabled, int* webSocketsListenPort );
+    bool *webSocketsEnabled, int* webSocketsListenPort,
+    int* writeThreadCount, int* tlsHandshakeThreadCount,
+    int* tlsSessionCacheSize, bool* tlsSessionTicketsEnabled, int* tlsSessionTimeout );
 
 /**
  * Invoked when the broker library can be initialized.
@@ -133,15 +141,30 @@ bool dxl_on_publish_message(
  *
  * @param   sourceContext The source context (can be null)
  * @param   message The message that was stored
- * @param   outPayloadLen The output payload length (0 if not rewritten)
- * @param   outPayload The output payload (NULL if not rewritten)
+ * @param   outPayload The rewritten payload (bytes are NULL if not rewritten)
  * @param   certHashes The certificate hashes associated with the source context
  * @param   certChain The certificate chain associated with the source context
+ * @param   messageSource The message source of the source context, created on the first
+ *          message stored for the context (can be null)
  */
 void dxl_on_store_message(
     struct mosquitto* sourceContext, struct mosquitto_msg_store *message,
-    uint32_t* outPayloadLen, void** outPayload, struct cert_hashes *certHashes,
-    const char* certChain );
+    struct payload_splice* outPayload, struct cert_hashes *certHashes,
+    const char* certChain, struct dxl_message_source_t** messageSource );
+
+/**
+ * Releases the interned GUIDs of the specified context
+ *
+ * @param   context The context
+ */
+void dxl_release_guid_ids( struct mosquitto* context );
+
+/**
+ * Releases the message source of the specified context
+ *
+ * @param   context The context
+ */
+void dxl_release_message_source( struct mosquitto* context );
 
 
 /**
@@ -172,11 +195,34 @@ bool dxl_on_insert_message( struct mosquitto* destContext, struct mosquitto_msg_
     struct cert_hashes *certHashes, bool* isClientMessageEnabled, unsigned char** clientMessage, size_t* clientMessageLen );
 
 /**
- * Invoked when a message is about to be finalized (all operations completed)
+ * The tenants that a message may be delivered to in multi-tenant mode (in addition to
+ * operations clients and bridges)
+ */
+struct dxl_message_tenants
+{
+    /** Whether the message is restricted to the tenants (otherwise any tenant may receive it) */
+    bool restricted;
+    /** The count of tenant GUIDs */
+    size_t count;
+    /** The tenant GUIDs (valid until the next invocation) */
+    const char* const* guids;
+};
+
+/**
+ * Returns the tenants that a stored message may be delivered to (multi-tenant mode)
+ *
+ * @param   message The stored message
+ * @param   tenants The tenants that the message may be delivered to (out)
+ */
+void dxl_get_message_tenants( struct mosquitto_msg_store *message, struct dxl_message_tenants* tenants );
+
+/**
+ * Invoked when a message is about to be finalized (all operations completed). The broker
+ * library context of the message is released, subsequent invocations have no effect.
  *
- * @param   dbId The database identifier
+ * @param   message The stored message
  */
-void dxl_on_finalize_message( dbid_t dbId );
+void dxl_on_finalize_message( struct mosquitto_msg_store *message );
 
 /**
  * Invoked when a message is inserted for a destination
@@ -53,7 +53,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 // DXL Begin
 #include "dxl.h"
-#include <malloc.h>
+#include <pthread.h>
 #include "search_optimization.h"
 // DXL End
 
@@ -74,10 +74,15 @@ static void handle_read(struct mosquitto_db *db, struct mosquitto *context, stru
 static void handle_write(struct mosquitto_db *db, struct mosquitto *context,
     struct epoll_event *event, uint32_t contextId);
 static void loop_handle_reads_writes(struct mosquitto_db *db, struct epoll_event *events, int eventcount);
+static void flush_pending_writes(struct mosquitto_db *db);
+static void handle_write_error(struct mosquitto_db *db, struct mosquitto *context);
 
 /* The EPOLL file descriptor */
 static int efd = 0;
 
+/* DXL: The interval (in seconds) at which the periodic maintenance is performed */
+#define MAINTENANCE_INTERVAL 10
+
 #include "uthash.h"
 static bool new_client = false;
 
@@ -94,10 +99,13 @@ void mosquitto_add_new_msgs_set(struct mosquitto* context)
 
     HASH_FIND_PTR(new_msgs_hash, (&context), s);
     if(!s){
-        s = (struct context_hash *)malloc(sizeof(struct context_hash));
+        s = (struct context_hash *)_mosquitto_pool_malloc(sizeof(struct context_hash));
         s->context = context;
         HASH_ADD_PTR(new_msgs_hash, context, s);
     }
+
+    // DXL: The in-flight messages are checked for retry by the context timer
+    mosquitto_context_timer_update(context, mosquitto_time_cached() + MAINTENANCE_INTERVAL);
 }
 
 static void remove_new_msgs_set(struct mosquitto* context)
@@ -107,7 +115,7 @@ static void remove_new_msgs_set(struct mosquitto* context)
     HASH_FIND_PTR(new_msgs_hash, (&context), s);
     if(s){
         HASH_DEL(new_msgs_hash, s);
-        free(s);
+        _mosquitto_pool_free(s, sizeof(struct context_hash));
     }
 }
 
@@ -120,7 +128,7 @@ void mosquitto_add_new_clients_set(struct mosquitto* context)
 
     HASH_FIND_PTR(new_clients_hash, (&context), s);
     if(!s){
-        s = (struct context_hash *)malloc(sizeof(struct context_hash));
+        s = (struct context_hash *)_mosquitto_pool_malloc(sizeof(struct context_hash));
         s->context = context;
         HASH_ADD_PTR(new_clients_hash, context, s);
     }
@@ -133,7 +141,7 @@ static void remove_new_clients_set(struct mosquitto* context)
     HASH_FIND_PTR(new_clients_hash, (&context), s);
     if(s){
         HASH_DEL(new_clients_hash, s);
-        free(s);
+        _mosquitto_pool_free(s, sizeof(struct context_hash));
     }
 }
 
@@ -145,7 +153,7 @@ void mosquitto_add_pending_bytes_set(struct mosquitto* context)
 
         HASH_FIND_PTR(pending_bytes_hash, (&context), s);
         if(!s){
-            s = (struct context_hash *)malloc(sizeof(struct context_hash));
+            s = (struct context_hash *)_mosquitto_pool_malloc(sizeof(struct context_hash));
             s->context = context;
             HASH_ADD_PTR(pending_bytes_hash, context, s);
         }
@@ -161,38 +169,44 @@ void mosquitto_remove_pending_bytes_set(struct mosquitto* context)
         HASH_FIND_PTR(pending_bytes_hash, (&context), s);
         if(s){
             HASH_DEL(pending_bytes_hash, s);
-            free(s);		
+            _mosquitto_pool_free(s, sizeof(struct context_hash));
         }
         context->pending_bytes = false;
     }
 }
 
+/* DXL: The contexts that have packets to be flushed by the write threads */
+static struct context_hash *pending_writes_hash = NULL;
+void mosquitto_add_pending_writes_set(struct mosquitto* context)
+{
+    if(!context->pending_write){
+        struct context_hash *s = (struct context_hash *)_mosquitto_pool_malloc(sizeof(struct context_hash));
+        s->context = context;
+        HASH_ADD_PTR(pending_writes_hash, context, s);
+        context->pending_write = true;
+    }
+}
+
+void mosquitto_remove_pending_writes_set(struct mosquitto* context)
+{
+    if(context->pending_write){
+        struct context_hash *s = NULL;
+
+        HASH_FIND_PTR(pending_writes_hash, (&context), s);
+        if(s){
+            HASH_DEL(pending_writes_hash, s);
+            _mosquitto_pool_free(s, sizeof(struct context_hash));
+        }
+        context->pending_write = false;
+    }
+}
+
 /*
  * DXL:
  * Cleans sessions that are currently marked for cleaning
  * db - The database
  */
 static void clean_sessions(struct mosquitto_db *db);
-// DXL: The sessions to clean (via clean_sessions)
-static struct mosquitto **sessions_to_clean = NULL;
-// DXL: The size of the session to clean array
-static int sessions_to_clean_size = 0;
-
-/*
- * DXL: Resizes the clean sessions array to match the current context array size
- * db - The database
- */
-static void resize_sessions_to_clean(struct mosquitto_db *db)
-{
-    if(!sessions_to_clean || sessions_to_clean_size < db->context_count){
-        if(sessions_to_clean){
-            free(sessions_to_clean);
-        }
-        sessions_to_clean_size = db->context_count;
-        sessions_to_clean = (struct mosquitto **)malloc(sessions_to_clean_size * sizeof(struct mosquitto *));
-        memset(sessions_to_clean, 0, sessions_to_clean_size * sizeof(struct mosquitto *));
-    }
-}
 
 void write_context_messages(struct mosquitto_db *db, struct mosquitto *context, time_t now)
 {
@@ -314,10 +328,7 @@ void restart_bridge_connection(struct mosquitto_db *db, struct mosquitto *contex
 void clean_session(struct mosquitto_db *db, uint32_t ctx_idx)
 {
     // DXL Begin
-    resize_sessions_to_clean(db);
-    if(sessions_to_clean_size > 0){
-        sessions_to_clean[0] = db->contexts[ctx_idx];
-        db->contexts[ctx_idx]->clean_subs = true;
+    if(mosquitto_clean_session_queue(db->contexts[ctx_idx])){
         clean_sessions(db);
     }
     // DXL End
@@ -331,18 +342,10 @@ void clean_session(struct mosquitto_db *db, uint32_t ctx_idx)
  */
 static void clean_sessions(struct mosquitto_db *db)
 {
-    bool cleaned_subs = false;    
-    for(int i = 0; i < sessions_to_clean_size; i++){
-        mosquitto* ctx = sessions_to_clean[i];
-        if(!ctx){
-            break;
-        }
-
-        if(!cleaned_subs){
-            // Clean the subscriptions
-            mqtt3_subs_clean_session(db, &db->subs);
-            cleaned_subs = true;
-        }
+    struct mosquitto *ctx;
+    while((ctx = mosquitto_clean_session_next())){
+        // Clean the subscriptions
+        mqtt3_subs_clean_context(db, ctx);
 
         /*
         * Remove context from EPOLL
@@ -352,9 +355,6 @@ static void clean_sessions(struct mosquitto_db *db)
         int contextIndex = ctx->numericId;
         mqtt3_context_cleanup(db, ctx, true, false);
         db->contexts[contextIndex] = NULL;
-
-        // Clear session to clean
-        sessions_to_clean[i] = NULL;
     }
 }
 
@@ -379,7 +379,7 @@ void write_message_loop(struct mosquitto_db *db)
     HASH_ITER(hh, new_msgs_hash, hash, tmp){
         struct mosquitto *context = hash->context;
         if(!IS_CONTEXT_INVALID(context)){ 
-            write_context_messages(db, context, mosquitto_time()); // EPOLL
+            write_context_messages(db, context, mosquitto_time_cached()); // EPOLL
             if(!context->msgs){
                 remove_new_msgs_set(context);
             }
@@ -459,80 +459,207 @@ static void checkPrimaryBridge(time_t now, mosquitto* context)
     } 
 }
 
-void maintenance_loop(struct mosquitto_db *db)
+/*
+ * DXL: Logs the network statistics for the last maintenance interval
+ */
+static void log_net_stats()
 {
+    static struct _mosquitto_net_stats last_stats = {0, 0, 0, 0};
+
+    uint64_t read_calls = g_net_stats.read_calls - last_stats.read_calls;
+    uint64_t packets_read = g_net_stats.packets_read - last_stats.packets_read;
+    if(packets_read > 0){
+        _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG,
+            "Network reads: %" PRIu64 " calls, %" PRIu64 " packets, %.2f calls/packet",
+            read_calls, packets_read, (double)read_calls / packets_read);
+    }
 
-    time_t now = 0;
+    uint64_t write_calls = g_net_stats.write_calls - last_stats.write_calls;
+    uint64_t bytes_written = g_net_stats.bytes_written - last_stats.bytes_written;
+    if(write_calls > 0){
+        _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG,
+            "Network writes: %" PRIu64 " calls, %" PRIu64 " bytes, %.2f bytes/call",
+            write_calls, bytes_written, (double)bytes_written / write_calls);
+    }
+    last_stats = g_net_stats;
+}
+
+// DXL: Logs the size and age histograms of the message store
+static void log_store_stats(struct mosquitto_db *db, time_t now)
+{
+    struct mqtt3_db_store_stats stats;
+    char sizes[256], ages[256];
+    int i, sizes_len = 0, ages_len = 0;
+
+    if(!db->msg_store_count) return;
+
+    mqtt3_db_store_stats(db, now, &stats);
+    for(i=0; i<MQTT3_DB_STORE_HISTOGRAM_BUCKETS; i++){
+        bool last = (i == MQTT3_DB_STORE_HISTOGRAM_BUCKETS - 1);
+        sizes_len += snprintf(sizes + sizes_len, sizeof(sizes) - sizes_len, last ? " >=%u:%d" : " <%u:%d",
+            last ? stats.size_bounds[i-1] : stats.size_bounds[i], stats.size_counts[i]);
+        ages_len += snprintf(ages + ages_len, sizeof(ages) - ages_len, last ? " >=%us:%d" : " <%us:%d",
+            last ? stats.age_bounds[i-1] : stats.age_bounds[i], stats.age_counts[i]);
+    }
+    _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG,
+        "Message store: %d messages, %" PRIu64 " bytes, sizes%s, ages%s",
+        stats.count, stats.bytes, sizes, ages);
+}
+
+// DXL: Logs the occupancy of the memory pools
+static void log_pool_stats()
+{
+    struct _mosquitto_pool_stats stats;
     int i;
 
+    for(i=0; i<_mosquitto_pool_class_count(); i++){
+        _mosquitto_pool_get_stats(i, &stats);
+        if(stats.slabs > 0){
+            _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG,
+                "Memory pool (%zu bytes): %" PRIu64 " slabs, %" PRIu64 " objects, %" PRIu64 " in use",
+                stats.size, stats.slabs, stats.capacity, stats.in_use);
+        }
+    }
+}
 
-    int clean_session_index = 0; // DXL
-    resize_sessions_to_clean(db); // DXL
+// DXL: Logs the hit rate of the subscription match cache
+static void log_sub_cache_stats()
+{
+    struct mqtt3_sub_cache_stats stats;
+    uint64_t lookups;
 
+    mqtt3_sub_cache_stats(&stats);
+    lookups = stats.hits + stats.misses;
+    if(!lookups) return;
 
-    for(i=0; i<db->context_count; i++){
-        if(db->contexts[i]){
-            now = mosquitto_time();            
-            db->contexts[i]->pollfd_index = -1;
+    _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG,
+        "Subscription cache: %d entries, %" PRIu64 " hits, %" PRIu64 " misses (%.1f%% hit rate)",
+        stats.entries, stats.hits, stats.misses, 100.0 * stats.hits / lookups);
+}
 
-            if(!IS_CONTEXT_INVALID(db->contexts[i])){
-                if(db->contexts[i]->bridge){
-                    _mosquitto_check_keepalive(db->contexts[i]);
+/*
+ * DXL: Invoked when the maintenance timer of a context expires. This performs
+ * the keepalive, bridge and message retry checks of the context and schedules
+ * the timer for the next time the context requires attention.
+ */
+static void context_timer_expired(struct mosquitto_timer *timer, time_t now)
+{
+    struct mosquitto_db *db = _mosquitto_get_db();
+    struct mosquitto *context = (struct mosquitto *)timer->data;
+    time_t next = 0;
 
-                    // DXL Begin
-                    if(db->contexts[i]->sock == INVALID_SOCKET){ 
-                        // Bridge connection timed out, fire a bridge disconnected event
-                        dxl_on_bridge_disconnected(db->contexts[i]);
-                    }
-                    // DXL End
-
-                    checkPrimaryBridge(now, db->contexts[i]);
-                } 
-                if(!db->contexts[i]->bridge &&
-                    db->contexts[i]->keepalive &&
-                    ((now - db->contexts[i]->last_msg_in) >= ((time_t)(db->contexts[i]->keepalive)*3/2))){
-                    if(db->config->connection_messages == true){
-                        if(IS_NOTICE_ENABLED)
-                            _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
-                            "Client %s has exceeded timeout, disconnecting.", db->contexts[i]->id);
-                    }
+    context->pollfd_index = -1;
+
+    if(!IS_CONTEXT_INVALID(context)){
+        if(context->bridge){
+            _mosquitto_check_keepalive(context);
 
-                    /* Client has exceeded keepalive*1.5 */
-                    mqtt3_context_disconnect(db, db->contexts[i]);
+            // DXL Begin
+            if(context->sock == INVALID_SOCKET){ 
+                // Bridge connection timed out, fire a bridge disconnected event
+                dxl_on_bridge_disconnected(context);
+            }
+            // DXL End
+
+            checkPrimaryBridge(now, context);
+
+            next = now + MAINTENANCE_INTERVAL;
+            if(context->bridge->primary_retry > now && context->bridge->primary_retry < next){
+                next = context->bridge->primary_retry + 1;
+            }
+        }else if(context->keepalive){
+            time_t deadline = context->last_msg_in + (time_t)(context->keepalive)*3/2;
+            if(now >= deadline){
+                if(db->config->connection_messages == true){
+                    if(IS_NOTICE_ENABLED)
+                        _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
+                        "Client %s has exceeded timeout, disconnecting.", context->id);
                 }
+
+                /* Client has exceeded keepalive*1.5 */
+                mqtt3_context_disconnect(db, context);
             }else{
-                if(db->contexts[i]->bridge){
-                    restart_bridge_connection(db, db->contexts[i], now, i); // EPOLL
-                }else{ 
-                    if(db->contexts[i]->clean_session == true){
-                        if(IS_DEBUG_ENABLED)
-                            _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
-                            "Cleaning session %s with index %d and numeric_id %d.", 
-                            db->contexts[i]->id, i, db->contexts[i]->numericId);
-                        // DXL Begin
-                        sessions_to_clean[clean_session_index++] = db->contexts[i];
-                        db->contexts[i]->clean_subs = true;
-                        //clean_session(db, i);
-                        // DXL End
-                    }
-                }
+                next = deadline;
+            }
+        }
+    }else{
+        if(context->bridge){
+            restart_bridge_connection(db, context, now, context->numericId); // EPOLL
+            next = now + MAINTENANCE_INTERVAL;
+        }else if(context->clean_session == true){
+            if(IS_DEBUG_ENABLED)
+                _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
+                "Cleaning session %s with numeric_id %d.", context->id, context->numericId);
+            if(!mosquitto_clean_session_queue(context)){
+                next = now + MAINTENANCE_INTERVAL;
             }
         }
+    }
 
-        if(db->contexts[i] && db->contexts[i]->msgs)
-            mqtt3_db_message_timeout_check(db->contexts[i], db->config->retry_interval);
-    } 
+    /* The in-flight messages of disconnected contexts are reset when they reconnect */
+    if(context->msgs && !IS_CONTEXT_INVALID(context)){
+        mqtt3_db_message_timeout_check(context, db->config->retry_interval);
+        if(!next || next > now + MAINTENANCE_INTERVAL){
+            next = now + MAINTENANCE_INTERVAL;
+        }
+    }
 
+    if(next){
+        mosquitto_context_timer_update(context, next);
+    }
+}
+
+void mosquitto_context_timer_start(struct mosquitto *context)
+{
+    context->timer.data = context;
+    context->timer.callback = context_timer_expired;
+    mosquitto_timer_schedule(&context->timer, mosquitto_time_cached());
+}
+
+void mosquitto_context_timer_update(struct mosquitto *context, time_t expiry)
+{
+    /* Contexts that have not been added to the database do not have a timer */
+    if(!context->timer.data){
+        return;
+    }
+    if(!context->timer.slot || context->timer.expiry > expiry){
+        mosquitto_timer_schedule(&context->timer, expiry);
+    }
+}
+
+/*
+ * DXL: Performs the periodic maintenance that is not specific to a context
+ * (the per-context checks are driven by the context timers).
+ */
+static void maintenance_loop(struct mosquitto_db *db, time_t now)
+{
     // DXL Begin
-    if(clean_session_index > 0){
+    if(mosquitto_clean_session_count() > 0){
         clean_sessions(db);
     }
     // DXL End
 
-    // DXL: Force trim of memory. For some reason the allocation pattern of Mosquitto
-    // causes memory to not be returned to the OS. This forces the memory to be returned.
-    malloc_trim(0);
+    dxl_on_maintenance(now);
+    if(db->config->ws_enabled){
+        mosquitto_ws_do_maintenance();
+    }
+
+    if(IS_DEBUG_ENABLED){
+        log_net_stats();
+        log_pool_stats(); // DXL
+        log_store_stats(db, now); // DXL
+        log_sub_cache_stats(); // DXL
+        _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG, "Timers: %d", mosquitto_timer_count()); // DXL
+    }
+}
+
+/* DXL: The timer for the periodic maintenance */
+static struct mosquitto_timer maintenance_timer;
 
+static void maintenance_timer_expired(struct mosquitto_timer *timer, time_t now)
+{
+    maintenance_loop(_mosquitto_get_db(), now);
+    mosquitto_timer_schedule(timer, now + MAINTENANCE_INTERVAL);
 }
 
 static struct epoll_event epoll_events[MAXEVENTS];
@@ -557,10 +684,237 @@ void mosquitto_epoll_destroy()
 {
 }
 
+/*
+ * DXL: Write threads
+ *
+ * The socket writes of connected clients are offloaded to a set of write threads.
+ * Each write thread owns the slice of db->contexts whose index modulo the write
+ * thread count is its index. The packets that are queued during a loop iteration
+ * are flushed by the write threads in parallel prior to waiting for events. Only
+ * the write threads that own contexts with pending writes are woken. The main
+ * thread acts as the first write thread and waits for the others to complete, so
+ * the packets of a context are never accessed by more than one thread at a time.
+ *
+ * Only the writes are offloaded: the main thread still waits for all events, reads
+ * and handles every packet, and routes every message.
+ */
+struct mosquitto_write_thread {
+    pthread_t thread;
+    /* Signalled when a flush is requested (or the write threads are stopping) */
+    pthread_cond_t start_cond;
+    /* Whether a flush has been requested and has not completed */
+    bool flush_requested;
+    /* The contexts to flush */
+    struct mosquitto **contexts;
+    /* The result of flushing each context */
+    int *results;
+    int context_count;
+    int context_size;
+    /* The network statistics of the last flush */
+    struct _mosquitto_net_stats stats;
+};
+
+static struct mosquitto_write_thread *write_threads = NULL;
+static int write_thread_count = 1;
+static pthread_mutex_t write_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t write_thread_done_cond = PTHREAD_COND_INITIALIZER;
+/* The count of write threads that have not completed the current flush */
+static int write_thread_pending = 0;
+static bool write_thread_stopping = false;
+
+static void write_thread_flush(struct mosquitto_write_thread *writer)
+{
+    int i;
+    for(i=0; i<writer->context_count; i++){
+        writer->results[i] = _mosquitto_packet_write(writer->contexts[i]);
+    }
+}
+
+static void* write_thread_main(void *arg)
+{
+    struct mosquitto_write_thread *writer = (struct mosquitto_write_thread *)arg;
+
+    pthread_mutex_lock(&write_thread_mutex);
+    while(true){
+        while(!write_thread_stopping && !writer->flush_requested){
+            pthread_cond_wait(&writer->start_cond, &write_thread_mutex);
+        }
+        if(write_thread_stopping) break;
+        pthread_mutex_unlock(&write_thread_mutex);
+
+        write_thread_flush(writer);
+        writer->stats = g_net_stats;
+        memset(&g_net_stats, 0, sizeof(g_net_stats));
+
+        pthread_mutex_lock(&write_thread_mutex);
+        writer->flush_requested = false;
+        if(--write_thread_pending == 0){
+            pthread_cond_signal(&write_thread_done_cond);
+        }
+    }
+    pthread_mutex_unlock(&write_thread_mutex);
+
+    return NULL;
+}
+
+int mosquitto_write_threads_init(int count)
+{
+    sigset_t sigblock, sigprev;
+    int i, rc;
+
+    write_thread_count = (count > 1 ? count : 1);
+    write_threads = (struct mosquitto_write_thread *)_mosquitto_calloc(write_thread_count, sizeof(struct mosquitto_write_thread));
+    if(!write_threads) return 1;
+    if(write_thread_count == 1) return 0;
+
+    for(i=1; i<write_thread_count; i++){
+        pthread_cond_init(&write_threads[i].start_cond, NULL);
+    }
+
+    _mosquitto_net_thread_init();
+
+    /* Signals are handled by the main thread */
+    sigfillset(&sigblock);
+    pthread_sigmask(SIG_BLOCK, &sigblock, &sigprev);
+    for(i=1; i<write_thread_count; i++){
+        rc = pthread_create(&write_threads[i].thread, NULL, write_thread_main, &write_threads[i]);
+        if(rc){
+            _mosquitto_log_printf(NULL, MOSQ_LOG_ERR,
+                "Error: Unable to create write thread: %s.", strerror(rc));
+            write_thread_count = i;
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &sigprev, NULL);
+
+    if(IS_INFO_ENABLED)
+        _mosquitto_log_printf(NULL, MOSQ_LOG_INFO, "Write threads: %d", write_thread_count);
+
+    return 0;
+}
+
+void mosquitto_write_threads_destroy()
+{
+    int i;
+
+    if(!write_threads) return;
+
+    pthread_mutex_lock(&write_thread_mutex);
+    write_thread_stopping = true;
+    for(i=1; i<write_thread_count; i++){
+        pthread_cond_signal(&write_threads[i].start_cond);
+    }
+    pthread_mutex_unlock(&write_thread_mutex);
+
+    for(i=0; i<write_thread_count; i++){
+        if(i > 0){
+            pthread_join(write_threads[i].thread, NULL);
+            pthread_cond_destroy(&write_threads[i].start_cond);
+        }
+        free(write_threads[i].contexts);
+        free(write_threads[i].results);
+    }
+    _mosquitto_free(write_threads);
+    write_threads = NULL;
+}
+
+int mosquitto_write_thread_count()
+{
+    return write_thread_count;
+}
+
+/* Adds a context to the contexts that are to be flushed by the write thread */
+static bool write_thread_add_context(struct mosquitto_write_thread *writer, struct mosquitto *context)
+{
+    if(writer->context_count == writer->context_size){
+        int size = (writer->context_size ? writer->context_size * 2 : 64);
+        struct mosquitto **contexts =
+            (struct mosquitto **)realloc(writer->contexts, size * sizeof(struct mosquitto *));
+        if(!contexts) return false;
+        writer->contexts = contexts;
+        int *results = (int *)realloc(writer->results, size * sizeof(int));
+        if(!results) return false;
+        writer->results = results;
+        writer->context_size = size;
+    }
+    writer->contexts[writer->context_count++] = context;
+    return true;
+}
+
+/*
+ * DXL: Flushes the packets of the contexts that have pending writes (distributed
+ * across the write threads)
+ */
+static void flush_pending_writes(struct mosquitto_db *db)
+{
+    struct context_hash *s, *tmp;
+    struct mosquitto_write_thread *writer;
+    int context_count = 0;
+    int i, j;
+
+    if(!pending_writes_hash) return;
+
+    HASH_ITER(hh, pending_writes_hash, s, tmp){
+        struct mosquitto *context = s->context;
+        mosquitto_remove_pending_writes_set(context);
+        if(IS_CONTEXT_INVALID(context)) continue;
+
+        writer = &write_threads[context->numericId % write_thread_count];
+        if(write_thread_add_context(writer, context)){
+            context_count++;
+        }else if(_mosquitto_packet_write(context)){
+            handle_write_error(db, context);
+        }
+    }
+
+    if(context_count > 1){
+        /* Wake the write threads that have contexts to flush */
+        pthread_mutex_lock(&write_thread_mutex);
+        for(i=1; i<write_thread_count; i++){
+            if(write_threads[i].context_count > 0){
+                write_threads[i].flush_requested = true;
+                write_thread_pending++;
+                pthread_cond_signal(&write_threads[i].start_cond);
+            }
+        }
+        pthread_mutex_unlock(&write_thread_mutex);
+
+        write_thread_flush(&write_threads[0]);
+
+        pthread_mutex_lock(&write_thread_mutex);
+        while(write_thread_pending > 0){
+            pthread_cond_wait(&write_thread_done_cond, &write_thread_mutex);
+        }
+        pthread_mutex_unlock(&write_thread_mutex);
+
+        for(i=1; i<write_thread_count; i++){
+            if(write_threads[i].context_count > 0){
+                g_net_stats.write_calls += write_threads[i].stats.write_calls;
+                g_net_stats.bytes_written += write_threads[i].stats.bytes_written;
+            }
+        }
+    }else{
+        /* Not worth waking the write threads */
+        for(i=0; i<write_thread_count; i++){
+            write_thread_flush(&write_threads[i]);
+        }
+    }
+
+    for(i=0; i<write_thread_count; i++){
+        writer = &write_threads[i];
+        for(j=0; j<writer->context_count; j++){
+            if(writer->results[j]){
+                handle_write_error(db, writer->contexts[j]);
+            }
+        }
+        writer->context_count = 0;
+    }
+}
+
 int mosquitto_main_loop(struct mosquitto_db *db)
 {
-    time_t start_time = mosquitto_time();
-    time_t last_store_clean = mosquitto_time();
+    mosquitto_time_update(); // DXL
+    time_t start_time = mosquitto_time_cached();
     int fdcount;
     int i;
 
@@ -568,7 +922,9 @@ int mosquitto_main_loop(struct mosquitto_db *db)
     sigemptyset(&sigblock);
     sigaddset(&sigblock, SIGINT);
 
-    time_t do_maintenance = start_time; // Loop OPT
+    // DXL: The first maintenance is performed immediately
+    maintenance_timer.callback = maintenance_timer_expired;
+    mosquitto_timer_schedule(&maintenance_timer, start_time);
 
     // Add listeners to EPOLL
     if(epoll_add_listeners()){
@@ -576,22 +932,19 @@ int mosquitto_main_loop(struct mosquitto_db *db)
     }
 
     while(run){
+        mosquitto_time_update(); // DXL
         write_message_loop(db);
-        /* The wait time is 100 milliseconds.  Run this loop every 10 seconds. */
-        time_t now = mosquitto_time();
-        if(now >= do_maintenance){
-            maintenance_loop(db);
-            dxl_on_maintenance(now);
-            if(db->config->ws_enabled){
-                mosquitto_ws_do_maintenance();
-            }
-            do_maintenance = now + 10;
-        }
+        /* DXL: Fire the keepalive, bridge retry and maintenance timers that have expired */
+        mosquitto_timer_process(mosquitto_time_cached());
+
+        // DXL: Flush the packets that were queued during this iteration
+        flush_pending_writes(db);
 
         int waitTime = HASH_COUNT(pending_bytes_hash) > 0 ? 0 : 100;
 
         /* See if there are any events */
         fdcount = epoll_pwait(efd, epoll_events, MAXEVENTS, waitTime, &sigblock);
+        mosquitto_time_update(); // DXL
         if(fdcount == -1){
             _mosquitto_log_printf(NULL, MOSQ_LOG_ERR,
                 "epoll_wait: error %d", errno);
@@ -618,10 +971,9 @@ int mosquitto_main_loop(struct mosquitto_db *db)
                 }
             }
         }
-        if(!db->config->store_clean_interval || last_store_clean + db->config->store_clean_interval < mosquitto_time()){
-            mqtt3_db_store_clean(db);
-            last_store_clean = mosquitto_time();
-        }
+
+        // DXL: Add the contexts whose TLS handshakes have completed
+        mosquitto_handshake_process(db);
 
         // Run the work queue (if there are any pending tasks)
         dxl_run_work_queue();
@@ -665,6 +1017,9 @@ static void loop_handle_reads_writes(struct mosquitto_db *db, struct epoll_event
             mosquitto_ws_handle_poll(event);
             continue;
         }
+        if(mosquitto_epoll_flag_is_handshake(event)){
+            continue;/* Handled once the events have been processed */
+        }
         uint32_t contextid = event->data.u32;
         struct mosquitto *context = db->contexts[contextid];
 
@@ -807,6 +1162,23 @@ static int epoll_add_listeners()
     return 0;
 }
 
+int mosquitto_epoll_add_handshake_fd(int fd)
+{
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.u64 = MOSQUITTO_EPOLL_DATA_HANDSHAKE_FLAG;
+    if(epoll_ctl(efd, EPOLL_CTL_ADD, fd, &event) == -1){
+        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+bool mosquitto_epoll_flag_is_handshake(struct epoll_event *event)
+{
+    return (event->data.u64 & MOSQUITTO_EPOLL_DATA_HANDSHAKE_FLAG) != 0;
+}
+
 bool mosquitto_epoll_flag_is_listener(struct epoll_event *event)
 {
     return (event->data.u32 & MOSQUITTO_EPOLL_DATA_LISTENER_FLAG) != 0;
@@ -819,19 +1191,7 @@ static void handle_write(struct mosquitto_db *db, struct mosquitto *context, str
         if(event->events & EPOLLOUT || context->want_write ||
             (context->ssl && context->state == mosq_cs_new)){
             if(_mosquitto_packet_write(context)){
-                if(db->config->connection_messages == true){
-                    if(context->state != mosq_cs_disconnecting){
-                        if(IS_NOTICE_ENABLED)
-                            _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
-                                "Socket write error on client %s, disconnecting.", context->id);
-                    }else{
-                        if(IS_NOTICE_ENABLED)
-                            _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
-                                "Client %s disconnected.", context->id);
-                    }
-                }
-                /* Write error or other that means we should disconnect */
-                mqtt3_context_disconnect(db, context);
+                handle_write_error(db, context);
             }
 
             // Update context, if no packets left, EPOLLOUT will be removed
@@ -840,6 +1200,23 @@ static void handle_write(struct mosquitto_db *db, struct mosquitto *context, str
     }
 }
 
+static void handle_write_error(struct mosquitto_db *db, struct mosquitto *context)
+{
+    if(db->config->connection_messages == true){
+        if(context->state != mosq_cs_disconnecting){
+            if(IS_NOTICE_ENABLED)
+                _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
+                    "Socket write error on client %s, disconnecting.", context->id);
+        }else{
+            if(IS_NOTICE_ENABLED)
+                _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
+                    "Client %s disconnected.", context->id);
+        }
+    }
+    /* Write error or other that means we should disconnect */
+    mqtt3_context_disconnect(db, context);
+}
+
 static void handle_read(struct mosquitto_db *db, struct mosquitto *context, struct epoll_event *event)
 {
     if(context && context->sock != INVALID_SOCKET){
@@ -264,6 +264,11 @@ int main(int argc, char *argv[])
     struct cert_hashes* brokerCertsUtHash = NULL;
     bool webSocketsEnabled = false;
     int webSocketsPort = 443;
+    int writeThreadCount = 1;
+    int tlsHandshakeThreadCount = 0;
+    int tlsSessionCacheSize = 0;
+    bool tlsSessionTicketsEnabled = false;
+    int tlsSessionTimeout = 300;
     const char *sslver;
 
     if(!dxl_main(argc, argv,
@@ -283,7 +288,12 @@ int main(int argc, char *argv[])
         &user,
         &brokerCertsUtHash,
         &webSocketsEnabled,
-        &webSocketsPort)){
+        &webSocketsPort,
+        &writeThreadCount,
+        &tlsHandshakeThreadCount,
+        &tlsSessionCacheSize,
+        &tlsSessionTicketsEnabled,
+        &tlsSessionTimeout)){
 
         // Failed to start the broker library, exit.
         _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Broker library forced exit (main).");
@@ -325,6 +335,9 @@ int main(int argc, char *argv[])
         brokerCertFile, ciphers,
         brokerCertsUtHash);
 
+    // Set the TLS session resumption settings
+    mqtt3_config_update_tls_sessions(
+        &config, tlsSessionCacheSize, tlsSessionTicketsEnabled, tlsSessionTimeout);
 
     // Set the maximum packet buffer size
     mqtt3_dxl_set_max_packet_buffer_size(maxPacketBufferSize);
@@ -422,6 +435,18 @@ int main(int argc, char *argv[])
     // Initialize epoll
     mosquitto_epoll_init();
 
+    // DXL: Start the write threads
+    if(mosquitto_write_threads_init(writeThreadCount)){
+        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Unable to start write threads.");
+        return 1;
+    }
+
+    // DXL: Start the TLS handshake threads
+    if(mosquitto_handshake_init(tlsHandshakeThreadCount)){
+        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Unable to start TLS handshake threads.");
+        return 1;
+    }
+
     // DXL Begin
     // Initialize the broker library
     if(!dxl_brokerlib_init()){
@@ -469,14 +494,15 @@ int main(int argc, char *argv[])
         mosquitto_ws_destroy();
     }
 
+    mosquitto_handshake_destroy();
+    mosquitto_write_threads_destroy();
     mosquitto_epoll_destroy();
 
     for(i=0; i<int_db.context_count; i++){
         if(int_db.contexts[i]){
-            int_db.contexts[i]->clean_subs = true;
+            mqtt3_subs_clean_context(&int_db, int_db.contexts[i]);
         }
     }
-    mqtt3_subs_clean_session(&int_db, &int_db.subs);
     for(i=0; i<int_db.context_count; i++){
         if(int_db.contexts[i]){
             mqtt3_context_cleanup(&int_db, int_db.contexts[i], true, false);
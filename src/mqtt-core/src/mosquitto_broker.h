@@ -31,6 +31,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define MQTT3_H
 
 #include "dxlcommon.h"
+#include "payload_splice.h"
 
 #include <config.h>
 #include <stdio.h>
@@ -60,6 +61,9 @@ POSSIBILITY OF SUCH DAMAGE.
 /* Flag for tracking websockets */
 #define MOSQUITTO_EPOLL_DATA_WEBSOCKETS_FLAG 0x0000000100000000
 
+/* DXL: Flag for tracking completed TLS handshakes */
+#define MOSQUITTO_EPOLL_DATA_HANDSHAKE_FLAG  0x0000000200000000
+
 typedef uint64_t dbid_t;
 
 struct _mqtt3_listener {
@@ -79,6 +83,11 @@ struct _mqtt3_listener {
     SSL_CTX *ssl_ctx;
     char *crlfile;
     char *tls_version;
+    // DXL Begin
+    int tls_session_cache_size;
+    bool tls_session_tickets;
+    int tls_session_timeout;
+    // DXL End
 };
 
 struct mqtt3_config {
@@ -99,7 +108,6 @@ struct mqtt3_config {
     char *pid_file;
     bool queue_qos0_messages;
     int retry_interval;
-    int store_clean_interval;
     bool upgrade_outgoing_qos;
     char *user;
     bool verbose;
@@ -110,34 +118,116 @@ struct mqtt3_config {
 };
 
 struct _mosquitto_subleaf {
-    struct _mosquitto_subleaf *prev;
-    struct _mosquitto_subleaf *next;
     struct mosquitto *context;
     int qos;
+    // DXL Begin
+    /* The position of the subscription in _mosquitto_subhier::subs */
+    int index;
+    /* The node the subscription is attached to */
+    struct _mosquitto_subhier *hier;
+    /* The other subscriptions of the context (see mosquitto::subs) */
+    struct _mosquitto_subleaf *context_prev;
+    struct _mosquitto_subleaf *context_next;
+    // DXL End
+};
+
+// DXL Begin
+/* A topic level, interned in the level table of the subscription tree (see subs.c) */
+struct _mosquitto_sublevel {
+    /* The hash of the level (see topic_level_hash) */
+    unsigned int hash;
+    unsigned int len;
+    /* The count of nodes (and tenant partitions) referring to the level */
+    unsigned int ref_count;
+    char topic[1];
+};
+
+/*
+ * A partition of the subscriptions of a node in multi-tenant mode: the subscriptions of
+ * the clients of a tenant, or of operations clients and bridges (tenant is NULL).
+ */
+struct _mosquitto_subpart {
+    /* The GUID of the tenant, interned in the level table */
+    struct _mosquitto_sublevel *tenant;
+    /* The range of the partition in _mosquitto_subhier::subs */
+    int start;
+    int count;
 };
 
+/* The indexes of the subscriptions of a node (allocated only when one is present) */
+struct _mosquitto_subindex {
+    /*
+     * The subscriptions by context, an open addressing table of 2 * sub_size slots (only
+     * present beyond SUBHIER_SMALL_SUBS subscriptions, below the array is scanned)
+     */
+    struct _mosquitto_subleaf **by_context;
+    /*
+     * The tenant partitions in multi-tenant mode, sorted by tenant (level hash). The
+     * subscriptions array is laid out partition after partition, in the same order.
+     */
+    struct _mosquitto_subpart *parts;
+    int part_count;
+    int part_size;
+};
+// DXL End
+
+/*
+ * DXL: The nodes of the subscription tree. Nodes and leaves are allocated from the
+ * memory pools and the levels are interned, so that nodes with a single subscription
+ * (reply topics for example) stay small.
+ */
 struct _mosquitto_subhier {
-    struct _mosquitto_subhier *children;
-    struct _mosquitto_subhier *next;
-    struct _mosquitto_subleaf *subs;
-    char *topic;
+    struct _mosquitto_subhier *parent;
+    /*
+     * The children. While there are few, this is an array (child_size entries, the first
+     * child_count in use) sorted by level hash. Beyond SUBHIER_SMALL_CHILDREN it is an
+     * open addressing table of child_size slots (see search_optimization.h).
+     */
+    struct _mosquitto_subhier **children;
+    /* The subscriptions of the node (dense, grouped by tenant partition if partitioned) */
+    struct _mosquitto_subleaf **subs;
+    /* The indexes of the subscriptions (by context and by tenant) */
+    struct _mosquitto_subindex *index;
+    struct _mosquitto_sublevel *level;
     struct mosquitto_msg_store *retained;
+    /* DXL: Stamped whenever the children of the node change (see the match cache in subs.c) */
+    uint64_t generation;
+    unsigned int child_count;
+    unsigned int child_size;
+    int sub_count;
+    int sub_size;
+    /* The count of subscriptions that are not from bridges */
+    int client_sub_count;
     // Search OPT Begin
-    struct subheir_hash *children_hash_table;
-    int hash_table_has_pound_wild_card;
-    int hash_table_has_plus_wild_card;
+    bool has_pound_wild_card;
+    bool has_plus_wild_card;
     // Search OPT End
 };
 
 struct mosquitto_msg_store{
     struct mosquitto_msg_store *next;
+    struct mosquitto_msg_store *prev; // DXL
     dbid_t db_id;
+    /* DXL: The message is freed as soon as the count of references drops to zero */
     int ref_count;
+    time_t timestamp; // DXL: The time the message was stored
     char *source_id;
     char **dest_ids;
     int dest_id_count;
     uint16_t source_mid;
     struct mosquitto_message msg;
+    // DXL: Encoded QoS 0 PUBLISH frames, shared by the destination contexts
+    // (index 0 is for the payload, index 1 is for the client payload)
+    struct _mosquitto_frame *frames[2];
+    // DXL: Received packet buffer that the topic and payload reference (zero-copy ingest)
+    uint8_t *buffer;
+    uint32_t buffer_len;
+    // DXL: Broker library context of the message (set when stored, cleared when finalized)
+    void *dxl_context;
+    // DXL: Rewritten fields that surround a region of the payload, when the broker library
+    // rewrites the message without copying its body. The payload is kept for the region,
+    // and the payload length is that of the rewritten message (see _db_store_payload_parts).
+    struct payload_splice splice;
 };
 
 struct mosquitto_client_msg{
@@ -167,8 +257,10 @@ struct mosquitto_db{
     struct mosquitto **contexts;
     struct _clientid_index_hash *clientid_index_hash;
     int context_count;
+    /* DXL: The stored messages (newest first), kept for diagnostics only */
     struct mosquitto_msg_store *msg_store;
     int msg_store_count;
+    uint64_t msg_store_bytes; // DXL
     struct mqtt3_config *config;
     int subscription_count;
     int retained_count;
@@ -245,20 +337,58 @@ int mosquitto_epoll_init();
 void mosquitto_epoll_destroy();
 bool mosquitto_epoll_flag_is_listener(struct epoll_event *event);
 bool mosquitto_epoll_flag_is_websocket(struct epoll_event *event);
+bool mosquitto_epoll_flag_is_handshake(struct epoll_event *event);
+int mosquitto_epoll_add_handshake_fd(int fd);
 int mosquitto_main_loop(struct mosquitto_db *db);
 int mosquitto_get_listensock_count();
 int* mosquitto_get_listensocks();
 void mosquitto_set_listensocks(int* socks, int sock_count);
 void mosquitto_add_pending_bytes_set(struct mosquitto* context);
 void mosquitto_remove_pending_bytes_set(struct mosquitto* context);
+void mosquitto_add_pending_writes_set(struct mosquitto* context);
+void mosquitto_remove_pending_writes_set(struct mosquitto* context);
+int mosquitto_write_threads_init(int count);
+void mosquitto_write_threads_destroy();
+int mosquitto_write_thread_count();
+int mosquitto_handshake_init(int count);
+void mosquitto_handshake_destroy();
+void mosquitto_handshake_process(struct mosquitto_db *db);
 void mosquitto_add_new_clients_set(struct mosquitto* context);
 void mosquitto_add_new_msgs_set(struct mosquitto* context);
 void mosquitto_update_context(uint32_t ctx_idx, struct mosquitto *context);
 void mosquitto_epoll_update_context_index(struct mosquitto *context, uint32_t new_ctx_idx);
 int mosquitto_epoll_restart_listeners();
 void mosquitto_remove_context(struct mosquitto *context);
+/* Starts the maintenance timer of a context that has been added to the database */
+void mosquitto_context_timer_start(struct mosquitto *context);
+/* Ensures the maintenance timer of a context fires no later than the specified time */
+void mosquitto_context_timer_update(struct mosquitto *context, time_t expiry);
 // DXL End
 
+/* ============================================================
+ * DXL: Timer wheel functions (timer.c, main loop only)
+ * ============================================================ */
+/* Schedules (or reschedules) the timer to fire at the specified time. */
+void mosquitto_timer_schedule(struct mosquitto_timer *timer, time_t expiry);
+/* Cancels the timer (if it is scheduled). */
+void mosquitto_timer_cancel(struct mosquitto_timer *timer);
+/* Fires the timers that have expired as of the specified time. */
+void mosquitto_timer_process(time_t now);
+/* Returns the count of scheduled timers. */
+int mosquitto_timer_count();
+
+/* ============================================================
+ * DXL: Sessions to clean (session_clean.c, main loop only)
+ * ============================================================ */
+/* Queues the session of the context to be cleaned. Returns false if out of memory. */
+bool mosquitto_clean_session_queue(struct mosquitto *context);
+/* Removes the context from the sessions to clean (if it is queued), for example on takeover. */
+void mosquitto_clean_session_cancel(struct mosquitto *context);
+/* Returns the next queued context to clean (removed from the queue), or NULL if none remain. */
+struct mosquitto *mosquitto_clean_session_next();
+/* Returns the count of queued contexts. */
+int mosquitto_clean_session_count();
+
 struct mosquitto_db *_mosquitto_get_db(void);
 
 /* ============================================================
@@ -333,6 +463,20 @@ int mqtt3_config_update_tls(
     const char* ciphers,
     struct cert_hashes* brokerCertsUtHash );
 
+/**
+ * Updates the TLS session resumption settings of the listeners
+ *
+ * @param   config The Mosquitto config
+ * @param   sessionCacheSize The size of the server-side session cache (0 disables the cache)
+ * @param   sessionTicketsEnabled Whether session tickets are enabled
+ * @param   sessionTimeout The session timeout (and ticket key rotation interval) in seconds
+ */
+int mqtt3_config_update_tls_sessions(
+    struct mqtt3_config *config,
+    int sessionCacheSize,
+    bool sessionTicketsEnabled,
+    int sessionTimeout);
+
 /**
  * Determines whether the specified certificate is a broker cert
  *
@@ -400,15 +544,43 @@ int mqtt3_db_messages_easy_queue(struct mosquitto_db *db, struct mosquitto *cont
     uint32_t payloadlen, const void *payload, int retain);
 int mqtt3_db_messages_queue(struct mosquitto_db *db, const char *source_id, const char *topic, int qos, int retain,
     struct mosquitto_msg_store *stored);
+/* Stores a message. The stored message is returned with a reference held by the caller (DXL), which
+ * must be released via mqtt3_db_msg_store_ref_dec() once it has been queued. */
 int mqtt3_db_message_store(struct mosquitto_db *db, struct mosquitto* context /*DXL*/, const char *source,
     uint16_t source_mid, const char *topic, int qos, uint32_t payloadlen, const void *payload, int retain,
     struct mosquitto_msg_store **stored, dbid_t store_id);
+/* DXL: Stores a message whose topic and payload reference the packet payload. On success, the
+ * store takes ownership of the payload (and the packet is left without one). */
+int mqtt3_db_message_store_packet(struct mosquitto_db *db, struct mosquitto* context, const char *source,
+    uint16_t source_mid, const char *topic, int qos, uint32_t payloadlen, const void *payload, int retain,
+    struct mosquitto_msg_store **stored, struct _mosquitto_packet *packet);
 int mqtt3_db_message_store_find(struct mosquitto *context, uint16_t mid, struct mosquitto_msg_store **stored);
 /* Check all messages waiting on a client reply and resend if timeout has been exceeded. */
 int mqtt3_db_message_timeout_check(struct mosquitto *context /* DXL */, unsigned int timeout);
 int mqtt3_db_message_reconnect_reset(struct mosquitto *context);
 int mqtt3_retain_queue(struct mosquitto_db *db, struct mosquitto *context, const char *sub, int sub_qos);
 void mqtt3_db_store_clean(struct mosquitto_db *db);
+// DXL Begin
+/* Adds a reference to the stored message. */
+void mqtt3_db_msg_store_ref_inc(struct mosquitto_msg_store *stored);
+/* Releases a reference to the stored message, finalizing and freeing it when it was the last one. */
+void mqtt3_db_msg_store_ref_dec(struct mosquitto_msg_store *stored);
+/* The count of message store histogram buckets */
+#define MQTT3_DB_STORE_HISTOGRAM_BUCKETS 6
+/* Statistics of the messages that are currently stored */
+struct mqtt3_db_store_stats{
+    int count;
+    uint64_t bytes;
+    /* The upper bounds of the size (bytes) and age (seconds) buckets (the last is unbounded) */
+    const uint32_t *size_bounds;
+    const uint32_t *age_bounds;
+    /* The count of messages per size and age bucket */
+    int size_counts[MQTT3_DB_STORE_HISTOGRAM_BUCKETS];
+    int age_counts[MQTT3_DB_STORE_HISTOGRAM_BUCKETS];
+};
+/* Returns the statistics of the stored messages (walks the store, intended for diagnostics). */
+void mqtt3_db_store_stats(struct mosquitto_db *db, time_t now, struct mqtt3_db_store_stats *stats);
+// DXL End
 void mqtt3_db_sys_update(struct mosquitto_db *db, int interval, time_t start_time);
 void mqtt3_db_vacuum(void);
 bool mqtt3_db_lookup_client(const char* clientId, struct mosquitto_db *db); // DXL
@@ -422,11 +594,24 @@ int mqtt3_sub_remove(struct mosquitto_db *db, struct mosquitto *context, const c
     struct _mosquitto_subhier *root);
 int mqtt3_sub_search(struct mosquitto_db *db, struct _mosquitto_subhier *root, const char *source_id,
     const char *topic, int qos, int retain, struct mosquitto_msg_store *stored);
-int mqtt3_subs_clean_session(struct mosquitto_db *db, struct _mosquitto_subhier *root);
+/* DXL: Removes all of the subscriptions of the context. */
+int mqtt3_subs_clean_context(struct mosquitto_db *db, struct mosquitto *context);
+/* DXL: Moves the subscriptions of the context to the tenant partition of its tenant and flags. */
+void mqtt3_subs_repartition_context(struct mosquitto *context);
 // DXL Begin
 int mqtt3_sub_count(struct mosquitto_db *db, const char *topic, int *count, const char* tenant_guid);
 int mqtt3_sub_init();
 void mqtt3_sub_cleanup();
+int mqtt3_subs_open(struct mosquitto_db *db);
+void mqtt3_subs_close(struct mosquitto_db *db);
+/* Statistics of the cache of the subscription matches of published topics */
+struct mqtt3_sub_cache_stats{
+    int entries;
+    uint64_t hits;
+    uint64_t misses;
+};
+/* Returns the statistics of the subscription match cache. */
+void mqtt3_sub_cache_stats(struct mqtt3_sub_cache_stats *stats);
 // DXL End
 
 /* ============================================================
@@ -484,6 +669,16 @@ void mosquitto_ws_do_maintenance();
  * ============================================================ */
 int mosquitto_process_client_certificate(X509_STORE_CTX *ctx, struct mosquitto *context);
 
+/**
+ * Performs the broker library checks (revocation, tenant limits) against the identity of
+ * the TLS session. Used for sessions whose certificate verification was either deferred
+ * (handshake workers) or skipped (resumed sessions).
+ *
+ * @param   context The client context
+ * @return  Whether the session is allowed
+ */
+bool mosquitto_tls_session_verify(struct mosquitto *context);
+
 
 /* ============================================================
  * Window service related functions
@@ -65,12 +65,399 @@ POSSIBILITY OF SUCH DAMAGE.
 // DXL Begin
 #include "dxl.h"
 #include "DxlFlags.h"
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
 #include <openssl/ssl.h>
 #include <openssl/x509_vfy.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time_mosq.h>
 // DXL End
 static int tls_ex_index_context = -1;
 static int tls_ex_index_listener = -1;
 
+// DXL Begin
+/*
+ * TLS handshake workers
+ *
+ * When enabled, the TLS handshake of each accepted connection is performed by a
+ * pool of worker threads rather than the main loop. A context is only added to the
+ * database (and epoll) once its handshake has completed. The broker library checks
+ * made during certificate verification (revocation, tenant limits) are not
+ * thread-safe; the workers defer them until the context is handed back to the main
+ * thread (see mosquitto_handshake_process).
+ */
+
+/* The maximum time allowed for a handshake to complete (in seconds) */
+#define HANDSHAKE_TIMEOUT 60
+
+/* The maximum events to process per handshake worker wait */
+#define HANDSHAKE_MAXEVENTS 64
+
+struct mosquitto_handshake {
+    struct mosquitto *context;
+    time_t start;
+    bool registered;
+    bool failed;
+    struct mosquitto_handshake *prev;
+    struct mosquitto_handshake *next;
+};
+
+struct mosquitto_handshake_worker {
+    pthread_t thread;
+    /* The worker epoll set */
+    int efd;
+    /* Used to wake the worker when handshakes are submitted */
+    int wakefd;
+    /* Submitted handshakes (guarded by handshake_mutex) */
+    struct mosquitto_handshake *submitted;
+    /* Handshakes in progress (worker only) */
+    struct mosquitto_handshake *active;
+};
+
+static struct mosquitto_handshake_worker *handshake_workers = NULL;
+static int handshake_worker_count = 0;
+static int handshake_next_worker = 0;
+static pthread_mutex_t handshake_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Completed handshakes (guarded by handshake_mutex) */
+static struct mosquitto_handshake *handshake_completed = NULL;
+/* Used to wake the main loop when handshakes complete */
+static int handshake_completed_fd = INVALID_SOCKET;
+static bool handshake_stopping = false;
+/* Whether the current thread is a handshake worker */
+static __thread bool handshake_worker_thread = false;
+
+/* Hands a finished (or failed) handshake back to the main thread */
+static void handshake_finish(struct mosquitto_handshake_worker *worker, struct mosquitto_handshake *hs)
+{
+    struct epoll_event event = {0};
+    uint64_t wake = 1;
+
+    if(hs->registered){
+        epoll_ctl(worker->efd, EPOLL_CTL_DEL, hs->context->sock, &event);
+    }
+    if(hs->prev){
+        hs->prev->next = hs->next;
+    }else{
+        worker->active = hs->next;
+    }
+    if(hs->next){
+        hs->next->prev = hs->prev;
+    }
+
+    pthread_mutex_lock(&handshake_mutex);
+    hs->prev = NULL;
+    hs->next = handshake_completed;
+    handshake_completed = hs;
+    pthread_mutex_unlock(&handshake_mutex);
+
+    if(write(handshake_completed_fd, &wake, sizeof(wake)) < 0){
+        /* The main loop is already due to wake */
+    }
+}
+
+/* Advances the handshake, waiting on the socket for the direction OpenSSL requires */
+static void handshake_step(struct mosquitto_handshake_worker *worker, struct mosquitto_handshake *hs)
+{
+    struct mosquitto *context = hs->context;
+    struct epoll_event event = {0};
+    char ebuf[256];
+    unsigned long e;
+    int rc;
+
+    rc = SSL_accept(context->ssl);
+    if(rc == 1){
+        handshake_finish(worker, hs);
+        return;
+    }
+
+    rc = SSL_get_error(context->ssl, rc);
+    if(rc == SSL_ERROR_WANT_READ || rc == SSL_ERROR_WANT_WRITE){
+        event.events = (rc == SSL_ERROR_WANT_READ ? EPOLLIN : EPOLLOUT) | EPOLLRDHUP | EPOLLONESHOT;
+        event.data.ptr = hs;
+        if(!epoll_ctl(worker->efd, hs->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, context->sock, &event)){
+            hs->registered = true;
+            return;
+        }
+        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+    }else{
+        e = ERR_get_error();
+        while(e){
+            if(IS_NOTICE_ENABLED)
+                _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
+                    "Client connection from %s failed: %s.",
+                    context->address, ERR_error_string(e, ebuf));
+            e = ERR_get_error();
+        }
+    }
+    hs->failed = true;
+    handshake_finish(worker, hs);
+}
+
+static void* handshake_worker_run(void *arg)
+{
+    struct mosquitto_handshake_worker *worker = (struct mosquitto_handshake_worker *)arg;
+    struct epoll_event events[HANDSHAKE_MAXEVENTS];
+    struct mosquitto_handshake *hs, *next;
+    time_t last_sweep = mosquitto_time();
+    time_t now;
+    uint64_t wake;
+    int count, i;
+
+    handshake_worker_thread = true;
+
+    while(true){
+        count = epoll_wait(worker->efd, events, HANDSHAKE_MAXEVENTS, 1000);
+
+        pthread_mutex_lock(&handshake_mutex);
+        if(handshake_stopping){
+            pthread_mutex_unlock(&handshake_mutex);
+            break;
+        }
+        hs = worker->submitted;
+        worker->submitted = NULL;
+        pthread_mutex_unlock(&handshake_mutex);
+
+        /* Start the submitted handshakes */
+        for(; hs; hs = next){
+            next = hs->next;
+            hs->prev = NULL;
+            hs->next = worker->active;
+            if(worker->active){
+                worker->active->prev = hs;
+            }
+            worker->active = hs;
+            handshake_step(worker, hs);
+        }
+
+        for(i=0; i<count; i++){
+            if(events[i].data.ptr){
+                handshake_step(worker, (struct mosquitto_handshake *)events[i].data.ptr);
+            }else if(read(worker->wakefd, &wake, sizeof(wake)) < 0){
+                /* Nothing to drain */
+            }
+        }
+
+        /* Fail the handshakes that have not completed in time */
+        now = mosquitto_time();
+        if(now != last_sweep){
+            for(hs = worker->active; hs; hs = next){
+                next = hs->next;
+                if(now - hs->start >= HANDSHAKE_TIMEOUT){
+                    if(IS_NOTICE_ENABLED)
+                        _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
+                            "Client connection from %s failed: handshake timed out.", hs->context->address);
+                    hs->failed = true;
+                    handshake_finish(worker, hs);
+                }
+            }
+            last_sweep = now;
+        }
+    }
+
+    return NULL;
+}
+
+bool mosquitto_tls_session_verify(struct mosquitto *context)
+{
+    struct cert_hashes *current, *tmp;
+
+    /* A resumed session whose identity could not be restored */
+    if(!context->cert_hashes && context->listener && context->listener->require_certificate){
+        return false;
+    }
+
+    HASH_ITER(hh, context->cert_hashes, current, tmp){
+        if(dxl_is_cert_revoked(current->cert_sha1)){
+            return false;
+        }
+    }
+
+    if(context->dxl_tenant_guid){
+        if(dxl_update_sent_byte_count(context, 0) ||
+            !dxl_is_tenant_connection_allowed(context)){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int mosquitto_handshake_init(int count)
+{
+    struct epoll_event event = {0};
+    sigset_t sigblock, sigprev;
+    int i, rc;
+
+    if(count < 1) return 0;
+
+    handshake_completed_fd = eventfd(0, EFD_NONBLOCK);
+    if(handshake_completed_fd == INVALID_SOCKET || mosquitto_epoll_add_handshake_fd(handshake_completed_fd)){
+        _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+        return 1;
+    }
+
+    handshake_workers = (struct mosquitto_handshake_worker *)_mosquitto_calloc(
+        count, sizeof(struct mosquitto_handshake_worker));
+    if(!handshake_workers) return 1;
+
+    _mosquitto_net_thread_init();
+
+    /* Signals are handled by the main thread */
+    sigfillset(&sigblock);
+    pthread_sigmask(SIG_BLOCK, &sigblock, &sigprev);
+    for(i=0; i<count; i++){
+        struct mosquitto_handshake_worker *worker = &handshake_workers[i];
+        worker->efd = epoll_create1(0);
+        worker->wakefd = eventfd(0, EFD_NONBLOCK);
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        if(worker->efd == -1 || worker->wakefd == -1 ||
+            epoll_ctl(worker->efd, EPOLL_CTL_ADD, worker->wakefd, &event) == -1){
+            _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+            rc = -1;
+        }else{
+            rc = pthread_create(&worker->thread, NULL, handshake_worker_run, worker);
+            if(rc){
+                _mosquitto_log_printf(NULL, MOSQ_LOG_ERR,
+                    "Error: Unable to create handshake thread: %s.", strerror(rc));
+            }
+        }
+        if(rc){
+            if(worker->efd != -1) COMPAT_CLOSE(worker->efd);
+            if(worker->wakefd != -1) COMPAT_CLOSE(worker->wakefd);
+            break;
+        }
+        handshake_worker_count++;
+    }
+    pthread_sigmask(SIG_SETMASK, &sigprev, NULL);
+
+    if(IS_INFO_ENABLED)
+        _mosquitto_log_printf(NULL, MOSQ_LOG_INFO, "TLS handshake threads: %d", handshake_worker_count);
+
+    return 0;
+}
+
+/* Releases a list of handshakes along with their contexts */
+static void handshake_cleanup_list(struct mosquitto_handshake *hs)
+{
+    struct mosquitto_handshake *next;
+    for(; hs; hs = next){
+        next = hs->next;
+        mqtt3_context_cleanup(NULL, hs->context, true, true /* DXL */);
+        _mosquitto_free(hs);
+    }
+}
+
+void mosquitto_handshake_destroy()
+{
+    uint64_t wake = 1;
+    int i;
+
+    if(!handshake_workers) return;
+
+    pthread_mutex_lock(&handshake_mutex);
+    handshake_stopping = true;
+    pthread_mutex_unlock(&handshake_mutex);
+
+    for(i=0; i<handshake_worker_count; i++){
+        if(write(handshake_workers[i].wakefd, &wake, sizeof(wake)) < 0){
+            /* The worker will wake on its wait timeout */
+        }
+        pthread_join(handshake_workers[i].thread, NULL);
+        handshake_cleanup_list(handshake_workers[i].submitted);
+        handshake_cleanup_list(handshake_workers[i].active);
+    }
+    for(i=0; i<handshake_worker_count; i++){
+        COMPAT_CLOSE(handshake_workers[i].efd);
+        COMPAT_CLOSE(handshake_workers[i].wakefd);
+    }
+    handshake_cleanup_list(handshake_completed);
+    handshake_completed = NULL;
+    COMPAT_CLOSE(handshake_completed_fd);
+    handshake_completed_fd = INVALID_SOCKET;
+
+    _mosquitto_free(handshake_workers);
+    handshake_workers = NULL;
+    handshake_worker_count = 0;
+}
+
+/* Hands the context to a handshake worker. Returns false if the workers are disabled. */
+static bool handshake_submit(struct mosquitto *context)
+{
+    struct mosquitto_handshake_worker *worker;
+    struct mosquitto_handshake *hs;
+    uint64_t wake = 1;
+
+    if(!handshake_worker_count) return false;
+
+    hs = (struct mosquitto_handshake *)_mosquitto_calloc(1, sizeof(struct mosquitto_handshake));
+    if(!hs) return false;
+    hs->context = context;
+    hs->start = mosquitto_time();
+
+    worker = &handshake_workers[handshake_next_worker];
+    handshake_next_worker = (handshake_next_worker + 1) % handshake_worker_count;
+
+    pthread_mutex_lock(&handshake_mutex);
+    hs->next = worker->submitted;
+    worker->submitted = hs;
+    pthread_mutex_unlock(&handshake_mutex);
+
+    if(write(worker->wakefd, &wake, sizeof(wake)) < 0){
+        /* The worker is already due to wake */
+    }
+    return true;
+}
+
+void mosquitto_handshake_process(struct mosquitto_db *db)
+{
+    struct mosquitto_handshake *hs, *next;
+    struct mosquitto *context;
+    uint64_t wake;
+
+    if(!handshake_worker_count) return;
+
+    if(read(handshake_completed_fd, &wake, sizeof(wake)) < 0){
+        /* Nothing to drain */
+    }
+
+    pthread_mutex_lock(&handshake_mutex);
+    hs = handshake_completed;
+    handshake_completed = NULL;
+    pthread_mutex_unlock(&handshake_mutex);
+
+    for(; hs; hs = next){
+        next = hs->next;
+        context = hs->context;
+        if(hs->failed){
+            mqtt3_context_cleanup(NULL, context, true, true /* DXL */);
+        }else if(!SSL_session_reused(context->ssl) /* Verified on CONNECT */ &&
+            !mosquitto_tls_session_verify(context)){
+            if(IS_NOTICE_ENABLED)
+                _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
+                    "Client connection from %s denied: certificate verification failed.", context->address);
+            mqtt3_context_cleanup(NULL, context, true, true /* DXL */);
+        }else{
+            if(IS_NOTICE_ENABLED)
+                _mosquitto_log_printf(NULL, MOSQ_LOG_NOTICE,
+                    "New connection from %s on port %d.", context->address, context->listener->port);
+            if(!mqtt3_db_add_new_context(db, context)){
+                /* Application data may have been buffered along with the handshake */
+                mosquitto_add_pending_bytes_set(context);
+            }
+        }
+        _mosquitto_free(hs);
+    }
+}
+// DXL End
+
 int mqtt3_socket_accept(struct mosquitto_db *db, int listensock)
 {
     int i;
@@ -151,6 +538,10 @@ int mqtt3_socket_accept(struct mosquitto_db *db, int listensock)
                         new_context->want_write = true;
                         bio = BIO_new_socket((int)new_sock, BIO_NOCLOSE);
                         SSL_set_bio(new_context->ssl, bio, bio);
+                        // DXL: The context is added to the database once its handshake completes
+                        if(handshake_submit(new_context)){
+                            return new_sock;
+                        }
                         rc = SSL_accept(new_context->ssl);
                         if(rc != 1){
                             rc = SSL_get_error(new_context->ssl, rc);
@@ -203,6 +594,18 @@ static struct mosquitto *get_client_context(X509_STORE_CTX *ctx, int index)
     return retVal;
 }
 
+/* Adds the certificate thumbprint to the set of hashes for the context */
+static void add_cert_hash(struct mosquitto *context, const char *sha1str)
+{
+    struct cert_hashes* s = NULL;
+    HASH_FIND_STR(context->cert_hashes, sha1str, s);
+    if(!s){
+        s = (struct cert_hashes*)_mosquitto_malloc(sizeof(struct cert_hashes));
+        s->cert_sha1 = strdup(sha1str);
+        HASH_ADD_KEYPTR(hh, context->cert_hashes, s->cert_sha1, (unsigned int)strlen(s->cert_sha1), s);
+    }
+}
+
 int mosquitto_process_client_certificate(X509_STORE_CTX *ctx, struct mosquitto *context)
 {
     // Whether certificate validation succeeded
@@ -222,19 +625,13 @@ int mosquitto_process_client_certificate(X509_STORE_CTX *ctx, struct mosquitto *
                     p += sprintf(p, "%02x", fprint[i]);
                 }
                 if(true){ // Check currently disabled
-                    // Check to see if the certificate has been revoked
-                    if(dxl_is_cert_revoked(sha1str)){
+                    // Check to see if the certificate has been revoked (deferred on handshake workers)
+                    if(!handshake_worker_thread && dxl_is_cert_revoked(sha1str)){
                         succeeded = 0;
                     }
 
                     // Add thumbprint for certificate to current set of hashes
-                    struct cert_hashes* s = NULL;
-                    HASH_FIND_STR(context->cert_hashes, sha1str, s);
-                    if(!s){
-                        s = (struct cert_hashes*)_mosquitto_malloc(sizeof(struct cert_hashes));
-                        s->cert_sha1 = strdup(sha1str);
-                        HASH_ADD_KEYPTR(hh, context->cert_hashes, s->cert_sha1, (unsigned int)strlen(s->cert_sha1), s);
-                    }
+                    add_cert_hash(context, sha1str);
                 }
 
                 if(IS_DEBUG_ENABLED){
@@ -278,9 +675,10 @@ int mosquitto_process_client_certificate(X509_STORE_CTX *ctx, struct mosquitto *
                                 }else{
                                     context->dxl_tenant_guid = _mosquitto_strdup((char*)octet_str_data);
 
-                                    // Check to see if tenant limit has been exceeded
-                                    if(dxl_update_sent_byte_count(context, 0) ||
-                                        !dxl_is_tenant_connection_allowed(context)){
+                                    // Check to see if tenant limit has been exceeded (deferred on handshake workers)
+                                    if(!handshake_worker_thread &&
+                                        (dxl_update_sent_byte_count(context, 0) ||
+                                        !dxl_is_tenant_connection_allowed(context))){
                                         // Has exceeded limit
                                         succeeded = 0;
                                     }
@@ -311,6 +709,375 @@ static int client_certificate_verify(int preverify_ok, X509_STORE_CTX *ctx)
 }
 // DXL End
 
+// DXL Begin
+/*
+ * TLS session resumption
+ *
+ * Sessions may be resumed from the server-side session cache or from a session
+ * ticket. The certificate verification callback is not invoked for a resumed
+ * session, so the DXL identity derived from the peer chain (certificate hashes,
+ * client and tenant GUIDs) is stored with the session when it is established and
+ * restored onto the context when it is resumed. For the session cache the identity
+ * is held in the session ex data; for tickets it is carried (encrypted) within the
+ * ticket itself. The broker library checks (revocation, tenant limits) for resumed
+ * sessions are performed when the CONNECT is received (see mqtt3_handle_connect).
+ *
+ * The identity is encoded as a sequence of NUL-terminated strings: the client GUID,
+ * the tenant GUID (both empty if absent) followed by the certificate hashes.
+ */
+
+struct tls_session_identity {
+    size_t len;
+    char data[1];
+};
+
+static int tls_ex_index_session = -1;
+
+/* Encodes the identity of the context. The returned buffer must be freed by the caller. */
+static char* tls_identity_encode(struct mosquitto *context, size_t *len)
+{
+    struct cert_hashes *current, *tmp;
+    const char *client_guid = context->dxl_client_guid ? context->dxl_client_guid : "";
+    const char *tenant_guid = context->dxl_tenant_guid ? context->dxl_tenant_guid : "";
+    char *data, *p;
+
+    *len = strlen(client_guid) + strlen(tenant_guid) + 2;
+    HASH_ITER(hh, context->cert_hashes, current, tmp){
+        *len += strlen(current->cert_sha1) + 1;
+    }
+
+    data = (char *)malloc(*len);
+    if(!data) return NULL;
+
+    p = data;
+    p = stpcpy(p, client_guid) + 1;
+    p = stpcpy(p, tenant_guid) + 1;
+    HASH_ITER(hh, context->cert_hashes, current, tmp){
+        p = stpcpy(p, current->cert_sha1) + 1;
+    }
+    return data;
+}
+
+/* Restores a previously encoded identity onto the context */
+static void tls_identity_restore(struct mosquitto *context, const char *data, size_t len)
+{
+    const char *end = data + len;
+    const char *p = data;
+    int field = 0;
+
+    if(!len || data[len-1] != '\0') return;
+
+    for(; p < end; p += strlen(p) + 1, field++){
+        if(field == 0){
+            if(*p && !context->dxl_client_guid) context->dxl_client_guid = _mosquitto_strdup(p);
+        }else if(field == 1){
+            if(*p && !context->dxl_tenant_guid) context->dxl_tenant_guid = _mosquitto_strdup(p);
+        }else if(*p){
+            add_cert_hash(context, p);
+        }
+    }
+}
+
+static void tls_session_identity_free(void *UNUSED(parent), void *ptr, CRYPTO_EX_DATA *UNUSED(ad), int UNUSED(idx),
+    long UNUSED(argl), void *UNUSED(argp))
+{
+    free(ptr);
+}
+
+/* Copies the identity when OpenSSL duplicates a session */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int tls_session_identity_dup(CRYPTO_EX_DATA *UNUSED(to), const CRYPTO_EX_DATA *UNUSED(from),
+    void **from_d, int UNUSED(idx), long UNUSED(argl), void *UNUSED(argp))
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+static int tls_session_identity_dup(CRYPTO_EX_DATA *UNUSED(to), const CRYPTO_EX_DATA *UNUSED(from),
+    void *from_d, int UNUSED(idx), long UNUSED(argl), void *UNUSED(argp))
+#else
+static int tls_session_identity_dup(CRYPTO_EX_DATA *UNUSED(to), CRYPTO_EX_DATA *UNUSED(from),
+    void *from_d, int UNUSED(idx), long UNUSED(argl), void *UNUSED(argp))
+#endif
+{
+    struct tls_session_identity **identity = (struct tls_session_identity **)from_d;
+    struct tls_session_identity *copy;
+    size_t size;
+
+    if(*identity){
+        size = sizeof(struct tls_session_identity) + (*identity)->len;
+        copy = (struct tls_session_identity *)malloc(size);
+        if(copy){
+            memcpy(copy, *identity, size);
+        }
+        *identity = copy;
+    }
+    return 1;
+}
+
+/* Stores the identity of the context with its (cached) session */
+static void tls_session_store_identity(struct mosquitto *context, SSL_SESSION *session)
+{
+    struct tls_session_identity *identity;
+    char *data;
+    size_t len;
+
+    if(SSL_SESSION_get_ex_data(session, tls_ex_index_session)) return;
+
+    data = tls_identity_encode(context, &len);
+    if(!data) return;
+    identity = (struct tls_session_identity *)malloc(sizeof(struct tls_session_identity) + len);
+    if(identity){
+        identity->len = len;
+        memcpy(identity->data, data, len);
+        if(!SSL_SESSION_set_ex_data(session, tls_ex_index_session, identity)){
+            free(identity);
+        }
+    }
+    free(data);
+}
+
+static void tls_info_callback(const SSL *ssl, int where, int UNUSED(ret))
+{
+    struct mosquitto *context;
+    struct tls_session_identity *identity;
+    SSL_SESSION *session;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    void *data;
+    size_t len;
+#endif
+
+    if(!(where & SSL_CB_HANDSHAKE_DONE)) return;
+
+    context = (struct mosquitto *)SSL_get_ex_data(ssl, tls_ex_index_context);
+    session = SSL_get_session(ssl);
+    if(!context || !session) return;
+
+    if(!SSL_session_reused((SSL *)ssl)){
+        if(context->listener && context->listener->tls_session_cache_size > 0){
+            tls_session_store_identity(context, session);
+        }
+        return;
+    }
+
+    if(context->cert_hashes) return;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    if(SSL_SESSION_get0_ticket_appdata(session, &data, &len) && len){
+        tls_identity_restore(context, (const char *)data, len);
+        return;
+    }
+#endif
+    identity = (struct tls_session_identity *)SSL_SESSION_get_ex_data(session, tls_ex_index_session);
+    if(identity){
+        tls_identity_restore(context, identity->data, identity->len);
+    }
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+/*
+ * Session ticket keys
+ *
+ * Tickets are encrypted with AES-256-CBC and authenticated with HMAC-SHA256. The
+ * keys are generated at random and rotated every session timeout; tickets issued
+ * under the previous key are still accepted (and renewed).
+ */
+
+#define TLS_TICKET_KEY_NAME_LEN 16
+
+struct tls_ticket_key {
+    unsigned char name[TLS_TICKET_KEY_NAME_LEN];
+    unsigned char aes_key[32];
+    unsigned char hmac_key[32];
+};
+
+/* The current and previous ticket keys (guarded by tls_ticket_key_mutex) */
+static struct tls_ticket_key tls_ticket_keys[2];
+static int tls_ticket_key_count = 0;
+static time_t tls_ticket_key_created = 0;
+static int tls_ticket_key_lifetime = 0;
+static pthread_mutex_t tls_ticket_key_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Rotates the ticket keys if the current key has expired. Must be called with the mutex held. */
+static bool tls_ticket_key_rotate()
+{
+    time_t now = mosquitto_time();
+
+    if(tls_ticket_key_count && now - tls_ticket_key_created < tls_ticket_key_lifetime){
+        return true;
+    }
+
+    tls_ticket_keys[1] = tls_ticket_keys[0];
+    if(RAND_bytes(tls_ticket_keys[0].name, sizeof(tls_ticket_keys[0].name)) != 1 ||
+        RAND_bytes(tls_ticket_keys[0].aes_key, sizeof(tls_ticket_keys[0].aes_key)) != 1 ||
+        RAND_bytes(tls_ticket_keys[0].hmac_key, sizeof(tls_ticket_keys[0].hmac_key)) != 1){
+        tls_ticket_keys[0] = tls_ticket_keys[1];
+        return tls_ticket_key_count > 0;
+    }
+    if(tls_ticket_key_count < 2) tls_ticket_key_count++;
+    tls_ticket_key_created = now;
+
+    return true;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int tls_ticket_mac_init(EVP_MAC_CTX *hctx, const unsigned char *key)
+{
+    OSSL_PARAM params[2];
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0);
+    params[1] = OSSL_PARAM_construct_end();
+    return EVP_MAC_init(hctx, key, 32, params);
+}
+
+static int tls_ticket_key_callback(SSL *UNUSED(ssl), unsigned char *key_name, unsigned char *iv,
+    EVP_CIPHER_CTX *ctx, EVP_MAC_CTX *hctx, int enc)
+#else
+static int tls_ticket_mac_init(HMAC_CTX *hctx, const unsigned char *key)
+{
+    return HMAC_Init_ex(hctx, key, 32, EVP_sha256(), NULL);
+}
+
+static int tls_ticket_key_callback(SSL *UNUSED(ssl), unsigned char *key_name, unsigned char *iv,
+    EVP_CIPHER_CTX *ctx, HMAC_CTX *hctx, int enc)
+#endif
+{
+    struct tls_ticket_key key;
+    int i, rc = 0;
+
+    pthread_mutex_lock(&tls_ticket_key_mutex);
+    if(!tls_ticket_key_rotate()){
+        pthread_mutex_unlock(&tls_ticket_key_mutex);
+        return -1;
+    }
+    if(enc){
+        key = tls_ticket_keys[0];
+        rc = 1;
+    }else{
+        for(i=0; i<tls_ticket_key_count; i++){
+            if(!memcmp(key_name, tls_ticket_keys[i].name, TLS_TICKET_KEY_NAME_LEN)){
+                key = tls_ticket_keys[i];
+                /* Renew tickets issued under the previous key */
+                rc = (i == 0 ? 1 : 2);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&tls_ticket_key_mutex);
+
+    if(!rc) return 0;
+
+    if(enc){
+        if(RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1) return -1;
+        memcpy(key_name, key.name, TLS_TICKET_KEY_NAME_LEN);
+        if(EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, key.aes_key, iv) != 1) return -1;
+    }else{
+        if(EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, key.aes_key, iv) != 1) return -1;
+    }
+    if(tls_ticket_mac_init(hctx, key.hmac_key) != 1) return -1;
+
+    return rc;
+}
+
+/* Attaches the identity of the context to the ticket being issued */
+static int tls_ticket_generate_callback(SSL *ssl, void *UNUSED(arg))
+{
+    struct mosquitto *context;
+    SSL_SESSION *session = SSL_get_session(ssl);
+    void *data;
+    size_t len;
+    char *identity;
+    int rc;
+
+    if(!session) return 0;
+
+    /* A renewed ticket retains the identity it was issued with */
+    if(SSL_SESSION_get0_ticket_appdata(session, &data, &len) && len) return 1;
+
+    context = (struct mosquitto *)SSL_get_ex_data(ssl, tls_ex_index_context);
+    if(!context) return 0;
+
+    identity = tls_identity_encode(context, &len);
+    if(!identity) return 0;
+    rc = SSL_SESSION_set1_ticket_appdata(session, identity, len);
+    free(identity);
+
+    return rc;
+}
+
+static SSL_TICKET_RETURN tls_ticket_decrypt_callback(SSL *UNUSED(ssl), SSL_SESSION *session,
+    const unsigned char *UNUSED(keyname), size_t UNUSED(keyname_length), SSL_TICKET_STATUS status,
+    void *UNUSED(arg))
+{
+    void *data;
+    size_t len;
+
+    switch(status){
+        case SSL_TICKET_SUCCESS:
+        case SSL_TICKET_SUCCESS_RENEW:
+            /* Tickets without an identity cannot be resumed */
+            if(!SSL_SESSION_get0_ticket_appdata(session, &data, &len) || !len){
+                return SSL_TICKET_RETURN_IGNORE_RENEW;
+            }
+            return status == SSL_TICKET_SUCCESS ? SSL_TICKET_RETURN_USE : SSL_TICKET_RETURN_USE_RENEW;
+        case SSL_TICKET_FATAL_ERR_MALLOC:
+        case SSL_TICKET_FATAL_ERR_OTHER:
+            return SSL_TICKET_RETURN_ABORT;
+        default:
+            return SSL_TICKET_RETURN_IGNORE_RENEW;
+    }
+}
+#endif
+
+/* Configures session caching and tickets for the listener */
+static void tls_session_configure(struct _mqtt3_listener *listener)
+{
+    bool tickets = listener->tls_session_tickets;
+
+    if(tls_ex_index_session == -1){
+        tls_ex_index_session = SSL_SESSION_get_ex_new_index(0, (void *)"session identity", NULL,
+            tls_session_identity_dup, tls_session_identity_free);
+    }
+
+    SSL_CTX_set_info_callback(listener->ssl_ctx, tls_info_callback);
+    if(listener->tls_session_timeout > 0){
+        SSL_CTX_set_timeout(listener->ssl_ctx, listener->tls_session_timeout);
+    }
+
+    if(listener->tls_session_cache_size > 0){
+        SSL_CTX_set_session_cache_mode(listener->ssl_ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(listener->ssl_ctx, listener->tls_session_cache_size);
+    }else{
+        SSL_CTX_set_session_cache_mode(listener->ssl_ctx, SSL_SESS_CACHE_OFF);
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    if(tickets){
+        pthread_mutex_lock(&tls_ticket_key_mutex);
+        if(SSL_CTX_get_timeout(listener->ssl_ctx) > tls_ticket_key_lifetime){
+            tls_ticket_key_lifetime = (int)SSL_CTX_get_timeout(listener->ssl_ctx);
+        }
+        pthread_mutex_unlock(&tls_ticket_key_mutex);
+        SSL_CTX_set_tlsext_ticket_key_cb(listener->ssl_ctx, tls_ticket_key_callback);
+        SSL_CTX_set_session_ticket_cb(listener->ssl_ctx,
+            tls_ticket_generate_callback, tls_ticket_decrypt_callback, NULL);
+    }
+#else
+    if(tickets){
+        /* The identity cannot be carried within the ticket */
+        if(IS_WARNING_ENABLED)
+            _mosquitto_log_printf(NULL, MOSQ_LOG_WARNING,
+                "Warning: TLS session tickets require OpenSSL 1.1.1 or later, disabling.");
+        tickets = false;
+    }
+#endif
+    if(!tickets){
+        SSL_CTX_set_options(listener->ssl_ctx, SSL_OP_NO_TICKET);
+    }
+
+    if(IS_INFO_ENABLED)
+        _mosquitto_log_printf(NULL, MOSQ_LOG_INFO,
+            "TLS session resumption on port %d: cache size %d, tickets %s, timeout %ld.",
+            listener->port, listener->tls_session_cache_size, tickets ? "enabled" : "disabled",
+            (long)SSL_CTX_get_timeout(listener->ssl_ctx));
+}
+// DXL End
+
 /* Creates a socket and listens on port 'port'.
  * Returns 1 on failure
  * Returns 0 on success.
@@ -433,13 +1200,15 @@ int mqtt3_socket_listen(struct _mqtt3_listener *listener)
             ssl_options |= SSL_OP_CIPHER_SERVER_PREFERENCE;
 #endif
             SSL_CTX_set_options(listener->ssl_ctx, ssl_options);
-            // Disable caching of sessions (DXL)
-            SSL_CTX_set_session_cache_mode(listener->ssl_ctx, SSL_SESS_CACHE_OFF);
+            // DXL: Session caching and tickets
+            tls_session_configure(listener);
 
 #ifdef SSL_MODE_RELEASE_BUFFERS
             /* Use even less memory per SSL connection. */
             SSL_CTX_set_mode(listener->ssl_ctx, SSL_MODE_RELEASE_BUFFERS);
 #endif
+            // DXL: A retried write may be staged in the buffer of a different write thread
+            SSL_CTX_set_mode(listener->ssl_ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 
 #ifdef WITH_EC
 #if OPENSSL_VERSION_NUMBER >= 0x10002000L && OPENSSL_VERSION_NUMBER < 0x10100000L
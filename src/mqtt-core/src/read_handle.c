@@ -100,6 +100,8 @@ int mqtt3_handle_publish(struct mosquitto_db *db, struct mosquitto *context)
     int i;
     struct _mqtt3_bridge_topic *cur_topic;
     bool match;
+    bool zero_copy; // DXL
+    bool stored_ref = false; // DXL: Whether the reference to the stored message is held
 
 #ifndef DXL
     dup = (header & 0x08)>>3;
@@ -124,14 +126,19 @@ int mqtt3_handle_publish(struct mosquitto_db *db, struct mosquitto *context)
     }
 #endif
 
-    if(_mosquitto_read_string(&context->in_packet, &topic)) return 1;
-    if(strlen(topic) == 0){
-        /* Invalid publish topic, disconnect client. */
-        _mosquitto_free(topic);
+    // DXL Begin
+    /* The topic and payload are read in place and the packet buffer is handed to the
+     * message store, unless the topic is subject to bridge remapping. */
+    zero_copy = !(context->bridge && context->bridge->topics && context->bridge->topic_remapping);
+    if(zero_copy ?
+        _mosquitto_read_string_inplace(&context->in_packet, &topic) :
+        _mosquitto_read_string(&context->in_packet, &topic)){
         return 1;
     }
-    if(!strlen(topic)){
-        _mosquitto_free(topic);
+    // DXL End
+    if(strlen(topic) == 0){
+        /* Invalid publish topic, disconnect client. */
+        if(!zero_copy) _mosquitto_free(topic); // DXL
         return 1;
     }
     if(context->bridge && context->bridge->topics && context->bridge->topic_remapping){
@@ -180,13 +187,13 @@ int mqtt3_handle_publish(struct mosquitto_db *db, struct mosquitto *context)
     }
     if(_mosquitto_topic_wildcard_len_check(topic) != MOSQ_ERR_SUCCESS){
         /* Invalid publish topic, just swallow it. */
-        _mosquitto_free(topic);
+        if(!zero_copy) _mosquitto_free(topic); // DXL
         return 1;
     }
 
     if(qos > 0){
         if(_mosquitto_read_uint16(&context->in_packet, &mid)){
-            _mosquitto_free(topic);
+            if(!zero_copy) _mosquitto_free(topic); // DXL
             return 1;
         }
     }
@@ -201,15 +208,23 @@ int mqtt3_handle_publish(struct mosquitto_db *db, struct mosquitto *context)
                     context->id, dup, qos, retain, mid, topic, (long)payloadlen);
             goto process_bad_message;
         }
-        payload = _mosquitto_calloc(payloadlen+1, sizeof(uint8_t));
-        if(!payload){
-            _mosquitto_free(topic);
-            return 1;
-        }
-        if(_mosquitto_read_bytes(&context->in_packet, payload, payloadlen)){
-            _mosquitto_free(topic);
-            _mosquitto_free(payload);
-            return 1;
+        if(zero_copy){
+            // DXL: The payload references the packet buffer, and is terminated in the byte
+            // that the buffer reserves beyond the packet (as the copied payload is)
+            payload = &(context->in_packet.payload[context->in_packet.pos]);
+            context->in_packet.pos += payloadlen;
+            context->in_packet.payload[context->in_packet.pos] = '\0';
+        }else{
+            payload = _mosquitto_calloc(payloadlen+1, sizeof(uint8_t));
+            if(!payload){
+                _mosquitto_free(topic);
+                return 1;
+            }
+            if(_mosquitto_read_bytes(&context->in_packet, payload, payloadlen)){
+                _mosquitto_free(topic);
+                _mosquitto_free(payload);
+                return 1;
+            }
         }
     }
 
@@ -230,11 +245,18 @@ int mqtt3_handle_publish(struct mosquitto_db *db, struct mosquitto *context)
     }
     if(!stored){
         dup = 0;
-        if(mqtt3_db_message_store(db, context, context->id, mid, topic, qos, payloadlen, payload, retain, &stored, 0)){
-            _mosquitto_free(topic);
-            if(payload) _mosquitto_free(payload);
+        // DXL: When zero-copy, the message store takes ownership of the packet buffer
+        if(zero_copy ?
+            mqtt3_db_message_store_packet(db, context, context->id, mid, topic, qos, payloadlen, payload,
+                retain, &stored, &context->in_packet) :
+            mqtt3_db_message_store(db, context, context->id, mid, topic, qos, payloadlen, payload, retain, &stored, 0)){
+            if(!zero_copy){
+                _mosquitto_free(topic);
+                if(payload) _mosquitto_free(payload);
+            }
             return 1;
         }
+        stored_ref = true; // DXL
     }else{
         dup = 1;
     }
@@ -263,13 +285,24 @@ int mqtt3_handle_publish(struct mosquitto_db *db, struct mosquitto *context)
             }
             break;
     }
-    _mosquitto_free(topic);
-    if(payload) _mosquitto_free(payload);
+    // DXL Begin
+    if(!zero_copy){
+        _mosquitto_free(topic);
+        if(payload) _mosquitto_free(payload);
+    }
+    if(stored_ref){
+        mqtt3_db_msg_store_ref_dec(stored);
+    }
+    // DXL End
 
     return rc;
 process_bad_message:
-    _mosquitto_free(topic);
-    if(payload) _mosquitto_free(payload);
+    // DXL Begin
+    if(!zero_copy){
+        _mosquitto_free(topic);
+        if(payload) _mosquitto_free(payload);
+    }
+    // DXL End
     switch(qos){
         case 0:
             return MOSQ_ERR_SUCCESS;
@@ -282,6 +315,7 @@ process_bad_message:
                     return 1;
                 }
                 res = mqtt3_db_message_insert(db, context, mid, mosq_md_in, qos, false, stored);
+                mqtt3_db_msg_store_ref_dec(stored); // DXL
             }else{
                 res = 0;
             }
@@ -117,6 +117,18 @@ int mqtt3_handle_connect(struct mosquitto_db *db, struct mosquitto *context)
         return MOSQ_ERR_PROTOCOL;
     }
 
+    // DXL Begin
+    /* Certificate verification is skipped for resumed TLS sessions */
+    if(context->ssl && SSL_session_reused(context->ssl) && !mosquitto_tls_session_verify(context)){
+        if(IS_INFO_ENABLED)
+            _mosquitto_log_printf(NULL, MOSQ_LOG_INFO,
+                "Client connection from %s denied: resumed session verification failed.", context->address);
+        _mosquitto_send_connack(context, CONNACK_REFUSED_NOT_AUTHORIZED);
+        mqtt3_context_disconnect(db, context);
+        return MOSQ_ERR_PROTOCOL;
+    }
+    // DXL End
+
     if(_mosquitto_read_string(&context->in_packet, &protocol_name)){
         mqtt3_context_disconnect(db, context);
         return 1;
@@ -429,8 +441,8 @@ int mqtt3_handle_connect(struct mosquitto_db *db, struct mosquitto *context)
             db->contexts[i]->address = _mosquitto_strdup(context->address);
             db->contexts[i]->sock = context->sock;
             db->contexts[i]->listener = context->listener;
-            db->contexts[i]->last_msg_in = mosquitto_time();
-            db->contexts[i]->last_msg_out = mosquitto_time();
+            db->contexts[i]->last_msg_in = mosquitto_time_cached();
+            db->contexts[i]->last_msg_out = mosquitto_time_cached();
             db->contexts[i]->keepalive = context->keepalive;
             db->contexts[i]->pollfd_index = context->pollfd_index;
             db->contexts[i]->epoll_events = context->epoll_events; // EPOLL
@@ -445,6 +457,8 @@ int mqtt3_handle_connect(struct mosquitto_db *db, struct mosquitto *context)
             if(context->dxl_tenant_guid){
                 db->contexts[i]->dxl_tenant_guid = _mosquitto_strdup(context->dxl_tenant_guid);
             }
+            /* The subscriptions of the session follow the tenant and flags of the new connection */
+            mqtt3_subs_repartition_context(db->contexts[i]);
 
             // Copy certs
             struct cert_hashes *current, *tmp;
@@ -458,13 +472,14 @@ int mqtt3_handle_connect(struct mosquitto_db *db, struct mosquitto *context)
             context->sock = -1;
             context->ssl = NULL;
             context->state = mosq_cs_disconnecting;
+            mosquitto_context_timer_update(context, mosquitto_time_cached()); // DXL
             context = db->contexts[i];
             if(context->msgs){
                 mqtt3_db_message_reconnect_reset(context);
             }
             mosquitto_epoll_update_context_index(db->contexts[i], i); // EPOLL
             context->numericId = i; // DXL
-            context->clean_subs = false; // DXL
+            mosquitto_clean_session_cancel(context); // DXL
             mosquitto_remove_pending_bytes_set(context); // DXL
         }
     }
@@ -543,6 +558,12 @@ int mqtt3_handle_connect(struct mosquitto_db *db, struct mosquitto *context)
     context->state = mosq_cs_connected;
 
     // DXL Begin
+    // Schedule the keepalive check for the negotiated keepalive
+    if(context->keepalive){
+        mosquitto_context_timer_update(context,
+            context->last_msg_in + (time_t)(context->keepalive)*3/2);
+    }
+
     // Notify that a bridge has connected
     if(context->is_bridge){
         dxl_on_bridge_connected(context);
@@ -1,4 +1,6 @@
 #include "search_optimization.h"
+#include "uthash.h"
+#include "memory_mosq.h"
 
 bool topic_is_wild_card(const char *topic_name, const char *wild_card)
 {
@@ -6,36 +8,90 @@ bool topic_is_wild_card(const char *topic_name, const char *wild_card)
 }
 
 // DXL Start
-void add_heir_to_hash(struct subheir_hash **subheir_hash, const char *topic_name, struct _mosquitto_subhier *subheir)
+/* Computes the hash of a topic level */
+unsigned int topic_level_hash(const char *topic_name, unsigned int topic_len)
 {
-    struct subheir_hash *s = 0;
-    HASH_FIND_STR(*subheir_hash, topic_name, s);
-    if(!s){
-        s = (struct subheir_hash *)malloc(sizeof(struct subheir_hash));
-        s->topic = topic_name;
-        s->subheir = subheir;
-        HASH_ADD_KEYPTR(hh, *subheir_hash, s->topic, (unsigned int)strlen(s->topic), s);
+    unsigned int hashv, bkt;
+    HASH_FCN(topic_name, topic_len, 1, hashv, bkt);
+    (void)bkt;
+    return hashv;
+}
+
+/* Returns the item matching the key, or NULL */
+void* ptr_table_find(void **slots, unsigned int size, unsigned int hashv,
+    const void *key, ptr_table_match_fn match)
+{
+    unsigned int mask = size - 1;
+    unsigned int i = hashv & mask;
+
+    while(slots[i]){
+        if(match(slots[i], key)){
+            return slots[i];
+        }
+        i = (i + 1) & mask;
     }
+    return NULL;
 }
 
-void remove_heir_from_hash(struct subheir_hash **subheir_hash, const char *topic_name)
+/* Inserts the item (the table must have a free slot) */
+void ptr_table_insert(void **slots, unsigned int size, void *item, unsigned int hashv)
 {
-    struct subheir_hash *s = 0;
-    if(*subheir_hash && topic_name /*&& *topic_name != '\0'*/){
-        HASH_FIND_STR(*subheir_hash, topic_name, s);
-        if(s){
-            HASH_DEL(*subheir_hash, s);
-            free(s);
+    unsigned int mask = size - 1;
+    unsigned int i = hashv & mask;
+
+    while(slots[i]){
+        i = (i + 1) & mask;
+    }
+    slots[i] = item;
+}
+
+/*
+ * Removes the item. The items that follow it in its probe sequence are shifted back, so
+ * no tombstones are needed.
+ */
+void ptr_table_remove(void **slots, unsigned int size, const void *item, unsigned int hashv,
+    ptr_table_hash_fn hash_of)
+{
+    unsigned int mask = size - 1;
+    unsigned int i = hashv & mask;
+    unsigned int j, k;
+
+    while(slots[i] != item){
+        if(!slots[i]) return;
+        i = (i + 1) & mask;
+    }
+
+    j = i;
+    for(;;){
+        j = (j + 1) & mask;
+        if(!slots[j]) break;
+        k = hash_of(slots[j]) & mask;
+        /* The item at j can fill the hole at i unless its home slot is in (i, j] */
+        if((i <= j) ? (k <= i || k > j) : (k <= i && k > j)){
+            slots[i] = slots[j];
+            i = j;
         }
     }
+    slots[i] = NULL;
 }
 
-void clear_hash_table(struct subheir_hash **subheir_hash)
+/*
+ * Returns a table of new_size slots holding the items of the table (which is freed),
+ * or NULL if out of memory (the table is left unchanged).
+ */
+void** ptr_table_rehash(void **slots, unsigned int size, unsigned int new_size,
+    ptr_table_hash_fn hash_of)
 {
-    struct subheir_hash *current, *tmp;
-    HASH_ITER(hh, *subheir_hash, current, tmp){
-        HASH_DEL(*subheir_hash, current);
-        free(current);
+    unsigned int i;
+    void **new_slots = (void **)_mosquitto_calloc(new_size, sizeof(void *));
+
+    if(!new_slots) return NULL;
+    for(i=0; slots && i<size; i++){
+        if(slots[i]){
+            ptr_table_insert(new_slots, new_size, slots[i], hash_of(slots[i]));
+        }
     }
+    if(slots) _mosquitto_free(slots);
+    return new_slots;
 }
 // DXL End
\ No newline at end of file
@@ -2,17 +2,24 @@
 #define _SEARCH_OPTIMIZATION_H_
 
 #include "mosquitto_broker.h"
-#include "uthash.h"
 
-struct subheir_hash {
-    const char *topic;
-    struct _mosquitto_subhier *subheir;
-    UT_hash_handle hh;
-};
-
-void add_heir_to_hash(struct subheir_hash **subheir_hash, const char *topic_name, struct _mosquitto_subhier *subheir);
-void remove_heir_from_hash(struct subheir_hash **subheir_hash, const char *topic_name);
-void clear_hash_table(struct subheir_hash **subheir_hash);
 bool topic_is_wild_card(const char *topic_name, const char *wild_card);
+unsigned int topic_level_hash(const char *topic_name, unsigned int topic_len);
+
+/*
+ * Open addressing (linear probing) tables of pointers. The size of a table is a power
+ * of two and empty slots are NULL. The hashes are computed by the caller, hash_of
+ * returns the hash of an item that is in the table.
+ */
+typedef unsigned int (*ptr_table_hash_fn)(const void *item);
+typedef bool (*ptr_table_match_fn)(const void *item, const void *key);
+
+void* ptr_table_find(void **slots, unsigned int size, unsigned int hashv,
+    const void *key, ptr_table_match_fn match);
+void ptr_table_insert(void **slots, unsigned int size, void *item, unsigned int hashv);
+void ptr_table_remove(void **slots, unsigned int size, const void *item, unsigned int hashv,
+    ptr_table_hash_fn hash_of);
+void** ptr_table_rehash(void **slots, unsigned int size, unsigned int new_size,
+    ptr_table_hash_fn hash_of);
 
 #endif
@@ -50,7 +50,7 @@ int _mosquitto_send_connack(struct mosquitto *context, int result)
         }
     }
 
-    packet = (struct _mosquitto_packet *)_mosquitto_calloc(1, sizeof(struct _mosquitto_packet));
+    packet = (struct _mosquitto_packet *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_packet));
     if(!packet) return MOSQ_ERR_NOMEM;
 
     packet->command = CONNACK;
@@ -58,7 +58,7 @@ int _mosquitto_send_connack(struct mosquitto *context, int result)
     if(context && context->wsi) packet->is_ws_packet = 1;
     rc = _mosquitto_packet_alloc(packet);
     if(rc){
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
         return rc;
     }
     packet->payload[packet->pos+0] = 0;
@@ -75,7 +75,7 @@ int _mosquitto_send_suback(struct mosquitto *context, uint16_t mid, uint32_t pay
     if(IS_DEBUG_ENABLED)
         _mosquitto_log_printf(NULL, MOSQ_LOG_DEBUG, "Sending SUBACK to %s", context->id);
 
-    packet = (struct _mosquitto_packet *)_mosquitto_calloc(1, sizeof(struct _mosquitto_packet));
+    packet = (struct _mosquitto_packet *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_packet));
     if(!packet) return MOSQ_ERR_NOMEM;
 
     packet->command = SUBACK;
@@ -83,7 +83,7 @@ int _mosquitto_send_suback(struct mosquitto *context, uint16_t mid, uint32_t pay
     if(context->wsi) packet->is_ws_packet = 1;
     rc = _mosquitto_packet_alloc(packet);
     if(rc){
-        _mosquitto_free(packet);
+        _mosquitto_pool_free(packet, sizeof(struct _mosquitto_packet));
         return rc;
     }
     _mosquitto_write_uint16(packet, mid);
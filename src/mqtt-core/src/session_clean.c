@@ -0,0 +1,89 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+/*
+ * DXL: Queue of the sessions to clean
+ *
+ * The sessions of disconnected clean session clients are queued, and cleaned
+ * in a batch by the maintenance tick. A context is queued at most once, and
+ * remembers its position in the queue (clean_subs_index). This allows the
+ * entry of a context that is taken over by a reconnecting client to be
+ * removed, so the context cannot be cleaned (freed) while it is in use, or
+ * reached through a second entry once it has been freed. The queue is not
+ * thread safe, it must only be used by the main loop.
+ *
+ * A context that is returned to be cleaned stays marked (clean_subs), so it
+ * is not queued again while it is being cleaned.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <mosquitto_broker.h>
+
+/* The queued contexts (NULL once cancelled or returned to be cleaned) */
+static struct mosquitto **queue = NULL;
+/* The size of the queue */
+static int queue_size = 0;
+/* The count of entries in the queue */
+static int queue_count = 0;
+/* The position of the next entry to return (see mosquitto_clean_session_next) */
+static int queue_next = 0;
+/* The count of queued contexts (excluding cancelled entries) */
+static int queued_count = 0;
+
+bool mosquitto_clean_session_queue(struct mosquitto *context)
+{
+    if(context->clean_subs){
+        return true;
+    }
+    if(queue_count == queue_size){
+        int size = (queue_size ? queue_size * 2 : 64);
+        struct mosquitto **tmp =
+            (struct mosquitto **)realloc(queue, size * sizeof(struct mosquitto *));
+        if(!tmp){
+            return false;
+        }
+        queue = tmp;
+        queue_size = size;
+    }
+    context->clean_subs_index = queue_count;
+    context->clean_subs = true;
+    queue[queue_count++] = context;
+    queued_count++;
+    return true;
+}
+
+void mosquitto_clean_session_cancel(struct mosquitto *context)
+{
+    if(!context->clean_subs){
+        return;
+    }
+    if(context->clean_subs_index < queue_size && queue[context->clean_subs_index] == context){
+        queue[context->clean_subs_index] = NULL;
+        queued_count--;
+    }
+    context->clean_subs = false;
+}
+
+struct mosquitto *mosquitto_clean_session_next()
+{
+    while(queue_next < queue_count){
+        struct mosquitto *context = queue[queue_next];
+        queue[queue_next++] = NULL;
+        if(context){
+            queued_count--;
+            return context;
+        }
+    }
+    queue_next = 0;
+    queue_count = 0;
+    return NULL;
+}
+
+int mosquitto_clean_session_count()
+{
+    return queued_count;
+}
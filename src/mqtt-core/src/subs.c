@@ -30,6 +30,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <config.h>
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -44,8 +45,29 @@ POSSIBILITY OF SUCH DAMAGE.
 
 struct _sub_token {
     struct _sub_token *next;
-    char *topic;
+    const char *topic;
+    // DXL Begin
+    unsigned int topic_len;
+    /* The hash of the level (see topic_level_hash) */
+    unsigned int hash;
+    // DXL End
+};
+
+// DXL Begin
+/*
+ * The tokens of a topic. The levels are NUL terminated copies held in buf. The
+ * inline storage is used unless the topic is unusually long, so tokenising a topic
+ * (for every publish) does not allocate.
+ */
+#define SUB_TOKENS_INLINE_LEVELS 32
+#define SUB_TOKENS_INLINE_LEN 512
+struct _sub_tokens {
+    struct _sub_token *tokens;
+    char *buf;
+    struct _sub_token inline_tokens[SUB_TOKENS_INLINE_LEVELS];
+    char inline_buf[SUB_TOKENS_INLINE_LEN];
 };
+// DXL End
 
 // DXL Begin
 static int _sub_add_full_topic(
@@ -58,17 +80,22 @@ static int _sub_remove_full_topic(
     struct _mosquitto_subhier *subhier, struct _sub_token *tokens,
     char* fulltopic, unsigned int fulltopiclean, unsigned int depth);
 
-static int _subs_clean_session_full_topic(
-    struct mosquitto_db *db, struct _mosquitto_subhier *root,
-    char* fulltopic, unsigned int fulltopiclen, unsigned int depth);
+static void _sub_token_set(struct _sub_token *token, const char *topic, unsigned int topic_len);
 
 // This is much less than the MQTT standard (64k).
 // We can increase this if necessary, but there will be a performance impact.
 #define MAX_TOPIC_LEN 1024
 static char* _fulltopic = NULL;
+// DXL: The wildcard levels
+static struct _sub_token _plus_token;
+static struct _sub_token _pound_token;
 
 int mqtt3_sub_init()
 {
+    // DXL Begin
+    _sub_token_set(&_plus_token, "+", 1);
+    _sub_token_set(&_pound_token, "#", 1);
+    // DXL End
     _fulltopic = (char*)_mosquitto_malloc(MAX_TOPIC_LEN);
     if(_fulltopic){
         _fulltopic[0] = '\0';
@@ -87,9 +114,9 @@ void mqtt3_sub_cleanup()
 static void _add_topic_to_path(
     struct _mosquitto_subhier *subhier, char* fulltopic, unsigned int fulltopiclen, unsigned int depth)
 {    
-    if(subhier && subhier->topic && fulltopic && fulltopiclen > 0){
+    if(subhier && subhier->level && fulltopic && fulltopiclen > 0){
         unsigned int pos = (int)strlen(fulltopic);
-        char* topic = subhier->topic;
+        char* topic = subhier->level->topic;
         if(pos < fulltopiclen){
             if(depth > 2 || (depth == 2 && !strcmp("", topic) && pos > 0)){
                 fulltopic[pos++] = '/';
@@ -112,48 +139,761 @@ static bool _is_topic_removed(struct mosquitto *context, struct _mosquitto_subhi
         return false;
     }
 
-    struct _mosquitto_subleaf *leaf = root->subs;
-    while(leaf){
-        if(!leaf->context->is_bridge){
-            return false;
+    return (root->client_sub_count == 0);
+}
+
+/* Sets the level of the token (topic must stay valid while the token is used) */
+static void _sub_token_set(struct _sub_token *token, const char *topic, unsigned int topic_len)
+{
+    token->next = NULL;
+    token->topic = topic;
+    token->topic_len = topic_len;
+    token->hash = topic_level_hash(topic, topic_len);
+}
+
+/*
+ * The level table. The levels of the nodes are interned, so that a level shared by many
+ * nodes ("+", "event", ...) is stored once. DXL: The tenant GUIDs of the tenant partitions
+ * are interned in it as well.
+ */
+#define SUB_LEVELS_MIN_SIZE 1024
+static struct _mosquitto_sublevel **_levels = NULL;
+static unsigned int _level_count = 0;
+static unsigned int _level_size = 0;
+
+static unsigned int _sub_level_hash_of(const void *item)
+{
+    return ((const struct _mosquitto_sublevel *)item)->hash;
+}
+
+static bool _sub_level_match(const void *item, const void *key)
+{
+    const struct _mosquitto_sublevel *level = (const struct _mosquitto_sublevel *)item;
+    const struct _sub_token *token = (const struct _sub_token *)key;
+    return level->hash == token->hash && level->len == token->topic_len &&
+        !memcmp(level->topic, token->topic, token->topic_len);
+}
+
+static size_t _sub_level_alloc_size(unsigned int len)
+{
+    return offsetof(struct _mosquitto_sublevel, topic) + len + 1;
+}
+
+/* Returns the interned level of the token (NULL if it is not interned), no reference is taken */
+static struct _mosquitto_sublevel* _sub_level_find(const struct _sub_token *token)
+{
+    if(!_levels) return NULL;
+    return (struct _mosquitto_sublevel *)ptr_table_find(
+        (void **)_levels, _level_size, token->hash, token, _sub_level_match);
+}
+
+/* Returns the interned level of the token, with a reference held by the caller */
+static struct _mosquitto_sublevel* _sub_level_get(const struct _sub_token *token)
+{
+    struct _mosquitto_sublevel *level;
+    struct _mosquitto_sublevel **tmp;
+
+    level = _sub_level_find(token);
+    if(level){
+        level->ref_count++;
+        return level;
+    }
+
+    if((_level_count + 1) * 2 > _level_size){
+        unsigned int size = (_level_size ? _level_size * 2 : SUB_LEVELS_MIN_SIZE);
+        tmp = (struct _mosquitto_sublevel **)ptr_table_rehash(
+            (void **)_levels, _level_size, size, _sub_level_hash_of);
+        if(!tmp) return NULL;
+        _levels = tmp;
+        _level_size = size;
+    }
+
+    level = (struct _mosquitto_sublevel *)_mosquitto_pool_malloc(_sub_level_alloc_size(token->topic_len));
+    if(!level) return NULL;
+    level->hash = token->hash;
+    level->len = token->topic_len;
+    level->ref_count = 1;
+    memcpy(level->topic, token->topic, token->topic_len);
+    level->topic[token->topic_len] = '\0';
+
+    ptr_table_insert((void **)_levels, _level_size, level, level->hash);
+    _level_count++;
+
+    return level;
+}
+
+/* Releases a reference to the level */
+static void _sub_level_release(struct _mosquitto_sublevel *level)
+{
+    struct _mosquitto_sublevel **tmp;
+
+    if(--level->ref_count){
+        return;
+    }
+    ptr_table_remove((void **)_levels, _level_size, level, level->hash, _sub_level_hash_of);
+    _level_count--;
+    _mosquitto_pool_free(level, _sub_level_alloc_size(level->len));
+
+    /* Shrink the table once it is mostly empty (it is grown when it is half full) */
+    if(_level_size > SUB_LEVELS_MIN_SIZE && _level_count * 8 <= _level_size){
+        tmp = (struct _mosquitto_sublevel **)ptr_table_rehash(
+            (void **)_levels, _level_size, _level_size / 2, _sub_level_hash_of);
+        if(tmp){
+            _levels = tmp;
+            _level_size /= 2;
+        }
+    }
+}
+
+/*
+ * The children of a node are kept in an array sorted by level hash while there are at
+ * most SUBHIER_SMALL_CHILDREN of them, and in an open addressing table beyond that.
+ */
+#define SUBHIER_SMALL_CHILDREN 16
+
+/* DXL: The last generation stamped on a node whose children changed */
+static uint64_t _subs_generation = 0;
+
+static unsigned int _sub_child_hash_of(const void *item)
+{
+    return ((const struct _mosquitto_subhier *)item)->level->hash;
+}
+
+static bool _sub_child_match(const void *item, const void *key)
+{
+    return _sub_level_match(((const struct _mosquitto_subhier *)item)->level, key);
+}
+
+/* Returns the position of the first child whose level hash is not less than hashv (small nodes) */
+static unsigned int _sub_child_lower_bound(struct _mosquitto_subhier *hier, unsigned int hashv)
+{
+    unsigned int lo = 0, hi = hier->child_count, mid;
+
+    while(lo < hi){
+        mid = (lo + hi) / 2;
+        if(hier->children[mid]->level->hash < hashv){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Returns the child of the node for the level of the token (NULL if there is none) */
+static struct _mosquitto_subhier* _sub_child_find(struct _mosquitto_subhier *hier, const struct _sub_token *token)
+{
+    unsigned int i;
+
+    if(hier->child_size > SUBHIER_SMALL_CHILDREN){
+        return (struct _mosquitto_subhier *)ptr_table_find(
+            (void **)hier->children, hier->child_size, token->hash, token, _sub_child_match);
+    }
+    for(i=_sub_child_lower_bound(hier, token->hash);
+            i<hier->child_count && hier->children[i]->level->hash == token->hash; i++){
+        if(_sub_child_match(hier->children[i], token)){
+            return hier->children[i];
+        }
+    }
+    return NULL;
+}
+
+/* Returns the child at or after position *i (advancing *i past it), or NULL after the last child */
+static struct _mosquitto_subhier* _sub_child_next(struct _mosquitto_subhier *hier, unsigned int *i)
+{
+    unsigned int end = (hier->child_size > SUBHIER_SMALL_CHILDREN ? hier->child_size : hier->child_count);
+    struct _mosquitto_subhier *child;
+
+    while(*i < end){
+        child = hier->children[(*i)++];
+        if(child){
+            return child;
+        }
+    }
+    return NULL;
+}
+
+/* Adds the child to the children of the node */
+static int _sub_child_add(struct _mosquitto_subhier *hier, struct _mosquitto_subhier *child)
+{
+    struct _mosquitto_subhier **tmp;
+    unsigned int size, pos;
+
+    if(hier->child_size <= SUBHIER_SMALL_CHILDREN && hier->child_count == hier->child_size){
+        if(hier->child_size < SUBHIER_SMALL_CHILDREN){
+            size = (hier->child_size ? hier->child_size * 2 : 1);
+            tmp = (struct _mosquitto_subhier **)_mosquitto_realloc(
+                hier->children, size * sizeof(struct _mosquitto_subhier *));
+        }else{
+            /* Switch to a table */
+            size = SUBHIER_SMALL_CHILDREN * 4;
+            tmp = (struct _mosquitto_subhier **)ptr_table_rehash(
+                (void **)hier->children, hier->child_count, size, _sub_child_hash_of);
+        }
+        if(!tmp) return MOSQ_ERR_NOMEM;
+        hier->children = tmp;
+        hier->child_size = size;
+    }
+
+    if(hier->child_size > SUBHIER_SMALL_CHILDREN){
+        if((hier->child_count + 1) * 2 > hier->child_size){
+            size = hier->child_size * 2;
+            tmp = (struct _mosquitto_subhier **)ptr_table_rehash(
+                (void **)hier->children, hier->child_size, size, _sub_child_hash_of);
+            if(!tmp) return MOSQ_ERR_NOMEM;
+            hier->children = tmp;
+            hier->child_size = size;
+        }
+        ptr_table_insert((void **)hier->children, hier->child_size, child, child->level->hash);
+    }else{
+        pos = _sub_child_lower_bound(hier, child->level->hash);
+        memmove(&hier->children[pos + 1], &hier->children[pos],
+            (hier->child_count - pos) * sizeof(struct _mosquitto_subhier *));
+        hier->children[pos] = child;
+    }
+    hier->child_count++;
+
+    // Determine whether topic is a wild card and set it appropriately for searching
+    if(topic_is_wild_card(child->level->topic, "#")) hier->has_pound_wild_card = true;
+    if(topic_is_wild_card(child->level->topic, "+")) hier->has_plus_wild_card = true;
+
+    hier->generation = ++_subs_generation;
+    return MOSQ_ERR_SUCCESS;
+}
+
+/* Removes the child from the children of the node */
+static void _sub_child_remove(struct _mosquitto_subhier *hier, struct _mosquitto_subhier *child)
+{
+    struct _mosquitto_subhier **tmp, *c;
+    unsigned int i, j, pos;
+
+    if(hier->child_size > SUBHIER_SMALL_CHILDREN){
+        ptr_table_remove((void **)hier->children, hier->child_size, child, child->level->hash, _sub_child_hash_of);
+        hier->child_count--;
+
+        if(hier->child_count <= SUBHIER_SMALL_CHILDREN / 2){
+            /* Switch back to a sorted array */
+            tmp = (struct _mosquitto_subhier **)_mosquitto_malloc(
+                SUBHIER_SMALL_CHILDREN * sizeof(struct _mosquitto_subhier *));
+            if(tmp){
+                for(i=0, j=0; i<hier->child_size; i++){
+                    if(!(c = hier->children[i])) continue;
+                    for(pos=j; pos>0 && tmp[pos-1]->level->hash > c->level->hash; pos--){
+                        tmp[pos] = tmp[pos-1];
+                    }
+                    tmp[pos] = c;
+                    j++;
+                }
+                _mosquitto_free(hier->children);
+                hier->children = tmp;
+                hier->child_size = SUBHIER_SMALL_CHILDREN;
+            }
+        }else if(hier->child_size > SUBHIER_SMALL_CHILDREN * 4 && hier->child_count * 8 <= hier->child_size){
+            tmp = (struct _mosquitto_subhier **)ptr_table_rehash(
+                (void **)hier->children, hier->child_size, hier->child_size / 2, _sub_child_hash_of);
+            if(tmp){
+                hier->children = tmp;
+                hier->child_size /= 2;
+            }
+        }
+    }else{
+        for(pos=_sub_child_lower_bound(hier, child->level->hash); pos<hier->child_count; pos++){
+            if(hier->children[pos] == child) break;
+        }
+        if(pos == hier->child_count) return;
+        hier->child_count--;
+        memmove(&hier->children[pos], &hier->children[pos + 1],
+            (hier->child_count - pos) * sizeof(struct _mosquitto_subhier *));
+        if(!hier->child_count){
+            _mosquitto_free(hier->children);
+            hier->children = NULL;
+            hier->child_size = 0;
+        }
+    }
+
+    // Determine wether topic is a wild card and set it appropriately for searching
+    if(topic_is_wild_card(child->level->topic, "#")) hier->has_pound_wild_card = false;
+    if(topic_is_wild_card(child->level->topic, "+")) hier->has_plus_wild_card = false;
+
+    hier->generation = ++_subs_generation;
+}
+
+/*
+ * The subscriptions of a node are scanned while there are at most SUBHIER_SMALL_SUBS of
+ * them. Beyond that they are also indexed by context in an open addressing table.
+ */
+#define SUBHIER_SMALL_SUBS 16
+
+static unsigned int _sub_leaf_hash(const struct mosquitto *context)
+{
+    return (unsigned int)context->numericId * 2654435761u;
+}
+
+static unsigned int _sub_leaf_hash_of(const void *item)
+{
+    return _sub_leaf_hash(((const struct _mosquitto_subleaf *)item)->context);
+}
+
+static bool _sub_leaf_match(const void *item, const void *key)
+{
+    return ((const struct _mosquitto_subleaf *)item)->context == (const struct mosquitto *)key;
+}
+
+/* Returns the indexes of the node, allocating them if necessary */
+static struct _mosquitto_subindex* _sub_index_get(struct _mosquitto_subhier *hier)
+{
+    if(!hier->index){
+        hier->index = (struct _mosquitto_subindex *)_mosquitto_calloc(1, sizeof(struct _mosquitto_subindex));
+    }
+    return hier->index;
+}
+
+/* Frees the indexes of the node once none is present */
+static void _sub_index_trim(struct _mosquitto_subhier *hier)
+{
+    if(hier->index && !hier->index->by_context && !hier->index->parts){
+        _mosquitto_free(hier->index);
+        hier->index = NULL;
+    }
+}
+
+static void _sub_index_free(struct _mosquitto_subhier *hier)
+{
+    int i;
+
+    if(!hier->index) return;
+    if(hier->index->by_context) _mosquitto_free(hier->index->by_context);
+    if(hier->index->parts){
+        for(i=0; i<hier->index->part_count; i++){
+            if(hier->index->parts[i].tenant) _sub_level_release(hier->index->parts[i].tenant);
+        }
+        _mosquitto_free(hier->index->parts);
+    }
+    _mosquitto_free(hier->index);
+    hier->index = NULL;
+}
+
+/* Returns the subscription of the context to the node (NULL if it is not subscribed) */
+static struct _mosquitto_subleaf* _sub_leaf_find(struct _mosquitto_subhier *hier, struct mosquitto *context)
+{
+    int i;
+
+    if(hier->index && hier->index->by_context){
+        return (struct _mosquitto_subleaf *)ptr_table_find((void **)hier->index->by_context,
+            2 * hier->sub_size, _sub_leaf_hash(context), context, _sub_leaf_match);
+    }
+    for(i=0; i<hier->sub_count; i++){
+        if(hier->subs[i]->context == context){
+            return hier->subs[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Rebuilds the index of the subscriptions by context after the array has been resized.
+ * The index is an optimization only: if it cannot be allocated, the array is scanned.
+ */
+static void _sub_leaf_reindex(struct _mosquitto_subhier *hier)
+{
+    struct _mosquitto_subindex *index;
+    int i;
+
+    if(hier->index && hier->index->by_context){
+        _mosquitto_free(hier->index->by_context);
+        hier->index->by_context = NULL;
+    }
+    if(hier->sub_size > SUBHIER_SMALL_SUBS && (index = _sub_index_get(hier))){
+        index->by_context = (struct _mosquitto_subleaf **)_mosquitto_calloc(
+            2 * hier->sub_size, sizeof(struct _mosquitto_subleaf *));
+        if(index->by_context){
+            for(i=0; i<hier->sub_count; i++){
+                ptr_table_insert((void **)index->by_context, 2 * hier->sub_size,
+                    hier->subs[i], _sub_leaf_hash(hier->subs[i]->context));
+            }
+        }
+    }
+    _sub_index_trim(hier);
+}
+
+/*
+ * DXL: The tenant partitions. In multi-tenant mode the subscriptions of a node are grouped
+ * by the tenant of their context, so that a message is only offered to the subscribers of
+ * the tenants it may be delivered to (see _subs_process). Operations clients and bridges
+ * share the partition without tenant.
+ */
+static int _sub_part_compare(const struct _mosquitto_sublevel *a, const struct _mosquitto_sublevel *b)
+{
+    unsigned int ha = (a ? a->hash : 0), hb = (b ? b->hash : 0);
+
+    if(ha != hb) return (ha < hb ? -1 : 1);
+    if(a != b) return (a < b ? -1 : 1);
+    return 0;
+}
+
+/* Returns the position of the partition of the tenant (or where it would be inserted) */
+static int _sub_part_lower_bound(struct _mosquitto_subindex *index, const struct _mosquitto_sublevel *tenant)
+{
+    int lo = 0, hi = index->part_count, mid;
+
+    while(lo < hi){
+        mid = (lo + hi) / 2;
+        if(_sub_part_compare(index->parts[mid].tenant, tenant) < 0){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Returns the partition of the tenant (NULL if the node has no subscriber of the tenant) */
+static struct _mosquitto_subpart* _sub_part_find(struct _mosquitto_subhier *hier, const struct _mosquitto_sublevel *tenant)
+{
+    struct _mosquitto_subindex *index = hier->index;
+    int pos;
+
+    pos = _sub_part_lower_bound(index, tenant);
+    if(pos < index->part_count && index->parts[pos].tenant == tenant){
+        return &index->parts[pos];
+    }
+    return NULL;
+}
+
+/* Returns the position of the partition containing the subscription */
+static int _sub_part_of(struct _mosquitto_subhier *hier, const struct _mosquitto_subleaf *leaf)
+{
+    struct _mosquitto_subindex *index = hier->index;
+    int lo = 0, hi = index->part_count - 1, mid;
+
+    while(lo < hi){
+        mid = (lo + hi + 1) / 2;
+        if(index->parts[mid].start <= leaf->index){
+            lo = mid;
+        }else{
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+/* The tenants a message may be delivered to (see mqtt3_db_messages_queue) */
+#define SUB_TENANTS_MAX 32
+struct _sub_tenants {
+    int count;
+    struct _mosquitto_sublevel *tenants[SUB_TENANTS_MAX];
+};
+
+/* Returns the partition of the subscriptions of the context, with a reference held by the caller */
+static int _sub_part_tenant(struct mosquitto *context, struct _mosquitto_sublevel **tenant)
+{
+    struct _sub_token token;
+    const char *guid;
+
+    if(context->is_bridge || (context->dxl_flags & DXL_FLAG_OPS)){
+        *tenant = NULL;
+        return MOSQ_ERR_SUCCESS;
+    }
+    guid = (context->dxl_tenant_guid ? context->dxl_tenant_guid : "");
+    _sub_token_set(&token, guid, (unsigned int)strlen(guid));
+    *tenant = _sub_level_get(&token);
+    return (*tenant ? MOSQ_ERR_SUCCESS : MOSQ_ERR_NOMEM);
+}
+
+static void _sub_leaf_move(struct _mosquitto_subhier *hier, int from, int to)
+{
+    hier->subs[to] = hier->subs[from];
+    hier->subs[to]->index = to;
+}
+
+/*
+ * Places the subscription (appended to the array) at the end of its partition. The first
+ * subscription of each of the following partitions moves to the end of its partition.
+ */
+static int _sub_part_insert(struct _mosquitto_subhier *hier, struct _mosquitto_subleaf *leaf)
+{
+    struct _mosquitto_subindex *index;
+    struct _mosquitto_subpart *tmp, *part;
+    struct _mosquitto_sublevel *tenant;
+    int pos, i, last = leaf->index;
+
+    if(_sub_part_tenant(leaf->context, &tenant)) return MOSQ_ERR_NOMEM;
+    index = _sub_index_get(hier);
+    if(!index) goto nomem;
+
+    pos = _sub_part_lower_bound(index, tenant);
+    if(pos < index->part_count && index->parts[pos].tenant == tenant){
+        if(tenant) _sub_level_release(tenant);
+    }else{
+        if(index->part_count == index->part_size){
+            int size = (index->part_size ? index->part_size * 2 : 1);
+            tmp = (struct _mosquitto_subpart *)_mosquitto_realloc(
+                index->parts, size * sizeof(struct _mosquitto_subpart));
+            if(!tmp) goto nomem;
+            index->parts = tmp;
+            index->part_size = size;
+        }
+        memmove(&index->parts[pos + 1], &index->parts[pos],
+            (index->part_count - pos) * sizeof(struct _mosquitto_subpart));
+        index->parts[pos].tenant = tenant;
+        index->parts[pos].start = (pos < index->part_count ? index->parts[pos + 1].start : last);
+        index->parts[pos].count = 0;
+        index->part_count++;
+    }
+
+    for(i=index->part_count-1; i>pos; i--){
+        part = &index->parts[i];
+        _sub_leaf_move(hier, part->start, last);
+        last = part->start++;
+    }
+    part = &index->parts[pos];
+    hier->subs[last] = leaf;
+    leaf->index = last;
+    part->count++;
+    return MOSQ_ERR_SUCCESS;
+
+nomem:
+    if(tenant) _sub_level_release(tenant);
+    _sub_index_trim(hier);
+    return MOSQ_ERR_NOMEM;
+}
+
+/*
+ * Removes the subscription from its partition, leaving the last entry of the array unused.
+ * The last subscription of the partition takes its place, and the last subscription of each
+ * of the following partitions moves to the start of its partition.
+ */
+static void _sub_part_remove(struct _mosquitto_subhier *hier, struct _mosquitto_subleaf *leaf)
+{
+    struct _mosquitto_subindex *index = hier->index;
+    struct _mosquitto_subpart *part;
+    int pos, i, hole;
+
+    pos = _sub_part_of(hier, leaf);
+    part = &index->parts[pos];
+    hole = part->start + part->count - 1;
+    if(hole != leaf->index) _sub_leaf_move(hier, hole, leaf->index);
+    part->count--;
+
+    for(i=pos+1; i<index->part_count; i++){
+        part = &index->parts[i];
+        if(part->start + part->count - 1 != hole){
+            _sub_leaf_move(hier, part->start + part->count - 1, hole);
+        }
+        hole = part->start + part->count - 1;
+        part->start--;
+    }
+
+    if(!index->parts[pos].count){
+        if(index->parts[pos].tenant) _sub_level_release(index->parts[pos].tenant);
+        index->part_count--;
+        memmove(&index->parts[pos], &index->parts[pos + 1],
+            (index->part_count - pos) * sizeof(struct _mosquitto_subpart));
+        if(!index->part_count){
+            _mosquitto_free(index->parts);
+            index->parts = NULL;
+            index->part_size = 0;
+            _sub_index_trim(hier);
         }
-        leaf = leaf->next;
     }
-    return true;
+}
+
+/* Drops the partitions of the node (should one not be allocated), its subscriptions stay in place */
+static void _sub_part_clear(struct _mosquitto_subhier *hier)
+{
+    struct _mosquitto_subindex *index = hier->index;
+    int i;
+
+    if(!index || !index->parts) return;
+    for(i=0; i<index->part_count; i++){
+        if(index->parts[i].tenant) _sub_level_release(index->parts[i].tenant);
+    }
+    _mosquitto_free(index->parts);
+    index->parts = NULL;
+    index->part_count = 0;
+    index->part_size = 0;
+    _sub_index_trim(hier);
+}
+
+/*
+ * Adds the subscription to the subscriptions of the node. In multi-tenant mode, a node
+ * whose subscriptions are all partitioned (an empty node for example) stays partitioned.
+ */
+static int _sub_leaf_insert(struct _mosquitto_subhier *hier, struct _mosquitto_subleaf *leaf)
+{
+    if(hier->sub_count == hier->sub_size){
+        int size = (hier->sub_size ? hier->sub_size * 2 : 1);
+        struct _mosquitto_subleaf **tmp = (struct _mosquitto_subleaf **)_mosquitto_realloc(
+            hier->subs, size * sizeof(struct _mosquitto_subleaf *));
+        if(!tmp){
+            return MOSQ_ERR_NOMEM;
+        }
+        hier->subs = tmp;
+        hier->sub_size = size;
+        _sub_leaf_reindex(hier);
+    }
+    leaf->hier = hier;
+    leaf->index = hier->sub_count;
+    hier->subs[hier->sub_count] = leaf;
+    // DXL Begin
+    if((!hier->sub_count || (hier->index && hier->index->parts)) && dxl_is_multi_tenant_mode_enabled()){
+        /* Without partitions every subscription is offered the messages, as it was */
+        if(_sub_part_insert(hier, leaf)) _sub_part_clear(hier);
+    }
+    // DXL End
+    hier->sub_count++;
+    if(hier->index && hier->index->by_context){
+        ptr_table_insert((void **)hier->index->by_context, 2 * hier->sub_size,
+            leaf, _sub_leaf_hash(leaf->context));
+    }
+    if(!leaf->context->is_bridge){
+        hier->client_sub_count++;
+    }
+    return MOSQ_ERR_SUCCESS;
+}
+
+/* Removes the subscription from the subscriptions of the node (the last one takes its place) */
+static void _sub_leaf_remove(struct _mosquitto_subhier *hier, struct _mosquitto_subleaf *leaf)
+{
+    struct _mosquitto_subleaf *last;
+    struct _mosquitto_subleaf **tmp;
+
+    if(hier->index && hier->index->by_context){
+        ptr_table_remove((void **)hier->index->by_context, 2 * hier->sub_size,
+            leaf, _sub_leaf_hash(leaf->context), _sub_leaf_hash_of);
+    }
+    if(hier->index && hier->index->parts){
+        _sub_part_remove(hier, leaf); // DXL
+        hier->sub_count--;
+    }else{
+        last = hier->subs[--hier->sub_count];
+        last->index = leaf->index;
+        hier->subs[leaf->index] = last;
+    }
+    if(!leaf->context->is_bridge){
+        hier->client_sub_count--;
+    }
+    if(!hier->sub_count){
+        _mosquitto_free(hier->subs);
+        hier->subs = NULL;
+        hier->sub_size = 0;
+        _sub_leaf_reindex(hier);
+    }else if(hier->sub_size > 4 && hier->sub_count * 4 <= hier->sub_size){
+        tmp = (struct _mosquitto_subleaf **)_mosquitto_realloc(
+            hier->subs, (hier->sub_size / 2) * sizeof(struct _mosquitto_subleaf *));
+        if(tmp){
+            hier->subs = tmp;
+            hier->sub_size /= 2;
+            _sub_leaf_reindex(hier);
+        }
+    }
+}
+
+/* Creates a child of the node (if any) for the level of the token */
+static struct _mosquitto_subhier* _sub_hier_new(struct _mosquitto_subhier *parent, const struct _sub_token *token)
+{
+    struct _mosquitto_subhier *hier;
+
+    hier = (struct _mosquitto_subhier *)_mosquitto_pool_calloc(sizeof(struct _mosquitto_subhier));
+    if(!hier) return NULL;
+    hier->level = _sub_level_get(token);
+    if(!hier->level){
+        _mosquitto_pool_free(hier, sizeof(struct _mosquitto_subhier));
+        return NULL;
+    }
+    hier->parent = parent;
+    hier->generation = ++_subs_generation;
+    if(parent && _sub_child_add(parent, hier)){
+        _sub_level_release(hier->level);
+        _mosquitto_pool_free(hier, sizeof(struct _mosquitto_subhier));
+        return NULL;
+    }
+    return hier;
+}
+
+/* Frees the node (which must have been unlinked from its parent) */
+static void _sub_hier_free(struct _mosquitto_subhier *hier)
+{
+    _sub_level_release(hier->level);
+    if(hier->children) _mosquitto_free(hier->children);
+    if(hier->subs) _mosquitto_free(hier->subs);
+    _sub_index_free(hier);
+    _mosquitto_pool_free(hier, sizeof(struct _mosquitto_subhier));
+}
+
+/*
+ * Builds the full topic of the node into fulltopic (as _add_topic_to_path does while
+ * descending the tree). Returns the depth of the node (-1 for the root).
+ */
+static int _sub_hier_full_topic(struct _mosquitto_subhier *hier, char* fulltopic, unsigned int fulltopiclen)
+{
+    int depth;
+
+    if(!hier->parent){
+        fulltopic[0] = '\0';
+        return -1;
+    }
+    depth = _sub_hier_full_topic(hier->parent, fulltopic, fulltopiclen) + 1;
+    _add_topic_to_path(hier, fulltopic, fulltopiclen, (unsigned int)depth);
+    return depth;
+}
+
+/* Frees the node and its ancestors while they are empty (top level nodes are kept) */
+static void _sub_hier_prune(struct _mosquitto_subhier *hier)
+{
+    struct _mosquitto_subhier *parent;
+
+    while(hier->parent && hier->parent->parent &&
+            !hier->child_count && !hier->sub_count && !hier->retained){
+        parent = hier->parent;
+        _sub_child_remove(parent, hier);
+        _sub_hier_free(hier);
+        hier = parent;
+    }
+}
+
+/* Links the subscription into the subscriptions of its context */
+static void _sub_leaf_link_context(struct _mosquitto_subleaf *leaf)
+{
+    struct mosquitto *context = leaf->context;
+
+    leaf->context_prev = NULL;
+    leaf->context_next = context->subs;
+    if(context->subs){
+        context->subs->context_prev = leaf;
+    }
+    context->subs = leaf;
+}
+
+/* Unlinks the subscription from the subscriptions of its context */
+static void _sub_leaf_unlink_context(struct _mosquitto_subleaf *leaf)
+{
+    if(leaf->context_prev){
+        leaf->context_prev->context_next = leaf->context_next;
+    }else{
+        leaf->context->subs = leaf->context_next;
+    }
+    if(leaf->context_next){
+        leaf->context_next->context_prev = leaf->context_prev;
+    }
 }
 // DXL End
 
-static int _subs_process(
-    struct mosquitto_db *db, struct _mosquitto_subhier *hier, const char *source_id,
-    const char* /*topic*/, int qos, int retain, struct mosquitto_msg_store *stored,
-    bool set_retain)
+/* DXL: Offers the message to the subscriptions of the node in the range [start, end) */
+static int _subs_deliver(
+    struct mosquitto_db *db, struct _mosquitto_subhier *hier, int start, int end,
+    const char *source_id, int qos, int retain, struct mosquitto_msg_store *stored)
 {
     int rc = 0;
     int client_qos, msg_qos;
     uint16_t mid;
     struct _mosquitto_subleaf *leaf;
     bool client_retain;
+    int i;
 
-    // When this is null, it means no one has subscribed to the message
-    leaf = hier->subs;
-    if(retain && set_retain){
-        if(hier->retained){
-            hier->retained->ref_count--;
-            /* FIXME - it would be nice to be able to remove the
-               message from the store at this point if ref_count == 0 */
-            db->retained_count--;
-        }
-        if(stored->msg.payloadlen){
-            hier->retained = stored;
-            hier->retained->ref_count++;
-            db->retained_count++;
-        }else{
-            hier->retained = NULL;
-        }
-    }
-    while(source_id && leaf){
+    for(i=start; i<end; i++){
+        leaf = hier->subs[i];
         if(leaf->context->is_bridge && !strcmp(leaf->context->id, source_id)){
-            leaf = leaf->next;
             continue;
         }
         client_qos = leaf->qos;
@@ -183,55 +923,110 @@ static int _subs_process(
             client_retain = false;
         }
         if(mqtt3_db_message_insert(db, leaf->context, mid, mosq_md_out, msg_qos, client_retain, stored) == 1) rc = 1;
-        leaf = leaf->next;
     }
 
     return rc;
 }
 
-static int _sub_topic_tokenise(const char *subtopic, struct _sub_token **topics)
+static int _subs_process(
+    struct mosquitto_db *db, struct _mosquitto_subhier *hier, const char *source_id,
+    const char* /*topic*/, int qos, int retain, struct mosquitto_msg_store *stored,
+    bool set_retain, const struct _sub_tenants *tenants /*DXL*/)
 {
-    struct _sub_token *new_topic, *tail = NULL;
+    int rc = 0;
+    struct _mosquitto_subpart *part; // DXL
+    int i;
+
+    if(retain && set_retain){
+        // DXL: The previous message is released last, in case it is being retained again
+        struct mosquitto_msg_store *previous = hier->retained;
+        if(stored->msg.payloadlen){
+            hier->retained = stored;
+            mqtt3_db_msg_store_ref_inc(hier->retained);
+            db->retained_count++;
+        }else{
+            hier->retained = NULL;
+        }
+        if(previous){
+            mqtt3_db_msg_store_ref_dec(previous);
+            db->retained_count--;
+        }
+    }
+    if(!source_id){
+        return rc;
+    }
+    // DXL Begin
+    if(tenants && hier->index && hier->index->parts){
+        /* Operations clients and bridges, then the tenants the message may be delivered to */
+        part = _sub_part_find(hier, NULL);
+        if(part && _subs_deliver(db, hier, part->start, part->start + part->count, source_id, qos, retain, stored)){
+            rc = 1;
+        }
+        for(i=0; i<tenants->count; i++){
+            part = _sub_part_find(hier, tenants->tenants[i]);
+            if(part && _subs_deliver(db, hier, part->start, part->start + part->count, source_id, qos, retain, stored)){
+                rc = 1;
+            }
+        }
+        return rc;
+    }
+    // DXL End
+
+    return _subs_deliver(db, hier, 0, hier->sub_count, source_id, qos, retain, stored);
+}
+
+/* DXL: Appends a token for the level (which must be NUL terminated at topic_len) */
+static void _sub_token_append(struct _sub_tokens *topics, struct _sub_token **tail,
+    const char *topic, unsigned int topic_len)
+{
+    struct _sub_token *token = (*tail ? *tail + 1 : topics->tokens);
+
+    _sub_token_set(token, topic, topic_len);
+    if(*tail){
+        (*tail)->next = token;
+    }
+    *tail = token;
+}
+
+static int _sub_topic_tokenise(const char *subtopic, struct _sub_tokens *topics)
+{
+    struct _sub_token *tail = NULL;
     int len;
-    int start, stop, tlen;
+    int start, stop;
     int i;
+    int count;
 
     assert(subtopic);
     assert(topics);
 
-    if(subtopic[0] != '$'){
-        new_topic = (struct _sub_token *)_mosquitto_malloc(sizeof(struct _sub_token));
-        if(!new_topic) goto cleanup;
-        new_topic->next = NULL;
-        new_topic->topic = _mosquitto_strdup("");
-        if(!new_topic->topic) goto cleanup;
-
-        if(tail){
-            tail->next = new_topic;
-            tail = tail->next;
-        }else{
-            *topics = new_topic;
-            tail = new_topic;
-        }
+    // DXL Begin
+    len = (int)strlen(subtopic);
+
+    /* Leading "" level, an extra "" level for a leading '/' and one level per '/' */
+    count = (subtopic[0] != '$' ? 1 : 0) + 1;
+    for(i=0; i<len; i++){
+        if(subtopic[i] == '/') count++;
     }
 
-    len = (int)strlen(subtopic);
+    topics->tokens = topics->inline_tokens;
+    topics->buf = topics->inline_buf;
+    if(count > SUB_TOKENS_INLINE_LEVELS){
+        topics->tokens = (struct _sub_token *)_mosquitto_malloc(count * sizeof(struct _sub_token));
+        if(!topics->tokens) goto cleanup;
+    }
+    if(len + 1 > SUB_TOKENS_INLINE_LEN){
+        topics->buf = (char *)_mosquitto_malloc(len + 1);
+        if(!topics->buf) goto cleanup;
+    }
+    memcpy(topics->buf, subtopic, len + 1);
+    // DXL End
 
-    if(subtopic[0] == '/'){
-        new_topic = (struct _sub_token *)_mosquitto_malloc(sizeof(struct _sub_token));
-        if(!new_topic) goto cleanup;
-        new_topic->next = NULL;
-        new_topic->topic = _mosquitto_strdup("");
-        if(!new_topic->topic) goto cleanup;
-
-        if(tail){
-            tail->next = new_topic;
-            tail = tail->next;
-        }else{
-            *topics = new_topic;
-            tail = new_topic;
-        }
+    if(subtopic[0] != '$'){
+        _sub_token_append(topics, &tail, "", 0); // DXL
+    }
 
+    if(subtopic[0] == '/'){
+        _sub_token_append(topics, &tail, "", 0); // DXL
         start = 1;
     }else{
         start = 0;
@@ -241,27 +1036,10 @@ static int _sub_topic_tokenise(const char *subtopic, struct _sub_token **topics)
     for(i=start; i<len+1; i++){
         if(subtopic[i] == '/' || subtopic[i] == '\0'){
             stop = i;
-            new_topic = (struct _sub_token *)_mosquitto_malloc(sizeof(struct _sub_token));
-            if(!new_topic) goto cleanup;
-            new_topic->next = NULL;
-
-            if(start != stop){
-                tlen = stop-start + 1;
-
-                new_topic->topic = (char*)_mosquitto_calloc(tlen, sizeof(char));
-                if(!new_topic->topic) goto cleanup;
-                memcpy(new_topic->topic, &subtopic[start], tlen-1);
-            }else{
-                new_topic->topic = _mosquitto_strdup("");
-                if(!new_topic->topic) goto cleanup;
-            }
-            if(tail){
-                tail->next = new_topic;
-                tail = tail->next;
-            }else{
-                tail = new_topic;
-                *topics = tail;
-            }
+            // DXL Begin
+            topics->buf[stop] = '\0';
+            _sub_token_append(topics, &tail, &topics->buf[start], (unsigned int)(stop-start));
+            // DXL End
             start = i+1;
         }
     }
@@ -269,17 +1047,25 @@ static int _sub_topic_tokenise(const char *subtopic, struct _sub_token **topics)
     return MOSQ_ERR_SUCCESS;
 
 cleanup:
-    tail = *topics;
-    *topics = NULL;
-    while(tail){
-        if(tail->topic) _mosquitto_free(tail->topic);
-        new_topic = tail->next;
-        _mosquitto_free(tail);
-        tail = new_topic;
-    }
+    if(topics->tokens != topics->inline_tokens) _mosquitto_free(topics->tokens);
+    topics->tokens = NULL;
+    topics->buf = NULL;
     return 1;
 }
 
+/* DXL: Releases the storage of the tokens (if any was allocated) */
+static void _sub_tokens_free(struct _sub_tokens *topics)
+{
+    if(topics->tokens && topics->tokens != topics->inline_tokens){
+        _mosquitto_free(topics->tokens);
+    }
+    if(topics->buf && topics->buf != topics->inline_buf){
+        _mosquitto_free(topics->buf);
+    }
+    topics->tokens = NULL;
+    topics->buf = NULL;
+}
+
 static int _sub_add(struct mosquitto_db *db, struct mosquitto *context, int qos,
     struct _mosquitto_subhier *subhier, struct _sub_token *tokens)
 {
@@ -291,9 +1077,9 @@ static int _sub_add_full_topic(struct mosquitto_db *db, struct mosquitto *contex
     int qos, struct _mosquitto_subhier *subhier, struct _sub_token *tokens,
     char* fulltopic, unsigned int fulltopiclen, unsigned int depth)
 {
-    struct _mosquitto_subhier *tmp, *branch, *last = NULL;
-    struct _mosquitto_subleaf *leaf, *last_leaf;    
-    bool first_leaf = true;        
+    struct _mosquitto_subhier *branch;
+    struct _mosquitto_subleaf *leaf;
+    bool first_leaf;
 
     // DXL Begin
     _add_topic_to_path(subhier, fulltopic, fulltopiclen, depth);
@@ -308,42 +1094,26 @@ static int _sub_add_full_topic(struct mosquitto_db *db, struct mosquitto *contex
 
     if(!tokens){
         if(context){
-            leaf = subhier->subs;
-            last_leaf = NULL;
-
-// TODO (DXL): This needs to be optimized. Add contexts into a set, so we can
-// do a quick check to see if they exist. Further, instead of walking to find last, 
-// we should just track last (or add to first)
-// Unsubscribe needs to be optimized as well.
-
-            while(leaf){
-                if(!strcmp(leaf->context->id, context->id)){
-                    /* Client making a second subscription to same topic. Only
-                     * need to update QoS. Return -1 to indicate this to the
-                     * calling function. */
-                    leaf->qos = qos;
-                    return -1;
-                }
-                // DXL Begin
-                if(!leaf->context->is_bridge){
-                    first_leaf = false;        
-                }
-                // DXL End
-                last_leaf = leaf;
-                leaf = leaf->next;
+            leaf = _sub_leaf_find(subhier, context); // DXL
+            if(leaf){
+                /* Client making a second subscription to same topic. Only
+                 * need to update QoS. Return -1 to indicate this to the
+                 * calling function. */
+                leaf->qos = qos;
+                return -1;
             }
-            leaf = (struct _mosquitto_subleaf *)_mosquitto_malloc(sizeof(struct _mosquitto_subleaf));
+            first_leaf = (subhier->client_sub_count == 0); // DXL
+            leaf = (struct _mosquitto_subleaf *)_mosquitto_pool_malloc(sizeof(struct _mosquitto_subleaf)); // DXL
             if(!leaf) return MOSQ_ERR_NOMEM;
-            leaf->next = NULL;
             leaf->context = context;
             leaf->qos = qos;
-            if(last_leaf){
-                last_leaf->next = leaf;
-                leaf->prev = last_leaf;
-            }else{
-                subhier->subs = leaf;
-                leaf->prev = NULL;
+            // DXL Begin
+            if(_sub_leaf_insert(subhier, leaf)){
+                _mosquitto_pool_free(leaf, sizeof(struct _mosquitto_subleaf));
+                return MOSQ_ERR_NOMEM;
             }
+            _sub_leaf_link_context(leaf);
+            // DXL End
             db->subscription_count++;
 
             // DXL Begin
@@ -358,44 +1128,10 @@ static int _sub_add_full_topic(struct mosquitto_db *db, struct mosquitto *contex
     }
 
     // DXL Begin
-    struct subheir_hash *s = 0;
-    HASH_FIND_STR(subhier->children_hash_table, tokens->topic, s);
-    if(s){
-        return _sub_add_full_topic(db, context, qos, s->subheir,
-            tokens->next, fulltopic, fulltopiclen, depth + 1);
-    }
-
-    /* Not found */
-    branch = (struct _mosquitto_subhier *)_mosquitto_calloc(1, sizeof(struct _mosquitto_subhier));
-    if(!branch) return MOSQ_ERR_NOMEM;
-    branch->topic = _mosquitto_strdup(tokens->topic);
-
-    if(!branch->topic){
-        _mosquitto_free(branch);
-        return MOSQ_ERR_NOMEM;
-    }
-
-    branch->children_hash_table = NULL;
-    branch->hash_table_has_pound_wild_card = 0;
-    branch->hash_table_has_plus_wild_card = 0;
-
-    // Add topic to the hash table
-    add_heir_to_hash(&subhier->children_hash_table, branch->topic, branch);
-
-    // Determine whether topic is a wild card and set it appropriately for searching
-    if(topic_is_wild_card(branch->topic, "#")) subhier->hash_table_has_pound_wild_card++;
-    if(topic_is_wild_card(branch->topic, "+")) subhier->hash_table_has_plus_wild_card++;
-
-    if(!subhier->children){
-        subhier->children = branch;
-    }else{
-        // These must be in order
-        tmp = subhier->children;
-        while(tmp){
-            last = tmp;
-            tmp = tmp->next;
-        }
-        last->next = branch;
+    branch = _sub_child_find(subhier, tokens);
+    if(!branch){
+        branch = _sub_hier_new(subhier, tokens);
+        if(!branch) return MOSQ_ERR_NOMEM;
     }
     // DXL End
 
@@ -413,119 +1149,231 @@ static int _sub_remove_full_topic(struct mosquitto_db *db, struct mosquitto *con
     struct _mosquitto_subhier *subhier, struct _sub_token *tokens, char* fulltopic,
     unsigned int fulltopiclen, unsigned int depth)
 {
-    struct _mosquitto_subhier *branch, *last = NULL;
+    struct _mosquitto_subhier *branch;
     struct _mosquitto_subleaf *leaf;
 
     _add_topic_to_path(subhier, fulltopic, fulltopiclen, depth); // DXL
 
     if(!tokens){
-        leaf = subhier->subs;
-        while(leaf){
-            if(leaf->context==context){
-                db->subscription_count--;
-                if(leaf->prev){
-                    leaf->prev->next = leaf->next;
-                }else{
-                    subhier->subs = leaf->next;
-                }
-                if(leaf->next){
-                    leaf->next->prev = leaf->prev;
-                }
-                // DXL Begin
-                context->subscription_count--;
+        leaf = _sub_leaf_find(subhier, context); // DXL
+        if(leaf){
+            db->subscription_count--;
+            // DXL Begin
+            _sub_leaf_remove(subhier, leaf);
+            _sub_leaf_unlink_context(leaf);
+            context->subscription_count--;
 
-                if(_is_topic_removed(context, subhier)){
-                    dxl_on_topic_removed_from_broker(fulltopic);
-                }
-                // DXL End
-                _mosquitto_free(leaf);
-                return MOSQ_ERR_SUCCESS;
+            if(_is_topic_removed(context, subhier)){
+                dxl_on_topic_removed_from_broker(fulltopic);
             }
-            leaf = leaf->next;
+            // DXL End
+            _mosquitto_pool_free(leaf, sizeof(struct _mosquitto_subleaf));
         }
         return MOSQ_ERR_SUCCESS;
     }
 
-    // TODO: Use hash table to to search for existing items.
-    branch = subhier->children;
-    while(branch){
-        if(!strcmp(branch->topic, tokens->topic)){
-            _sub_remove_full_topic(db, context, branch, tokens->next, fulltopic, fulltopiclen, depth + 1);
-            if(!branch->children && !branch->subs && !branch->retained){
-                if(last){
-                    last->next = branch->next;
-                }else{
-                    subhier->children = branch->next;
-                }
+    branch = _sub_child_find(subhier, tokens); // DXL
+    if(branch){
+        _sub_remove_full_topic(db, context, branch, tokens->next, fulltopic, fulltopiclen, depth + 1);
+        // DXL Begin
+        if(!branch->child_count && !branch->sub_count && !branch->retained){
+            _sub_child_remove(subhier, branch);
+            _sub_hier_free(branch);
+        }
+        // DXL End
+    }
+    return MOSQ_ERR_SUCCESS;
+}
 
-                // DXL Begin
-                remove_heir_from_hash(&subhier->children_hash_table, branch->topic);
+// DXL Begin
+/*
+ * The match cache. The nodes whose subscriptions match a published topic are cached by
+ * topic (direct mapped), along with the generation of every node whose children the
+ * search read. These are recorded in the order they were visited, so each node is
+ * validated after its parent and a node freed since is never read. The subscriptions
+ * of the matched nodes are walked when delivering, so (un)subscribing only invalidates
+ * the entries that pass through a node that was added or removed.
+ */
+#define SUB_CACHE_SIZE 1024
+#define SUB_CACHE_MAX_DEPS 64
+#define SUB_CACHE_MAX_MATCHES 64
 
-                // Determine wether topic is a wild card and set it appropriately for searching
-                if(topic_is_wild_card(branch->topic, "#") && (subhier->hash_table_has_pound_wild_card > 0))
-                    subhier->hash_table_has_pound_wild_card--;
-                if(topic_is_wild_card(branch->topic, "+") && (subhier->hash_table_has_plus_wild_card > 0))
-                    subhier->hash_table_has_plus_wild_card--;
-                // DXL End
+struct _sub_cache_dep {
+    struct _mosquitto_subhier *hier;
+    uint64_t generation;
+};
 
-                _mosquitto_free(branch->topic);
-                _mosquitto_free(branch);
-            }
-            return MOSQ_ERR_SUCCESS;
-        }
-        last = branch;
-        branch = branch->next;
+struct _sub_cache_entry {
+    unsigned int hash;
+    unsigned int topic_len;
+    int dep_count;
+    int match_count;
+    struct _sub_cache_dep *deps;
+    struct _mosquitto_subhier **matches;
+    char *topic;
+};
+
+/* The nodes visited and matched while searching the tree for a topic */
+struct _sub_match_set {
+    int dep_count;
+    int match_count;
+    bool overflow;
+    struct _sub_cache_dep deps[SUB_CACHE_MAX_DEPS];
+    struct _mosquitto_subhier *matches[SUB_CACHE_MAX_MATCHES];
+};
+
+static struct _sub_cache_entry **_sub_cache = NULL;
+static int _sub_cache_count = 0;
+/* Set while delivering from an entry, entries are not replaced until it is done */
+static int _sub_cache_busy = 0;
+static uint64_t _sub_cache_hits = 0;
+static uint64_t _sub_cache_misses = 0;
+
+static void _sub_match_set_visit(struct _sub_match_set *set, struct _mosquitto_subhier *hier)
+{
+    if(!set) return;
+    if(set->dep_count == SUB_CACHE_MAX_DEPS){
+        set->overflow = true;
+        return;
     }
-    return MOSQ_ERR_SUCCESS;
+    set->deps[set->dep_count].hier = hier;
+    set->deps[set->dep_count].generation = hier->generation;
+    set->dep_count++;
+}
+
+static void _sub_match_set_match(struct _sub_match_set *set, struct _mosquitto_subhier *hier)
+{
+    if(!set) return;
+    if(set->match_count == SUB_CACHE_MAX_MATCHES){
+        set->overflow = true;
+        return;
+    }
+    set->matches[set->match_count++] = hier;
+}
+
+/* Returns the entry for the topic, if it is still valid */
+static struct _sub_cache_entry* _sub_cache_find(unsigned int hash, const char *topic, unsigned int topic_len)
+{
+    struct _sub_cache_entry *entry;
+    int i;
+
+    if(!_sub_cache) return NULL;
+    entry = _sub_cache[hash & (SUB_CACHE_SIZE - 1)];
+    if(!entry || entry->hash != hash || entry->topic_len != topic_len
+        || memcmp(entry->topic, topic, topic_len)){
+        return NULL;
+    }
+    for(i=0; i<entry->dep_count; i++){
+        if(entry->deps[i].hier->generation != entry->deps[i].generation) return NULL;
+    }
+    return entry;
 }
 
+/* Caches the result of searching the tree for the topic (replacing the entry in its slot) */
+static void _sub_cache_store(unsigned int hash, const char *topic, unsigned int topic_len,
+    const struct _sub_match_set *set)
+{
+    struct _sub_cache_entry *entry, **slot;
+
+    if(set->overflow || _sub_cache_busy) return;
+    if(!_sub_cache){
+        _sub_cache = (struct _sub_cache_entry **)_mosquitto_calloc(
+            SUB_CACHE_SIZE, sizeof(struct _sub_cache_entry *));
+        if(!_sub_cache) return;
+    }
+
+    entry = (struct _sub_cache_entry *)_mosquitto_malloc(sizeof(struct _sub_cache_entry)
+        + set->dep_count * sizeof(struct _sub_cache_dep)
+        + set->match_count * sizeof(struct _mosquitto_subhier *) + topic_len);
+    if(!entry) return;
+    entry->hash = hash;
+    entry->topic_len = topic_len;
+    entry->dep_count = set->dep_count;
+    entry->match_count = set->match_count;
+    entry->deps = (struct _sub_cache_dep *)(entry + 1);
+    entry->matches = (struct _mosquitto_subhier **)(entry->deps + set->dep_count);
+    entry->topic = (char *)(entry->matches + set->match_count);
+    memcpy(entry->deps, set->deps, set->dep_count * sizeof(struct _sub_cache_dep));
+    memcpy(entry->matches, set->matches, set->match_count * sizeof(struct _mosquitto_subhier *));
+    memcpy(entry->topic, topic, topic_len);
+
+    slot = &_sub_cache[hash & (SUB_CACHE_SIZE - 1)];
+    if(*slot){
+        _mosquitto_free(*slot);
+    }else{
+        _sub_cache_count++;
+    }
+    *slot = entry;
+}
+
+static void _sub_cache_clear()
+{
+    int i;
+
+    if(!_sub_cache) return;
+    for(i=0; i<SUB_CACHE_SIZE; i++){
+        if(_sub_cache[i]) _mosquitto_free(_sub_cache[i]);
+    }
+    _mosquitto_free(_sub_cache);
+    _sub_cache = NULL;
+    _sub_cache_count = 0;
+}
+
+void mqtt3_sub_cache_stats(struct mqtt3_sub_cache_stats *stats)
+{
+    stats->entries = _sub_cache_count;
+    stats->hits = _sub_cache_hits;
+    stats->misses = _sub_cache_misses;
+}
+// DXL End
+
 static void _sub_search(struct mosquitto_db *db, struct _mosquitto_subhier *subhier,
     struct _sub_token *tokens, const char *source_id,
-    const char *topic, int qos, int retain, struct mosquitto_msg_store *stored, bool /*set_retain*/)
+    const char *topic, int qos, int retain, struct mosquitto_msg_store *stored, bool /*set_retain*/,
+    const struct _sub_tenants *tenants /*DXL*/, struct _sub_match_set *matches /*DXL*/)
 {
     /* FIXME - need to take into account source_id if the client is a bridge */
     struct _mosquitto_subhier *branch;
     /*bool sr;*/
-    struct subheir_hash *topic_child = 0;
 
     // DXL Start
-    if(subhier->hash_table_has_pound_wild_card){ // #
-        HASH_FIND_STR(subhier->children_hash_table, "#", topic_child);
-        if(topic_child){
-            branch = topic_child->subheir;
-            if(!branch->children){
+    _sub_match_set_visit(matches, subhier);
+    if(subhier->has_pound_wild_card){ // #
+        branch = _sub_child_find(subhier, &_pound_token);
+        if(branch){
+            _sub_match_set_visit(matches, branch);
+            if(!branch->child_count){
                 /* The topic matches due to a # wildcard - process the
                  * subscriptions but *don't* return. Although this branch has ended
                  * there may still be other subscriptions to deal with.
                  */
-                _subs_process(db, branch, source_id, topic, qos, retain, stored, false);
+                _subs_process(db, branch, source_id, topic, qos, retain, stored, false, tenants);
+                _sub_match_set_match(matches, branch);
             }
         }
     }
 
     if(tokens && tokens->topic){
-        if(subhier->hash_table_has_plus_wild_card){ // +
-            topic_child = 0;
-            HASH_FIND_STR(subhier->children_hash_table, "+", topic_child);
-            if(topic_child){
-                branch = topic_child->subheir;
-                _sub_search(db, branch, tokens->next, source_id, topic, qos, retain, stored, false);
+        if(subhier->has_plus_wild_card){ // +
+            branch = _sub_child_find(subhier, &_plus_token);
+            if(branch){
+                _sub_search(db, branch, tokens->next, source_id, topic, qos, retain, stored, false, tenants, matches);
                 if(!tokens->next){
-                    _subs_process(db, branch, source_id, topic, qos, retain, stored, false);
+                    _subs_process(db, branch, source_id, topic, qos, retain, stored, false, tenants);
+                    _sub_match_set_match(matches, branch);
                 }
             }
         }
 
-        topic_child = 0;
         // Topic match
-        HASH_FIND_STR(subhier->children_hash_table, tokens->topic, topic_child);
-        if(topic_child){
-            branch = topic_child->subheir;
+        branch = _sub_child_find(subhier, tokens);
+        if(branch){
             /* The topic matches this subscription.
                 * Doesn't include # wildcards */
-            _sub_search(db, branch, tokens->next, source_id, topic, qos, retain, stored, false);
+            _sub_search(db, branch, tokens->next, source_id, topic, qos, retain, stored, false, tenants, matches);
             if(!tokens->next){
-                _subs_process(db, branch, source_id, topic, qos, retain, stored, false);
+                _subs_process(db, branch, source_id, topic, qos, retain, stored, false, tenants);
+                _sub_match_set_match(matches, branch);
             }
         }
     }
@@ -537,52 +1385,27 @@ int mqtt3_sub_add(struct mosquitto_db *db, struct mosquitto *context,
 {
     int rc = 0;
     struct _mosquitto_subhier /* *subhier,*/ *child;
-    struct _sub_token *tokens = NULL, *tail;
+    struct _sub_tokens topics; // DXL
+    struct _sub_token *tokens;
 
     assert(root);
     assert(sub);
 
-    if(_sub_topic_tokenise(sub, &tokens)) return 1;
+    if(_sub_topic_tokenise(sub, &topics)) return 1;
+    tokens = topics.tokens;
 
-    struct subheir_hash *s = 0;
-    HASH_FIND_STR(root->children_hash_table, tokens->topic, s);
-    if(s){
-        rc = _sub_add(db, context, qos, s->subheir, tokens);
-    }else{
-        child = (_mosquitto_subhier*)_mosquitto_malloc(sizeof(struct _mosquitto_subhier));
+    child = _sub_child_find(root, tokens); // DXL
+    if(!child){
+        child = _sub_hier_new(root, tokens); // DXL
         if(!child){
             _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Out of memory.");
+            _sub_tokens_free(&topics); // DXL
             return MOSQ_ERR_NOMEM;
         }
-        child->topic = _mosquitto_strdup(tokens->topic);
-        if(!child->topic){
-            _mosquitto_log_printf(NULL, MOSQ_LOG_ERR, "Error: Out of memory.");
-            return MOSQ_ERR_NOMEM;
-        }
-        child->subs = NULL;
-        child->children = NULL;
-        child->retained = NULL;
-        child->children_hash_table = NULL;
-        child->hash_table_has_pound_wild_card = 0;
-        child->hash_table_has_plus_wild_card = 0;
-        add_heir_to_hash(&db->subs.children_hash_table, child->topic, child);
-
-        if(db->subs.children){
-            child->next = db->subs.children;
-        }else{
-            child->next = NULL;
-        }
-        db->subs.children = child;
-
-        rc = _sub_add(db, context, qos, child, tokens);
     }
+    rc = _sub_add(db, context, qos, child, tokens);
 
-    while(tokens){
-        tail = tokens->next;
-        _mosquitto_free(tokens->topic);
-        _mosquitto_free(tokens);
-        tokens = tail;
-    }
+    _sub_tokens_free(&topics); // DXL
     /* We aren't worried about -1 (already subscribed) return codes. */
     if(rc == -1) rc = MOSQ_ERR_SUCCESS;
     return rc;
@@ -592,158 +1415,226 @@ int mqtt3_sub_remove(struct mosquitto_db *db, struct mosquitto *context,
     const char *sub, struct _mosquitto_subhier *root)
 {
     int rc = 0;
-    /*struct _mosquitto_subhier *subhier;*/
-    struct _sub_token *tokens = NULL, *tail;
+    struct _mosquitto_subhier *subhier;
+    struct _sub_tokens topics; // DXL
+    struct _sub_token *tokens;
 
     assert(root);
     assert(sub);
 
-    if(_sub_topic_tokenise(sub, &tokens)) return 1;
+    if(_sub_topic_tokenise(sub, &topics)) return 1;
+    tokens = topics.tokens;
 
-    struct subheir_hash *s = 0;
-    HASH_FIND_STR(root->children_hash_table, tokens->topic, s);
-    if(s){
-        rc = _sub_remove(db, context, s->subheir, tokens);
+    subhier = _sub_child_find(root, tokens); // DXL
+    if(subhier){
+        rc = _sub_remove(db, context, subhier, tokens);
     }
 
-    while(tokens){
-        tail = tokens->next;
-        _mosquitto_free(tokens->topic);
-        _mosquitto_free(tokens);
-        tokens = tail;
-    }
+    _sub_tokens_free(&topics); // DXL
 
     return rc;
 }
 
+/*
+ * DXL: Returns the tenant partitions the message may be delivered to in multi-tenant mode
+ * (NULL if it may be delivered to any). Tenants without subscriptions are not interned and
+ * are skipped. The insert handlers still decide for each subscription that is offered the
+ * message, the partitions only spare offering it to those that would be rejected.
+ */
+static const struct _sub_tenants* _sub_tenants_get(struct mosquitto_msg_store *stored, struct _sub_tenants *tenants)
+{
+    struct dxl_message_tenants message_tenants;
+    struct _mosquitto_sublevel *tenant;
+    struct _sub_token token;
+    size_t i;
+
+    if(!dxl_is_multi_tenant_mode_enabled()) return NULL;
+
+    dxl_get_message_tenants(stored, &message_tenants);
+    if(!message_tenants.restricted || message_tenants.count > SUB_TENANTS_MAX) return NULL;
+
+    tenants->count = 0;
+    for(i=0; i<message_tenants.count; i++){
+        _sub_token_set(&token, message_tenants.guids[i], (unsigned int)strlen(message_tenants.guids[i]));
+        tenant = _sub_level_find(&token);
+        if(tenant) tenants->tenants[tenants->count++] = tenant;
+    }
+    return tenants;
+}
+
 int mqtt3_db_messages_queue(struct mosquitto_db *db, const char *source_id, const char *topic, int qos,
     int retain, struct mosquitto_msg_store *stored)
 {
     int rc = 0;
-    struct _sub_token *tokens = NULL, *tail;
+    struct _mosquitto_subhier *subhier;
+    struct _sub_tokens topics; // DXL
+    struct _sub_token *tokens;
+    // DXL Begin
+    struct _sub_match_set matches;
+    struct _sub_match_set *collect = NULL;
+    struct _sub_cache_entry *entry;
+    unsigned int topic_len = 0, hash = 0;
+    struct _sub_tenants tenant_set;
+    const struct _sub_tenants *tenants;
+    int i;
+    // DXL End
 
     assert(db);
     assert(topic);
 
-    if(_sub_topic_tokenise(topic, &tokens)) return 1;
+    // DXL Begin
+    tenants = _sub_tenants_get(stored, &tenant_set);
+
+    /* Retained messages may add to the tree, they are not cached */
+    if(!retain){
+        topic_len = (unsigned int)strlen(topic);
+        hash = topic_level_hash(topic, topic_len);
+        entry = _sub_cache_find(hash, topic, topic_len);
+        if(entry){
+            _sub_cache_hits++;
+            _sub_cache_busy++;
+            for(i=0; i<entry->match_count; i++){
+                _subs_process(db, entry->matches[i], source_id, topic, qos, retain, stored, false, tenants);
+            }
+            _sub_cache_busy--;
+            dxl_on_finalize_message(stored);
+            return rc;
+        }
+        _sub_cache_misses++;
+        matches.dep_count = 0;
+        matches.match_count = 0;
+        matches.overflow = false;
+        collect = &matches;
+    }
+    // DXL End
+
+    if(_sub_topic_tokenise(topic, &topics)) return 1;
+    tokens = topics.tokens;
 
-    struct subheir_hash *s = 0;
-    HASH_FIND_STR(db->subs.children_hash_table, tokens->topic, s);
-    if(s){
+    _sub_match_set_visit(collect, &db->subs); // DXL
+    subhier = _sub_child_find(&db->subs, tokens); // DXL
+    if(subhier){
         if(retain){
             /* We have a message that needs to be retained, so ensure that the subscription
                 * tree for its topic exists.
                 */
-            _sub_add(db, NULL, 0, s->subheir, tokens);
+            _sub_add(db, NULL, 0, subhier, tokens);
         }
-        _sub_search(db, s->subheir, tokens, source_id, topic, qos, retain, stored, true);
-    }
-    while(tokens){
-        tail = tokens->next;
-        _mosquitto_free(tokens->topic);
-        _mosquitto_free(tokens);
-        tokens = tail;
+        _sub_search(db, subhier, tokens, source_id, topic, qos, retain, stored, true, tenants, collect);
     }
+    _sub_tokens_free(&topics); // DXL
 
-    dxl_on_finalize_message(stored->db_id); // DXL
+    if(collect) _sub_cache_store(hash, topic, topic_len, collect); // DXL
+    dxl_on_finalize_message(stored); // DXL
 
     return rc;
 }
 
-static int _subs_clean_session(struct mosquitto_db *db, struct _mosquitto_subhier *root)
+/*
+ * DXL: Moves the subscriptions of the context to the partition of its tenant, should its
+ * tenant or flags have changed (a client taking over a persistent session).
+ */
+void mqtt3_subs_repartition_context(struct mosquitto *context)
 {
-    _fulltopic[0] = '\0';
-    return _subs_clean_session_full_topic(db, root, _fulltopic, MAX_TOPIC_LEN, 0);
+    struct _mosquitto_subhier *hier;
+    struct _mosquitto_subleaf *leaf;
+    struct _mosquitto_sublevel *tenant;
+    bool nomem;
+
+    if(!context->subs) return;
+    nomem = (_sub_part_tenant(context, &tenant) != MOSQ_ERR_SUCCESS);
+
+    for(leaf=context->subs; leaf; leaf=leaf->context_next){
+        hier = leaf->hier;
+        if(!hier->index || !hier->index->parts) continue;
+        if(nomem){
+            _sub_part_clear(hier);
+        }else if(hier->index->parts[_sub_part_of(hier, leaf)].tenant != tenant){
+            _sub_part_remove(hier, leaf);
+            leaf->index = hier->sub_count - 1;
+            hier->subs[leaf->index] = leaf;
+            if(_sub_part_insert(hier, leaf)) _sub_part_clear(hier);
+        }
+    }
+    if(!nomem && tenant) _sub_level_release(tenant);
 }
 
-static int _subs_clean_session_full_topic(struct mosquitto_db *db,
-    struct _mosquitto_subhier *root, char* fulltopic, unsigned int fulltopiclen, unsigned int depth)
+/* DXL: Remove all subscriptions for a client (only its own subscriptions are visited).
+ */
+int mqtt3_subs_clean_context(struct mosquitto_db *db, struct mosquitto *context)
 {
-    int rc = 0;
-    struct _mosquitto_subhier *child, *last = NULL;
-    struct _mosquitto_subleaf *leaf, *next;
-
-    if(!root) return MOSQ_ERR_SUCCESS;
+    struct _mosquitto_subhier *hier;
+    struct _mosquitto_subleaf *leaf;
 
-    _add_topic_to_path(root, fulltopic, fulltopiclen, depth); // DXL
+    while((leaf = context->subs)){
+        hier = leaf->hier;
+        _sub_leaf_unlink_context(leaf);
+        _sub_leaf_remove(hier, leaf);
+        db->subscription_count--;
 
-    leaf = root->subs;
-    while(leaf){
-        if(leaf->context->clean_subs /* DXL */){
-            db->subscription_count--;
-            if(leaf->prev){
-                leaf->prev->next = leaf->next;
-            }else{
-                root->subs = leaf->next;
-            }
-            if(leaf->next){
-                leaf->next->prev = leaf->prev;
-            }
-            next = leaf->next;
-            // DXL Begin
-            if(_is_topic_removed(leaf->context, root)){
-                dxl_on_topic_removed_from_broker(fulltopic);
-            }
-            // DXL End
-            _mosquitto_free(leaf);
-            leaf = next;
-        }else{
-            leaf = leaf->next;
+        if(_is_topic_removed(context, hier)){
+            _sub_hier_full_topic(hier, _fulltopic, MAX_TOPIC_LEN);
+            dxl_on_topic_removed_from_broker(_fulltopic);
         }
+        _mosquitto_pool_free(leaf, sizeof(struct _mosquitto_subleaf));
+        _sub_hier_prune(hier);
     }
 
-    child = root->children;
-    while(child){
-        // DXL Begin
-        char* old = strdup(fulltopic);
-        _subs_clean_session_full_topic(db, child, fulltopic, fulltopiclen, depth + 1);
-        if(old){
-            strcpy(fulltopic, old);
-            free(old);
-        }
-        // DXL End
-        if(!child->children && !child->subs && !child->retained){
-            if(last){
-                last->next = child->next;
-            }else{
-                root->children = child->next;
-            }
+    return MOSQ_ERR_SUCCESS;
+}
 
-            remove_heir_from_hash(&root->children_hash_table, child->topic);
+/* DXL: Creates the root of the subscription tree and its "" and "$SYS" top level nodes. */
+int mqtt3_subs_open(struct mosquitto_db *db)
+{
+    struct _sub_token token;
 
-            // Determine wether topic is a wild card and set it appropriately for searching
-            if(topic_is_wild_card(child->topic, "#") && (root->hash_table_has_pound_wild_card > 0))
-                root->hash_table_has_pound_wild_card--;
-            if(topic_is_wild_card(child->topic, "+") && (root->hash_table_has_plus_wild_card > 0))
-                root->hash_table_has_plus_wild_card--;
+    memset(&db->subs, 0, sizeof(db->subs));
+    _sub_token_set(&token, "", 0);
+    db->subs.level = _sub_level_get(&token);
+    if(!db->subs.level) return MOSQ_ERR_NOMEM;
+    if(!_sub_hier_new(&db->subs, &token)) return MOSQ_ERR_NOMEM;
+    _sub_token_set(&token, "$SYS", 4);
+    if(!_sub_hier_new(&db->subs, &token)) return MOSQ_ERR_NOMEM;
 
-            _mosquitto_free(child->topic);
-            _mosquitto_free(child);
-            if(last){
-                child = last->next;
-            }else{
-                child = root->children;
-            }
-        }else{
-            last = child;
-            child = child->next;
-        }
-    }
-    return rc;
+    return MOSQ_ERR_SUCCESS;
 }
 
-/* Remove all subscriptions for a client.
- */
-int mqtt3_subs_clean_session(struct mosquitto_db *db, struct _mosquitto_subhier *root)
+static void _subs_close(struct _mosquitto_subhier *hier)
 {
     struct _mosquitto_subhier *child;
-    child = root->children;
-    while(child){
-        _subs_clean_session(db, child);
-        child = child->next;
+    unsigned int i = 0;
+    int j;
+
+    while((child = _sub_child_next(hier, &i))){
+        _subs_close(child);
+        _sub_hier_free(child);
     }
+    for(j=0; j<hier->sub_count; j++){
+        _mosquitto_pool_free(hier->subs[j], sizeof(struct _mosquitto_subleaf));
+    }
+    if(hier->retained){
+        mqtt3_db_msg_store_ref_dec(hier->retained);
+    }
+}
 
-    return MOSQ_ERR_SUCCESS;
+/* DXL: Frees the subscription tree. */
+void mqtt3_subs_close(struct mosquitto_db *db)
+{
+    if(!db->subs.level) return;
+
+    _sub_cache_clear();
+    _subs_close(&db->subs);
+    if(db->subs.children) _mosquitto_free(db->subs.children);
+    if(db->subs.subs) _mosquitto_free(db->subs.subs);
+    _sub_index_free(&db->subs);
+    _sub_level_release(db->subs.level);
+    memset(&db->subs, 0, sizeof(db->subs));
+
+    if(!_level_count && _levels){
+        _mosquitto_free(_levels);
+        _levels = NULL;
+        _level_size = 0;
+    }
 }
 
 static int _retain_process(struct mosquitto_db *db, struct mosquitto_msg_store *retained,
@@ -766,11 +1657,13 @@ static int _retain_process(struct mosquitto_db *db, struct mosquitto_msg_store *
 static int _retain_search(struct mosquitto_db *db, struct _mosquitto_subhier *subhier,
     struct _sub_token *tokens, struct mosquitto *context, const char *sub, int sub_qos, int level)
 {
-    struct _mosquitto_subhier *branch;
+    struct _mosquitto_subhier *branch, *next;
+    unsigned int i = 0;
     int flag = 0;
 
-    branch = subhier->children;
+    branch = _sub_child_next(subhier, &i); // DXL
     while(branch){
+        next = _sub_child_next(subhier, &i); // DXL
         /* Subscriptions with wildcards in aren't really valid topics to publish to
          * so they can't have retained messages.
          */
@@ -783,13 +1676,13 @@ static int _retain_search(struct mosquitto_db *db, struct _mosquitto_subhier *su
             if(branch->retained){
                 _retain_process(db, branch->retained, context, sub, sub_qos);
             }
-            if(branch->children){
+            if(branch->child_count){
                 _retain_search(db, branch, tokens, context, sub, sub_qos, level+1);
             }
-        }else if(strcmp(branch->topic, "+") && (!strcmp(branch->topic, tokens->topic) || !strcmp(tokens->topic, "+"))){
+        }else if(strcmp(branch->level->topic, "+") && (!strcmp(branch->level->topic, tokens->topic) || !strcmp(tokens->topic, "+"))){
             if(tokens->next){
                 if(_retain_search(db, branch, tokens->next, context, sub, sub_qos, level+1) == -1
-                        || (!branch->next && tokens->next && !strcmp(tokens->next->topic, "#") && level>0)){
+                        || (!next && tokens->next && !strcmp(tokens->next->topic, "#") && level>0)){
 
                     if(branch->retained){
                         _retain_process(db, branch->retained, context, sub, sub_qos);
@@ -802,7 +1695,7 @@ static int _retain_search(struct mosquitto_db *db, struct _mosquitto_subhier *su
             }
         }
 
-        branch = branch->next;
+        branch = next;
     }
     return flag;
 }
@@ -810,28 +1703,21 @@ static int _retain_search(struct mosquitto_db *db, struct _mosquitto_subhier *su
 int mqtt3_retain_queue(struct mosquitto_db *db, struct mosquitto *context, const char *sub, int sub_qos)
 {
     struct _mosquitto_subhier *subhier;
-    struct _sub_token *tokens = NULL, *tail;
+    struct _sub_tokens topics; // DXL
+    struct _sub_token *tokens;
 
     assert(db);
     assert(context);
     assert(sub);
 
-    if(_sub_topic_tokenise(sub, &tokens)) return 1;
+    if(_sub_topic_tokenise(sub, &topics)) return 1;
+    tokens = topics.tokens;
 
-    subhier = db->subs.children;
-    while(subhier){
-        if(!strcmp(subhier->topic, tokens->topic)){
-            _retain_search(db, subhier, tokens, context, sub, sub_qos, 0);
-            break;
-        }
-        subhier = subhier->next;
-    }
-    while(tokens){
-        tail = tokens->next;
-        _mosquitto_free(tokens->topic);
-        _mosquitto_free(tokens);
-        tokens = tail;
+    subhier = _sub_child_find(&db->subs, tokens); // DXL
+    if(subhier){
+        _retain_search(db, subhier, tokens, context, sub, sub_qos, 0);
     }
+    _sub_tokens_free(&topics); // DXL
 
     return MOSQ_ERR_SUCCESS;
 }
@@ -842,19 +1728,20 @@ static int _sub_count_process(struct mosquitto_db * /*db*/, struct _mosquitto_su
 {
     int rc = 0;
     struct _mosquitto_subleaf *leaf;
+    int i;
 
-    // When this is null, it means no one has subscribed to the message
-    leaf = hier->subs;
-    while(leaf){
+    if(!tenant_guid){
+        *count += hier->client_sub_count;
+        return rc;
+    }
+    for(i=0; i<hier->sub_count; i++){
+        leaf = hier->subs[i];
         if(leaf->context->is_bridge){
-            leaf = leaf->next;
             continue;
         }
-        if(!tenant_guid ||
-           (leaf->context->dxl_tenant_guid && !strcmp(tenant_guid, leaf->context->dxl_tenant_guid))){
+        if(leaf->context->dxl_tenant_guid && !strcmp(tenant_guid, leaf->context->dxl_tenant_guid)){
            (*count)++;
         }
-        leaf = leaf->next;
     }
 
     return rc;
@@ -863,37 +1750,37 @@ static int _sub_count_process(struct mosquitto_db * /*db*/, struct _mosquitto_su
 static int _sub_count_search(struct mosquitto_db *db, struct _mosquitto_subhier *subhier,
     struct _sub_token *tokens, const char *topic, int *count, const char* tenant_guid)
 {
-    struct subheir_hash *s = 0;
+    struct _mosquitto_subhier *branch;
     int flag = 0;
 
     if(tokens && tokens->topic){
-        HASH_FIND_STR(subhier->children_hash_table, "+", s);
-        if(s){
-            if(_sub_count_search(db, s->subheir, tokens->next, topic, count, tenant_guid) == -1){
+        branch = _sub_child_find(subhier, &_plus_token);
+        if(branch){
+            if(_sub_count_search(db, branch, tokens->next, topic, count, tenant_guid) == -1){
                 flag = -1;
             }
             if(!tokens->next){
-                _sub_count_process(db, s->subheir, topic, count, tenant_guid);
+                _sub_count_process(db, branch, topic, count, tenant_guid);
             }
-        }        
-        HASH_FIND_STR(subhier->children_hash_table, tokens->topic, s);
-        if(s){
-            if(_sub_count_search(db, s->subheir, tokens->next, topic, count, tenant_guid) == -1){
+        }
+        branch = _sub_child_find(subhier, tokens);
+        if(branch){
+            if(_sub_count_search(db, branch, tokens->next, topic, count, tenant_guid) == -1){
                 flag = -1;
             }
             if(!tokens->next){
-                _sub_count_process(db, s->subheir, topic, count, tenant_guid);
+                _sub_count_process(db, branch, topic, count, tenant_guid);
             }
         }
     }
 
-    HASH_FIND_STR(subhier->children_hash_table, "#", s);
-    if(s){
+    branch = _sub_child_find(subhier, &_pound_token);
+    if(branch){
         /* The topic matches due to a # wildcard - process the
          * subscriptions but *don't* return. Although this branch has ended
          * there may still be other subscriptions to deal with.
          */
-        _sub_count_process(db, s->subheir, topic, count, tenant_guid);
+        _sub_count_process(db, branch, topic, count, tenant_guid);
         flag = -1;
     }
 
@@ -903,28 +1790,25 @@ static int _sub_count_search(struct mosquitto_db *db, struct _mosquitto_subhier
 int mqtt3_sub_count(struct mosquitto_db *db, const char *topic, int *count, const char* tenant_guid)
 {
     int rc = 0;
-    struct _sub_token *tokens = NULL, *tail;
-    struct subheir_hash *s = 0;
+    struct _mosquitto_subhier *subhier;
+    struct _sub_tokens topics; // DXL
+    struct _sub_token *tokens;
 
     assert(db);
     assert(topic);
 
-    if(_sub_topic_tokenise(topic, &tokens)) return 1;
+    if(_sub_topic_tokenise(topic, &topics)) return 1;
+    tokens = topics.tokens;
 
-    HASH_FIND_STR(db->subs.children_hash_table, tokens->topic, s);
-    if(s){
-        rc = _sub_count_search(db, s->subheir, tokens, topic, count, tenant_guid);
+    subhier = _sub_child_find(&db->subs, tokens); // DXL
+    if(subhier){
+        rc = _sub_count_search(db, subhier, tokens, topic, count, tenant_guid);
         if(rc == -1){
-            _sub_count_process(db, s->subheir, topic, count, tenant_guid);
+            _sub_count_process(db, subhier, topic, count, tenant_guid);
             rc = 0;
         }
     }
-    while(tokens){
-        tail = tokens->next;
-        _mosquitto_free(tokens->topic);
-        _mosquitto_free(tokens);
-        tokens = tail;
-    }
+    _sub_tokens_free(&topics); // DXL
 
     return rc;
 }
@@ -0,0 +1,156 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+/*
+ * DXL: Hierarchical timer wheel
+ *
+ * Timers are kept in two wheels of doubly linked slot lists. The inner wheel
+ * has a slot for each of the next 256 seconds. The outer wheel has a slot for
+ * each of the next 64 blocks of 256 seconds; when the inner wheel reaches the
+ * start of a block, the timers of the corresponding outer slot are cascaded into
+ * the inner wheel. Timers that are further out than the outer wheel covers are
+ * parked in its last slot and re-placed each time it is cascaded.
+ *
+ * Scheduling and cancelling are O(1), and processing a second only touches the
+ * timers that expire (or cascade) in that second. The wheel is not thread safe,
+ * it must only be used by the main loop.
+ */
+
+#include <config.h>
+
+#include <mosquitto_broker.h>
+#include <time_mosq.h>
+
+#define TIMER_INNER_BITS 8
+#define TIMER_INNER_SIZE (1 << TIMER_INNER_BITS)
+#define TIMER_INNER_MASK (TIMER_INNER_SIZE - 1)
+#define TIMER_OUTER_SIZE 64
+#define TIMER_OUTER_MASK (TIMER_OUTER_SIZE - 1)
+
+static struct mosquitto_timer *inner_wheel[TIMER_INNER_SIZE];
+static struct mosquitto_timer *outer_wheel[TIMER_OUTER_SIZE];
+/* The next second whose inner slot has not been processed (0 until first use) */
+static time_t wheel_next = 0;
+/* The count of scheduled timers */
+static int timer_count = 0;
+
+static void timer_link(struct mosquitto_timer **slot, struct mosquitto_timer *timer)
+{
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = *slot;
+    if(*slot){
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+}
+
+static void timer_unlink(struct mosquitto_timer *timer)
+{
+    if(timer->prev){
+        timer->prev->next = timer->next;
+    }else{
+        *timer->slot = timer->next;
+    }
+    if(timer->next){
+        timer->next->prev = timer->prev;
+    }
+    timer->slot = NULL;
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+/* Links the timer into the slot that is due when (or before) the timer expires */
+static void timer_place(struct mosquitto_timer *timer)
+{
+    time_t expiry = (timer->expiry > wheel_next ? timer->expiry : wheel_next);
+    time_t block = expiry >> TIMER_INNER_BITS;
+    time_t next_block = wheel_next >> TIMER_INNER_BITS;
+
+    if(expiry - wheel_next < TIMER_INNER_SIZE){
+        timer_link(&inner_wheel[expiry & TIMER_INNER_MASK], timer);
+    }else if(block - next_block < TIMER_OUTER_SIZE){
+        timer_link(&outer_wheel[block & TIMER_OUTER_MASK], timer);
+    }else{
+        /* Beyond the outer wheel, re-placed when the last slot is cascaded */
+        timer_link(&outer_wheel[(next_block + TIMER_OUTER_SIZE - 1) & TIMER_OUTER_MASK], timer);
+    }
+}
+
+/* Moves the timers of a slot onto a private list (so callbacks can cancel them) */
+static void timer_detach(struct mosquitto_timer **slot, struct mosquitto_timer **list)
+{
+    struct mosquitto_timer *timer;
+
+    *list = *slot;
+    *slot = NULL;
+    for(timer = *list; timer; timer = timer->next){
+        timer->slot = list;
+    }
+}
+
+static void timer_start()
+{
+    if(!wheel_next){
+        wheel_next = mosquitto_time_cached();
+    }
+}
+
+void mosquitto_timer_schedule(struct mosquitto_timer *timer, time_t expiry)
+{
+    timer_start();
+    if(timer->slot){
+        timer_unlink(timer);
+    }else{
+        timer_count++;
+    }
+    timer->expiry = expiry;
+    timer_place(timer);
+}
+
+void mosquitto_timer_cancel(struct mosquitto_timer *timer)
+{
+    if(timer->slot){
+        timer_unlink(timer);
+        timer_count--;
+    }
+}
+
+void mosquitto_timer_process(time_t now)
+{
+    struct mosquitto_timer *list;
+    struct mosquitto_timer *timer;
+    time_t second;
+
+    timer_start();
+    while(wheel_next <= now){
+        second = wheel_next;
+        if(!(second & TIMER_INNER_MASK)){
+            timer_detach(&outer_wheel[(second >> TIMER_INNER_BITS) & TIMER_OUTER_MASK], &list);
+            while(list){
+                timer = list;
+                timer_unlink(timer);
+                timer_place(timer);
+            }
+        }
+
+        timer_detach(&inner_wheel[second & TIMER_INNER_MASK], &list);
+        wheel_next = second + 1;
+        while(list){
+            timer = list;
+            timer_unlink(timer);
+            if(timer->expiry > second){
+                timer_place(timer);
+            }else{
+                timer_count--;
+                timer->callback(timer, now);
+            }
+        }
+    }
+}
+
+int mosquitto_timer_count()
+{
+    return timer_count;
+}
@@ -177,6 +177,7 @@ callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
                     }
                     LOG_DEBUG("Destroy WSI-1: wsi[%p] num_id[%d]", (void*)wsi, mosq->numericId);
                     mosq->wsi = NULL;
+                    mosquitto_context_timer_update(mosq, mosquitto_time_cached()); // DXL
                 }
                 HASH_DEL(wsi_context_map, s);
                 free(s);
@@ -192,6 +193,7 @@ callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
                     }
                     LOG_DEBUG("Destroy WSI: wsi[%p] num_id[%d]", (void*)wsi, mosq->numericId);
                     mosq->wsi = NULL;
+                    mosquitto_context_timer_update(mosq, mosquitto_time_cached()); // DXL
                 }
                 data->mosq = NULL;
             }
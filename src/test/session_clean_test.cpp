@@ -0,0 +1,205 @@
+/******************************************************************************
+ * Copyright (c) 2018 McAfee, LLC - All Rights Reserved.
+ *****************************************************************************/
+
+/*
+ * Tests of the queue of the sessions to clean (session_clean.c), in particular
+ * of clean session clients that reconnect (and take over their session) before
+ * the queued sessions are cleaned.
+ */
+
+#include <config.h>
+#include <mosquitto_broker.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+/** The count of failed checks */
+static int g_failures = 0;
+
+#define CHECK( condition ) \
+    if( !( condition ) ) \
+    { \
+        fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition ); \
+        g_failures++; \
+    }
+
+/**
+ * Creates a client context
+ *
+ * @param   id The numeric identifier of the context
+ * @return  The context
+ */
+static struct mosquitto* createContext( int id )
+{
+    struct mosquitto* context = (struct mosquitto*)calloc( 1, sizeof( struct mosquitto ) );
+    context->numericId = id;
+    return context;
+}
+
+/**
+ * Returns the contexts that remain to be cleaned (as the maintenance tick cleans them)
+ *
+ * @return  The contexts that remain to be cleaned, in order
+ */
+static vector<struct mosquitto*> drain()
+{
+    vector<struct mosquitto*> contexts;
+    struct mosquitto* context;
+    while( ( context = mosquitto_clean_session_next() ) )
+    {
+        contexts.push_back( context );
+    }
+    return contexts;
+}
+
+/**
+ * A client disconnects, reconnects (taking over its session), and disconnects again before
+ * the sessions are cleaned. Its session must be cleaned once.
+ */
+static void testTakeoverThenDisconnect()
+{
+    struct mosquitto* context = createContext( 1 );
+
+    CHECK( mosquitto_clean_session_queue( context ) );
+    // The takeover of the session (mqtt3_handle_connect)
+    mosquitto_clean_session_cancel( context );
+    CHECK( !context->clean_subs );
+    CHECK( mosquitto_clean_session_count() == 0 );
+    CHECK( mosquitto_clean_session_queue( context ) );
+    CHECK( mosquitto_clean_session_count() == 1 );
+
+    vector<struct mosquitto*> cleaned = drain();
+    CHECK( cleaned.size() == 1 && cleaned[0] == context );
+    CHECK( mosquitto_clean_session_count() == 0 );
+    free( context );
+}
+
+/**
+ * A client disconnects and reconnects before the sessions are cleaned. Its session must
+ * not be cleaned, and the other sessions must be.
+ */
+static void testTakeover()
+{
+    struct mosquitto* first = createContext( 1 );
+    struct mosquitto* taken = createContext( 2 );
+    struct mosquitto* last = createContext( 3 );
+
+    CHECK( mosquitto_clean_session_queue( first ) );
+    CHECK( mosquitto_clean_session_queue( taken ) );
+    CHECK( mosquitto_clean_session_queue( last ) );
+    mosquitto_clean_session_cancel( taken );
+    CHECK( mosquitto_clean_session_count() == 2 );
+
+    vector<struct mosquitto*> cleaned = drain();
+    CHECK( cleaned.size() == 2 && cleaned[0] == first && cleaned[1] == last );
+    CHECK( !taken->clean_subs );
+
+    // The session is cleaned when the client disconnects again
+    CHECK( mosquitto_clean_session_queue( taken ) );
+    cleaned = drain();
+    CHECK( cleaned.size() == 1 && cleaned[0] == taken );
+
+    free( first );
+    free( taken );
+    free( last );
+}
+
+/**
+ * A session is queued once, however often it is queued, including while it is being cleaned.
+ */
+static void testQueueOnce()
+{
+    struct mosquitto* context = createContext( 1 );
+
+    CHECK( mosquitto_clean_session_queue( context ) );
+    CHECK( mosquitto_clean_session_queue( context ) );
+    CHECK( mosquitto_clean_session_count() == 1 );
+
+    CHECK( mosquitto_clean_session_next() == context );
+    CHECK( mosquitto_clean_session_queue( context ) );
+    CHECK( mosquitto_clean_session_next() == NULL );
+    free( context );
+}
+
+/**
+ * Cancelling a session that is not queued has no effect, including a session whose
+ * position in the queue has since been reused by another session.
+ */
+static void testCancelNotQueued()
+{
+    struct mosquitto* context = createContext( 1 );
+    struct mosquitto* other = createContext( 2 );
+
+    mosquitto_clean_session_cancel( context );
+    CHECK( mosquitto_clean_session_count() == 0 );
+
+    CHECK( mosquitto_clean_session_queue( context ) );
+    CHECK( mosquitto_clean_session_next() == context );
+    CHECK( mosquitto_clean_session_next() == NULL );
+    CHECK( mosquitto_clean_session_queue( other ) );
+    CHECK( other->clean_subs_index == context->clean_subs_index );
+    mosquitto_clean_session_cancel( context );
+    CHECK( mosquitto_clean_session_count() == 1 );
+    CHECK( mosquitto_clean_session_next() == other );
+    CHECK( mosquitto_clean_session_next() == NULL );
+
+    free( context );
+    free( other );
+}
+
+/**
+ * Many sessions, half of which are taken over, some of them after reconnecting twice.
+ */
+static void testMany()
+{
+    vector<struct mosquitto*> contexts;
+    for( int i = 0; i < 1000; i++ )
+    {
+        contexts.push_back( createContext( i ) );
+        CHECK( mosquitto_clean_session_queue( contexts[i] ) );
+    }
+    for( int i = 0; i < 1000; i += 2 )
+    {
+        mosquitto_clean_session_cancel( contexts[i] );
+        if( i % 4 == 0 )
+        {
+            CHECK( mosquitto_clean_session_queue( contexts[i] ) );
+        }
+    }
+    CHECK( mosquitto_clean_session_count() == 750 );
+
+    vector<struct mosquitto*> cleaned = drain();
+    CHECK( cleaned.size() == 750 );
+    vector<int> counts( contexts.size(), 0 );
+    for( size_t i = 0; i < cleaned.size(); i++ )
+    {
+        counts[cleaned[i]->numericId]++;
+    }
+    for( int i = 0; i < 1000; i++ )
+    {
+        CHECK( counts[i] == ( i % 2 == 0 && i % 4 != 0 ? 0 : 1 ) );
+        free( contexts[i] );
+    }
+}
+
+int main()
+{
+    testTakeoverThenDisconnect();
+    testTakeover();
+    testQueueOnce();
+    testCancelNotQueued();
+    testMany();
+
+    if( g_failures )
+    {
+        fprintf( stderr, "session_clean_test: %d checks failed\n", g_failures );
+        return 1;
+    }
+    printf( "session_clean_test: passed\n" );
+    return 0;
+}